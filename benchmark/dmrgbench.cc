@@ -0,0 +1,526 @@
+#include "core.h"
+#include "model/spinhalf.h"
+#include "model/spinone.h"
+#include "model/hubbard.h"
+#include "model/tj.h"
+#include "hams/Heisenberg.h"
+#include "hams/J1J2Chain.h"
+#include "hams/ExtendedHubbard.h"
+#include "hams/tJChain.h"
+#include "cputime.h"
+#include "boost/property_tree/ptree.hpp"
+#include "boost/property_tree/json_parser.hpp"
+#include <unistd.h>
+#include <sys/wait.h>
+using boost::format;
+using namespace std;
+
+//
+// End-to-end DMRG benchmarks
+//
+// Runs a set of standard DMRG calculations with
+// fixed Sweeps, reports the wall time of each sweep,
+// peak memory, energies and the flop rate of the
+// eigensolver, and optionally compares them to the
+// results of an earlier run.
+//
+// Usage: dmrgbench [-l] [-o results.json] [-b baseline.json]
+//                  [-t tolerance] [-r repeats] [workload ...]
+//
+//   -l  list the workloads and exit
+//   -o  write the results as JSON (as read by -b)
+//   -b  compare to the results in baseline.json, exiting
+//       with status 1 if a workload got slower or used more
+//       memory by more than the tolerance or if its energy changed
+//   -t  relative tolerance of the comparison (default 0.1)
+//   -r  run each workload this many times and keep the
+//       fastest run (default 1)
+//
+// All workloads are run if none are named.
+//
+// Every workload starts from the same product state,
+// so the sequence of operations (and the energies) are
+// the same from run to run.
+// Each run of a workload is done in a child process of
+// its own, so its peak memory (the maximum resident set
+// size of the child) does not include that of the 
+// workloads run before it.
+//
+
+struct SweepResult
+    {
+    int sweep,
+        maxm;
+    Real energy,
+         wall,
+         eig_wall,
+         flops;
+    };
+
+struct Result
+    {
+    Result() : N(0), energy(0), wall(0), peak_mem(0) { }
+
+    string name;
+    int N;
+    Real energy,
+         wall,
+         peak_mem;
+    vector<SweepResult> sweeps;
+
+    Real
+    wallPerSweep() const { return sweeps.empty() ? 0. : wall/sweeps.size(); }
+
+    //Flop rate of the eigensolver in GFlop/s
+    Real
+    gflops() const
+        {
+        Real flops = 0,
+             eig_wall = 0;
+        Foreach(const SweepResult& s, sweeps)
+            {
+            flops += s.flops;
+            eig_wall += s.eig_wall;
+            }
+        return (eig_wall > 0 ? flops/eig_wall/1E9 : 0.);
+        }
+    };
+
+//
+// Observer collecting the timing of every step
+//
+class BenchObserver : public DMRGObserver
+    {
+    public:
+
+    BenchObserver() : DMRGObserver(Opt("PrintEigs",false)) { }
+
+    void
+    measure(int N, int sw, int ha, int b, const Spectrum& spec, Real energy,
+            const OptSet& opts)
+        { }
+
+    void
+    measureStats(const BondStats& st, const OptSet& opts)
+        {
+        stats_.add(st);
+        }
+
+    vector<SweepResult>
+    sweeps(int nsweep) const
+        {
+        vector<SweepResult> res;
+        for(int sw = 1; sw <= nsweep; ++sw)
+            {
+            SweepResult s;
+            s.sweep = sw;
+            s.maxm = 0;
+            s.energy = 0;
+            s.wall = 0;
+            s.eig_wall = 0;
+            s.flops = 0;
+            Foreach(const BondStats& st, stats_.bonds())
+                {
+                if(st.sweep != sw) continue;
+                s.maxm = max(s.maxm,st.m);
+                s.energy = st.energy;
+                s.wall += st.wallTime();
+                s.eig_wall += st.eig_wall;
+                s.flops += st.flops;
+                }
+            res.push_back(s);
+            }
+        return res;
+        }
+
+    private:
+
+    SweepStats stats_;
+    };
+
+template <class Tensor>
+Result
+runDMRG(const string& name, const MPOt<Tensor>& H,
+        const MPSt<Tensor>& psi0, const Sweeps& sweeps)
+    {
+    MPSt<Tensor> psi(psi0);
+    BenchObserver obs;
+
+    Result res;
+    res.name = name;
+    res.N = psi.N();
+
+    const Real t0 = mywalltime();
+    res.energy = dmrg(psi,H,sweeps,obs,Quiet());
+    res.wall = mywalltime()-t0;
+
+    res.peak_mem = mypeakmem();
+    res.sweeps = obs.sweeps(sweeps.nsweep());
+    return res;
+    }
+
+//
+// The workloads
+//
+
+Sweeps
+benchSweeps(int nsweep, int maxm)
+    {
+    Sweeps sweeps(nsweep);
+    sweeps.maxm() = maxm/4,maxm/2,maxm;
+    sweeps.minm() = 1;
+    sweeps.cutoff() = 1E-10;
+    sweeps.niter() = 2;
+    sweeps.noise() = 0;
+    return sweeps;
+    }
+
+Result
+runHeisenberg()
+    {
+    const int N = 100;
+    SpinHalf model(N);
+    IQMPO H = Heisenberg(model);
+
+    InitState init(model);
+    for(int i = 1; i <= N; ++i)
+        init.set(i,(i%2==1 ? "Up" : "Dn"));
+
+    return runDMRG("heisenberg",H,IQMPS(init),benchSweeps(6,200));
+    }
+
+Result
+runSpin1()
+    {
+    const int N = 60;
+    SpinOne model(N);
+    IQMPO H = Heisenberg(model);
+
+    InitState init(model);
+    for(int i = 1; i <= N; ++i)
+        init.set(i,(i%2==1 ? "Up" : "Dn"));
+
+    return runDMRG("spin1",H,IQMPS(init),benchSweeps(6,160));
+    }
+
+//A two-leg ladder is only available in its zigzag
+//form: ExtendedHubbard with equal nearest and
+//next-nearest neighbor hopping
+Result
+runHubbardLadder()
+    {
+    const int N = 24;
+    Hubbard model(N);
+    IQMPO H = ExtendedHubbard(model,Opt("U",4.)&Opt("t1",1.)&Opt("t2",1.));
+
+    //Half filling
+    InitState init(model);
+    for(int i = 1; i <= N; ++i)
+        init.set(i,(i%2==1 ? "Up" : "Dn"));
+
+    return runDMRG("hubbard_ladder",H,IQMPS(init),benchSweeps(6,64));
+    }
+
+Result
+runJ1J2()
+    {
+    const int N = 100;
+    SpinHalf model(N);
+    IQMPO H = J1J2Chain(model,Opt("J2",0.2));
+
+    InitState init(model);
+    for(int i = 1; i <= N; ++i)
+        init.set(i,(i%2==1 ? "Up" : "Dn"));
+
+    return runDMRG("j1j2",H,IQMPS(init),benchSweeps(6,160));
+    }
+
+Result
+runTJ()
+    {
+    const int N = 32;
+    tJ model(N);
+    IQMPO H = tJChain(model,Opt("J",0.35)&Opt("t",1.));
+
+    //One hole in every four sites
+    InitState init(model);
+    for(int i = 1; i <= N; ++i)
+        {
+        if(i%4 == 0) init.set(i,"Emp");
+        else         init.set(i,(i%2==1 ? "Up" : "Dn"));
+        }
+
+    return runDMRG("tj",H,IQMPS(init),benchSweeps(6,64));
+    }
+
+struct Workload
+    {
+    const char* name;
+    const char* description;
+    Result (*run)();
+    };
+
+const Workload workloads[] =
+    {
+    { "heisenberg", "S=1/2 Heisenberg chain, N=100 (IQ)", runHeisenberg },
+    { "spin1", "S=1 Heisenberg chain, N=60 (IQ)", runSpin1 },
+    { "hubbard_ladder", "Hubbard zigzag ladder, N=24, U=4 (IQ)", runHubbardLadder },
+    { "j1j2", "J1-J2 chain, N=100, J2=0.2 (IQ)", runJ1J2 },
+    { "tj", "t-J chain, N=32, J=0.35, 1/4 doping (IQ)", runTJ }
+    };
+const int nworkload = sizeof(workloads)/sizeof(Workload);
+
+//
+// Running each workload in a child process
+//
+
+void
+writeResult(ostream& s, const Result& r)
+    {
+    s << format("%d %.17g %.17g %.17g %d\n") 
+         % r.N % r.energy % r.wall % r.peak_mem % r.sweeps.size();
+    Foreach(const SweepResult& sw, r.sweeps)
+        {
+        s << format("%d %d %.17g %.17g %.17g %.17g\n")
+             % sw.sweep % sw.maxm % sw.energy % sw.wall % sw.eig_wall % sw.flops;
+        }
+    }
+
+Result
+readResult(istream& s, const string& name)
+    {
+    Result r;
+    r.name = name;
+    int nsweep = 0;
+    s >> r.N >> r.energy >> r.wall >> r.peak_mem >> nsweep;
+    r.sweeps.resize(max(0,nsweep));
+    Foreach(SweepResult& sw, r.sweeps)
+        {
+        s >> sw.sweep >> sw.maxm >> sw.energy >> sw.wall >> sw.eig_wall >> sw.flops;
+        }
+    if(!s) Error("dmrgbench: could not read result of " + name);
+    return r;
+    }
+
+//Runs w in a forked child, which sends 
+//its Result back through a pipe
+Result
+runIsolated(const Workload& w)
+    {
+    int fd[2];
+    if(pipe(fd) != 0) Error("dmrgbench: could not create pipe");
+    cout.flush();
+
+    const pid_t pid = fork();
+    if(pid < 0) Error("dmrgbench: could not fork");
+    if(pid == 0)
+        {
+        close(fd[0]);
+        int status = 0;
+        try {
+            ostringstream os;
+            writeResult(os,w.run());
+            const string out = os.str();
+            size_t done = 0;
+            while(done < out.size())
+                {
+                const ssize_t n = write(fd[1],out.data()+done,out.size()-done);
+                if(n <= 0) { status = 1; break; }
+                done += n;
+                }
+            }
+        catch(const ITError& e)
+            {
+            cerr << "dmrgbench: " << w.name << ": " << e << endl;
+            status = 1;
+            }
+        catch(const std::exception& e)
+            {
+            cerr << "dmrgbench: " << w.name << ": " << e.what() << endl;
+            status = 1;
+            }
+        close(fd[1]);
+        cout.flush();
+        _exit(status);
+        }
+
+    close(fd[1]);
+    string in;
+    char buf[4096];
+    ssize_t n = 0;
+    while((n = read(fd[0],buf,sizeof(buf))) > 0) in.append(buf,n);
+    close(fd[0]);
+
+    int status = 0;
+    waitpid(pid,&status,0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+        Error(string("dmrgbench: workload ") + w.name + " failed");
+        }
+
+    istringstream is(in);
+    return readResult(is,w.name);
+    }
+
+//
+// Output and comparison
+//
+
+void
+writeJSON(ostream& s, const vector<Result>& results)
+    {
+    s << "{\n\"workloads\": [\n";
+    for(size_t n = 0; n < results.size(); ++n)
+        {
+        const Result& r = results[n];
+        s << format("{\"name\": \"%s\", \"N\": %d, \"energy\": %.14g, \"wall\": %.6g, "
+                    "\"wall_per_sweep\": %.6g, \"peak_mem\": %.0f, \"gflops\": %.6g,\n")
+             % r.name % r.N % r.energy % r.wall % r.wallPerSweep() % r.peak_mem % r.gflops();
+        s << " \"sweeps\": [\n";
+        for(size_t j = 0; j < r.sweeps.size(); ++j)
+            {
+            const SweepResult& sw = r.sweeps[j];
+            s << format("  {\"sweep\": %d, \"maxm\": %d, \"energy\": %.14g, \"wall\": %.6g, \"gflops\": %.6g}%s\n")
+                 % sw.sweep % sw.maxm % sw.energy % sw.wall
+                 % (sw.eig_wall > 0 ? sw.flops/sw.eig_wall/1E9 : 0.)
+                 % (j+1 < r.sweeps.size() ? "," : "");
+            }
+        s << " ]}" << (n+1 < results.size() ? "," : "") << "\n";
+        }
+    s << "]\n}" << endl;
+    }
+
+void
+printResult(const Result& r)
+    {
+    cout << format("%-15s E = %.10f  %.3fs (%.3fs/sweep)  %.2f GFlop/s  peak mem %.1f MB\n")
+            % r.name % r.energy % r.wall % r.wallPerSweep() % r.gflops() % (r.peak_mem/1E6);
+    Foreach(const SweepResult& s, r.sweeps)
+        {
+        cout << format("    sweep %d: m = %d, E = %.10f, %.3fs\n")
+                % s.sweep % s.maxm % s.energy % s.wall;
+        }
+    }
+
+//Returns the number of regressions
+int
+compare(const vector<Result>& results, const string& basefile, Real tol)
+    {
+    using boost::property_tree::ptree;
+    ptree base;
+    try {
+        read_json(basefile,base);
+        }
+    catch(const std::exception& e)
+        {
+        cout << "Could not read baseline " << basefile << ": " << e.what() << endl;
+        return 1;
+        }
+
+    cout << format("\nComparison to %s (tolerance %.0f%%):\n") % basefile % (100*tol);
+    cout << format("%-15s %12s %12s %8s %10s %10s  %s\n")
+            % "workload" % "base s/sw" % "new s/sw" % "change" % "base MB" % "new MB" % "status";
+
+    int nregress = 0;
+    Foreach(const Result& r, results)
+        {
+        const ptree* b = 0;
+        Foreach(const ptree::value_type& w, base.get_child("workloads"))
+            {
+            if(w.second.get<string>("name") == r.name) b = &w.second;
+            }
+        if(b == 0)
+            {
+            cout << format("%-15s not in baseline\n") % r.name;
+            continue;
+            }
+
+        const Real bt = b->get<Real>("wall_per_sweep"),
+                   bm = b->get<Real>("peak_mem"),
+                   be = b->get<Real>("energy");
+
+        string status;
+        if(r.wallPerSweep() > (1+tol)*bt) status += " SLOWER";
+        if(r.peak_mem > (1+tol)*bm) status += " MORE-MEMORY";
+        if(fabs(r.energy-be) > 1E-8*max(1.,fabs(be))) status += " ENERGY-CHANGED";
+        if(status.empty()) status = " ok";
+        else ++nregress;
+
+        cout << format("%-15s %12.4f %12.4f %+7.1f%% %10.1f %10.1f %s\n")
+                % r.name % bt % r.wallPerSweep() % (bt > 0 ? 100*(r.wallPerSweep()/bt-1) : 0.)
+                % (bm/1E6) % (r.peak_mem/1E6) % status;
+        }
+    return nregress;
+    }
+
+int
+main(int argc, char* argv[])
+    {
+    string outfile,
+           basefile;
+    Real tol = 0.1;
+    int nrepeat = 1;
+    vector<string> names;
+
+    for(int a = 1; a < argc; ++a)
+        {
+        const string arg(argv[a]);
+        const bool has_val = (a+1 < argc);
+        if(arg == "-l")
+            {
+            for(int n = 0; n < nworkload; ++n)
+                cout << format("%-15s %s\n") % workloads[n].name % workloads[n].description;
+            return 0;
+            }
+        else if(arg == "-o" && has_val) outfile = argv[++a];
+        else if(arg == "-b" && has_val) basefile = argv[++a];
+        else if(arg == "-t" && has_val) tol = atof(argv[++a]);
+        else if(arg == "-r" && has_val) nrepeat = max(1,atoi(argv[++a]));
+        else if(arg[0] == '-')
+            {
+            cout << "Usage: " << argv[0] << " [-l] [-o results.json] [-b baseline.json]"
+                 << " [-t tolerance] [-r repeats] [workload ...]" << endl;
+            return 1;
+            }
+        else names.push_back(arg);
+        }
+
+    vector<const Workload*> torun;
+    for(int n = 0; n < nworkload; ++n)
+        {
+        if(names.empty() || find(names.begin(),names.end(),workloads[n].name) != names.end())
+            torun.push_back(&workloads[n]);
+        }
+    if(torun.size() < names.size())
+        {
+        cout << "Unknown workload, run " << argv[0] << " -l for the list" << endl;
+        return 1;
+        }
+
+    vector<Result> results;
+    Foreach(const Workload* w, torun)
+        {
+        Result best;
+        for(int rep = 0; rep < nrepeat; ++rep)
+            {
+            const Result r = runIsolated(*w);
+            if(rep == 0 || r.wall < best.wall) best = r;
+            }
+        printResult(best);
+        results.push_back(best);
+        }
+
+    if(!outfile.empty())
+        {
+        ofstream f(outfile.c_str());
+        writeJSON(f,results);
+        cout << "\nWrote " << outfile << endl;
+        }
+
+    if(!basefile.empty() && compare(results,basefile,tol) > 0)
+        {
+        return 1;
+        }
+
+    return 0;
+    }
@@ -0,0 +1,148 @@
+#include "core.h"
+#include "tensortrace.h"
+#include "threadpool.h"
+using boost::format;
+using namespace std;
+
+//
+// Reruns the tensor operations recorded in a
+// trace file (see tensortrace.h) and compares
+// their timings to the recorded ones.
+//
+// To record a trace, run a program with environment
+// variable ITENSOR_TRACE set to the trace file name
+// (and ITENSOR_TRACE_DATA=1 to include the tensor
+// elements), e.g.
+//
+//   ITENSOR_TRACE=heisenberg.trace ./dmrgbench heisenberg
+//
+// Usage: tracereplay [-s] [-n nthread] [-r repeats] [-m nslow] tracefile
+//
+//   -s  only print a description of every record
+//   -n  number of threads of the thread pool, also
+//       used by svdRank2 for IQTensor blocks (default 1)
+//   -r  rerun each operation this many times and
+//       keep the fastest time (default 1)
+//   -m  list the nslow slowest operations (default 10)
+//
+// Building this program against a modified library
+// (or running it with different thread counts) gives
+// the change in time of every kind of operation.
+//
+
+struct OpTimes
+    {
+    OpTimes() : count(0), recorded(0), replayed(0) { }
+
+    long count;
+    Real recorded,
+         replayed;
+    };
+
+int
+main(int argc, char* argv[])
+    {
+    bool summary_only = false;
+    int nthread = 1,
+        nrepeat = 1,
+        nslow = 10;
+    string fname;
+
+    for(int a = 1; a < argc; ++a)
+        {
+        const string arg(argv[a]);
+        const bool has_val = (a+1 < argc);
+        if(arg == "-s") summary_only = true;
+        else if(arg == "-n" && has_val) nthread = max(1,atoi(argv[++a]));
+        else if(arg == "-r" && has_val) nrepeat = max(1,atoi(argv[++a]));
+        else if(arg == "-m" && has_val) nslow = max(0,atoi(argv[++a]));
+        else if(arg[0] != '-' && fname.empty()) fname = arg;
+        else
+            {
+            fname.clear();
+            break;
+            }
+        }
+    if(fname.empty())
+        {
+        cout << "Usage: " << argv[0]
+             << " [-s] [-n nthread] [-r repeats] [-m nslow] tracefile" << endl;
+        return 1;
+        }
+
+    ThreadPool::instance().resize(nthread);
+    const OptSet opts(NumThreads(nthread));
+
+    TraceReader reader(fname);
+    cout << format("Trace %s (%s tensor elements)\n")
+            % fname % (reader.withData() ? "with" : "without");
+    if(!summary_only)
+        cout << format("Replaying with %d thread(s), best of %d\n") % nthread % nrepeat;
+
+    map<string,OpTimes> times;
+    //Slowest operations as (replay time, description)
+    vector<pair<Real,string> > slowest;
+
+    TraceRecord rec;
+    long nrec = 0;
+    while(reader.next(rec))
+        {
+        ++nrec;
+        if(summary_only)
+            {
+            cout << format("%6d ") % nrec << rec.describe() << endl;
+            continue;
+            }
+
+        Real best = 0;
+        for(int r = 0; r < nrepeat; ++r)
+            {
+            const Real t = rec.replay(opts);
+            if(r == 0 || t < best) best = t;
+            }
+
+        const string name = string(TensorTrace::opName(rec.type)) + (rec.iq ? " (IQ)" : "");
+        OpTimes& ot = times[name];
+        ++ot.count;
+        ot.recorded += rec.wall;
+        ot.replayed += best;
+
+        slowest.push_back(make_pair(best,rec.describe()));
+        if(int(slowest.size()) > 4*nslow+100)
+            {
+            sort(slowest.rbegin(),slowest.rend());
+            slowest.resize(nslow);
+            }
+        }
+
+    if(summary_only) return 0;
+
+    cout << format("\n%-15s %10s %14s %14s %9s\n")
+            % "operation" % "count" % "recorded (s)" % "replayed (s)" % "speedup";
+    OpTimes total;
+    typedef map<string,OpTimes>::const_iterator
+    cit;
+    for(cit it = times.begin(); it != times.end(); ++it)
+        {
+        const OpTimes& ot = it->second;
+        cout << format("%-15s %10d %14.4f %14.4f %9.2f\n")
+                % it->first % ot.count % ot.recorded % ot.replayed
+                % (ot.replayed > 0 ? ot.recorded/ot.replayed : 0.);
+        total.count += ot.count;
+        total.recorded += ot.recorded;
+        total.replayed += ot.replayed;
+        }
+    cout << format("%-15s %10d %14.4f %14.4f %9.2f\n")
+            % "total" % total.count % total.recorded % total.replayed
+            % (total.replayed > 0 ? total.recorded/total.replayed : 0.);
+
+    sort(slowest.rbegin(),slowest.rend());
+    if(int(slowest.size()) > nslow) slowest.resize(nslow);
+    if(!slowest.empty()) cout << "\nSlowest operations (replayed time):\n";
+    for(size_t n = 0; n < slowest.size(); ++n)
+        {
+        cout << format("%.3Es  ") % slowest[n].first << slowest[n].second << endl;
+        }
+
+    return 0;
+    }
@@ -5,6 +5,7 @@
 #ifndef __ITENSOR_DMRGOBSERVER_H
 #define __ITENSOR_DMRGOBSERVER_H
 #include "observer.h"
+#include "fileops.h"
 
 #define Cout std::cout
 #define Endl std::endl
@@ -47,6 +48,11 @@ class DMRGObserver : public Observer
     printEigs() const { return printeigs; }
     void 
     printEigs(bool val) { printeigs = val; }
+
+    void virtual
+    write(std::ostream& s) const;
+    void virtual
+    read(std::istream& s);
     
     private:
 
@@ -60,6 +66,7 @@ class DMRGObserver : public Observer
     bool printeigs;      //Print slowest decaying eigenvalues after every sweep
     int max_eigs;
     Real max_te;
+    Real last_energy;    //Energy at the end of the previous sweep
 
     //
     /////////////
@@ -73,7 +80,8 @@ DMRGObserver(const OptSet& opts)
     orth_weight(opts.getReal("OrthWeight",1)),
     printeigs(opts.getBool("PrintEigs",true)),
     max_eigs(-1),
-    max_te(-1)
+    max_te(-1),
+    last_energy(1000)
     { 
     }
 
@@ -129,8 +137,6 @@ bool inline DMRGObserver::
 checkDone(int sw, Real energy,
           const OptSet& opts)
     {
-    static Real last_energy;
-    
     if(sw == 1) last_energy = 1000;
     if(energy_errgoal > 0 && sw%2 == 0)
         {
@@ -146,13 +152,29 @@ checkDone(int sw, Real energy,
     if(fileExists("STOP_DMRG"))
         {
         Cout << "File STOP_DMRG found: stopping this DMRG run after sweep " << sw << Endl;
-        system("rm -f STOP_DMRG");
+        removeFile("STOP_DMRG");
         return true;
         }
     
     return false;
     }
 
+void inline DMRGObserver::
+write(std::ostream& s) const
+    {
+    s.write((char*) &max_eigs,sizeof(max_eigs));
+    s.write((char*) &max_te,sizeof(max_te));
+    s.write((char*) &last_energy,sizeof(last_energy));
+    }
+
+void inline DMRGObserver::
+read(std::istream& s)
+    {
+    s.read((char*) &max_eigs,sizeof(max_eigs));
+    s.read((char*) &max_te,sizeof(max_te));
+    s.read((char*) &last_energy,sizeof(last_energy));
+    }
+
 #undef Cout
 #undef Endl
 #undef Format
@@ -0,0 +1,297 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "binaryio.h"
+#include <cstdio>
+#include <cstring>
+#include "boost/make_shared.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::vector;
+
+static const char BinaryMagic[] = "ITNSRBIN";
+static const uint32_t BinaryVersion = 1;
+static const uint32_t ByteOrderMark = 0x01020304;
+static const uint64_t PayloadAlign = 64;
+
+struct BinaryHeader
+    {
+    char magic[8];
+    uint32_t version,
+             byteorder,
+             kind,
+             npayload;
+    uint64_t meta_offset,
+             meta_size,
+             table_offset,
+             checksum,
+             reserved;
+    };
+
+//Compile-time check of the header size
+typedef char BinaryHeaderSizeCheck[sizeof(BinaryHeader) == 64 ? 1 : -1];
+
+static const uint64_t FNVBasis = 14695981039346656037ULL;
+
+//64-bit FNV-1a hash of n bytes, continuing from h
+static uint64_t
+fnv1a(const char* p, uint64_t n, uint64_t h = FNVBasis)
+    {
+    for(uint64_t i = 0; i < n; ++i)
+        {
+        h ^= (unsigned char) p[i];
+        h *= 1099511628211ULL;
+        }
+    return h;
+    }
+
+static uint64_t
+alignUp(uint64_t pos, uint64_t a) { return ((pos+a-1)/a)*a; }
+
+//
+// BinaryWriter
+//
+
+BinaryWriter::
+BinaryWriter(const string& fname, int kind)
+    :
+    fname_(fname),
+    tmpname_(fname + ".tmp"),
+    file_(tmpname_.c_str(),std::ios::binary),
+    pos_(0),
+    kind_(kind),
+    closed_(false)
+    {
+    if(!file_.good())
+        Error("Couldn't open file \"" + tmpname_ + "\" for writing");
+    //Header is filled in by close()
+    pad(sizeof(BinaryHeader));
+    }
+
+BinaryWriter::
+~BinaryWriter()
+    {
+    //An unclosed writer means an error occurred
+    //while writing, leave any existing file alone
+    if(!closed_)
+        {
+        file_.close();
+        std::remove(tmpname_.c_str());
+        }
+    }
+
+void BinaryWriter::
+pad(uint64_t newpos)
+    {
+    static const char zeros[PayloadAlign] = { 0 };
+    while(pos_ < newpos)
+        {
+        const uint64_t n = std::min(newpos-pos_,PayloadAlign);
+        file_.write(zeros,n);
+        pos_ += n;
+        }
+    }
+
+int BinaryWriter::
+addPayload(const Vector& v)
+    {
+    if(closed_) Error("BinaryWriter: already closed");
+    //Leave room for the StoreLink header in front
+    //of an aligned payload
+    const uint64_t off = alignUp(pos_+StoreLink::HeaderSize(),PayloadAlign);
+    pad(off);
+
+    Entry e;
+    e.offset = off;
+    e.length = v.Length();
+    const uint64_t nbyte = sizeof(Real)*e.length;
+    const char* p = (const char*) v.Store();
+    e.checksum = fnv1a(p,nbyte);
+    e.reserved = 0;
+    file_.write(p,nbyte);
+    pos_ += nbyte;
+
+    table_.push_back(e);
+    return table_.size()-1;
+    }
+
+void BinaryWriter::
+close()
+    {
+    if(closed_) return;
+
+    const string meta = meta_.str();
+    BinaryHeader h;
+    std::memcpy(h.magic,BinaryMagic,8);
+    h.version = BinaryVersion;
+    h.byteorder = ByteOrderMark;
+    h.kind = kind_;
+    h.npayload = table_.size();
+
+    h.meta_offset = alignUp(pos_,8);
+    pad(h.meta_offset);
+    h.meta_size = meta.size();
+    file_.write(meta.data(),meta.size());
+    pos_ += meta.size();
+
+    h.table_offset = alignUp(pos_,8);
+    pad(h.table_offset);
+    const uint64_t tsize = sizeof(Entry)*table_.size();
+    if(tsize > 0) file_.write((const char*) &table_.front(),tsize);
+    pos_ += tsize;
+
+    h.checksum = fnv1a(meta.data(),meta.size());
+    if(tsize > 0) h.checksum = fnv1a((const char*) &table_.front(),tsize,h.checksum);
+    h.reserved = 0;
+
+    file_.seekp(0);
+    file_.write((const char*) &h,sizeof(h));
+    file_.close();
+    if(file_.fail())
+        Error("BinaryWriter: error writing file \"" + tmpname_ + "\"");
+    //Replacing (rather than overwriting) the file keeps
+    //its old contents valid for anyone still mapping it
+    if(std::rename(tmpname_.c_str(),fname_.c_str()) != 0)
+        Error("BinaryWriter: couldn't rename \"" + tmpname_ + "\" to \"" + fname_ + "\"");
+    closed_ = true;
+    }
+
+//
+// MappedFile
+//
+
+class MappedFile
+    {
+    public:
+
+    MappedFile(const string& fname)
+        : base_(0), size_(0)
+        {
+        const int fd = open(fname.c_str(),O_RDONLY);
+        if(fd < 0) Error("Couldn't open file \"" + fname + "\" for reading");
+        struct stat st;
+        if(fstat(fd,&st) != 0)
+            {
+            ::close(fd);
+            Error("Couldn't determine size of file \"" + fname + "\"");
+            }
+        size_ = st.st_size;
+        if(size_ > 0)
+            {
+            //Private, writable mapping: writes (including the
+            //reference counts in front of each payload) go to
+            //copies of the pages and never to the file
+            void* p = mmap(0,size_,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+            if(p == MAP_FAILED)
+                {
+                ::close(fd);
+                Error("Couldn't map file \"" + fname + "\"");
+                }
+            base_ = (char*) p;
+            }
+        ::close(fd);
+        }
+
+    ~MappedFile()
+        {
+        if(base_ != 0) munmap(base_,size_);
+        }
+
+    char*
+    base() const { return base_; }
+
+    uint64_t
+    size() const { return size_; }
+
+    private:
+
+    char* base_;
+    uint64_t size_;
+
+    //Not copyable
+    MappedFile(const MappedFile&);
+    void operator=(const MappedFile&);
+
+    };
+
+//
+// BinaryReader
+//
+
+bool BinaryReader::
+isBinary(const string& fname)
+    {
+    std::ifstream s(fname.c_str(),std::ios::binary);
+    char magic[8];
+    s.read(magic,8);
+    return s.good() && std::memcmp(magic,BinaryMagic,8) == 0;
+    }
+
+BinaryReader::
+BinaryReader(const string& fname, const OptSet& opts)
+    :
+    map_(boost::make_shared<MappedFile>(fname)),
+    kind_(0),
+    version_(0),
+    npayload_(0),
+    table_offset_(0),
+    verify_(opts.getBool("Verify",false))
+    {
+    const MappedFile& m = *map_;
+    if(m.size() < sizeof(BinaryHeader))
+        Error("BinaryReader: file \"" + fname + "\" too short");
+    BinaryHeader h;
+    std::memcpy(&h,m.base(),sizeof(h));
+    if(std::memcmp(h.magic,BinaryMagic,8) != 0)
+        Error("BinaryReader: \"" + fname + "\" is not an ITensor binary file");
+    if(h.byteorder != ByteOrderMark)
+        Error("BinaryReader: \"" + fname + "\" was written with a different byte order");
+    if(h.version < 1 || h.version > BinaryVersion)
+        Error("BinaryReader: \"" + fname + "\" has an unsupported format version");
+
+    const uint64_t tsize = sizeof(BinaryWriter::Entry)*h.npayload;
+    if(h.meta_offset+h.meta_size > m.size() || h.table_offset+tsize > m.size())
+        Error("BinaryReader: file \"" + fname + "\" is truncated");
+
+    const char* meta = m.base()+h.meta_offset;
+    const char* table = m.base()+h.table_offset;
+    if(fnv1a(table,tsize,fnv1a(meta,h.meta_size)) != h.checksum)
+        Error("BinaryReader: checksum mismatch in \"" + fname + "\"");
+
+    kind_ = h.kind;
+    version_ = h.version;
+    npayload_ = h.npayload;
+    table_offset_ = h.table_offset;
+    meta_.str(string(meta,h.meta_size));
+    }
+
+void BinaryReader::
+payload(int k, Vector& v)
+    {
+    if(k < 0 || k >= npayload_)
+        Error("BinaryReader: payload number out of range");
+    BinaryWriter::Entry e;
+    std::memcpy(&e,map_->base()+table_offset_+k*sizeof(e),sizeof(e));
+    const uint64_t nbyte = sizeof(Real)*e.length;
+    if(e.offset % PayloadAlign != 0 || e.offset < uint64_t(StoreLink::HeaderSize())
+    || e.offset+nbyte > map_->size())
+        {
+        Error("BinaryReader: corrupt payload table");
+        }
+    char* p = map_->base()+e.offset;
+    if(verify_ && fnv1a(p,nbyte) != e.checksum)
+        {
+        Error("BinaryReader: checksum mismatch in tensor data");
+        }
+    if(e.length == 0)
+        {
+        v.ReDimension(0);
+        return;
+        }
+    v.AdoptStorage((Real*) p,e.length);
+    }
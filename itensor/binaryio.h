@@ -0,0 +1,191 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_BINARYIO_H
+#define __ITENSOR_BINARYIO_H
+
+#include "global.h"
+#include <stdint.h>
+#include <sstream>
+
+//
+// Self-describing binary format for ITensors, IQTensors,
+// MPS and MPOs:
+//
+//   [header, 64 bytes]
+//       magic "ITNSRBIN", format version, byte order marker (0x01020304),
+//       kind of object, number of payloads, offset and size of the
+//       metadata, offset of the payload table, checksum of the
+//       metadata and table
+//   [payloads]
+//       tensor data (Reals), each starting on a 64-byte boundary
+//       and preceded by StoreLink::HeaderSize() spare bytes
+//   [metadata]
+//       index sets, scale factors, MPS limits and spectra, in the
+//       format of the write(std::ostream&) methods but with the
+//       number of a payload in place of each data vector
+//   [payload table]
+//       offset, number of Reals and checksum of each payload
+//
+// Checksums are 64-bit FNV-1a hashes.
+//
+// Reading maps the file into memory (privately): tensor data refer
+// to the mapped pages, which are only loaded when touched and only
+// copied (by the operating system) when first written to.
+//
+// A file is written under a temporary name and renamed when complete,
+// so objects still referring to an older version of it stay valid.
+//
+// Files written by writeToFile (the plain write(std::ostream&) format)
+// are recognized by readBinary and read the old way.
+//
+
+class BinaryWriter
+    {
+    public:
+
+    BinaryWriter(const std::string& fname, int kind);
+
+    ~BinaryWriter();
+
+    //Stream receiving the metadata
+    std::ostream&
+    meta() { return meta_; }
+
+    //Writes the data of v, returns its payload number
+    int
+    addPayload(const Vector& v);
+
+    //Writes the metadata, payload table and header
+    void
+    close();
+
+    private:
+
+    friend class BinaryReader;
+
+    struct Entry
+        {
+        uint64_t offset,
+                 length,
+                 checksum,
+                 reserved;
+        };
+
+    std::string fname_,
+                tmpname_;
+    std::ofstream file_;
+    std::ostringstream meta_;
+    std::vector<Entry> table_;
+    uint64_t pos_;
+    int kind_;
+    bool closed_;
+
+    void
+    pad(uint64_t newpos);
+
+    };
+
+class MappedFile;
+
+class BinaryReader
+    {
+    public:
+
+    //Options recognized:
+    //   Verify - compare the checksum of every payload
+    //            (reads all of the data, default false)
+    BinaryReader(const std::string& fname,
+                 const OptSet& opts = Global::opts());
+
+    //True if fname starts with the binary format header
+    static bool
+    isBinary(const std::string& fname);
+
+    int
+    kind() const { return kind_; }
+
+    int
+    version() const { return version_; }
+
+    //Stream holding the metadata
+    std::istream&
+    meta() { return meta_; }
+
+    //Makes v refer to the mapped data of payload k
+    void
+    payload(int k, Vector& v);
+
+    //Keeps the mapped file alive
+    const boost::shared_ptr<MappedFile>&
+    mapping() const { return map_; }
+
+    private:
+
+    boost::shared_ptr<MappedFile> map_;
+    std::istringstream meta_;
+    int kind_,
+        version_,
+        npayload_;
+    uint64_t table_offset_;
+    bool verify_;
+
+    };
+
+//
+// Kinds of objects stored
+//
+enum BinaryKind { bITensor = 1, bIQTensor = 2, bMPS = 3, bIQMPS = 4,
+                  bMPO = 5, bIQMPO = 6 };
+
+class ITensor;
+class IQTensor;
+template <class Tensor>
+class MPSt;
+template <class Tensor>
+class MPOt;
+
+inline int binaryKind(const ITensor&) { return bITensor; }
+inline int binaryKind(const IQTensor&) { return bIQTensor; }
+inline int binaryKind(const MPSt<ITensor>&) { return bMPS; }
+inline int binaryKind(const MPSt<IQTensor>&) { return bIQMPS; }
+inline int binaryKind(const MPOt<ITensor>&) { return bMPO; }
+inline int binaryKind(const MPOt<IQTensor>&) { return bIQMPO; }
+
+//
+// Writes t (an ITensor, IQTensor, MPS or MPO) to fname
+// in the binary format
+//
+template<class T>
+void
+writeBinary(const std::string& fname, const T& t)
+    {
+    BinaryWriter w(fname,binaryKind(t));
+    t.write(w);
+    w.close();
+    }
+
+//
+// Reads t from fname, written by writeBinary or writeToFile.
+// An MPS or MPO must already have its Model.
+//
+template<class T>
+void
+readBinary(const std::string& fname, T& t,
+           const OptSet& opts = Global::opts())
+    {
+    if(!BinaryReader::isBinary(fname))
+        {
+        readFromFile(fname,t);
+        return;
+        }
+    BinaryReader r(fname,opts);
+    if(r.kind() != binaryKind(t))
+        {
+        Error("readBinary: file \"" + fname + "\" holds a different kind of object");
+        }
+    t.read(r);
+    }
+
+#endif
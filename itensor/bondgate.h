@@ -30,6 +30,10 @@ class BondGate
     BondGate(const Model& model, int i, int j, 
              Type type, Real tau, Tensor bondH);
 
+    //Gate given explicitly, for example a product of gates
+    BondGate(int i, int j, Type type, const Tensor& gate)
+        : type_(type), i_(i), j_(j), gate_(gate) { }
+
     operator const Tensor&() const { return gate_; }
 
     const Tensor&
@@ -52,6 +56,14 @@ class BondGate
 
     };
 
+//
+// Gate equal to applying A, then B
+// (A and B must act on the same sites)
+//
+template <class Tensor>
+BondGate<Tensor>
+operator*(const BondGate<Tensor>& B, const BondGate<Tensor>& A);
+
 template <class Tensor>
 BondGate<Tensor>::
 BondGate(const Model& model, int i, int j)
@@ -100,4 +112,20 @@ BondGate(const Model& model, int i, int j,
         }
     }
 
+template <class Tensor>
+BondGate<Tensor>
+operator*(const BondGate<Tensor>& B, const BondGate<Tensor>& A)
+    {
+    if(A.i() != B.i() || A.j() != B.j())
+        {
+        Error("Can only multiply gates acting on the same sites");
+        }
+    Tensor b = B.gate();
+    b.mapprime(1,2);
+    b.mapprime(0,1);
+    Tensor g = A.gate() * b;
+    g.mapprime(2,1);
+    return BondGate<Tensor>(A.i(),A.j(),A.type(),g);
+    }
+
 #endif
@@ -0,0 +1,249 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "compress.h"
+#include <cstring>
+#include <stdint.h>
+
+using std::string;
+using std::vector;
+
+//
+// Layout of compressed data:
+//
+//   magic "ITCMPRS1", uint32 codec, uint32 (unused),
+//   uint64 uncompressed size, then the compressed bytes
+//
+static const char CompressMagic[] = "ITCMPRS1";
+static const size_t HeaderSize = 24;
+
+//Size of the words whose bytes are grouped by the shuffle
+static const size_t ShuffleWidth = sizeof(Real);
+
+//
+// The LZ format: a sequence of
+//
+//   token: (number of literals) << 4 | (match length - MinMatch)
+//   [more literal count bytes if the count is >= 15]
+//   literals
+//   offset of the match (2 bytes, little endian)
+//   [more match length bytes if the length - MinMatch is >= 15]
+//
+// where the final sequence only has literals. Counts >= 15 are
+// continued by bytes which are added up until one is less than 255.
+//
+static const size_t MinMatch = 4;
+static const size_t MaxOffset = 65535;
+static const int HashBits = 16;
+
+Codec
+codecFromName(const string& name)
+    {
+    if(name == "None") return NoCodec;
+    if(name == "LZ") return ShuffleLZ;
+    Error("Unknown compression codec \"" + name + "\", use \"None\" or \"LZ\"");
+    return NoCodec;
+    }
+
+string
+codecName(Codec c)
+    {
+    if(c == ShuffleLZ) return "LZ";
+    return "None";
+    }
+
+static uint32_t
+read32(const unsigned char* p)
+    {
+    uint32_t v;
+    std::memcpy(&v,p,sizeof(v));
+    return v;
+    }
+
+static void
+putCount(string& out, size_t n)
+    {
+    while(n >= 255)
+        {
+        out += char(255);
+        n -= 255;
+        }
+    out += char(n);
+    }
+
+static void
+putSequence(string& out, const unsigned char* lit, size_t nlit,
+            size_t offset, size_t mlen)
+    {
+    const size_t mcode = (mlen >= MinMatch ? mlen-MinMatch : 0);
+    const unsigned char token = (std::min<size_t>(nlit,15) << 4)
+                              | std::min<size_t>(mcode,15);
+    out += char(token);
+    if(nlit >= 15) putCount(out,nlit-15);
+    out.append((const char*) lit,nlit);
+    if(mlen == 0) return; //final sequence
+    out += char(offset & 0xFF);
+    out += char(offset >> 8);
+    if(mcode >= 15) putCount(out,mcode-15);
+    }
+
+static void
+lzCompress(const unsigned char* in, size_t n, string& out)
+    {
+    vector<long> table(1 << HashBits,-1);
+    size_t ip = 0,
+           anchor = 0,
+           misses = 0;
+    while(ip+MinMatch <= n)
+        {
+        const uint32_t seq = read32(in+ip);
+        const uint32_t h = (seq * 2654435761U) >> (32-HashBits);
+        const long ref = table[h];
+        table[h] = ip;
+        if(ref >= 0 && ip-ref <= MaxOffset && read32(in+ref) == seq)
+            {
+            size_t len = MinMatch;
+            while(ip+len < n && in[ref+len] == in[ip+len]) ++len;
+            putSequence(out,in+anchor,ip-anchor,ip-ref,len);
+            ip += len;
+            anchor = ip;
+            misses = 0;
+            }
+        else
+            {
+            //Skip faster through data that does not compress
+            ip += 1 + (misses++ >> 6);
+            }
+        }
+    putSequence(out,in+anchor,n-anchor,0,0);
+    }
+
+static size_t
+getCount(const unsigned char*& ip, const unsigned char* iend, size_t n)
+    {
+    while(true)
+        {
+        if(ip >= iend) throw ITError("decompressBytes: corrupt data");
+        const unsigned char b = *ip++;
+        n += b;
+        if(b < 255) return n;
+        }
+    }
+
+static void
+lzDecompress(const unsigned char* ip, const unsigned char* iend,
+             unsigned char* out, size_t n)
+    {
+    unsigned char* op = out;
+    unsigned char* const oend = out+n;
+    while(ip < iend)
+        {
+        const unsigned char token = *ip++;
+        size_t nlit = token >> 4;
+        if(nlit == 15) nlit = getCount(ip,iend,nlit);
+        if(size_t(iend-ip) < nlit || size_t(oend-op) < nlit)
+            throw ITError("decompressBytes: corrupt data");
+        std::memcpy(op,ip,nlit);
+        ip += nlit;
+        op += nlit;
+        if(ip == iend) break;
+
+        if(iend-ip < 2) throw ITError("decompressBytes: corrupt data");
+        const size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        size_t mlen = token & 15;
+        if(mlen == 15) mlen = getCount(ip,iend,mlen);
+        mlen += MinMatch;
+        if(offset == 0 || offset > size_t(op-out) || size_t(oend-op) < mlen)
+            throw ITError("decompressBytes: corrupt data");
+        //Matches may overlap the bytes they produce
+        const unsigned char* ref = op-offset;
+        for(size_t k = 0; k < mlen; ++k) op[k] = ref[k];
+        op += mlen;
+        }
+    if(op != oend) throw ITError("decompressBytes: corrupt data");
+    }
+
+static void
+shuffle(const unsigned char* in, size_t n, unsigned char* out)
+    {
+    const size_t nw = n/ShuffleWidth;
+    for(size_t w = 0; w < nw; ++w)
+        for(size_t b = 0; b < ShuffleWidth; ++b)
+            {
+            out[b*nw+w] = in[w*ShuffleWidth+b];
+            }
+    std::memcpy(out+nw*ShuffleWidth,in+nw*ShuffleWidth,n-nw*ShuffleWidth);
+    }
+
+static void
+unshuffle(const unsigned char* in, size_t n, unsigned char* out)
+    {
+    const size_t nw = n/ShuffleWidth;
+    for(size_t w = 0; w < nw; ++w)
+        for(size_t b = 0; b < ShuffleWidth; ++b)
+            {
+            out[w*ShuffleWidth+b] = in[b*nw+w];
+            }
+    std::memcpy(out+nw*ShuffleWidth,in+nw*ShuffleWidth,n-nw*ShuffleWidth);
+    }
+
+static void
+putHeader(string& out, Codec c, uint64_t rawsize)
+    {
+    out.assign(CompressMagic,8);
+    const uint32_t code[2] = { uint32_t(c), 0 };
+    out.append((const char*) code,sizeof(code));
+    out.append((const char*) &rawsize,sizeof(rawsize));
+    }
+
+bool
+isCompressed(const char* data, size_t n)
+    {
+    return n >= 8 && std::memcmp(data,CompressMagic,8) == 0;
+    }
+
+void
+compressBytes(Codec c, const string& in, string& out)
+    {
+    if(c == ShuffleLZ && !in.empty())
+        {
+        vector<unsigned char> sh(in.size());
+        shuffle((const unsigned char*) in.data(),in.size(),&sh.front());
+        putHeader(out,ShuffleLZ,in.size());
+        out.reserve(HeaderSize+in.size()+in.size()/255+16);
+        lzCompress(&sh.front(),sh.size(),out);
+        if(out.size() < HeaderSize+in.size()) return;
+        }
+    //Store as is
+    putHeader(out,NoCodec,in.size());
+    out += in;
+    }
+
+void
+decompressBytes(const string& in, string& out)
+    {
+    if(in.size() < HeaderSize || !isCompressed(in.data(),in.size()))
+        throw ITError("decompressBytes: not compressed data");
+    uint32_t code[2];
+    uint64_t rawsize;
+    std::memcpy(code,in.data()+8,sizeof(code));
+    std::memcpy(&rawsize,in.data()+16,sizeof(rawsize));
+    const unsigned char* ip = (const unsigned char*) in.data()+HeaderSize;
+    const unsigned char* iend = (const unsigned char*) in.data()+in.size();
+
+    if(code[0] == NoCodec)
+        {
+        if(size_t(iend-ip) != rawsize) throw ITError("decompressBytes: corrupt data");
+        out.assign((const char*) ip,rawsize);
+        return;
+        }
+    if(code[0] != ShuffleLZ)
+        throw ITError("decompressBytes: unknown codec");
+
+    vector<unsigned char> sh(rawsize);
+    if(rawsize > 0) lzDecompress(ip,iend,&sh.front(),rawsize);
+    out.resize(rawsize);
+    if(rawsize > 0) unshuffle(&sh.front(),rawsize,(unsigned char*) &out[0]);
+    }
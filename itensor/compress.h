@@ -0,0 +1,189 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_COMPRESS_H
+#define __ITENSOR_COMPRESS_H
+
+#include "fileops.h"
+#include "cputime.h"
+#include <sstream>
+
+//
+// Lossless compression of tensor files.
+//
+// Codecs:
+//
+//   NoCodec   - data written as is (the plain writeToFile format)
+//   ShuffleLZ - bytes of each 8-byte word are grouped together
+//               (all first bytes, then all second bytes, ...),
+//               which puts the similar sign and exponent bytes of
+//               the Reals next to each other, then compressed with
+//               a fast LZ77-style codec
+//
+// The codec is chosen with the option "Compress",
+// "None" (the default) or "LZ".
+//
+// Files that can't be opened and corrupt data throw
+// an ITError (rather than calling Error), so that the 
+// I/O thread of TensorIO can hand them to the caller.
+//
+
+enum Codec { NoCodec = 0, ShuffleLZ = 1 };
+
+Codec
+codecFromName(const std::string& name);
+
+std::string
+codecName(Codec c);
+
+//
+// Amount of data passed through a codec
+// and time spent compressing and decompressing.
+//
+class CodecStats
+    {
+    public:
+
+    CodecStats() { reset(); }
+
+    void
+    reset()
+        {
+        raw_bytes = 0;
+        stored_bytes = 0;
+        time = 0;
+        }
+
+    CodecStats&
+    operator+=(const CodecStats& other)
+        {
+        raw_bytes += other.raw_bytes;
+        stored_bytes += other.stored_bytes;
+        time += other.time;
+        return *this;
+        }
+
+    //Compression ratio (raw size / size on disk)
+    Real
+    ratio() const { return stored_bytes > 0 ? raw_bytes/stored_bytes : 1.; }
+
+    //Bytes (uncompressed) processed per second by the codec
+    Real
+    throughput() const { return time > 0 ? raw_bytes/time : 0.; }
+
+    //Uncompressed size of the data written or read
+    Real raw_bytes;
+    //Size of the data on disk
+    Real stored_bytes;
+    //Wall time (seconds) spent in the codec
+    Real time;
+
+    };
+
+inline std::ostream&
+operator<<(std::ostream& s, const CodecStats& st)
+    {
+    s << boost::format("raw=%.1fMB stored=%.1fMB ratio=%.2f codec=%.3fs (%.0f MB/s)")
+         % (st.raw_bytes/1E6) % (st.stored_bytes/1E6) % st.ratio()
+         % st.time % (st.throughput()/1E6);
+    return s;
+    }
+
+//
+// Compresses in into out (replacing its contents).
+// The result records the codec used, so decompressBytes
+// needs no further information. If the data do not
+// compress they are stored as is.
+//
+void
+compressBytes(Codec c, const std::string& in, std::string& out);
+
+void
+decompressBytes(const std::string& in, std::string& out);
+
+//True if the n bytes at data start with
+//the header written by compressBytes
+bool
+isCompressed(const char* data, size_t n);
+
+//
+// Writes t to the new file fname (see writeToNewFile),
+// compressed with codec c. Adds the amount of data and
+// codec time to st if st is not null.
+//
+template<class T>
+void
+writeCompressed(const std::string& fname, const T& t, Codec c,
+                CodecStats* st = 0)
+    {
+    if(c == NoCodec)
+        {
+        //As writeToNewFile, but throwing on failure
+        removeFile(fname);
+        std::ofstream s(fname.c_str(),std::ios::binary);
+        if(!s.good())
+            throw ITError("Couldn't open file \"" + fname + "\" for writing");
+        t.write(s);
+        s.close();
+        if(s.fail()) throw ITError("Error writing file \"" + fname + "\"");
+        return;
+        }
+    std::ostringstream raw;
+    t.write(raw);
+    const std::string rawdata = raw.str();
+    const Real t0 = mywalltime();
+    std::string data;
+    compressBytes(c,rawdata,data);
+    if(st != 0)
+        {
+        st->time += mywalltime()-t0;
+        st->raw_bytes += rawdata.size();
+        st->stored_bytes += data.size();
+        }
+    removeFile(fname);
+    std::ofstream s(fname.c_str(),std::ios::binary);
+    if(!s.good())
+        throw ITError("Couldn't open file \"" + fname + "\" for writing");
+    s.write(data.data(),data.size());
+    s.close();
+    if(s.fail()) throw ITError("Error writing file \"" + fname + "\"");
+    }
+
+//
+// Reads t from fname, written by writeCompressed
+// with any codec (or by writeToFile).
+//
+template<class T>
+void
+readCompressed(const std::string& fname, T& t, CodecStats* st = 0)
+    {
+    std::ifstream s(fname.c_str(),std::ios::binary);
+    if(!s.good())
+        throw ITError("Couldn't open file \"" + fname + "\" for reading");
+    char head[8];
+    s.read(head,sizeof(head));
+    const bool compressed = isCompressed(head,s.gcount());
+    s.clear();
+    s.seekg(0);
+    if(!compressed)
+        {
+        t.read(s);
+        return;
+        }
+    std::string data((std::istreambuf_iterator<char>(s)),
+                     std::istreambuf_iterator<char>());
+    const Real t0 = mywalltime();
+    std::string rawdata;
+    decompressBytes(data,rawdata);
+    if(st != 0)
+        {
+        st->time += mywalltime()-t0;
+        st->raw_bytes += rawdata.size();
+        st->stored_bytes += data.size();
+        }
+    std::istringstream raw(rawdata);
+    t.read(raw);
+    }
+
+#endif
@@ -36,8 +36,7 @@ conj()
 void Condenser::
 init(const std::string& smallind_name)
     {
-    static std::vector<QN> qns(10);
-    qns.resize(0);
+    std::vector<QN> qns;
     Foreach(const IndexQN& x, bigind_.indices()) 
         qns.push_back(x.qn);
 
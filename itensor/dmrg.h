@@ -10,6 +10,7 @@
 #include "localmpo_mps.h"
 #include "sweeps.h"
 #include "DMRGObserver.h"
+#include "sweepstats.h"
 
 #define Cout std::cout
 #define Endl std::endl
@@ -18,6 +19,27 @@
 //
 // Available DMRG methods:
 //
+// (Passing NumCenter(1) selects single-site DMRG
+//  where the bond dimension grows through subspace
+//  expansion only, with strength set by the sweeps noise,
+//  so a nonzero noise is needed early on in that case.)
+//
+// Checkpoints: with the option Checkpoint("fname"), psi, the
+// edge tensors of the projected Hamiltonian which are up to
+// date, the Observer state and the step reached are saved
+// to fname at the end of each sweep and, if CheckpointEvery
+// is given, also every CheckpointEvery steps. Running again with 
+// Restart(true) and the same arguments resumes at the 
+// saved step without recomputing the edge tensors.
+// Tensors spilled to disk (WriteM or MemoryBudget options)
+// are not copied into fname but hard linked into a snapshot
+// directory next to it, named in fname; use removeCheckpoint
+// to remove both.
+// The checkpoint shares the indices of the Model and of H, 
+// so a new process must read these back with readFromFile
+// (after writing them with writeToFile) instead of making 
+// new ones.
+//
 
 //
 //DMRG with an MPO
@@ -158,6 +180,130 @@ dmrg(MPSt<Tensor>& psi,
 
 
 
+//
+// Checkpoint files
+//
+// The file is written to fname.tmp, flushed to disk and
+// then renamed to fname, so that a job killed while
+// writing leaves the previous checkpoint intact.
+//
+// Tensors of psi and PH held on disk go into a new
+// snapshot directory (see snapshotDir) made next to
+// fname. On entry snapdir is the snapshot directory of 
+// the previous checkpoint, removed once the new one
+// is in place; on return it is that of the new one
+// (empty if all tensors were held in memory).
+//
+
+static const char DMRGCheckpointMagic[] = "ITDMRGC2";
+
+template <class Tensor, class LocalOpT>
+void
+writeCheckpoint(const std::string& fname,
+                int sw, int ha, int b, Real energy,
+                const MPSt<Tensor>& psi,
+                const LocalOpT& PH,
+                const Observer& obs,
+                std::string& snapdir)
+    {
+    std::string newsnap;
+    if(psi.doWrite() || PH.doWrite())
+        {
+        const size_t p = fname.rfind('/');
+        const std::string locn = (p == std::string::npos ? "./" : fname.substr(0,p+1));
+        newsnap = mkTempDir(fname.substr(p+1)+"_snap",locn);
+        }
+
+    const std::string tmpname = fname + ".tmp";
+    std::ofstream s(tmpname.c_str(),std::ios::binary);
+    if(!s.good())
+        Error("Couldn't open file \"" + tmpname + "\" for writing");
+    const int N = psi.N();
+    s.write(DMRGCheckpointMagic,8);
+    const int len = newsnap.size();
+    s.write((char*) &len,sizeof(len));
+    s.write(newsnap.data(),len);
+    s.write((char*) &N,sizeof(N));
+    s.write((char*) &sw,sizeof(sw));
+    s.write((char*) &ha,sizeof(ha));
+    s.write((char*) &b,sizeof(b));
+    s.write((char*) &energy,sizeof(energy));
+    psi.write(s,newsnap);
+    PH.write(s,newsnap);
+    obs.write(s);
+    s.close();
+    if(s.fail() || !syncFile(tmpname))
+        Error("Error writing checkpoint file \"" + tmpname + "\"");
+    if(std::rename(tmpname.c_str(),fname.c_str()) != 0)
+        Error("Couldn't rename \"" + tmpname + "\" to \"" + fname + "\"");
+    if(!snapdir.empty()) removeDir(snapdir);
+    snapdir = newsnap;
+    }
+
+//Opens the checkpoint fname and reads its snapshot directory
+void inline
+openCheckpoint(const std::string& fname, std::ifstream& s, std::string& snapdir)
+    {
+    s.open(fname.c_str(),std::ios::binary);
+    if(!s.good())
+        Error("Couldn't open file \"" + fname + "\" for reading");
+    char magic[8];
+    s.read(magic,8);
+    if(s.gcount() != 8 || std::string(magic,8) != std::string(DMRGCheckpointMagic,8))
+        Error("File \"" + fname + "\" is not a DMRG checkpoint");
+    int len = 0;
+    s.read((char*) &len,sizeof(len));
+    if(s.fail() || len < 0)
+        Error("Checkpoint file \"" + fname + "\" is truncated");
+    std::vector<char> dir(len);
+    if(len > 0) s.read(&dir.front(),len);
+    snapdir.assign(dir.begin(),dir.end());
+    }
+
+template <class Tensor, class LocalOpT>
+void
+readCheckpoint(const std::string& fname,
+               int& sw, int& ha, int& b, Real& energy,
+               MPSt<Tensor>& psi,
+               LocalOpT& PH,
+               Observer& obs,
+               std::string& snapdir)
+    {
+    std::ifstream s;
+    openCheckpoint(fname,s,snapdir);
+    int N = 0;
+    s.read((char*) &N,sizeof(N));
+    if(N != psi.N())
+        Error("Checkpoint \"" + fname + "\" has a different number of sites");
+    s.read((char*) &sw,sizeof(sw));
+    s.read((char*) &ha,sizeof(ha));
+    s.read((char*) &b,sizeof(b));
+    s.read((char*) &energy,sizeof(energy));
+    psi.read(s,snapdir);
+    PH.read(s,snapdir);
+    obs.read(s);
+    if(s.fail())
+        Error("Checkpoint file \"" + fname + "\" is truncated");
+    }
+
+//
+// Removes the checkpoint fname (if it exists)
+// together with its snapshot directory
+//
+void inline
+removeCheckpoint(const std::string& fname)
+    {
+    if(fileExists(fname))
+        {
+        std::ifstream s;
+        std::string snapdir;
+        openCheckpoint(fname,s,snapdir);
+        if(!snapdir.empty()) removeDir(snapdir);
+        }
+    removeFile(fname);
+    removeFile(fname + ".tmp");
+    }
+
 //
 // DMRGWorker
 //
@@ -194,15 +340,77 @@ DMRGWorker(MPSt<Tensor>& psi,
     const int N = psi.N();
     Real energy = NAN;
 
-    psi.position(1);
+    //Step to start at: sweep, half-sweep and bond
+    int sw0 = 1, 
+        ha0 = 1, 
+        b0 = 1;
+
+    const std::string checkpoint = opts.getString("Checkpoint","");
+    //By default only at the end of each sweep
+    const int checkpoint_every = opts.getInt("CheckpointEvery",0);
+    if(checkpoint_every < 0) Error("CheckpointEvery must be >= 0");
+    //Snapshot directory of the last checkpoint
+    std::string snapdir;
+    if(!checkpoint.empty() 
+       && opts.getBool("Restart",false) 
+       && fileExists(checkpoint))
+        {
+        readCheckpoint(checkpoint,sw0,ha0,b0,energy,psi,PH,obs,snapdir);
+        if(!quiet)
+            {
+            Cout << Format("Restarting from checkpoint %s at sweep %d, half-sweep %d, bond %d")
+                    % checkpoint % sw0 % ha0 % b0 << Endl;
+            }
+        }
+    else
+        {
+        psi.position(1);
+        }
 
     opts.add(Opt("DebugLevel",debug_level));
     
     Eigensolver solver(opts);
 
     opts.add(DoNormalize(true));
+
+    //Options of the decomposition done at every step
+    const DecompOpts dopts(opts);
+
+    const bool onesite = (PH.numCenter() == 1);
+
+    //Timing and resource use of each step is passed
+    //to obs.measureStats and, if a StatsFile is given,
+    //written out after every sweep (as JSON if the
+    //file name ends in .json, otherwise as CSV)
+    SweepStats stats;
+    const std::string stats_file = opts.getString("StatsFile","");
+    const bool stats_json = (stats_file.size() >= 5 
+                             && stats_file.substr(stats_file.size()-5) == ".json");
+    if(!stats_file.empty() && !stats_json)
+        {
+        std::ofstream sf(stats_file.c_str());
+        if(!sf.good()) Error("Can't open StatsFile " + stats_file);
+        SweepStats::writeCSVHeader(sf);
+        }
+
+    //With a memory budget (in MB), edge and site tensors
+    //stay in memory as long as they fit; the ones which 
+    //will be needed furthest in the future are spilled to disk
+    const bool use_budget = opts.defined("MemoryBudget");
+    MemoryBudget budget(opts.getReal("MemoryBudget",0)*1E6);
+    if(use_budget)
+        {
+        if(!quiet)
+            {
+            Cout << Format("Using memory budget of %.1f MB, write_dir = %s") 
+                    % (budget.maxBytes()/1E6) % opts.getString("WriteDir","./") << Endl;
+            }
+        psi.memoryBudget(&budget,opts);
+        PH.memoryBudget(&budget);
+        }
     
-    for(int sw = 1; sw <= sweeps.nsweep(); ++sw)
+    int nstep = 0;
+    for(int sw = sw0; sw <= sweeps.nsweep(); ++sw)
         {
         psi.cutoff(sweeps.cutoff(sw)); 
         psi.minm(sweeps.minm(sw)); 
@@ -210,7 +418,8 @@ DMRGWorker(MPSt<Tensor>& psi,
         psi.noise(sweeps.noise(sw));
         solver.maxIter(sweeps.niter(sw));
 
-        if(!PH.doWrite() &&
+        if(!use_budget &&
+            !PH.doWrite() &&
             opts.defined("WriteM") &&
             sweeps.maxm(sw) >= opts.getInt("WriteM"))
             {
@@ -222,25 +431,95 @@ DMRGWorker(MPSt<Tensor>& psi,
                      << write_dir << Endl;
                 }
 
-            psi.doWrite(true);
+            psi.doWrite(true,opts);
             PH.doWrite(true);
             }
 
-        for(int b = 1, ha = 1; ha <= 2; sweepnext(b,ha,N))
+        int b = 1, 
+            ha = 1;
+        if(sw == sw0)
             {
-            if(!quiet)
+            b = b0;
+            ha = ha0;
+            }
+        for(; ha <= 2; sweepnext(b,ha,N))
+            {
+            BondStats st;
+            st.sweep = sw;
+            st.halfsweep = ha;
+            st.bond = b;
+            const Real io0 = PH.ioStats().wait_time + psi.ioStats().wait_time;
+            const long n0 = StoreLink::NumAllocated();
+            Real w0 = mywalltime(),
+                 c0 = mytime(),
+                 a0 = allocBytes();
+
+            if(onesite)
                 {
-                Cout << Format("Sweep=%d, HS=%d, Bond=(%d,%d)") 
-                        % sw % ha % b % (b+1) << Endl;
+                //Optimize the site to the left of bond b
+                //when sweeping right, to the right of it
+                //when sweeping left, then move across b
+                const int j = (ha==1 ? b : b+1);
+
+                if(!quiet)
+                    {
+                    Cout << Format("Sweep=%d, HS=%d, Site=%d") 
+                            % sw % ha % j << Endl;
+                    }
+
+                PH.position(j,psi);
+
+                Tensor phi = psi.A(j);
+
+                st.env_wall = mywalltime()-w0; st.env_cpu = mytime()-c0;
+                st.env_alloc = allocBytes()-a0;
+                w0 = mywalltime(); c0 = mytime(); a0 = allocBytes();
+
+                energy = solver.davidson(PH,phi);
+
+                st.eig_wall = mywalltime()-w0; st.eig_cpu = mytime()-c0;
+                st.eig_alloc = allocBytes()-a0;
+                w0 = mywalltime(); c0 = mytime(); a0 = allocBytes();
+
+                psi.svdSite(j,phi,(ha==1?Fromleft:Fromright),PH,dopts);
                 }
+            else
+                {
+                if(!quiet)
+                    {
+                    Cout << Format("Sweep=%d, HS=%d, Bond=(%d,%d)") 
+                            % sw % ha % b % (b+1) << Endl;
+                    }
 
-            PH.position(b,psi);
+                PH.position(b,psi);
 
-            Tensor phi = psi.bondTensor(b);
+                Tensor phi = psi.bondTensor(b);
 
-            energy = solver.davidson(PH,phi);
-            
-            psi.svdBond(b,phi,(ha==1?Fromleft:Fromright),PH,opts);
+                st.env_wall = mywalltime()-w0; st.env_cpu = mytime()-c0;
+                st.env_alloc = allocBytes()-a0;
+                w0 = mywalltime(); c0 = mytime(); a0 = allocBytes();
+
+                energy = solver.davidson(PH,phi);
+
+                st.eig_wall = mywalltime()-w0; st.eig_cpu = mytime()-c0;
+                st.eig_alloc = allocBytes()-a0;
+                w0 = mywalltime(); c0 = mytime(); a0 = allocBytes();
+                
+                psi.svdBond(b,phi,(ha==1?Fromleft:Fromright),PH,dopts);
+                }
+
+            st.decomp_wall = mywalltime()-w0; 
+            st.decomp_cpu = mytime()-c0;
+            st.decomp_alloc = allocBytes()-a0;
+            st.nalloc = StoreLink::NumAllocated()-n0;
+            st.io_wait = std::max(0.,PH.ioStats().wait_time + psi.ioStats().wait_time - io0);
+            st.niter = solver.lastNumIter();
+            //Davidson does one product per iteration plus one to start
+            st.flops = (st.niter+1)*PH.productFlops();
+            st.m = psi.LinkInd(b).m();
+            st.truncerr = psi.spectrum(b).truncerr();
+            st.energy = energy;
+            st.peak_mem = mypeakmem();
 
             if(!quiet)
                 { 
@@ -258,12 +537,72 @@ DMRGWorker(MPSt<Tensor>& psi,
 
             obs.measure(N,sw,ha,b,psi.spectrum(b),energy,opts);
 
+            stats.add(st);
+            obs.measureStats(st,opts);
+
+            ++nstep;
+            if(!checkpoint.empty() && checkpoint_every > 0 
+               && nstep%checkpoint_every == 0)
+                {
+                //Save the step to do next, the end of 
+                //the sweep is saved below
+                int nb = b,
+                    nha = ha;
+                sweepnext(nb,nha,N);
+                if(nha <= 2) 
+                    writeCheckpoint(checkpoint,sw,nha,nb,energy,psi,PH,obs,snapdir);
+                }
+
             } //for loop over b
+
+        if(!quiet)
+            {
+            Cout << "Sweep " << sw << " timing: " << stats.sweepTotal(sw) << Endl;
+            }
+
+        if(!stats_file.empty())
+            {
+            if(stats_json)
+                {
+                std::ofstream sf(stats_file.c_str());
+                stats.writeJSON(sf);
+                }
+            else
+                {
+                std::ofstream sf(stats_file.c_str(),std::ios::app);
+                stats.writeCSV(sf,sw);
+                }
+            }
+
+        if(PH.doWrite() && !quiet)
+            {
+            Cout << "Disk I/O for environments: " << PH.ioStats() << Endl;
+            Cout << "Disk I/O for wavefunction: " << psi.ioStats() << Endl;
+            if(use_budget)
+                {
+                Cout << Format("Memory in use %.1f MB, %d tensors evicted so far")
+                        % (budget.memUse()/1E6) % budget.nevict() << Endl;
+                }
+            }
         
-        if(obs.checkDone(sw,energy,opts)) break;
+        const bool done = obs.checkDone(sw,energy,opts);
+
+        if(!checkpoint.empty())
+            {
+            const int next_sw = (done ? sweeps.nsweep()+1 : sw+1);
+            writeCheckpoint(checkpoint,next_sw,1,1,energy,psi,PH,obs,snapdir);
+            }
+
+        if(done) break;
     
         } //for loop over sw
     
+    if(use_budget)
+        {
+        psi.memoryBudget(0);
+        PH.memoryBudget(0);
+        }
+
     psi.cutoff(orig_cutoff); 
     psi.minm(orig_minm); 
     psi.maxm(orig_maxm);
@@ -78,6 +78,11 @@ class Eigensolver
     void 
     debugLevel(int val) { debug_level_ = val; }
 
+    //Number of iterations done by the 
+    //most recent call to davidson or genDavidson
+    int 
+    lastNumIter() const { return last_niter_; }
+
     //Other methods ------------
 
     private:
@@ -146,6 +151,7 @@ class Eigensolver
     Real errgoal_;
     int numget_;
     int debug_level_;
+    mutable int last_niter_;
 
     }; //class Eigensolver
 
@@ -153,7 +159,8 @@ class Eigensolver
 inline Eigensolver::
 Eigensolver(const OptSet& opts)
     : 
-    miniter_(1)
+    miniter_(1),
+    last_niter_(0)
     { 
     maxiter_ = opts.getInt("MaxIter",2);
     errgoal_ = opts.getReal("ErrGoal",1E-4);
@@ -481,6 +488,7 @@ davidson(const BigMatrixT& A, Tensor& phi) const
         Print(Vo_final);
         }
 
+    last_niter_ = iter;
 
     if(debug_level_ > 0)
         {
@@ -709,6 +717,8 @@ genDavidson(const BigMatrixTA& A, const BigMatrixTB& B, Tensor& phi) const
 
         } //for(ii)
 
+    last_niter_ = iter;
+
     if(debug_level_ > 0)
         {
         Cout << Format("I %d q %.0E E %.10f")
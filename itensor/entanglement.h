@@ -0,0 +1,121 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_ENTANGLEMENT_H
+#define __ITENSOR_ENTANGLEMENT_H
+
+#include "global.h"
+
+//
+// Entanglement spectrum of every bond of an MPS:
+// eigs(b) are the eigenvalues (in decreasing order,
+// summing to one) of the reduced density matrix
+// of sites 1,...,b.
+//
+// Entropies use the natural logarithm.
+//
+
+class EntanglementProfile
+    {
+    public:
+
+    EntanglementProfile(int N = 0) : eigs_(N > 1 ? N : 1) { }
+
+    //Number of sites
+    int
+    N() const { return eigs_.size(); }
+
+    const Vector&
+    eigs(int b) const { return eigs_.at(b); }
+    void
+    eigs(int b, const Vector& val) { eigs_.at(b) = val; }
+
+    //Von Neumann entropy -sum_k p_k log(p_k)
+    Real
+    vonNeumann(int b) const;
+
+    //Renyi entropy log(sum_k p_k^alpha)/(1-alpha)
+    //(von Neumann entropy for alpha == 1)
+    Real
+    renyi(int b, Real alpha) const;
+
+    void
+    read(std::istream& s);
+    void
+    write(std::ostream& s) const;
+
+    static void
+    writeCSVHeader(std::ostream& s);
+
+    //One line per bond: bond, number of states,
+    //von Neumann and second Renyi entropies
+    void
+    writeCSV(std::ostream& s) const;
+
+    private:
+
+    //eigs_[0] unused
+    std::vector<Vector> eigs_;
+
+    };
+
+inline Real EntanglementProfile::
+vonNeumann(int b) const
+    {
+    const Vector& p = eigs_.at(b);
+    Real S = 0;
+    for(int k = 1; k <= p.Length(); ++k)
+        {
+        if(p(k) > 0) S -= p(k)*log(p(k));
+        }
+    return S;
+    }
+
+inline Real EntanglementProfile::
+renyi(int b, Real alpha) const
+    {
+    if(fabs(alpha-1) < 1E-12) return vonNeumann(b);
+    const Vector& p = eigs_.at(b);
+    Real tr = 0;
+    for(int k = 1; k <= p.Length(); ++k)
+        {
+        if(p(k) > 0) tr += pow(p(k),alpha);
+        }
+    return log(tr)/(1-alpha);
+    }
+
+inline void EntanglementProfile::
+read(std::istream& s)
+    {
+    int N = 0;
+    s.read((char*)&N,sizeof(N));
+    eigs_.assign(N > 1 ? N : 1,Vector());
+    for(int b = 1; b < N; ++b) eigs_.at(b).read(s);
+    }
+
+inline void EntanglementProfile::
+write(std::ostream& s) const
+    {
+    const int N = eigs_.size();
+    s.write((char*)&N,sizeof(N));
+    for(int b = 1; b < N; ++b) eigs_.at(b).write(s);
+    }
+
+inline void EntanglementProfile::
+writeCSVHeader(std::ostream& s)
+    {
+    s << "bond,m,vonNeumann,renyi2\n";
+    }
+
+inline void EntanglementProfile::
+writeCSV(std::ostream& s) const
+    {
+    for(int b = 1; b < N(); ++b)
+        {
+        s << boost::format("%d,%d,%.15E,%.15E\n")
+             % b % eigs_.at(b).Length() % vonNeumann(b) % renyi(b,2);
+        }
+    }
+
+#endif
@@ -0,0 +1,163 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "fileops.h"
+#include "cputime.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+using std::string;
+
+//Clone the contents of file descriptor in into out,
+//sharing the disk blocks
+static bool
+reflinkFile(int in, int out)
+    {
+#ifdef FICLONE
+    return ioctl(out,FICLONE,in) == 0;
+#else
+    return false;
+#endif
+    }
+
+static bool
+copyContents(int in, int out, Real& nbytes)
+    {
+    static const size_t BufSize = 1 << 20;
+    std::vector<char> buf(BufSize);
+    while(true)
+        {
+        const ssize_t nr = read(in,&buf.front(),BufSize);
+        if(nr == 0) return true;
+        if(nr < 0)
+            {
+            if(errno == EINTR) continue;
+            return false;
+            }
+        ssize_t done = 0;
+        while(done < nr)
+            {
+            const ssize_t nw = write(out,&buf.front()+done,nr-done);
+            if(nw < 0)
+                {
+                if(errno == EINTR) continue;
+                return false;
+                }
+            done += nw;
+            }
+        nbytes += nr;
+        }
+    }
+
+//Reflink or copy from to to, recording which in st
+static void
+cloneOrCopy(const string& from, const string& to, SnapshotStats& st)
+    {
+    const int in = open(from.c_str(),O_RDONLY);
+    if(in < 0) Error("snapshotDir: couldn't open \"" + from + "\"");
+    const int out = open(to.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(out < 0)
+        {
+        close(in);
+        Error("snapshotDir: couldn't create \"" + to + "\"");
+        }
+    bool ok = true;
+    if(reflinkFile(in,out))
+        {
+        ++st.nreflink;
+        }
+    else
+        {
+        ok = copyContents(in,out,st.bytes_copied);
+        ++st.ncopy;
+        }
+    close(in);
+    if(close(out) != 0) ok = false;
+    if(!ok) Error("snapshotDir: error copying \"" + from + "\" to \"" + to + "\"");
+    }
+
+SnapshotStats
+snapshotDir(const string& from, const string& to)
+    {
+    const Real t0 = mywalltime();
+    SnapshotStats st;
+
+    DIR* d = opendir(from.c_str());
+    if(d == 0) Error("snapshotDir: couldn't open directory \"" + from + "\"");
+    //Once a link fails (e.g. the directories are on
+    //different file systems) don't try again
+    bool try_link = true;
+    struct dirent* e = 0;
+    while((e = readdir(d)) != 0)
+        {
+        const string name(e->d_name);
+        if(name == "." || name == "..") continue;
+        const string src = from + "/" + name,
+                     dst = to + "/" + name;
+        struct stat sb;
+        if(stat(src.c_str(),&sb) != 0 || !S_ISREG(sb.st_mode)) continue;
+
+        removeFile(dst);
+        if(try_link)
+            {
+            if(link(src.c_str(),dst.c_str()) == 0)
+                {
+                ++st.nlink;
+                continue;
+                }
+            try_link = false;
+            }
+        cloneOrCopy(src,dst,st);
+        }
+    closedir(d);
+
+    st.wall_time = mywalltime()-t0;
+    return st;
+    }
+
+bool
+removeDir(const string& dirname)
+    {
+    DIR* d = opendir(dirname.c_str());
+    if(d == 0) return (errno == ENOENT);
+    bool ok = true;
+    struct dirent* e = 0;
+    while((e = readdir(d)) != 0)
+        {
+        const string name(e->d_name);
+        if(name == "." || name == "..") continue;
+        const string path = dirname + "/" + name;
+        struct stat sb;
+        if(lstat(path.c_str(),&sb) != 0) { ok = false; continue; }
+        if(S_ISDIR(sb.st_mode))
+            {
+            if(!removeDir(path)) ok = false;
+            }
+        else
+        if(unlink(path.c_str()) != 0)
+            {
+            ok = false;
+            }
+        }
+    closedir(d);
+    if(rmdir(dirname.c_str()) != 0) ok = false;
+    return ok;
+    }
+
+bool
+syncFile(const string& fname)
+    {
+    const int fd = open(fname.c_str(),O_RDONLY);
+    if(fd < 0) return false;
+    bool ok = (fsync(fd) == 0);
+    if(close(fd) != 0) ok = false;
+    return ok;
+    }
@@ -0,0 +1,105 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_FILEOPS_H
+#define __ITENSOR_FILEOPS_H
+
+#include "global.h"
+#include <cstdio>
+
+//
+// File and directory operations done in-process
+// (without starting a shell).
+//
+
+class SnapshotStats
+    {
+    public:
+
+    SnapshotStats() { reset(); }
+
+    void
+    reset()
+        {
+        nlink = 0;
+        nreflink = 0;
+        ncopy = 0;
+        bytes_copied = 0;
+        wall_time = 0;
+        }
+
+    int
+    nfile() const { return nlink+nreflink+ncopy; }
+
+    //Files hard linked
+    int nlink;
+    //Files cloned (copy-on-write copies sharing disk blocks)
+    int nreflink;
+    //Files copied in full
+    int ncopy;
+    //Bytes copied in full
+    Real bytes_copied;
+    //Wall time (seconds) taken by the snapshot
+    Real wall_time;
+
+    };
+
+inline std::ostream&
+operator<<(std::ostream& s, const SnapshotStats& st)
+    {
+    s << boost::format("files=%d (linked=%d reflinked=%d copied=%d, %.1f MB) time=%.4fs")
+         % st.nfile() % st.nlink % st.nreflink % st.ncopy
+         % (st.bytes_copied/1E6) % st.wall_time;
+    return s;
+    }
+
+//
+// Makes the files of directory "from" (not including
+// subdirectories) appear in the existing directory "to".
+//
+// Each file is hard linked if possible, otherwise cloned
+// (reflink) if the file system supports it, otherwise copied.
+// Linked files share their contents, so files in either
+// directory must afterwards only be replaced, never modified
+// in place: see writeToNewFile.
+//
+SnapshotStats
+snapshotDir(const std::string& from, const std::string& to);
+
+//
+// Removes dirname and everything in it,
+// like "rm -fr dirname" but without starting a shell.
+// Returns false if anything could not be removed.
+//
+bool
+removeDir(const std::string& dirname);
+
+//
+// Removes the file fname if it exists,
+// like "rm -f fname".
+//
+void inline
+removeFile(const std::string& fname) { std::remove(fname.c_str()); }
+
+//
+// Flushes the contents of fname to the storage device
+// (fsync). Returns false if this failed.
+//
+bool
+syncFile(const std::string& fname);
+
+//
+// Like writeToFile but writes t to a new file, so that
+// other links to the old fname (see snapshotDir)
+// keep their contents.
+//
+template<class T>
+void
+writeToNewFile(const std::string& fname, const T& t)
+    {
+    removeFile(fname);
+    writeToFile(fname,t);
+    }
+
+#endif
@@ -5,6 +5,9 @@
 #include "index.h"
 #include "boost/make_shared.hpp"
 #include "boost/random/lagged_fibonacci.hpp"
+#ifdef ITENSOR_USE_THREADS
+#include "boost/thread/mutex.hpp"
+#endif
 //#include "boost/random/mersenne_twister.hpp"
 
 using std::istream;
@@ -143,6 +146,12 @@ IDType
 generateID()
     {
     static Generator rng(std::time(NULL) + getpid());
+#ifdef ITENSOR_USE_THREADS
+    //Indices may be created by several threads at once
+    //(for example METTS chains)
+    static boost::mutex mut;
+    boost::mutex::scoped_lock lock(mut);
+#endif
     return rng();
 
     //static IDType nextid = 0;
@@ -5,6 +5,7 @@
 #ifndef __ITENSOR_IQTDAT_H
 #define __ITENSOR_IQTDAT_H
 #include "indexset.h"
+#include "binaryio.h"
 
 
 //
@@ -89,6 +90,12 @@ class IQTDat : public boost::noncopyable
     void 
     write(std::ostream& s) const;
 
+    void 
+    read(BinaryReader& r);
+
+    void 
+    write(BinaryWriter& w) const;
+
     static const boost::shared_ptr<IQTDat>& 
     Null();
 
@@ -239,6 +246,31 @@ write(std::ostream& s) const
         }
     }
 
+template<class Tensor>
+void IQTDat<Tensor>::
+read(BinaryReader& r)
+    { 
+    size_t size;
+    r.meta().read((char*) &size,sizeof(size));
+    blocks_.resize(size);
+    Foreach(Tensor& t, blocks_)
+        { 
+        t.read(r); 
+        }
+    }
+
+template<class Tensor>
+void IQTDat<Tensor>::
+write(BinaryWriter& w) const
+    {
+    size_t size = blocks_.size();
+    w.meta().write((char*) &size,sizeof(size));
+    Foreach(const Tensor& t, blocks_)
+        { 
+        t.write(w); 
+        }
+    }
+
 template<class Tensor>
 const boost::shared_ptr<IQTDat<Tensor> >& IQTDat<Tensor>::
 Null()
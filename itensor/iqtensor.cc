@@ -4,6 +4,7 @@
 //
 #include "iqtensor.h"
 #include "qcounter.h"
+#include "tensortrace.h"
 
 using std::istream;
 using std::ostream;
@@ -74,6 +75,14 @@ iten_size() const { return dat().size(); }
 bool IQTensor::
 iten_empty() const { return dat().empty(); }
 
+IQTDat<ITensor>& IQTensor::
+ncblocks() 
+    { 
+    if(isNull()) Error("IQTensor is null");
+    solo(); 
+    return dat.nc(); 
+    }
+
 //----------------------------------------------------
 //IQTensor: Constructors 
 
@@ -235,6 +244,31 @@ write(std::ostream& s) const
 	dat().write(s);
 	}
 
+void IQTensor::
+read(BinaryReader& r)
+    {
+    std::istream& s = r.meta();
+    bool null_;
+    s.read((char*) &null_,sizeof(null_));
+    if(null_) 
+        { *this = IQTensor(); return; }
+    is_ = boost::make_shared<IndexSet<IQIndex> >();
+    is_->read(s);
+    dat = Data();
+    dat.nc().read(r);
+    }
+
+void IQTensor::
+write(BinaryWriter& w) const
+    {
+    std::ostream& s = w.meta();
+    bool null_ = isNull();
+    s.write((char*) &null_,sizeof(null_));
+    if(null_) return;
+    is_->write(s);
+    dat().write(w);
+    }
+
 IQTensor& IQTensor::
 operator*=(Real fac) 
     { 
@@ -898,6 +932,8 @@ operator*=(const IQTensor& other)
         return operator*=(cp_oth);
         }
 
+    TraceOp trace(TensorTrace::Contract,*this,other);
+
     if(this->isNull()) 
         Error("'This' IQTensor null in product");
 
@@ -1197,6 +1233,8 @@ operator+=(const IQTensor& other)
         return *this;
         }
 
+    TraceOp trace(TensorTrace::Add,*this,other);
+
     /*
     //EMS Mar 7 2013: not sure what this does or if it's correct
     if(is_->r() == 0)	// Automatic initializing a summed IQTensor in a loop
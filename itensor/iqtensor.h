@@ -108,6 +108,11 @@ class IQTensor
     //Foreach(const ITensor& t, T.blocks()) { ... }
     const IQTDat<ITensor>&
     blocks() const { return dat(); }
+
+    //Non-const version of blocks, for changing
+    //elements in place (see ITensor::ncdatStart)
+    IQTDat<ITensor>&
+    ncblocks();
     
     const IndexSet<IQIndex>& 
     indices() const { return *is_; }
@@ -333,6 +338,13 @@ class IQTensor
     void 
     write(std::ostream& s) const;
 
+    //Binary file I/O, see binaryio.h
+    void 
+    read(BinaryReader& r);
+
+    void 
+    write(BinaryWriter& w) const;
+
     //Typedefs -----------------------------------------------------
 
     typedef IQIndex 
@@ -424,8 +424,7 @@ product(const IQTSparse& S, const IQTensor& T, IQTensor& res)
     vector<Real> common_inds;
     
     //Load iqindex_ with those IQIndex's *not* common to *this and other
-    static vector<IQIndex> riqind_holder;
-    riqind_holder.resize(0);
+    vector<IQIndex> riqind_holder;
 
     for(int i = 1; i <= S.is_->r(); ++i)
         {
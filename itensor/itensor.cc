@@ -3,6 +3,8 @@
 //    (See accompanying LICENSE file.)
 //
 #include "itensor.h"
+#include "binaryio.h"
+#include "tensortrace.h"
 using std::ostream;
 using std::cout;
 using std::cerr;
@@ -483,6 +485,47 @@ write(std::ostream& s) const
     if(is_cplx) i_->write(s);
     }
 
+void ITensor::
+read(BinaryReader& r)
+    { 
+    std::istream& s = r.meta();
+    bool isNull_;
+    s.read((char*) &isNull_,sizeof(isNull_));
+    if(isNull_) { *this = ITensor(); return; }
+
+    is_.read(s);
+    scale_.read(s);
+    r_ = make_shared<ITDat>();
+    r_->read(r);
+    bool is_cplx = false;
+    s.read((char*)&is_cplx,sizeof(is_cplx));
+    if(is_cplx)
+        {
+        i_ = make_shared<ITDat>();
+        i_->read(r);
+        }
+    else
+        {
+        i_.reset();
+        }
+    }
+
+void ITensor::
+write(BinaryWriter& w) const 
+    { 
+    std::ostream& s = w.meta();
+    bool isNull_ = isNull();
+    s.write((char*) &isNull_,sizeof(isNull_));
+    if(isNull_) return;
+
+    is_.write(s);
+    scale_.write(s);
+    r_->write(w);
+    bool is_cplx = isComplex();
+    s.write((char*)&is_cplx,sizeof(is_cplx));
+    if(is_cplx) i_->write(w);
+    }
+
 
 Real ITensor::
 toReal() const 
@@ -1242,6 +1285,15 @@ imagDatStart() const
     return i_->v.Store();
     }
 
+Real* ITensor::
+ncdatStart()
+    {
+    if(!r_) Error("ITensor is null");
+    solo();
+    scaleTo(1);
+    return r_->v.Store();
+    }
+
 void ITensor::
 randomize(const OptSet& opts) 
     { 
@@ -2010,6 +2062,8 @@ operator*=(const ITensor& other)
         return operator*=(cp_oth);
         }
 
+    TraceOp trace(TensorTrace::Contract,*this,other);
+
     if(scale_.isZero() || other.scale_.isZero())
         {
         scale_ = 0;
@@ -2220,6 +2274,8 @@ operator+=(const ITensor& other)
         return *this;
         }
 
+    TraceOp trace(TensorTrace::Add,*this,other);
+
     if(this == &other) 
         { 
         scale_ *= 2; 
@@ -2715,6 +2771,29 @@ write(std::ostream& s) const
     s.write((char*) v.Store(), sizeof(Real)*size); 
     }
 
+ITDat::
+~ITDat()
+    {
+    //Release the mapped storage before unmapping it
+    if(keep_) v.ReDimension(0);
+    }
+
+void ITDat:: 
+read(BinaryReader& r) 
+    { 
+    int k = 0;
+    r.meta().read((char*) &k,sizeof(k));
+    r.payload(k,v);
+    keep_ = r.mapping();
+    }
+
+void ITDat::
+write(BinaryWriter& w) const 
+    { 
+    const int k = w.addPayload(v);
+    w.meta().write((char*) &k, sizeof(k));
+    }
+
 //
 // commaInit
 //
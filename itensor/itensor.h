@@ -23,6 +23,9 @@ struct ProductProps;
 class Combiner;
 class ITDat;
 class ITSparse;
+class BinaryReader;
+class BinaryWriter;
+class MappedFile;
 
 //
 // ITensor
@@ -139,6 +142,15 @@ class ITensor
     void
     write(std::ostream& s) const;
 
+    //Read in ITensor from a binary file (see binaryio.h),
+    //the data refer to the mapped file until modified
+    void 
+    read(BinaryReader& r);
+
+    //Write out ITensor to a binary file (see binaryio.h)
+    void
+    write(BinaryWriter& w) const;
+
 
     //
     // Operators
@@ -402,6 +414,12 @@ class ITensor
     const Real*
     imagDatStart() const;
 
+    //Like datStart but for changing elements in place:
+    //first gives this ITensor its own copy of the data 
+    //(if shared) and absorbs the scale factor into it
+    Real*
+    ncdatStart();
+
     void 
     randomize(const OptSet& opts = Global::opts());
 
@@ -581,11 +599,19 @@ class ITDat
     explicit 
     ITDat(const ITDat& other);
 
+    ~ITDat();
+
     void
     read(std::istream& s);
 
     void 
     write(std::ostream& s) const;
+
+    void
+    read(BinaryReader& r);
+
+    void 
+    write(BinaryWriter& w) const;
     
 #ifdef ITENSOR_USE_ALLOCATOR
     void* operator 
@@ -610,6 +636,9 @@ class ITDat
     //Must be dynamically allocated:
     void operator=(const ITDat&);
 
+    //Mapped file holding the storage of v, if read
+    //from a binary file
+    boost::shared_ptr<MappedFile> keep_;
 
     };
 
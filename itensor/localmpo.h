@@ -6,6 +6,7 @@
 #define __ITENSOR_LOCALMPO
 #include "mpo.h"
 #include "localop.h"
+#include "tensorio.h"
 
 //
 // The LocalMPO class projects an MPO 
@@ -30,7 +31,7 @@
 //
 
 template <class Tensor>
-class LocalMPO
+class LocalMPO : public CacheUser
     {
     public:
 
@@ -65,6 +66,15 @@ class LocalMPO
              const Tensor& LH, const Tensor& RH,
              const OptSet& opts = Global::opts());
 
+    //Copies are not attached to the MemoryBudget
+    //(if any) of the LocalMPO they are copied from
+    LocalMPO(const LocalMPO& other);
+
+    LocalMPO&
+    operator=(const LocalMPO& other);
+
+    ~LocalMPO();
+
     //
     // Sparse Matrix Methods
     //
@@ -163,6 +173,11 @@ class LocalMPO
     int
     size() const { return lop_.size(); }
 
+    //Estimated floating point operations done by
+    //product (only when representing an MPO)
+    Real
+    productFlops() const { return (Op_ == 0 ? 0 : lop_.productFlops()); }
+
     bool
     isNull() const { return Op_ == 0 && Psi_ == 0; }
 
@@ -181,6 +196,52 @@ class LocalMPO
     const std::string&
     writeDir() const { return writedir_; }
 
+    //Statistics of the disk I/O done
+    //since doWrite(true) was called
+    TensorIOStats
+    ioStats() const { return io_ ? io_->stats() : TensorIOStats(); }
+
+    //Attach to a MemoryBudget (turning on doWrite if needed):
+    //edge tensors then stay in memory as long as the budget
+    //allows instead of being written to disk as soon as 
+    //the current bond moves away from them.
+    //Call with budget == 0 to detach.
+    void
+    memoryBudget(MemoryBudget* budget);
+
+    //CacheUser interface, used by MemoryBudget
+    Real
+    memUse() const;
+    int
+    farthestUse() const;
+    void
+    evictFarthest();
+    void
+    budgetDestroyed() { budget_ = 0; }
+
+    //
+    // Save and restore the edge tensors which are
+    // up to date (those up to LHlim_ and from RHlim_),
+    // for example to resume a calculation without
+    // recomputing them. Edge tensors on disk are
+    // read back in by write.
+    //
+    void
+    write(std::ostream& s) const;
+    void
+    read(std::istream& s);
+
+    //
+    // Same as above except that edge tensors on disk 
+    // are not read back in: the write directory is linked
+    // into the existing directory snapdir (see snapshotDir) 
+    // and read takes them from there.
+    //
+    void
+    write(std::ostream& s, const std::string& snapdir) const;
+    void
+    read(std::istream& s, const std::string& snapdir);
+
     private:
 
     /////////////////
@@ -197,6 +258,19 @@ class LocalMPO
 
     bool do_write_;
     std::string writedir_;
+    //Max. number of edge tensors kept in memory
+    //by io_ (prefetched or waiting to be written)
+    int io_window_;
+    //Whether to fsync each file written
+    bool io_fsync_;
+    //Codec compressing the files written
+    Codec io_codec_;
+    boost::shared_ptr<TensorIO<Tensor> > io_;
+    //Last bond passed to position,
+    //used to guess sweep direction
+    int lastb_;
+    Direction sweepdir_;
+    MemoryBudget* budget_;
 
     const MPSt<Tensor>* Psi_;
 
@@ -220,12 +294,23 @@ class LocalMPO
     void
     initWrite();
 
+    void
+    prefetch(int b);
+
+    int
+    farthest(int& dist) const;
+
     std::string
-    PHFName(int j) const
+    PHFName(int j, const std::string& dirname = "") const
         {
-        return (boost::format("%s/PH_%03d")%writedir_%j).str();
+        return (boost::format("%s/PH_%03d")%(dirname == "" ? writedir_ : dirname)%j).str();
         }
 
+    //Checks edge tensor j just read by read
+    //and writes it to disk if it is not kept in memory
+    void
+    storeRead(int j);
+
     };
 
 template <class Tensor>
@@ -237,6 +322,12 @@ LocalMPO()
       nc_(2),
       do_write_(false),
       writedir_("."),
+      io_window_(0),
+      io_fsync_(false),
+      io_codec_(NoCodec),
+      lastb_(0),
+      sweepdir_(Fromleft),
+      budget_(0),
       Psi_(0)
     { }
 
@@ -252,6 +343,12 @@ LocalMPO(const MPOt<Tensor>& H,
       lop_(opts),
       do_write_(false),
       writedir_("."),
+      io_window_(opts.getInt("PrefetchWindow",0)),
+      io_fsync_(opts.getBool("Fsync",false)),
+      io_codec_(codecFromName(opts.getString("Compress","None"))),
+      lastb_(0),
+      sweepdir_(Fromleft),
+      budget_(0),
       Psi_(0)
     { 
     if(opts.defined("NumCenter"))
@@ -270,6 +367,12 @@ LocalMPO(const MPSt<Tensor>& Psi,
       lop_(opts),
       do_write_(false),
       writedir_("."),
+      io_window_(opts.getInt("PrefetchWindow",0)),
+      io_fsync_(opts.getBool("Fsync",false)),
+      io_codec_(codecFromName(opts.getString("Compress","None"))),
+      lastb_(0),
+      sweepdir_(Fromleft),
+      budget_(0),
       Psi_(&Psi)
     { 
     if(opts.defined("NumCenter"))
@@ -289,6 +392,12 @@ LocalMPO(const MPOt<Tensor>& H,
       lop_(opts),
       do_write_(false),
       writedir_("."),
+      io_window_(opts.getInt("PrefetchWindow",0)),
+      io_fsync_(opts.getBool("Fsync",false)),
+      io_codec_(codecFromName(opts.getString("Compress","None"))),
+      lastb_(0),
+      sweepdir_(Fromleft),
+      budget_(0),
       Psi_(0)
     { 
     PH_[0] = LH;
@@ -310,7 +419,8 @@ product(const Tensor& phi, Tensor& phip) const
         {
         int b = position();
         Tensor othr = (L().isNull() ? primed(Psi_->A(b),Link) : L()*primed(Psi_->A(b),Link));
-        othr *= primed(Psi_->A(b+1),Link);
+        if(nc_ == 2)
+            othr *= primed(Psi_->A(b+1),Link);
         if(!R().isNull()) 
             othr *= R();
 
@@ -363,16 +473,22 @@ position(int b, const MPSType& psi)
     setRHlim(b+nc_); //not redundant since RHlim_ could be < b+nc_
 
 #ifdef DEBUG
-    if(nc_ != 2)
+    if(nc_ != 1 && nc_ != 2)
         {
-        Error("LocalOp only supports 2 center sites currently");
+        Error("LocalOp only supports 1 or 2 center sites currently");
         }
 #endif
 
     if(Op_ != 0) //normal MPO case
         {
-        lop_.update(Op_->A(b),Op_->A(b+1),L(),R());
+        if(nc_ == 1)
+            lop_.update(Op_->A(b),L(),R());
+        else
+            lop_.update(Op_->A(b),Op_->A(b+1),L(),R());
         }
+
+    if(do_write_) prefetch(b);
+    if(budget_ != 0) budget_->enforce();
     }
 
 template <class Tensor>
@@ -393,9 +509,9 @@ shift(int j, Direction dir, const Tensor& A)
     if(this->isNull()) Error("LocalMPO is null");
 
 #ifdef DEBUG
-    if(nc_ != 2)
+    if(nc_ != 1 && nc_ != 2)
         {
-        Error("LocalOp only supports 2 center sites currently");
+        Error("LocalOp only supports 1 or 2 center sites currently");
         }
 #endif
 
@@ -414,7 +530,12 @@ shift(int j, Direction dir, const Tensor& A)
         setLHlim(j);
         setRHlim(j+nc_+1);
 
-        lop_.update(Op_->A(j+1),Op_->A(j+2),L(),R());
+        if(nc_ == 1)
+            lop_.update(Op_->A(j+1),L(),R());
+        else
+            lop_.update(Op_->A(j+1),Op_->A(j+2),L(),R());
+        if(do_write_) prefetch(j+1);
+        if(budget_ != 0) budget_->enforce();
         }
     else //dir == Fromright
         {
@@ -431,7 +552,12 @@ shift(int j, Direction dir, const Tensor& A)
         setLHlim(j-nc_-1);
         setRHlim(j);
 
-        lop_.update(Op_->A(j-1),Op_->A(j),L(),R());
+        if(nc_ == 1)
+            lop_.update(Op_->A(j-1),L(),R());
+        else
+            lop_.update(Op_->A(j-1),Op_->A(j),L(),R());
+        if(do_write_) prefetch(j-1);
+        if(budget_ != 0) budget_->enforce();
         }
     }
 
@@ -503,10 +629,12 @@ setLHlim(int val)
         return;
         }
 
-    if(LHlim_ != val && !PH_.at(LHlim_).isNull())
+    //With a MemoryBudget, tensors stay in memory
+    //until the budget asks for them to be evicted
+    if(budget_ == 0 && LHlim_ != val && !PH_.at(LHlim_).isNull())
         {
         //std::cerr << boost::format("Writing PH(%d) to %s\n")%LHlim_%writedir_;
-        writeToFile(PHFName(LHlim_),PH_.at(LHlim_));
+        io_->write(PHFName(LHlim_),PH_.at(LHlim_));
         PH_.at(LHlim_) = Tensor();
         }
     LHlim_ = val;
@@ -518,18 +646,7 @@ setLHlim(int val)
         }
     if(PH_.at(LHlim_).isNull())
         {
-        std::string fname = PHFName(LHlim_);
-        std::ifstream s(fname.c_str());
-        if(s.good())
-            {
-            PH_.at(LHlim_).read(s);
-            s.close();
-            }
-        else
-            {
-            std::cerr << boost::format("Tried to read file %s\n")%fname;
-            Error("Missing file");
-            }
+        io_->read(PHFName(LHlim_),PH_.at(LHlim_));
         }
     }
 
@@ -543,10 +660,12 @@ setRHlim(int val)
         return;
         }
 
-    if(RHlim_ != val && !PH_.at(RHlim_).isNull())
+    //With a MemoryBudget, tensors stay in memory
+    //until the budget asks for them to be evicted
+    if(budget_ == 0 && RHlim_ != val && !PH_.at(RHlim_).isNull())
         {
         //std::cerr << boost::format("Writing PH(%d) to %s\n")%RHlim_%writedir_;
-        writeToFile(PHFName(RHlim_),PH_.at(RHlim_));
+        io_->write(PHFName(RHlim_),PH_.at(RHlim_));
         PH_.at(RHlim_) = Tensor();
         }
     RHlim_ = val;
@@ -558,18 +677,125 @@ setRHlim(int val)
         }
     if(PH_.at(RHlim_).isNull())
         {
-        std::string fname = PHFName(RHlim_);
-        std::ifstream s(fname.c_str());
-        if(s.good())
+        io_->read(PHFName(RHlim_),PH_.at(RHlim_));
+        }
+    }
+
+template <class Tensor>
+void inline LocalMPO<Tensor>::
+write(std::ostream& s) const
+    {
+    const int size = PH_.size();
+    s.write((char*) &size,sizeof(size));
+    s.write((char*) &LHlim_,sizeof(LHlim_));
+    s.write((char*) &RHlim_,sizeof(RHlim_));
+    for(int j = 0; j < size; ++j)
+        {
+        if(j > LHlim_ && j < RHlim_) continue;
+        if(PH_.at(j).isNull() && do_write_ && j >= 1 && j < size-1)
             {
-            PH_.at(RHlim_).read(s);
-            s.close();
+            Tensor E;
+            io_->read(PHFName(j),E);
+            E.write(s);
             }
         else
             {
-            std::cerr << boost::format("Tried to read file %s\n")%fname;
-            Error("Missing file");
+            PH_.at(j).write(s);
+            }
+        }
+    }
+
+template <class Tensor>
+void inline LocalMPO<Tensor>::
+read(std::istream& s)
+    {
+    int size = 0;
+    s.read((char*) &size,sizeof(size));
+    if(size != int(PH_.size()))
+        Error("LocalMPO::read: number of sites does not match");
+    s.read((char*) &LHlim_,sizeof(LHlim_));
+    s.read((char*) &RHlim_,sizeof(RHlim_));
+    for(int j = 0; j < size; ++j)
+        {
+        if(j > LHlim_ && j < RHlim_) 
+            {
+            PH_.at(j) = Tensor();
+            continue;
+            }
+        PH_.at(j).read(s);
+        storeRead(j);
+        }
+    if(budget_ != 0) budget_->enforce();
+    }
+
+template <class Tensor>
+void inline LocalMPO<Tensor>::
+write(std::ostream& s, const std::string& snapdir) const
+    {
+    if(do_write_)
+        {
+        io_->flush();
+        snapshotDir(writedir_,snapdir);
+        }
+    const int size = PH_.size();
+    s.write((char*) &size,sizeof(size));
+    s.write((char*) &LHlim_,sizeof(LHlim_));
+    s.write((char*) &RHlim_,sizeof(RHlim_));
+    for(int j = 0; j < size; ++j)
+        {
+        if(j > LHlim_ && j < RHlim_) continue;
+        const char ondisk = (PH_.at(j).isNull() && do_write_ && j >= 1 && j < size-1);
+        s.write(&ondisk,1);
+        if(!ondisk) PH_.at(j).write(s);
+        }
+    }
+
+template <class Tensor>
+void inline LocalMPO<Tensor>::
+read(std::istream& s, const std::string& snapdir)
+    {
+    int size = 0;
+    s.read((char*) &size,sizeof(size));
+    if(size != int(PH_.size()))
+        Error("LocalMPO::read: number of sites does not match");
+    s.read((char*) &LHlim_,sizeof(LHlim_));
+    s.read((char*) &RHlim_,sizeof(RHlim_));
+    for(int j = 0; j < size; ++j)
+        {
+        if(j > LHlim_ && j < RHlim_) 
+            {
+            PH_.at(j) = Tensor();
+            continue;
             }
+        char ondisk = 0;
+        s.read(&ondisk,1);
+        if(ondisk) readCompressed(PHFName(j,snapdir),PH_.at(j));
+        else       PH_.at(j).read(s);
+        storeRead(j);
+        }
+    if(budget_ != 0) budget_->enforce();
+    }
+
+template <class Tensor>
+void inline LocalMPO<Tensor>::
+storeRead(int j)
+    {
+    const int size = PH_.size();
+    //The edge tensors share the link indices of Op_,
+    //so it must be the same MPO (e.g. read from a file)
+    const int l = (j <= LHlim_ ? j : j-1);
+    if(Op_ != 0 && l >= 1 && l < Op_->N() && !PH_.at(j).isNull()
+       && !hasindex(PH_.at(j),Op_->LinkInd(l)))
+        {
+        Error("LocalMPO::read: edge tensors were made with a different MPO");
+        }
+    //Without a MemoryBudget, only the edge tensors 
+    //at LHlim_ and RHlim_ are kept in memory
+    if(do_write_ && budget_ == 0 && j >= 1 && j < size-1
+       && j != LHlim_ && j != RHlim_)
+        {
+        io_->write(PHFName(j),PH_.at(j));
+        PH_.at(j) = Tensor();
         }
     }
 
@@ -580,6 +806,165 @@ initWrite()
     std::string global_write_dir = Global::opts().getString("WriteDir","./");
     writedir_ = mkTempDir("PH",global_write_dir);
     //std::cout << "Successfully created directory " + writedir_ << std::endl;
+    io_ = boost::make_shared<TensorIO<Tensor> >(io_window_,io_fsync_,io_codec_);
+    }
+
+//
+// While the current bond is being optimized,
+// have the I/O thread read in the edge tensors
+// needed for the next few bonds in the sweep.
+//
+template <class Tensor>
+void inline LocalMPO<Tensor>::
+prefetch(int b)
+    {
+    const int N = Op_->N();
+    Direction dir = (b >= lastb_ ? Fromleft : Fromright);
+    //Sweep turns around at the ends
+    if(RHlim_ > N) dir = Fromright;
+    if(LHlim_ < 1) dir = Fromleft;
+    lastb_ = b;
+    sweepdir_ = dir;
+
+    for(int n = 1; n <= io_window_; ++n)
+        {
+        const int j = (dir == Fromleft ? RHlim_+n : LHlim_-n);
+        if(j < 1 || j > N) break;
+        if(PH_.at(j).isNull()) io_->prefetch(PHFName(j));
+        }
+    }
+
+template <class Tensor>
+inline LocalMPO<Tensor>::
+LocalMPO(const LocalMPO& other)
+    : Op_(other.Op_),
+      PH_(other.PH_),
+      LHlim_(other.LHlim_),
+      RHlim_(other.RHlim_),
+      nc_(other.nc_),
+      lop_(other.lop_),
+      do_write_(other.do_write_),
+      writedir_(other.writedir_),
+      io_window_(other.io_window_),
+      io_fsync_(other.io_fsync_),
+      io_codec_(other.io_codec_),
+      io_(other.io_),
+      lastb_(other.lastb_),
+      sweepdir_(other.sweepdir_),
+      budget_(0),
+      Psi_(other.Psi_)
+    { }
+
+template <class Tensor>
+inline LocalMPO<Tensor>& LocalMPO<Tensor>::
+operator=(const LocalMPO& other)
+    {
+    if(this == &other) return *this;
+    Op_ = other.Op_;
+    PH_ = other.PH_;
+    LHlim_ = other.LHlim_;
+    RHlim_ = other.RHlim_;
+    nc_ = other.nc_;
+    lop_ = other.lop_;
+    do_write_ = other.do_write_;
+    writedir_ = other.writedir_;
+    io_window_ = other.io_window_;
+    io_fsync_ = other.io_fsync_;
+    io_codec_ = other.io_codec_;
+    io_ = other.io_;
+    lastb_ = other.lastb_;
+    sweepdir_ = other.sweepdir_;
+    if(budget_ != 0) budget_->remove(this);
+    budget_ = 0;
+    Psi_ = other.Psi_;
+    return *this;
+    }
+
+template <class Tensor>
+inline LocalMPO<Tensor>::
+~LocalMPO()
+    {
+    if(budget_ != 0) budget_->remove(this);
+    }
+
+template <class Tensor>
+void inline LocalMPO<Tensor>::
+memoryBudget(MemoryBudget* budget)
+    {
+    if(budget_ != 0) budget_->remove(this);
+    budget_ = budget;
+    if(budget_ == 0) return;
+    doWrite(true);
+    budget_->add(this);
+    }
+
+template <class Tensor>
+Real inline LocalMPO<Tensor>::
+memUse() const
+    {
+    Real b = 0;
+    Foreach(const Tensor& E, PH_)
+        {
+        b += memBytes(E);
+        }
+    return b;
+    }
+
+//
+//Returns the position of the edge tensor, among those
+//in memory and not in use, which will be needed furthest
+//in the future (or -1 if there is none)
+//
+template <class Tensor>
+int inline LocalMPO<Tensor>::
+farthest(int& dist) const
+    {
+    const int N = Op_->N();
+    const int b = LHlim_+1;
+    int jfar = -1;
+    dist = -1;
+    for(int j = 1; j <= N; ++j)
+        {
+        if(j == LHlim_ || j == RHlim_) continue;
+        if(PH_.at(j).isNull()) continue;
+        int d = INT_MAX; 
+        //Edge tensors between LHlim_ and RHlim_
+        //are out of date and never read again
+        if(j < LHlim_) 
+            d = sweepDistance(b,j+1,sweepdir_,N);
+        else
+        if(j > RHlim_)
+            d = sweepDistance(b,j-nc_,sweepdir_,N);
+        if(d > dist)
+            {
+            dist = d;
+            jfar = j;
+            }
+        }
+    return jfar;
+    }
+
+template <class Tensor>
+int inline LocalMPO<Tensor>::
+farthestUse() const
+    {
+    int dist = -1;
+    farthest(dist);
+    return dist;
+    }
+
+template <class Tensor>
+void inline LocalMPO<Tensor>::
+evictFarthest()
+    {
+    int dist = -1;
+    const int j = farthest(dist);
+    if(j < 0) return;
+    if(j < LHlim_ || j > RHlim_)
+        {
+        io_->write(PHFName(j),PH_.at(j));
+        }
+    PH_.at(j) = Tensor();
     }
 
 #endif
@@ -5,6 +5,7 @@
 #ifndef __ITENSOR_LOCALMPO_MPS
 #define __ITENSOR_LOCALMPO_MPS
 #include "localmpo.h"
+#include "parallel.h"
 
 template <class Tensor>
 class LocalMPO_MPS
@@ -60,6 +61,14 @@ class LocalMPO_MPS
     int
     size() const { return lmpo_.size(); }
 
+    Real
+    productFlops() const { return lmpo_.productFlops(); }
+
+    int
+    numCenter() const { return lmpo_.numCenter(); }
+    void
+    numCenter(int val);
+
     bool
     isNull() const { return Op_ == 0; }
 
@@ -68,11 +77,51 @@ class LocalMPO_MPS
     void
     weight(Real val) { weight_ = val; }
 
+    //Number of threads used to sum the
+    //MPO and projector terms in product
+    int
+    numThreads() const { return nthread_; }
+    void
+    numThreads(int val) { nthread_ = val; }
+
     bool
     doWrite() const { return lmpo_.doWrite(); }
     void
     doWrite(bool val) { lmpo_.doWrite(val); }
 
+    TensorIOStats
+    ioStats() const { return lmpo_.ioStats(); }
+
+    void
+    memoryBudget(MemoryBudget* budget) { lmpo_.memoryBudget(budget); }
+
+    void
+    write(std::ostream& s) const
+        {
+        lmpo_.write(s);
+        Foreach(const LocalMPO<Tensor>& M, lmps_) M.write(s);
+        }
+    void
+    read(std::istream& s)
+        {
+        lmpo_.read(s);
+        Foreach(LocalMPO<Tensor>& M, lmps_) M.read(s);
+        }
+
+    //Only lmpo_ writes to disk
+    void
+    write(std::ostream& s, const std::string& snapdir) const
+        {
+        lmpo_.write(s,snapdir);
+        Foreach(const LocalMPO<Tensor>& M, lmps_) M.write(s);
+        }
+    void
+    read(std::istream& s, const std::string& snapdir)
+        {
+        lmpo_.read(s,snapdir);
+        Foreach(LocalMPO<Tensor>& M, lmps_) M.read(s);
+        }
+
     private:
 
     /////////////////
@@ -91,9 +140,38 @@ class LocalMPO_MPS
 
     Real weight_;
 
+    int nthread_;
+
     //
     /////////////////
 
+    //Term 0 is the MPO, term j+1 is 
+    //the weighted projector onto psis_[j]
+    class ProductTerm
+        {
+        public:
+        ProductTerm(const LocalMPOType& lmpo, 
+                    const std::vector<LocalMPOType>& lmps,
+                    Real weight, const Tensor& phi)
+            : lmpo_(lmpo), lmps_(lmps), weight_(weight), phi_(phi) { }
+        void
+        operator()(int n, Tensor& term) const 
+            { 
+            if(n == 0) 
+                {
+                lmpo_.product(phi_,term); 
+                return;
+                }
+            lmps_[n-1].product(phi_,term);
+            term *= weight_;
+            }
+        private:
+        const LocalMPOType& lmpo_;
+        const std::vector<LocalMPOType>& lmps_;
+        Real weight_;
+        const Tensor& phi_;
+        };
+
     };
 
 template <class Tensor>
@@ -102,7 +180,8 @@ LocalMPO_MPS()
     : 
     Op_(0),
     psis_(0),
-    weight_(1)
+    weight_(1),
+    nthread_(1)
     { }
 
 template <class Tensor>
@@ -114,12 +193,13 @@ LocalMPO_MPS(const MPOt<Tensor>& Op,
     Op_(&Op),
     psis_(&psis),
     lmps_(psis.size()),
-    weight_(1)
+    weight_(1),
+    nthread_(getNumThreads(opts))
     { 
-    lmpo_ = LocalMPOType(Op);
+    lmpo_ = LocalMPOType(Op,opts);
 
     for(size_t j = 0; j < lmps_.size(); ++j)
-        lmps_[j] = LocalMPOType(psis[j]);
+        lmps_[j] = LocalMPOType(psis[j],opts);
 
     if(opts.defined("Weight"))
         weight(opts.getReal("Weight"));
@@ -129,15 +209,17 @@ template <class Tensor>
 void inline LocalMPO_MPS<Tensor>::
 product(const Tensor& phi, Tensor& phip) const
     {
-    lmpo_.product(phi,phip);
+    parallelSum(ProductTerm(lmpo_,lmps_,weight_,phi),
+                1+lmps_.size(),phip,nthread_);
+    }
 
-    Tensor outer;
+template <class Tensor>
+void inline LocalMPO_MPS<Tensor>::
+numCenter(int val)
+    {
+    lmpo_.numCenter(val);
     for(size_t j = 0; j < lmps_.size(); ++j)
-        {
-        lmps_[j].product(phi,outer);
-        outer *= weight_;
-        phip += outer;
-        }
+        lmps_[j].numCenter(val);
     }
 
 template <class Tensor>
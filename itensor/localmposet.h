@@ -5,6 +5,7 @@
 #ifndef __ITENSOR_LOCALMPOSET
 #define __ITENSOR_LOCALMPOSET
 #include "localmpo.h"
+#include "parallel.h"
 
 template <class Tensor>
 class LocalMPOSet
@@ -55,9 +56,20 @@ class LocalMPOSet
     int
     size() const { return lmpo_.front().size(); }
 
+    Real
+    productFlops() const;
+
     bool
     isNull() const { return Op_ == 0; }
 
+    //Number of threads used to sum the
+    //contributions of each MPO in product,
+    //diag and deltaRho (see parallel.h)
+    int
+    numThreads() const { return nthread_; }
+    void
+    numThreads(int val) { nthread_ = val; }
+
     bool
     doWrite() const { return false; }
     void
@@ -66,6 +78,32 @@ class LocalMPOSet
         if(val) Error("Write to disk not yet supported LocalMPOSet");
         }
 
+    TensorIOStats
+    ioStats() const { return TensorIOStats(); }
+
+    void
+    memoryBudget(MemoryBudget* budget)
+        {
+        if(budget) Error("Write to disk not yet supported LocalMPOSet");
+        }
+
+    void
+    write(std::ostream& s) const
+        {
+        Foreach(const LocalMPOT& M, lmpo_) M.write(s);
+        }
+    void
+    read(std::istream& s)
+        {
+        Foreach(LocalMPOT& M, lmpo_) M.read(s);
+        }
+
+    //Never writes to disk, so nothing goes in snapdir
+    void
+    write(std::ostream& s, const std::string& snapdir) const { write(s); }
+    void
+    read(std::istream& s, const std::string& snapdir) { read(s); }
+
     private:
 
     /////////////////
@@ -75,17 +113,58 @@ class LocalMPOSet
 
     const std::vector<MPOt<Tensor> >* Op_;
     std::vector<LocalMPO<Tensor> > lmpo_;
+    int nthread_;
 
     //
     /////////////////
 
+    class ProductTerm
+        {
+        public:
+        ProductTerm(const std::vector<LocalMPOT>& lmpo, const Tensor& phi)
+            : lmpo_(lmpo), phi_(phi) { }
+        void
+        operator()(int n, Tensor& term) const { lmpo_[n].product(phi_,term); }
+        private:
+        const std::vector<LocalMPOT>& lmpo_;
+        const Tensor& phi_;
+        };
+
+    class DeltaRhoTerm
+        {
+        public:
+        DeltaRhoTerm(const std::vector<LocalMPOT>& lmpo, const Tensor& AA,
+                     const CombinerT& comb, Direction dir)
+            : lmpo_(lmpo), AA_(AA), comb_(comb), dir_(dir) { }
+        void
+        operator()(int n, Tensor& term) const 
+            { term = lmpo_[n].deltaRho(AA_,comb_,dir_); }
+        private:
+        const std::vector<LocalMPOT>& lmpo_;
+        const Tensor& AA_;
+        const CombinerT& comb_;
+        Direction dir_;
+        };
+
+    class DiagTerm
+        {
+        public:
+        DiagTerm(const std::vector<LocalMPOT>& lmpo)
+            : lmpo_(lmpo) { }
+        void
+        operator()(int n, Tensor& term) const { term = lmpo_[n].diag(); }
+        private:
+        const std::vector<LocalMPOT>& lmpo_;
+        };
+
     };
 
 template <class Tensor>
 inline LocalMPOSet<Tensor>::
 LocalMPOSet()
     : 
-    Op_(0)
+    Op_(0),
+    nthread_(1)
     { }
 
 template <class Tensor>
@@ -94,11 +173,12 @@ LocalMPOSet(const std::vector<MPOt<Tensor> >& Op,
             const OptSet& opts)
     : 
     Op_(&Op),
-    lmpo_(Op.size())
+    lmpo_(Op.size()),
+    nthread_(getNumThreads(opts))
     { 
     for(size_t n = 0; n < lmpo_.size(); ++n)
         {
-        lmpo_[n] = LocalMPOT(Op.at(n));
+        lmpo_[n] = LocalMPOT(Op.at(n),opts);
         }
     }
 
@@ -106,14 +186,7 @@ template <class Tensor>
 void inline LocalMPOSet<Tensor>::
 product(const Tensor& phi, Tensor& phip) const
     {
-    lmpo_.front().product(phi,phip);
-
-    Tensor phi_n;
-    for(size_t n = 1; n < lmpo_.size(); ++n)
-        {
-        lmpo_[n].product(phi,phi_n);
-        phip += phi_n;
-        }
+    parallelSum(ProductTerm(lmpo_,phi),lmpo_.size(),phip,nthread_);
     }
 
 template <class Tensor>
@@ -133,11 +206,12 @@ Tensor inline LocalMPOSet<Tensor>::
 deltaRho(const Tensor& AA,
          const CombinerT& comb, Direction dir) const
     {
-    Tensor delta = lmpo_.front().deltaRho(AA,comb,dir);
-    for(size_t n = 1; n < lmpo_.size(); ++n)
-        {
-        delta += lmpo_[n].deltaRho(AA,comb,dir);
-        }
+    //Make sure comb is initialized before
+    //it is shared between threads
+    comb.right();
+
+    Tensor delta;
+    parallelSum(DeltaRhoTerm(lmpo_,AA,comb,dir),lmpo_.size(),delta,nthread_);
     return delta;
     }
 
@@ -145,11 +219,8 @@ template <class Tensor>
 Tensor inline LocalMPOSet<Tensor>::
 diag() const
     {
-    Tensor D = lmpo_.front().diag();
-    for(size_t n = 1; n < lmpo_.size(); ++n)
-        {
-        D += lmpo_[n].diag();
-        }
+    Tensor D;
+    parallelSum(DiagTerm(lmpo_),lmpo_.size(),D,nthread_);
     return D;
     }
 
@@ -170,6 +241,16 @@ combineMPO(bool val)
         lmpo_[n].combineMPO(val);
     }
 
+template <class Tensor>
+Real inline LocalMPOSet<Tensor>::
+productFlops() const
+    {
+    Real f = 0;
+    for(size_t n = 0; n < lmpo_.size(); ++n)
+        f += lmpo_[n].productFlops();
+    return f;
+    }
+
 template <class Tensor>
 void inline LocalMPOSet<Tensor>::
 numCenter(int val)
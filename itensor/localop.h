@@ -28,6 +28,15 @@
 //  can even be null in which case
 //  they will not be used.)
 //
+// If only Op1 is provided (Op2 null), the
+// LocalOp acts on a single site instead:
+//
+//   .-      -.
+//   |    |   |
+//   L - Op1 -R
+//   |    |   |
+//   '-      -'
+//
 
 
 template <class Tensor>
@@ -77,6 +86,12 @@ class LocalOp
     int
     size() const;
 
+    //Estimated number of floating point 
+    //operations done by one call to product
+    //(counting all tensors as dense)
+    Real
+    productFlops() const;
+
     //
     // Accessor Methods
     //
@@ -88,6 +103,10 @@ class LocalOp
     update(const Tensor& Op1, const Tensor& Op2, 
            const Tensor& L, const Tensor& R);
 
+    //Single-site version
+    void
+    update(const Tensor& Op1, const Tensor& L, const Tensor& R);
+
     const Tensor&
     Op1() const 
         { 
@@ -99,6 +118,7 @@ class LocalOp
     Op2() const 
         { 
         if(isNull()) Error("LocalOp is null");
+        if(Op2_ == 0) Error("LocalOp is single-site");
         return *Op2_;
         }
 
@@ -131,6 +151,9 @@ class LocalOp
     bool
     isNull() const { return Op1_ == 0; }
 
+    bool
+    isSingleSite() const { return Op2_ == 0; }
+
     bool
     LIsNull() const;
 
@@ -250,6 +273,18 @@ update(const Tensor& Op1, const Tensor& Op2,
     R_ = &R;
     }
 
+template <class Tensor>
+void inline LocalOp<Tensor>::
+update(const Tensor& Op1, const Tensor& L, const Tensor& R)
+    {
+    Op1_ = &Op1;
+    Op2_ = 0;
+    L_ = &L;
+    R_ = &R;
+    size_ = -1;
+    bond_ = Tensor();
+    }
+
 template <class Tensor>
 bool inline LocalOp<Tensor>::
 LIsNull() const
@@ -272,6 +307,16 @@ product(const Tensor& phi, Tensor& phip) const
     {
     if(this->isNull()) Error("LocalOp is null");
 
+    if(isSingleSite())
+        {
+        phip = phi;
+        if(!LIsNull()) phip *= L(); //m^3 k d
+        phip *= (*Op1_);            //m^2 k^2 d^2
+        if(!RIsNull()) phip *= R(); //m^3 k d
+        phip.mapprime(1,0);
+        return;
+        }
+
     const Tensor& Op1 = *Op1_;
     const Tensor& Op2 = *Op2_;
 
@@ -335,7 +380,7 @@ deltaRho(const Tensor& AA, const CombinerT& comb, Direction dir) const
     else //dir == Fromright
         {
         if(!RIsNull()) delta *= R();
-        delta *= (*Op2_);
+        delta *= (isSingleSite() ? *Op1_ : *Op2_);
         }
 
     delta.noprime();
@@ -350,6 +395,8 @@ template <class Tensor>
 Tensor inline LocalOp<Tensor>::
 deltaPhi(const Tensor& phi) const
     {
+    if(isSingleSite()) Error("deltaPhi not defined for single-site LocalOp");
+
     Tensor deltaL(phi),
            deltaR(phi);
 
@@ -386,6 +433,8 @@ template <>
 IQTensor inline LocalOp<IQTensor>::
 deltaPhi(const IQTensor& phi) const
     {
+    if(isSingleSite()) Error("deltaPhi not defined for single-site LocalOp");
+
     IQTensor deltaL(phi),
            deltaR(phi);
 
@@ -440,7 +489,6 @@ diag() const
     if(this->isNull()) Error("LocalOp is null");
 
     const Tensor& Op1 = *Op1_;
-    const Tensor& Op2 = *Op2_;
 
     IndexT toTie;
     bool found = false;
@@ -462,18 +510,22 @@ diag() const
 
     Tensor Diag = tieIndices(Op1,toTie,primed(toTie),toTie);
 
-    found = false;
-    Foreach(const IndexT& s, Op2.indices())
+    if(!isSingleSite())
         {
-        if(s.primeLevel() == 0 && s.type() == Site) 
+        const Tensor& Op2 = *Op2_;
+        found = false;
+        Foreach(const IndexT& s, Op2.indices())
             {
-            toTie = s;
-            found = true;
-            break;
+            if(s.primeLevel() == 0 && s.type() == Site) 
+                {
+                toTie = s;
+                found = true;
+                break;
+                }
             }
+        if(!found) Error("Couldn't find Index");
+        Diag *= tieIndices(Op2,toTie,primed(toTie),toTie);
         }
-    if(!found) Error("Couldn't find Index");
-    Diag *= tieIndices(Op2,toTie,primed(toTie),toTie);
 
     if(!LIsNull())
         {
@@ -549,11 +601,52 @@ size() const
             }
 
         size_ *= findtype(*Op1_,Site).m();
-        size_ *= findtype(*Op2_,Site).m();
+        if(!isSingleSite()) size_ *= findtype(*Op2_,Site).m();
         }
     return size_;
     }
 
+template <class Tensor>
+Real inline LocalOp<Tensor>::
+productFlops() const
+    {
+    if(this->isNull()) Error("LocalOp is null");
+
+    //Link and MPO bond dimensions of the edge tensors:
+    //L (or R) has a primed and unprimed link index of 
+    //size m plus the MPO bond index of size k
+    Real mL = 1, kL = 1,
+         mR = 1, kR = 1;
+    if(!LIsNull())
+        {
+        Real dim = 1;
+        Foreach(const IndexT& I, L().indices())
+            {
+            dim *= I.m();
+            if(I.primeLevel() > 0) mL = I.m();
+            }
+        kL = dim/(mL*mL);
+        }
+    if(!RIsNull())
+        {
+        Real dim = 1;
+        Foreach(const IndexT& I, R().indices())
+            {
+            dim *= I.m();
+            if(I.primeLevel() > 0) mR = I.m();
+            }
+        kR = dim/(mR*mR);
+        }
+
+    Real d = findtype(*Op1_,Site).m();
+    if(!isSingleSite()) d *= findtype(*Op2_,Site).m();
+
+    //Contracting phi with L, then the MPO 
+    //tensor(s), then R
+    const Real n = size();
+    return 2*n*(kL*mL + kL*kR*d + kR*mR);
+    }
+
 template <class Tensor>
 void inline LocalOp<Tensor>::
 makeBond() const
@@ -561,7 +654,7 @@ makeBond() const
     if(bond_.isNull()) 
         {
         if(!combine_mpo_) Error("combineMPO is false");
-        bond_ = (*Op1_) * (*Op2_);
+        bond_ = (isSingleSite() ? *Op1_ : (*Op1_) * (*Op2_));
         }
     }
 
@@ -0,0 +1,187 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_MEMBUDGET_H
+#define __ITENSOR_MEMBUDGET_H
+
+#include "iqtensor.h"
+#include <algorithm>
+#include <climits>
+
+//
+// Approximate memory (in bytes) used by the
+// elements of a tensor
+//
+
+Real inline
+memBytes(const ITensor& T)
+    {
+    if(T.isNull()) return 0;
+    return Real(T.indices().dim())*sizeof(Real)*(T.isComplex() ? 2 : 1);
+    }
+
+Real inline
+memBytes(const IQTensor& T)
+    {
+    if(T.isNull()) return 0;
+    Real b = 0;
+    Foreach(const ITensor& t, T.blocks())
+        {
+        b += memBytes(t);
+        }
+    return b;
+    }
+
+//
+// Number of bond moves needed to go from
+// bond b to bond t in a DMRG-style sweep over bonds
+// 1,...,N-1 currently moving in direction dir
+// (Fromleft meaning moving to the right).
+//
+int inline
+sweepDistance(int b, int t, Direction dir, int N)
+    {
+    if(dir == Fromleft)
+        return (t >= b ? t-b : (N-1-b)+(N-1-t));
+    else
+        return (t <= b ? b-t : (b-1)+(t-1));
+    }
+
+//
+// Interface for objects (such as LocalMPO and MPSt
+// in write-to-disk mode) holding tensors that a
+// MemoryBudget may ask to evict from memory.
+//
+class CacheUser
+    {
+    public:
+
+    //Bytes used by tensors currently held in memory
+    virtual Real
+    memUse() const = 0;
+
+    //Number of bond moves until the evictable tensor
+    //needed furthest in the future gets used
+    //(a very large value if it will never be used again)
+    //or -1 if nothing can be evicted
+    virtual int
+    farthestUse() const = 0;
+
+    //Remove the tensor reported by farthestUse from
+    //memory, writing it to disk if it is still needed
+    virtual void
+    evictFarthest() = 0;
+
+    //Called by a MemoryBudget being destroyed while
+    //this is still attached to it: must forget the budget
+    virtual void
+    budgetDestroyed() = 0;
+
+    virtual
+    ~CacheUser() { }
+
+    };
+
+//
+// MemoryBudget keeps the total memory held by
+// a set of CacheUsers below a fixed number of bytes.
+//
+// Each time enforce() is called and the budget is
+// exceeded, the tensor (among all users) needed
+// furthest in the future is evicted until the total fits.
+//
+// Users still attached when the MemoryBudget is destroyed
+// (say by an exception unwinding the scope holding it)
+// are detached from it.
+//
+class MemoryBudget
+    {
+    public:
+
+    explicit
+    MemoryBudget(Real maxbytes)
+        :
+        maxbytes_(maxbytes),
+        nevict_(0)
+        { }
+
+    ~MemoryBudget()
+        {
+        Foreach(CacheUser* u, users_)
+            {
+            u->budgetDestroyed();
+            }
+        }
+
+    Real
+    maxBytes() const { return maxbytes_; }
+
+    void
+    add(CacheUser* u)
+        {
+        if(std::find(users_.begin(),users_.end(),u) == users_.end())
+            users_.push_back(u);
+        }
+
+    void
+    remove(CacheUser* u)
+        {
+        users_.erase(std::remove(users_.begin(),users_.end(),u),users_.end());
+        }
+
+    Real
+    memUse() const
+        {
+        Real tot = 0;
+        Foreach(const CacheUser* u, users_)
+            {
+            tot += u->memUse();
+            }
+        return tot;
+        }
+
+    void
+    enforce()
+        {
+        Real tot = memUse();
+        while(tot > maxbytes_)
+            {
+            CacheUser* victim = 0;
+            int far = -1;
+            Foreach(CacheUser* u, users_)
+                {
+                const int f = u->farthestUse();
+                if(f > far)
+                    {
+                    far = f;
+                    victim = u;
+                    }
+                }
+            //Nothing left that may be evicted
+            if(victim == 0) break;
+
+            const Real before = victim->memUse();
+            victim->evictFarthest();
+            tot -= (before-victim->memUse());
+            ++nevict_;
+            }
+        }
+
+    //Number of tensors evicted so far
+    long
+    nevict() const { return nevict_; }
+
+    private:
+
+    std::vector<CacheUser*> users_;
+    Real maxbytes_;
+    long nevict_;
+
+    //Not copyable
+    MemoryBudget(const MemoryBudget&);
+    void operator=(const MemoryBudget&);
+
+    };
+
+#endif
@@ -0,0 +1,486 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_METTS_H
+#define __ITENSOR_METTS_H
+
+#include "mpo.h"
+#include "sampler.h"
+#include "stats.h"
+
+#define Cout std::cout
+#define Endl std::endl
+#define Format boost::format
+
+//
+// Measurement hook for METTS: measure is called for every
+// METTS |phi> (normalized) after the warm-up steps and should
+// append the measured values to vals, always in the same order.
+//
+// Chains run concurrently when NumThreads > 1, so measure
+// must be safe to call from several threads at once.
+//
+template <class Tensor>
+class METTSObserver
+    {
+    public:
+
+    virtual void
+    measure(int chain, int step, const MPSt<Tensor>& phi,
+            std::vector<Real>& vals) const = 0;
+
+    virtual ~METTSObserver() { }
+
+    };
+
+//
+// Measures the energy <phi|H|phi>
+//
+template <class Tensor>
+class METTSEnergy : public METTSObserver<Tensor>
+    {
+    public:
+
+    METTSEnergy(const MPOt<Tensor>& H) : H_(H) { }
+
+    void
+    measure(int chain, int step, const MPSt<Tensor>& phi,
+            std::vector<Real>& vals) const
+        {
+        vals.push_back(psiHphi(phi,H_,phi));
+        }
+
+    private:
+
+    const MPOt<Tensor>& H_;
+
+    };
+
+//
+// Minimally entangled typical thermal states (METTS)
+// at inverse temperature beta.
+//
+// Each Markov chain starts from a product state, evolves it in
+// imaginary time by beta/2 (using the toExpH approximation of
+// exp(-tau H) and fitApplyMPO), measures the resulting METTS and
+// collapses it into a new product state by sampling.
+// Independent chains run in parallel threads.
+//
+// Collapsing only in the site basis keeps any quantum number
+// conserved by H fixed along a chain (as it always is for IQMPS);
+// with the AltBasis option every second collapse is done in the
+// eigenbasis of a site operator instead (for example "Sx"),
+// which makes the chains sample all quantum number sectors.
+//
+// Options recognized:
+//   Tau - imaginary time step (default 0.1); each step applies
+//         toExpH with tau*(1+i)/2 then tau*(1-i)/2, so that
+//         the bias from the time step is O(tau^2)
+//   Approx - approximation used by toExpH (default "WII")
+//   Maxm, Cutoff - truncation of the METTS (default 200, 1E-10)
+//   Nchain - number of independent Markov chains (default 1)
+//   NumThreads - number of threads running chains, used only if
+//                compiled with ITENSOR_USE_THREADS (default 1)
+//   Nwarm - METTS discarded at the start of each chain (default 5)
+//   Nstep - METTS measured per chain (default 50)
+//   AltBasis - name of a real symmetric site operator; every second
+//              collapse is done in its eigenbasis (MPS only, default none)
+//   Seed - seed of the random number streams (default 1);
+//          chain n uses the stream (Seed,n)
+//   Verbose - print each measured METTS
+//
+template <class Tensor>
+class METTS
+    {
+    public:
+
+    METTS(const MPOt<Tensor>& H, Real beta,
+          const OptSet& opts = Global::opts());
+
+    //Runs all chains from the product state init
+    void
+    run(const InitState& init, const METTSObserver<Tensor>& obs);
+
+    //Number of measured quantities
+    int
+    nobs() const { return nobs_; }
+
+    //Average of quantity k over all chains and steps
+    Real
+    mean(int k) const;
+
+    //Error bar of mean(k) from the spread of the chain averages
+    //(binned over each chain if there is a single chain)
+    Real
+    err(int k) const;
+
+    //Integrated autocorrelation time of quantity k
+    //(in METTS steps, averaged over chains)
+    Real
+    autocorr(int k) const;
+
+    //data()[c][s][k] is quantity k measured at step s of chain c
+    const std::vector<std::vector<std::vector<Real> > >&
+    data() const { return data_; }
+
+    private:
+
+    /////////////////
+    //
+    // Data Members
+    //
+
+    const MPOt<Tensor>& H_;
+    //exp(-tau H) approximated as K2_*K1_
+    MPOt<Tensor> K1_,
+                 K2_;
+    Real beta_,
+         tau_;
+    int nstep_tau_,
+        maxm_;
+    Real cutoff_;
+    int nchain_,
+        nthread_,
+        nwarm_,
+        nstep_,
+        seed_;
+    bool verbose_;
+
+    //Site basis rotations for AltBasis collapses:
+    //rot_[j](s=a,s'=n) is component a of eigenvector n
+    std::vector<Tensor> rot_;
+
+    int nobs_;
+    std::vector<std::vector<std::vector<Real> > > data_;
+
+    //
+    /////////////////
+
+    void
+    runChain(int c, const InitState& init, const METTSObserver<Tensor>& obs);
+
+    void
+    runChains(int first, int stride, const InitState& init,
+              const METTSObserver<Tensor>& obs, std::string& errmess);
+
+    Stats
+    series(int c, int k) const;
+
+    void
+    initAltBasis(const std::string& opname);
+
+    template <class T>
+    friend class METTSWorker;
+
+    };
+
+//
+// Integrated autocorrelation time 1/2 + sum_t rho(t)
+// of a time series, summing rho(t) up to the first
+// t >= 5*tau (automatic windowing)
+//
+inline Real
+integratedAutocorr(const std::vector<Real>& x)
+    {
+    const int n = x.size();
+    if(n < 2) return 0.5;
+    Real avg = 0;
+    for(int i = 0; i < n; ++i) avg += x[i];
+    avg /= n;
+    Real c0 = 0;
+    for(int i = 0; i < n; ++i) c0 += sqr(x[i]-avg);
+    c0 /= n;
+    if(c0 <= 0) return 0.5;
+
+    Real tau = 0.5;
+    for(int t = 1; t < n; ++t)
+        {
+        Real ct = 0;
+        for(int i = 0; i+t < n; ++i) ct += (x[i]-avg)*(x[i+t]-avg);
+        ct /= (n-t);
+        tau += ct/c0;
+        if(t >= 5*tau) break;
+        }
+    return tau;
+    }
+
+template <class Tensor>
+class METTSWorker
+    {
+    public:
+
+    METTSWorker(METTS<Tensor>& m, int first, int stride, const InitState& init,
+                const METTSObserver<Tensor>& obs, std::string& errmess)
+        : m_(&m), first_(first), stride_(stride), init_(&init),
+          obs_(&obs), errmess_(&errmess)
+        { }
+
+    void
+    operator()() const
+        {
+        m_->runChains(first_,stride_,*init_,*obs_,*errmess_);
+        }
+
+    private:
+
+    METTS<Tensor>* m_;
+    int first_,
+        stride_;
+    const InitState* init_;
+    const METTSObserver<Tensor>* obs_;
+    std::string* errmess_;
+    };
+
+template <class Tensor>
+METTS<Tensor>::
+METTS(const MPOt<Tensor>& H, Real beta, const OptSet& opts)
+    :
+    H_(H),
+    beta_(beta),
+    tau_(opts.getReal("Tau",0.1)),
+    maxm_(opts.getInt("Maxm",200)),
+    cutoff_(opts.getReal("Cutoff",1E-10)),
+    nchain_(opts.getInt("Nchain",1)),
+    nthread_(getNumThreads(opts)),
+    nwarm_(opts.getInt("Nwarm",5)),
+    nstep_(opts.getInt("Nstep",50)),
+    seed_(opts.getInt("Seed",1)),
+    verbose_(opts.getBool("Verbose",false)),
+    nobs_(0)
+    {
+    if(beta_ <= 0) Error("METTS: beta must be positive");
+    if(nchain_ < 1 || nstep_ < 1) Error("METTS: Nchain and Nstep must be at least 1");
+
+    //Round the number of steps to reach beta/2,
+    //adjusting tau slightly
+    nstep_tau_ = std::max(1,int(beta_/(2*tau_)+0.5));
+    tau_ = beta_/(2*nstep_tau_);
+
+    //The O(tau^2) errors of the complex steps cancel
+    const Opt approx("Approx",opts.getString("Approx","WII"));
+    toExpH(H_,tau_*Complex(0.5,0.5),K1_,approx);
+    toExpH(H_,tau_*Complex(0.5,-0.5),K2_,approx);
+
+    const std::string alt = opts.getString("AltBasis","");
+    if(alt != "") initAltBasis(alt);
+    }
+
+template <class Tensor>
+void METTS<Tensor>::
+initAltBasis(const std::string& opname)
+    {
+    Error("METTS: AltBasis is only supported for MPS, not IQMPS");
+    }
+
+template <>
+inline void METTS<ITensor>::
+initAltBasis(const std::string& opname)
+    {
+    const Model& model = H_.model();
+    rot_.assign(model.N()+1,ITensor());
+    for(int j = 1; j <= model.N(); ++j)
+        {
+        const ITensor op = model.op(opname,j);
+        if(op.isComplex()) Error("METTS: AltBasis operator must be real");
+        const Index s = model.si(j),
+                    sP = model.siP(j);
+        const int d = s.m();
+        Matrix M(d,d);
+        for(int a = 1; a <= d; ++a)
+        for(int b = 1; b <= d; ++b)
+            {
+            M(a,b) = op(s(a),sP(b));
+            }
+        Vector evals;
+        Matrix U;
+        EigenValues(M,evals,U);
+        ITensor& R = rot_.at(j);
+        R = ITensor(s,sP);
+        for(int a = 1; a <= d; ++a)
+        for(int n = 1; n <= d; ++n)
+            {
+            R(s(a),sP(n)) = U(a,n);
+            }
+        }
+    }
+
+template <class Tensor>
+void METTS<Tensor>::
+runChain(int c, const InitState& init, const METTSObserver<Tensor>& obs)
+    {
+    SampleRNG gen = MPSSampler<Tensor>::makeRNG(seed_,c);
+    const OptSet fopts = Maxm(maxm_) & Cutoff(cutoff_);
+
+    std::vector<std::vector<Real> >& dat = data_.at(c);
+    dat.clear();
+
+    MPSt<Tensor> psi(init);
+    for(int step = 1; step <= nwarm_+nstep_; ++step)
+        {
+        MPSt<Tensor> phi(psi);
+        for(int t = 1; t <= nstep_tau_; ++t)
+            {
+            MPSt<Tensor> half,
+                         next;
+            fitApplyMPO(phi,K1_,half,fopts);
+            fitApplyMPO(half,K2_,next,fopts);
+            next.normalize();
+            phi = next;
+            }
+
+        if(step > nwarm_)
+            {
+            std::vector<Real> vals;
+            obs.measure(c,step-nwarm_,phi,vals);
+            dat.push_back(vals);
+            if(verbose_)
+                {
+                Cout << Format("METTS chain %d step %d, average m = %.1f:")
+                        % c % (step-nwarm_) % phi.averageM();
+                Foreach(Real v, vals) Cout << Format(" %.10f") % v;
+                Cout << Endl;
+                }
+            }
+
+        const bool alt = (!rot_.empty() && step%2 == 0);
+        if(alt)
+            {
+            //Components of phi in the rotated basis
+            for(int j = 1; j <= phi.N(); ++j)
+                {
+                phi.Anc(j) *= rot_.at(j);
+                phi.Anc(j).noprime(Site);
+                }
+            }
+
+        MPSSampler<Tensor> sampler(phi);
+        typename MPSSampler<Tensor>::Config conf;
+        sampler.sample(conf,gen);
+        psi = MPSt<Tensor>(sampler.initState(conf));
+
+        if(alt)
+            {
+            //Product of the chosen eigenvectors
+            for(int j = 1; j <= psi.N(); ++j)
+                {
+                psi.Anc(j) *= swapPrime(rot_.at(j),0,1);
+                psi.Anc(j).noprime(Site);
+                }
+            }
+        }
+    }
+
+template <class Tensor>
+void METTS<Tensor>::
+runChains(int first, int stride, const InitState& init,
+          const METTSObserver<Tensor>& obs, std::string& errmess)
+    {
+    try {
+        for(int c = first; c < nchain_; c += stride)
+            {
+            runChain(c,init,obs);
+            }
+        }
+    catch(const ITError& e)
+        {
+        //Exceptions must not escape a thread,
+        //save the message for the calling thread
+        errmess = e.what();
+        }
+    }
+
+template <class Tensor>
+void METTS<Tensor>::
+run(const InitState& init, const METTSObserver<Tensor>& obs)
+    {
+    data_.assign(nchain_,std::vector<std::vector<Real> >());
+
+    int nthread = nthread_;
+#ifndef ITENSOR_USE_THREADS
+    nthread = 1;
+#endif
+    if(nthread > nchain_) nthread = nchain_;
+    if(nthread > 1 && !ThreadPool::instance().parallelAllowed()) nthread = 1;
+    if(nthread < 1) nthread = 1;
+
+    std::vector<std::string> errmess(nthread);
+    if(nthread == 1)
+        {
+        runChains(0,1,init,obs,errmess[0]);
+        }
+    else
+        {
+        //Chains run as tasks of the library thread pool, with
+        //the sums within each chain done serially (see threadpool.h)
+        ParallelRegion region;
+        TaskGroup tasks("METTS");
+        for(int t = 1; t < nthread; ++t)
+            {
+            tasks.run(METTSWorker<Tensor>(*this,t,nthread,init,obs,errmess[t]));
+            }
+        runChains(0,nthread,init,obs,errmess[0]);
+        tasks.wait();
+        }
+    for(int t = 0; t < nthread; ++t)
+        {
+        if(!errmess[t].empty()) throw ITError(errmess[t]);
+        }
+
+    nobs_ = data_.front().front().size();
+    for(int c = 0; c < nchain_; ++c)
+    for(size_t s = 0; s < data_.at(c).size(); ++s)
+        {
+        if(int(data_.at(c).at(s).size()) != nobs_)
+            Error("METTS: observer returned a varying number of values");
+        }
+    }
+
+template <class Tensor>
+Stats METTS<Tensor>::
+series(int c, int k) const
+    {
+    Stats st;
+    for(size_t s = 0; s < data_.at(c).size(); ++s) st.putin(data_.at(c).at(s).at(k));
+    return st;
+    }
+
+template <class Tensor>
+Real METTS<Tensor>::
+mean(int k) const
+    {
+    Stats all;
+    for(int c = 0; c < nchain_; ++c) all.putin(series(c,k).avg());
+    return all.avg();
+    }
+
+template <class Tensor>
+Real METTS<Tensor>::
+err(int k) const
+    {
+    if(nchain_ > 1)
+        {
+        Stats all;
+        for(int c = 0; c < nchain_; ++c) all.putin(series(c,k).avg());
+        return all.err();
+        }
+    //Single chain: bins a few autocorrelation times long
+    const Stats st = series(0,k);
+    const int bs = std::max(1,int(2*autocorr(k)+0.5));
+    return (int(st.dat.size()) >= 2*bs ? st.binerr(bs) : st.err());
+    }
+
+template <class Tensor>
+Real METTS<Tensor>::
+autocorr(int k) const
+    {
+    Real tau = 0;
+    for(int c = 0; c < nchain_; ++c) tau += integratedAutocorr(series(c,k).dat);
+    return tau/nchain_;
+    }
+
+#undef Cout
+#undef Endl
+#undef Format
+
+#endif
@@ -42,8 +42,11 @@ class tJ : public Model
     virtual const IQIndex&
     getSi(int i) const;
 
-    virtual IQIndex
-    getSiP(int i) const;
+    virtual IQIndexVal
+    getState(int i, const String& state) const;
+
+    virtual IQTensor
+    getOp(int i, const String& opname, const OptSet& opts = Global::opts()) const;
 
     virtual void
     doRead(std::istream& s);
@@ -167,7 +170,7 @@ UpP(int i) const
 inline IQIndexVal tJ::
 DnP(int i) const
     {
-    return primed(getSiP(i))(3);
+    return primed(getSi(i))(3);
     }
 
 inline IQTensor tJ::
@@ -3,6 +3,7 @@
 //    (See accompanying LICENSE file.)
 //
 #include "hambuilder.h"
+#include "sweeps.h"
 
 using std::istream;
 using std::ostream;
@@ -483,13 +484,224 @@ template
 void 
 exactApplyMPO(const IQMPS& x, const IQMPO& K, IQMPS& res);
 
+template<class Tensor>
+void 
+fitApplyMPO(const MPSt<Tensor>& psi, const MPOt<Tensor>& K, MPSt<Tensor>& res,
+            const OptSet& opts)
+    {
+    const int N = psi.N();
+    if(K.N() != N) Error("Mismatched N in fitApplyMPO");
+
+    if(&psi == &res)
+        Error("psi and res must be different MPS instances");
+
+    const Real cutoff = opts.getReal("Cutoff",psi.cutoff());
+    const int maxm = opts.getInt("Maxm",psi.maxm());
+    const int nsweep = opts.getInt("Nsweep",4);
+    const Real errgoal = opts.getReal("ErrGoal",1E-10);
+    const bool verbose = opts.getBool("Verbose",false);
+
+    if(!opts.getBool("UseGuess",false)) res = psi;
+    if(res.N() != N) Error("Mismatched N of guess in fitApplyMPO");
+
+    const Real orig_cutoff = res.cutoff(),
+               orig_noise = res.noise();
+    const int orig_maxm = res.maxm();
+    res.cutoff(cutoff);
+    res.maxm(maxm);
+    res.noise(0);
+
+    res.position(1);
+
+    //LE[j] is the environment of sites 1..j,
+    //RE[j] of sites j..N, each formed from
+    //psi, K and conj(res) (with primed indices)
+    vector<Tensor> LE(N+1),
+                   RE(N+2);
+    for(int j = N; j > 2; --j)
+        {
+        RE[j] = (RE[j+1].isNull() ? psi.A(j) : RE[j+1]*psi.A(j));
+        RE[j] *= K.A(j);
+        RE[j] *= conj(primed(res.A(j)));
+        }
+
+    Real last_nrm2 = -1;
+    for(int sw = 1; sw <= nsweep; ++sw)
+        {
+        Real nrm2 = 0;
+        for(int b = 1, ha = 1; ha <= 2; sweepnext(b,ha,N))
+            {
+            Tensor phi = (LE[b-1].isNull() ? psi.A(b) : LE[b-1]*psi.A(b));
+            phi *= K.A(b);
+            phi *= psi.A(b+1);
+            phi *= K.A(b+1);
+            if(!RE[b+2].isNull()) phi *= RE[b+2];
+            phi.noprime();
+
+            nrm2 = sqr(phi.norm());
+
+            const Direction dir = (ha == 1 ? Fromleft : Fromright);
+            res.svdBond(b,phi,dir,opts);
+
+            if(dir == Fromleft)
+                {
+                LE[b] = (LE[b-1].isNull() ? psi.A(b) : LE[b-1]*psi.A(b));
+                LE[b] *= K.A(b);
+                LE[b] *= conj(primed(res.A(b)));
+                }
+            else
+                {
+                RE[b+1] = (RE[b+2].isNull() ? psi.A(b+1) : RE[b+2]*psi.A(b+1));
+                RE[b+1] *= K.A(b+1);
+                RE[b+1] *= conj(primed(res.A(b+1)));
+                }
+            }
+
+        //Before truncation <res|res> = |phi|^2, which 
+        //increases toward <psi|K^dag K|psi> as the fit improves
+        if(verbose)
+            {
+            int mm = 1;
+            for(int j = 1; j < N; ++j) mm = max(mm,res.LinkInd(j).m());
+            cout << format("    fitApplyMPO: sweep %d, <res|res> = %.12f, max m = %d")
+                    % sw % nrm2 % mm << endl;
+            }
+        if(last_nrm2 > 0 && fabs(nrm2-last_nrm2) < errgoal*nrm2) break;
+        last_nrm2 = nrm2;
+        }
+
+    res.cutoff(orig_cutoff);
+    res.maxm(orig_maxm);
+    res.noise(orig_noise);
+    } //void fitApplyMPO
+template
+void 
+fitApplyMPO(const MPS& psi, const MPO& K, MPS& res, const OptSet& opts);
+template
+void 
+fitApplyMPO(const IQMPS& psi, const IQMPO& K, IQMPS& res, const OptSet& opts);
+
+
+template <class MPOType>
+void 
+fitMultMPO(const MPOType& Aorig, const MPOType& Borig, MPOType& res,
+           const OptSet& opts)
+    {
+    typedef typename MPOType::TensorT Tensor;
+    const int N = Aorig.N();
+    if(Borig.N() != N) Error("Mismatched N in fitMultMPO");
+
+    if(&Aorig == &res || &Borig == &res)
+        Error("res must be a different MPO instance than A and B");
+
+    const Real cutoff = opts.getReal("Cutoff",Aorig.cutoff());
+    const int maxm = opts.getInt("Maxm",Aorig.maxm());
+    const int nsweep = opts.getInt("Nsweep",4);
+    const Real errgoal = opts.getReal("ErrGoal",1E-10);
+    const bool verbose = opts.getBool("Verbose",false);
+
+    //Same index conventions as nmultMPO:
+    //B's sites i,i' -> i',i'' so that A*B
+    //leaves sites i,i'' and links of A, B
+    //and res are kept distinct by priming
+    const MPOType& A = Aorig;
+    MPOType B(Borig);
+    B.primeall();
+
+    if(opts.getBool("UseGuess",false))
+        {
+        if(res.N() != N) Error("Mismatched N of guess in fitMultMPO");
+        }
+    else
+        {
+        //Start from the (already truncated) product
+        //computed site by site by nmultMPO
+        nmultMPO(Aorig,Borig,res,cutoff,maxm);
+        }
+    res.primelinks(0,2);
+    res.mapprime(1,2,Site);
+
+    const Real orig_cutoff = res.cutoff();
+    const int orig_maxm = res.maxm();
+    res.cutoff(cutoff);
+    res.maxm(maxm);
+
+    res.position(1);
+
+    //LE[j] is the environment of sites 1..j,
+    //RE[j] of sites j..N, each formed from
+    //A, B and conj(res)
+    vector<Tensor> LE(N+1),
+                   RE(N+2);
+    for(int j = N; j > 2; --j)
+        {
+        RE[j] = (RE[j+1].isNull() ? A.A(j) : RE[j+1]*A.A(j));
+        RE[j] *= B.A(j);
+        RE[j] *= conj(res.A(j));
+        }
+
+    Real last_nrm2 = -1;
+    for(int sw = 1; sw <= nsweep; ++sw)
+        {
+        Real nrm2 = 0;
+        for(int b = 1, ha = 1; ha <= 2; sweepnext(b,ha,N))
+            {
+            Tensor phi = (LE[b-1].isNull() ? A.A(b) : LE[b-1]*A.A(b));
+            phi *= B.A(b);
+            phi *= A.A(b+1);
+            phi *= B.A(b+1);
+            if(!RE[b+2].isNull()) phi *= RE[b+2];
+
+            nrm2 = sqr(phi.norm());
+
+            const Direction dir = (ha == 1 ? Fromleft : Fromright);
+            res.svdBond(b,phi,dir,opts);
+
+            if(dir == Fromleft)
+                {
+                LE[b] = (LE[b-1].isNull() ? A.A(b) : LE[b-1]*A.A(b));
+                LE[b] *= B.A(b);
+                LE[b] *= conj(res.A(b));
+                }
+            else
+                {
+                RE[b+1] = (RE[b+2].isNull() ? A.A(b+1) : RE[b+2]*A.A(b+1));
+                RE[b+1] *= B.A(b+1);
+                RE[b+1] *= conj(res.A(b+1));
+                }
+            }
+
+        if(verbose)
+            {
+            int mm = 1;
+            for(int j = 1; j < N; ++j) mm = max(mm,res.LinkInd(j).m());
+            cout << format("    fitMultMPO: sweep %d, Tr(res^dag res) = %.12E, max m = %d")
+                    % sw % nrm2 % mm << endl;
+            }
+        if(last_nrm2 > 0 && fabs(nrm2-last_nrm2) < errgoal*nrm2) break;
+        last_nrm2 = nrm2;
+        }
+
+    res.noprimelink();
+    res.mapprime(2,1,Site);
+    res.cutoff(orig_cutoff);
+    res.maxm(orig_maxm);
+    } //void fitMultMPO
+template
+void 
+fitMultMPO(const MPO& A, const MPO& B, MPO& res, const OptSet& opts);
+template
+void 
+fitMultMPO(const IQMPO& A, const IQMPO& B, IQMPO& res, const OptSet& opts);
 
 template<class Tensor>
 void 
 expsmallH(const MPOt<Tensor>& H, MPOt<Tensor>& K, 
-          Real tau, Real Etot, Real Kcutoff)
+          Real tau, Real Etot, Real Kcutoff, const OptSet& opts)
     {
-    const int maxm = 400;
+    const int maxm = opts.getInt("Maxm",400);
+    const int order = opts.getInt("Order",12);
+    const bool fit = opts.getBool("Fit",false);
 
     HamBuilder hb(H.model());
 
@@ -507,7 +719,7 @@ expsmallH(const MPOt<Tensor>& H, MPOt<Tensor>& K,
     //      o=1    o=2      o=3      o=4  
     // K = 1-t*H*(1-t*H/2*(1-t*H/3*(1-t*H/4*(...))))
     //
-    for(int o = 50; o >= 1; --o)
+    for(int o = order; o >= 1; --o)
         {
         if(o > 1) xx[1].Anc(1) *= 1.0 / o;
 
@@ -515,28 +727,40 @@ expsmallH(const MPOt<Tensor>& H, MPOt<Tensor>& K,
 
         sum(xx,K,errlim,maxm);
         if(o > 1)
-            nmultMPO(K,Hshift,xx[1],errlim,maxm);
+            {
+            if(fit)
+                {
+                //The previous term K*Hshift is a cheap and
+                //close starting guess for the new one
+                fitMultMPO(K,Hshift,xx[1],opts & Cutoff(errlim) & Maxm(maxm) & Opt("UseGuess"));
+                }
+            else
+                {
+                nmultMPO(K,Hshift,xx[1],errlim,maxm);
+                }
+            }
         }
     }
 template
 void 
-expsmallH(const MPO& H, MPO& K, Real tau, Real Etot, Real Kcutoff);
+expsmallH(const MPO& H, MPO& K, Real tau, Real Etot, Real Kcutoff, const OptSet& opts);
 template
 void 
-expsmallH(const IQMPO& H, IQMPO& K, Real tau, Real Etot, Real Kcutoff);
+expsmallH(const IQMPO& H, IQMPO& K, Real tau, Real Etot, Real Kcutoff, const OptSet& opts);
 
 template<class Tensor>
 void 
 expH(const MPOt<Tensor>& H, MPOt<Tensor>& K, Real tau, Real Etot,
-     Real Kcutoff, int ndoub)
+     Real Kcutoff, int ndoub, const OptSet& opts)
     {
+    const bool fit = opts.getBool("Fit",false);
+
     Real ttau = tau / pow(2.0,ndoub);
     //cout << "ttau in expH is " << ttau << endl;
 
     K.cutoff(0.1 * Kcutoff * pow(0.25,ndoub));
-    expsmallH(H, K, ttau,Etot,K.cutoff());
+    expsmallH(H, K, ttau,Etot,K.cutoff(),opts);
 
-    cout << "Starting doubling in expH" << endl;
     for(int doub = 1; doub <= ndoub; ++doub)
         {
         //cout << " Double step " << doub << endl;
@@ -546,7 +770,10 @@ expH(const MPOt<Tensor>& H, MPOt<Tensor>& K, Real tau, Real Etot,
             K.cutoff(0.1 * Kcutoff * pow(0.25,ndoub-doub));
         //cout << "in expH, K.cutoff is " << K.cutoff << endl;
         MPOt<Tensor> KK;
-        nmultMPO(K,K,KK,K.cutoff(),K.maxm());
+        if(fit)
+            fitMultMPO(K,K,KK,opts & Cutoff(K.cutoff()) & Maxm(K.maxm()));
+        else
+            nmultMPO(K,K,KK,K.cutoff(),K.maxm());
         K = KK;
         /*
         if(doub == ndoub)
@@ -561,8 +788,395 @@ expH(const MPOt<Tensor>& H, MPOt<Tensor>& K, Real tau, Real Etot,
     }
 template
 void 
-expH(const MPO& H, MPO& K, Real tau, Real Etot,Real Kcutoff, int ndoub);
+expH(const MPO& H, MPO& K, Real tau, Real Etot,Real Kcutoff, int ndoub, const OptSet& opts);
 template
 void 
-expH(const IQMPO& H, IQMPO& K, Real tau, Real Etot,Real Kcutoff, int ndoub);
+expH(const IQMPO& H, IQMPO& K, Real tau, Real Etot,Real Kcutoff, int ndoub, const OptSet& opts);
+
 
+//
+// Helpers for toExpH
+//
+
+//Complex d x d operator stored as real and imaginary parts,
+//M(b,a) = <b|O|a>
+struct CMatrix
+    {
+    Matrix re,
+           im;
+
+    CMatrix() { }
+
+    explicit
+    CMatrix(int d) : re(d,d), im(d,d) { re = 0; im = 0; }
+
+    bool
+    isZero() const
+        {
+        for(int i = 1; i <= re.Nrows(); ++i)
+        for(int j = 1; j <= re.Ncols(); ++j)
+            {
+            if(fabs(re(i,j)) > 1E-13 || fabs(im(i,j)) > 1E-13) return false;
+            }
+        return true;
+        }
+
+    bool
+    isId() const
+        {
+        for(int i = 1; i <= re.Nrows(); ++i)
+        for(int j = 1; j <= re.Ncols(); ++j)
+            {
+            if(fabs(re(i,j)-(i==j ? 1 : 0)) > 1E-13 || fabs(im(i,j)) > 1E-13) return false;
+            }
+        return true;
+        }
+    };
+
+//Exponential of a general (non-symmetric) real matrix
+//by scaling and squaring of its Taylor series
+static Matrix
+expGeneral(const Matrix& M)
+    {
+    const int n = M.Nrows();
+    Real nrm = 0;
+    for(int i = 1; i <= n; ++i)
+        {
+        Real rs = 0;
+        for(int j = 1; j <= n; ++j) rs += fabs(M(i,j));
+        nrm = max(nrm,rs);
+        }
+    int nsquare = 0;
+    while(nrm > 0.5) { nrm /= 2; ++nsquare; }
+
+    Matrix X = M * pow(0.5,nsquare);
+    Matrix E(n,n),
+           term(n,n);
+    E = 1;
+    term = 1;
+    for(int k = 1; k <= 18; ++k)
+        {
+        term = term*X;
+        term *= 1./k;
+        E += term;
+        }
+    for(int j = 0; j < nsquare; ++j) E = E*E;
+    return E;
+    }
+
+//Adds f*M to the block (out bits ob, in bits ib) of the 
+//matrix h, where h acts on a site space times two bits
+static void
+addBlock(Matrix& hre, Matrix& him, int d, int ob, int ib, 
+         Complex f, const CMatrix& M)
+    {
+    for(int i = 1; i <= d; ++i)
+    for(int j = 1; j <= d; ++j)
+        {
+        hre(ob*d+i,ib*d+j) += f.real()*M.re(i,j) - f.imag()*M.im(i,j);
+        him(ob*d+i,ib*d+j) += f.real()*M.im(i,j) + f.imag()*M.re(i,j);
+        }
+    }
+
+static Index
+expHLink(const Index& old, const vector<int>& vals, int b)
+    {
+    return Index(nameint("wl",b),vals.size(),Link);
+    }
+
+static IQIndex
+expHLink(const IQIndex& old, const vector<int>& vals, int b)
+    {
+    vector<IndexQN> iq;
+    for(size_t j = 0; j < vals.size(); ++j)
+        {
+        iq.push_back(IndexQN(Index(nameint("wl",b)+nameint("_",j+1),1,Link),
+                             IQIndexVal(old,vals[j]).indexqn().qn));
+        }
+    return IQIndex(nameint("wl",b),iq,old.dir());
+    }
+
+static ITensor
+expHToITensor(const ITensor& T) { return T; }
+
+static ITensor
+expHToITensor(const IQTensor& T) { return T.toITensor(); }
+
+//Returns the index of T equal to I (with the arrow it has in T)
+template <class IndexT, class Tensor>
+IndexT
+expHFindIndex(const Tensor& T, const IndexT& I)
+    {
+    Foreach(const IndexT& J, T.indices())
+        {
+        if(J == I) return J;
+        }
+    Error("toExpH: index not found");
+    return I;
+    }
+
+template <class Tensor>
+void
+toExpH(const MPOt<Tensor>& H, Complex tau, MPOt<Tensor>& K, 
+       const OptSet& opts)
+    {
+    typedef typename Tensor::IndexT IndexT;
+    typedef typename Tensor::IndexValT IndexValT;
+
+    const int N = H.N();
+    if(N < 2) Error("toExpH: MPO must have at least two sites");
+
+    const std::string approx = opts.getString("Approx","WII");
+    if(approx != "WI" && approx != "WII")
+        Error("toExpH: Approx must be \"WI\" or \"WII\"");
+
+    //exp(-tau*H) = 1 + t*H + ... 
+    const Complex t = -tau;
+
+    //
+    // Read the operator blocks W[r][c] of each site.
+    // At site 1 the only row is the starting state 
+    // and at site N the only column is the ending state.
+    //
+    vector<IndexT> lnk(N);
+    for(int b = 1; b < N; ++b) lnk[b] = expHFindIndex(H.A(b),H.LinkInd(b));
+
+    vector<vector<vector<CMatrix> > > W(N+1);
+    vector<int> kl(N+1,1),
+                kr(N+1,1);
+    int d = 0;
+    for(int n = 1; n <= N; ++n)
+        {
+        const Tensor& Wn = H.A(n);
+        const IndexT sin = expHFindIndex(Wn,IndexT(H.si(n))),
+                     sout = expHFindIndex(Wn,IndexT(H.siP(n)));
+        IndexT row, 
+               col;
+        if(n > 1) { row = expHFindIndex(Wn,lnk[n-1]); kl[n] = row.m(); }
+        if(n < N) { col = expHFindIndex(Wn,lnk[n]); kr[n] = col.m(); }
+        d = sin.m();
+
+        const ITensor T = expHToITensor(Wn);
+        const ITensor Tre = realPart(T);
+        ITensor Tim;
+        if(T.isComplex()) Tim = imagPart(T);
+
+        W[n].assign(kl[n]+1,vector<CMatrix>(kr[n]+1));
+        for(int r = 1; r <= kl[n]; ++r)
+        for(int c = 1; c <= kr[n]; ++c)
+            {
+            CMatrix& M = W[n][r][c];
+            M = CMatrix(d);
+            for(int a = 1; a <= d; ++a)
+            for(int bb = 1; bb <= d; ++bb)
+                {
+                IndexVal ivs[4] = { IndexVal(sin,a), IndexVal(sout,bb), 
+                                    IndexVal::Null(), IndexVal::Null() };
+                int nv = 2;
+                if(n > 1) ivs[nv++] = IndexVal(row,r);
+                if(n < N) ivs[nv++] = IndexVal(col,c);
+                M.re(bb,a) = Tre(ivs[0],ivs[1],ivs[2],ivs[3]);
+                if(T.isComplex()) M.im(bb,a) = Tim(ivs[0],ivs[1],ivs[2],ivs[3]);
+                }
+            }
+        }
+
+    //
+    // Find the starting (s) and ending (e) states of each bond:
+    // the end state passes to the end state with an identity
+    // and nothing else, the start state is reached from
+    // the start state by an identity and nothing else
+    //
+    vector<int> s(N,0),
+                e(N,0);
+    for(int b = N-1; b >= 1; --b)
+        {
+        const int n = b+1;
+        const int ec = (n == N ? 1 : e[n]);
+        for(int r = 1; r <= kl[n]; ++r)
+            {
+            if(!W[n][r][ec].isId()) continue;
+            bool only = true;
+            for(int c = 1; c <= kr[n]; ++c)
+                {
+                if(c != ec && !W[n][r][c].isZero()) only = false;
+                }
+            if(!only) continue;
+            if(e[b] != 0) Error("toExpH: could not identify the ending state of the MPO");
+            e[b] = r;
+            }
+        if(e[b] == 0) Error("toExpH: could not identify the ending state of the MPO");
+        }
+    for(int b = 1; b < N; ++b)
+        {
+        const int n = b;
+        const int sr = (n == 1 ? 1 : s[n-1]);
+        for(int c = 1; c <= kr[n]; ++c)
+            {
+            if(c == e[b] || !W[n][sr][c].isId()) continue;
+            bool only = true;
+            for(int r = 1; r <= kl[n]; ++r)
+                {
+                if(r != sr && !W[n][r][c].isZero()) only = false;
+                }
+            if(!only) continue;
+            if(s[b] != 0) Error("toExpH: could not identify the starting state of the MPO");
+            s[b] = c;
+            }
+        if(s[b] == 0) Error("toExpH: could not identify the starting state of the MPO");
+        }
+
+    //
+    // New links: start and end states merge into
+    // the first state, then the intermediate states
+    //
+    vector<vector<int> > inter(N);
+    vector<IndexT> nlnk(N);
+    for(int b = 1; b < N; ++b)
+        {
+        vector<int> vals(1,s[b]);
+        for(int v = 1; v <= lnk[b].m(); ++v)
+            {
+            if(v == s[b] || v == e[b]) continue;
+            inter[b].push_back(v);
+            vals.push_back(v);
+            }
+        nlnk[b] = expHLink(lnk[b],vals,b);
+        }
+
+    K = MPOt<Tensor>(H.model());
+
+    for(int n = 1; n <= N; ++n)
+        {
+        const int rs = (n == 1 ? 1 : s[n-1]),
+                  ce = (n == N ? 1 : e[n]);
+        const vector<int> ri = (n == 1 ? vector<int>() : inter[n-1]),
+                          ci = (n == N ? vector<int>() : inter[n]);
+        const int nr = 1+ri.size(),
+                  nc = 1+ci.size();
+
+        //New operator blocks KW[r][c], r,c = 1 the merged state
+        vector<vector<CMatrix> > KW(nr+1,vector<CMatrix>(nc+1));
+
+        if(approx == "WI")
+            {
+            for(int r = 1; r <= nr; ++r)
+            for(int c = 1; c <= nc; ++c)
+                {
+                const CMatrix& M = W[n][r == 1 ? rs : ri[r-2]][c == 1 ? ce : ci[c-2]];
+                CMatrix& R = KW[r][c];
+                R = CMatrix(d);
+                //Starting-state row carries the factor t
+                const Complex f = (r == 1 ? t : Complex(1,0));
+                R.re = M.re*f.real() - M.im*f.imag();
+                R.im = M.im*f.real() + M.re*f.imag();
+                if(r == 1 && c == 1) R.re += 1;
+                }
+            }
+        else //WII
+            {
+            //Site space times two hard-core bosons (bit 1: row state r
+            //occupied, bit 2: column state c occupied), so the 
+            //complex matrix h has dimension 4d; it is exponentiated
+            //through its real 8d x 8d representation
+            const int D = 4*d;
+            for(int r = 1; r <= nr; ++r)
+            for(int c = 1; c <= nc; ++c)
+                {
+                Matrix hre(D,D),
+                       him(D,D);
+                hre = 0;
+                him = 0;
+                const CMatrix& Dm = W[n][rs][ce];
+                for(int x = 0; x < 4; ++x) addBlock(hre,him,d,x,x,t,Dm);
+                if(c > 1)
+                    {
+                    const CMatrix& Cm = W[n][rs][ci[c-2]];
+                    addBlock(hre,him,d,2,0,t,Cm);
+                    addBlock(hre,him,d,3,1,t,Cm);
+                    }
+                if(r > 1)
+                    {
+                    const CMatrix& Bm = W[n][ri[r-2]][ce];
+                    addBlock(hre,him,d,0,1,Complex_1,Bm);
+                    addBlock(hre,him,d,2,3,Complex_1,Bm);
+                    }
+                if(r > 1 && c > 1)
+                    {
+                    const CMatrix& Am = W[n][ri[r-2]][ci[c-2]];
+                    addBlock(hre,him,d,2,1,Complex_1,Am);
+                    }
+
+                Matrix h2(2*D,2*D);
+                for(int i = 1; i <= D; ++i)
+                for(int j = 1; j <= D; ++j)
+                    {
+                    h2(i,j) = h2(D+i,D+j) = hre(i,j);
+                    h2(i,D+j) = -him(i,j);
+                    h2(D+i,j) = him(i,j);
+                    }
+                const Matrix w = expGeneral(h2);
+
+                //Read off <out|w|in> with in = r bit, out = c bit
+                const int ib = (r > 1 ? 1 : 0),
+                          ob = (c > 1 ? 2 : 0);
+                CMatrix& R = KW[r][c];
+                R = CMatrix(d);
+                for(int i = 1; i <= d; ++i)
+                for(int j = 1; j <= d; ++j)
+                    {
+                    R.re(i,j) = w(ob*d+i,ib*d+j);
+                    R.im(i,j) = w(D+ob*d+i,ib*d+j);
+                    }
+                }
+            }
+
+        //
+        // Write the new site tensor
+        //
+        const Tensor& Wn = H.A(n);
+        const IndexT sin = expHFindIndex(Wn,IndexT(H.si(n))),
+                     sout = expHFindIndex(Wn,IndexT(H.siP(n)));
+        IndexT row,
+               col;
+        if(n > 1) 
+            {
+            const IndexT orow = expHFindIndex(Wn,lnk[n-1]);
+            row = (orow.dir() == lnk[n-1].dir() ? nlnk[n-1] : conj(nlnk[n-1]));
+            }
+        if(n < N) 
+            {
+            const IndexT ocol = expHFindIndex(Wn,lnk[n]);
+            col = (ocol.dir() == lnk[n].dir() ? nlnk[n] : conj(nlnk[n]));
+            }
+
+        Tensor& A = K.Anc(n);
+        if(n == 1)      A = Tensor(sin,sout,col);
+        else if(n == N) A = Tensor(sin,sout,row);
+        else            A = Tensor(sin,sout,row,col);
+
+        for(int r = 1; r <= nr; ++r)
+        for(int c = 1; c <= nc; ++c)
+            {
+            const CMatrix& R = KW[r][c];
+            for(int a = 1; a <= d; ++a)
+            for(int bb = 1; bb <= d; ++bb)
+                {
+                const Complex z(R.re(bb,a),R.im(bb,a));
+                if(z == Complex(0,0)) continue;
+                Tensor el = Tensor(IndexValT(sin,a)) * Tensor(IndexValT(sout,bb));
+                if(n > 1) el *= Tensor(IndexValT(row,r));
+                if(n < N) el *= Tensor(IndexValT(col,c));
+                if(z.imag() == 0) el *= z.real();
+                else              el *= z;
+                A += el;
+                }
+            }
+        }
+    }
+template
+void
+toExpH(const MPO& H, Complex tau, MPO& K, const OptSet& opts);
+template
+void
+toExpH(const IQMPO& H, Complex tau, IQMPO& K, const OptSet& opts);
@@ -387,11 +387,85 @@ template<class Tensor>
 void 
 exactApplyMPO(const MPSt<Tensor>& x, const MPOt<Tensor>& K, MPSt<Tensor>& res);
 
+//
+// Applies an MPO K to an MPS psi by variationally fitting
+// |res> to K|psi>: sweeps back and forth, replacing
+// each pair of sites of res by the projection of K|psi>
+// onto the rest of res (environments of <res|K|psi>)
+// and truncating with an SVD.
+//
+// Cost per step is O(m^3 k d^2 + m^2 k^2 d^4)
+// where m is the bond dimension of psi and res.
+//
+// Options recognized:
+//   Maxm, Cutoff - truncation of res (default those of psi)
+//   Nsweep  - maximum number of sweeps (default 4)
+//   ErrGoal - stop once the relative change in <res|res>
+//             over a sweep is below this (default 1E-10)
+//   UseGuess - if true, start from res as passed in,
+//              otherwise start from psi (default false)
+//   Verbose - print <res|res> after each sweep
+//
+template<class Tensor>
+void 
+fitApplyMPO(const MPSt<Tensor>& psi, const MPOt<Tensor>& K, MPSt<Tensor>& res,
+            const OptSet& opts = Global::opts());
+
+//
+// Multiplies two MPOs by variationally fitting res to A*B,
+// treating the MPOs as MPS with two site indices per site.
+// Same conventions as nmultMPO: the primes of B are raised
+// so that res applies A first, then B.
+//
+// Options recognized:
+//   Maxm, Cutoff - truncation of res (default those of A)
+//   Nsweep  - maximum number of sweeps (default 4)
+//   ErrGoal - stop once the relative change in Tr(res^dag res)
+//             over a sweep is below this (default 1E-10)
+//   UseGuess - if true, start from res as passed in, otherwise
+//              from the product computed by nmultMPO with the
+//              same Maxm and Cutoff (default false)
+//   Verbose - print Tr(res^dag res) after each sweep
+//
+template <class MPOType>
+void 
+fitMultMPO(const MPOType& A, const MPOType& B, MPOType& res,
+           const OptSet& opts = Global::opts());
+
 //Computes the exponential of the MPO H: K=exp(-tau*(H-Etot))
+//
+//Options recognized:
+//   Order - order of the Taylor series for exp(-tau/2^ndoub*(H-Etot))
+//           (default 12)
+//   Maxm - maximum bond dimension of K (default 400)
+//   Fit - if true, use fitMultMPO instead of nmultMPO
+//         for all MPO products, each fit starting from the
+//         previous product (default false). Slower, but
+//         closer to the exact products when Maxm truncates them
+//         (e.g. relative error 0.27 instead of 0.52 for the square
+//         of a 20 site J1-J2 chain Hamiltonian at m=6)
 template<class Tensor>
 void 
 expH(const MPOt<Tensor>& H, MPOt<Tensor>& K, Real tau, Real Etot,
-     Real Kcutoff, int ndoub);
+     Real Kcutoff, int ndoub, const OptSet& opts = Global::opts());
+
+//Approximates K=exp(-tau*H) by an MPO with the same bond dimension
+//as H (the W^I or W^II approximation of Zaletel et al.), 
+//with error O(tau^2) per site for a sum of local terms.
+//H must have the usual lower/upper triangular form: the
+//starting and ending states of each bond are found automatically.
+//
+//For real time evolution use tau = i*dt. Applying toExpH with 
+//tau1 = tau*(1+i)/2 and then with tau2 = tau*(1-i)/2 cancels 
+//the O(tau^2) error.
+//
+//Options recognized:
+//   Approx - "WII" (default) or "WI"
+//
+template<class Tensor>
+void 
+toExpH(const MPOt<Tensor>& H, Complex tau, MPOt<Tensor>& K,
+       const OptSet& opts = Global::opts());
 
 #undef Cout
 #undef Endl
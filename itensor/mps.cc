@@ -4,6 +4,7 @@
 //
 #include "mps.h"
 #include "localop.h"
+#include "sweeps.h"
 
 using std::map;
 using std::istream;
@@ -34,7 +35,9 @@ MPSt()
     model_(0),
     atb_(1),
     writedir_("."),
-    do_write_(false)
+    do_write_(false),
+    budget_(0),
+    sweepdir_(Fromleft)
     { }
 template MPSt<ITensor>::
 MPSt();
@@ -52,9 +55,12 @@ MPSt(const Model& mod_,int maxmm, Real cut)
     is_ortho_(false),
     model_(&mod_), 
     spectrum_(N_),
+    spec_valid_(N_,false),
     atb_(1),
     writedir_("."),
-    do_write_(false)
+    do_write_(false),
+    budget_(0),
+    sweepdir_(Fromleft)
     { 
     cutoff(cut);
     maxm(maxmm);
@@ -76,9 +82,12 @@ MPSt(const InitState& initState,int maxmm, Real cut)
     is_ortho_(true),
     model_(&(initState.model())), 
     spectrum_(N_),
+    spec_valid_(N_,false),
     atb_(1),
     writedir_("."),
-    do_write_(false)
+    do_write_(false),
+    budget_(0),
+    sweepdir_(Fromleft)
     { 
     cutoff(cut);
     maxm(maxmm);
@@ -101,9 +110,12 @@ MPSt(const Model& mod_, const InitState& initState,int maxmm, Real cut)
     is_ortho_(true),
     model_(&(initState.model())), 
     spectrum_(N_),
+    spec_valid_(N_,false),
     atb_(1),
     writedir_("."),
-    do_write_(false)
+    do_write_(false),
+    budget_(0),
+    sweepdir_(Fromleft)
     { 
     cutoff(cut);
     maxm(maxmm);
@@ -124,7 +136,9 @@ MPSt(const Model& model, std::istream& s)
     model_(&model),
     atb_(1),
     writedir_("."),
-    do_write_(false)
+    do_write_(false),
+    budget_(0),
+    sweepdir_(Fromleft)
     { 
     read(s); 
     }
@@ -144,9 +158,13 @@ MPSt(const MPSt& other)
     is_ortho_(other.is_ortho_),
     model_(other.model_),
     spectrum_(other.spectrum_),
+    spec_valid_(other.spec_valid_),
     atb_(other.atb_),
     writedir_(other.writedir_),
-    do_write_(other.do_write_)
+    do_write_(other.do_write_),
+    io_(other.io_),
+    budget_(0),
+    sweepdir_(other.sweepdir_)
     { 
     copyWriteDir();
     }
@@ -166,9 +184,14 @@ operator=(const MPSt& other)
     is_ortho_ = other.is_ortho_;
     model_ = other.model_;
     spectrum_ = other.spectrum_;
+    spec_valid_ = other.spec_valid_;
     atb_ = other.atb_;
     writedir_ = other.writedir_;
     do_write_ = other.do_write_;
+    io_ = other.io_;
+    if(budget_) budget_->remove(this);
+    budget_ = 0;
+    sweepdir_ = other.sweepdir_;
 
     copyWriteDir();
     return *this;
@@ -195,6 +218,7 @@ Anc(int i)
     if(i <= l_orth_lim_) l_orth_lim_ = i-1;
     if(i >= r_orth_lim_) r_orth_lim_ = i+1;
     is_ortho_ = false;
+    spec_valid_.assign(N_,false);
     return A_.at(i); 
     }
 template
@@ -235,6 +259,7 @@ read(std::istream& s)
     spectrum_.resize(N_);
     Foreach(Spectrum& spec, spectrum_)
         spec.read(s);
+    spec_valid_.assign(N_,false);
     }
 template
 void MPSt<ITensor>::read(std::istream& s);
@@ -246,12 +271,20 @@ template <class Tensor>
 void MPSt<Tensor>::
 write(std::ostream& s) const
     {
-    if(do_write_)
-        Error("MPSt::write not yet supported if doWrite(true)");
-
     for(int j = 1; j <= N_; ++j) 
         {
-        A_.at(j).write(s);
+        if(do_write_ && A_.at(j).isNull())
+            {
+            //Tensors written to disk are read back in
+            //without moving the bond kept in memory
+            Tensor A;
+            io_->read(AFName(j),A);
+            A.write(s);
+            }
+        else
+            {
+            A_.at(j).write(s);
+            }
         }
     s.write((char*) &l_orth_lim_,sizeof(l_orth_lim_));
     s.write((char*) &r_orth_lim_,sizeof(r_orth_lim_));
@@ -263,6 +296,115 @@ void MPSt<ITensor>::write(std::ostream& s) const;
 template
 void MPSt<IQTensor>::write(std::ostream& s) const;
 
+template <class Tensor>
+void MPSt<Tensor>::
+read(std::istream& s, const std::string& snapdir)
+    {
+    if(model_ == 0)
+        Error("Can't read to default constructed MPS");
+    for(int j = 1; j <= N_; ++j) 
+        {
+        char ondisk = 0;
+        s.read(&ondisk,1);
+        if(ondisk) readCompressed(AFName(j,snapdir),A_.at(j));
+        else       A_.at(j).read(s);
+        }
+    IndexT s1 = findtype(A_.at(1),Site);
+    s1.noprime();
+    if(s1 != IndexT(model_->si(1)))
+        Error("Tensors read from disk not compatible with Model passed to constructor.");
+    s.read((char*) &l_orth_lim_,sizeof(l_orth_lim_));
+    s.read((char*) &r_orth_lim_,sizeof(r_orth_lim_));
+    spectrum_.resize(N_);
+    Foreach(Spectrum& spec, spectrum_)
+        spec.read(s);
+    spec_valid_.assign(N_,false);
+    }
+template
+void MPSt<ITensor>::read(std::istream& s, const std::string& snapdir);
+template
+void MPSt<IQTensor>::read(std::istream& s, const std::string& snapdir);
+
+template <class Tensor>
+void MPSt<Tensor>::
+write(std::ostream& s, const std::string& snapdir) const
+    {
+    if(do_write_)
+        {
+        io_->flush();
+        snapshotDir(writedir_,snapdir);
+        }
+    for(int j = 1; j <= N_; ++j) 
+        {
+        const char ondisk = (do_write_ && A_.at(j).isNull());
+        s.write(&ondisk,1);
+        if(!ondisk) A_.at(j).write(s);
+        }
+    s.write((char*) &l_orth_lim_,sizeof(l_orth_lim_));
+    s.write((char*) &r_orth_lim_,sizeof(r_orth_lim_));
+    Foreach(const Spectrum& spec, spectrum_)
+        spec.write(s);
+    }
+template
+void MPSt<ITensor>::write(std::ostream& s, const std::string& snapdir) const;
+template
+void MPSt<IQTensor>::write(std::ostream& s, const std::string& snapdir) const;
+
+template <class Tensor>
+void MPSt<Tensor>::
+read(BinaryReader& r)
+    {
+    if(model_ == 0)
+        Error("Can't read to default constructed MPS");
+    for(int j = 1; j <= N_; ++j) 
+        A_.at(j).read(r);
+    IndexT s1 = findtype(A_.at(1),Site);
+    s1.noprime();
+    if(s1 != IndexT(model_->si(1)))
+        Error("Tensors read from disk not compatible with Model passed to constructor.");
+    std::istream& s = r.meta();
+    s.read((char*) &l_orth_lim_,sizeof(l_orth_lim_));
+    s.read((char*) &r_orth_lim_,sizeof(r_orth_lim_));
+    spectrum_.resize(N_);
+    Foreach(Spectrum& spec, spectrum_)
+        spec.read(s);
+    spec_valid_.assign(N_,false);
+    }
+template
+void MPSt<ITensor>::read(BinaryReader& r);
+template
+void MPSt<IQTensor>::read(BinaryReader& r);
+
+template <class Tensor>
+void MPSt<Tensor>::
+write(BinaryWriter& w) const
+    {
+    for(int j = 1; j <= N_; ++j) 
+        {
+        if(do_write_ && A_.at(j).isNull())
+            {
+            //As in write(std::ostream&), tensors on disk
+            //are read back without moving the bond in memory
+            Tensor A;
+            io_->read(AFName(j),A);
+            A.write(w);
+            }
+        else
+            {
+            A_.at(j).write(w);
+            }
+        }
+    std::ostream& s = w.meta();
+    s.write((char*) &l_orth_lim_,sizeof(l_orth_lim_));
+    s.write((char*) &r_orth_lim_,sizeof(r_orth_lim_));
+    Foreach(const Spectrum& spec, spectrum_)
+        spec.write(s);
+    }
+template
+void MPSt<ITensor>::write(BinaryWriter& w) const;
+template
+void MPSt<IQTensor>::write(BinaryWriter& w) const;
+
 template <class Tensor>
 void MPSt<Tensor>::
 read(const std::string& dirname)
@@ -279,7 +421,8 @@ read(const std::string& dirname)
     //    dname_ += "/";
 
     for(int j = 1; j <= N_; ++j)
-        readFromFile(AFName(j,dirname),A_.at(j));
+        readCompressed(AFName(j,dirname),A_.at(j));
+    spec_valid_.assign(N_,false);
     }
 template
 void MPSt<ITensor>::read(const std::string& dirname);
@@ -311,6 +454,13 @@ setBond(int b) const
         atb_ = b;
         return;
         }
+    const int oldb = atb_;
+    if(budget_ != 0)
+        {
+        //Tensors stay in memory until the
+        //MemoryBudget asks for them to be evicted
+        atb_ = b;
+        }
     //
     //Shift atb_ (location of bond that is loaded into RAM)
     //to requested value b, writing any non-Null tensors to
@@ -321,13 +471,13 @@ setBond(int b) const
         if(!A_.at(atb_).isNull())
             {
             //cout << format("Writing A(%d) to %s\n")%atb_%writedir_;
-            writeToFile(AFName(atb_),A_.at(atb_));
+            io_->write(AFName(atb_),A_.at(atb_));
             A_.at(atb_) = Tensor();
             }
         if(!A_.at(atb_+1).isNull())
             {
             //cout << format("Writing A(%d) to %s\n")%(atb_+1)%writedir_;
-            writeToFile(AFName(atb_+1),A_.at(atb_+1));
+            io_->write(AFName(atb_+1),A_.at(atb_+1));
             if(atb_+1 != b) A_.at(atb_+1) = Tensor();
             }
         ++atb_;
@@ -337,13 +487,13 @@ setBond(int b) const
         if(!A_.at(atb_).isNull())
             {
             //cerr << format("Writing A(%d) to %s\n")%atb_%writedir_;
-            writeToFile(AFName(atb_),A_.at(atb_));
+            io_->write(AFName(atb_),A_.at(atb_));
             if(atb_ != b+1) A_.at(atb_) = Tensor();
             }
         if(!A_.at(atb_+1).isNull())
             {
             //cerr << format("Writing A(%d) to %s\n")%(atb_+1)%writedir_;
-            writeToFile(AFName(atb_+1),A_.at(atb_+1));
+            io_->write(AFName(atb_+1),A_.at(atb_+1));
             A_.at(atb_+1) = Tensor();
             }
         --atb_;
@@ -355,17 +505,34 @@ setBond(int b) const
     //
     if(A_.at(b).isNull())
         {
-        readFromFile(AFName(b),A_.at(b));
+        io_->read(AFName(b),A_.at(b));
         }
 
     if(A_.at(b+1).isNull())
         {
-        readFromFile(AFName(b+1),A_.at(b+1));
+        io_->read(AFName(b+1),A_.at(b+1));
         }
 
+    //
+    //Have the I/O thread read in the site tensors
+    //needed for the next few bonds of the sweep
+    //
+    Direction dir = (b > oldb ? Fromleft : Fromright);
+    if(b+1 >= N_) dir = Fromright;
+    if(b <= 1) dir = Fromleft;
+    sweepdir_ = dir;
+    for(int n = 1; n <= io_->window(); ++n)
+        {
+        const int j = (dir == Fromleft ? b+1+n : b-n);
+        if(j < 1 || j > N_) break;
+        if(A_.at(j).isNull()) io_->prefetch(AFName(j));
+        }
+
+    if(budget_ != 0) budget_->enforce();
+
     if(b == 1)
         {
-        writeToFile(writedir_+"/model",*model_);
+        writeToNewFile(writedir_+"/model",*model_);
         //std::ofstream inf((format("%s/info")%writedir_).str().c_str());
         //    inf.write((char*) &l_orth_lim_,sizeof(l_orth_lim_));
         //    inf.write((char*) &r_orth_lim_,sizeof(r_orth_lim_));
@@ -378,6 +545,97 @@ void MPSt<ITensor>::setBond(int b) const;
 template
 void MPSt<IQTensor>::setBond(int b) const;
 
+template <class Tensor>
+void MPSt<Tensor>::
+memoryBudget(MemoryBudget* budget, const OptSet& opts)
+    {
+    if(budget_ != 0) budget_->remove(this);
+    budget_ = budget;
+    if(budget_ == 0) return;
+    doWrite(true,opts);
+    budget_->add(this);
+    }
+template
+void MPSt<ITensor>::memoryBudget(MemoryBudget* budget, const OptSet& opts);
+template
+void MPSt<IQTensor>::memoryBudget(MemoryBudget* budget, const OptSet& opts);
+
+template <class Tensor>
+Real MPSt<Tensor>::
+memUse() const
+    {
+    Real b = 0;
+    for(int j = 1; j <= N_; ++j)
+        {
+        b += memBytes(A_.at(j));
+        }
+    return b;
+    }
+template
+Real MPSt<ITensor>::memUse() const;
+template
+Real MPSt<IQTensor>::memUse() const;
+
+//
+//Returns the site whose tensor, among those in memory
+//and not at the current bond, will be needed
+//furthest in the future (or 0 if there is none)
+//
+template <class Tensor>
+int MPSt<Tensor>::
+farthest(int& dist) const
+    {
+    int jfar = 0;
+    dist = -1;
+    for(int j = 1; j <= N_; ++j)
+        {
+        if(j == atb_ || j == atb_+1) continue;
+        if(A_.at(j).isNull()) continue;
+        //Site j is used at bonds j-1 and j
+        int d = INT_MAX;
+        if(j > 1) d = sweepDistance(atb_,j-1,sweepdir_,N_);
+        if(j < N_) d = std::min(d,sweepDistance(atb_,j,sweepdir_,N_));
+        if(d > dist)
+            {
+            dist = d;
+            jfar = j;
+            }
+        }
+    return jfar;
+    }
+template
+int MPSt<ITensor>::farthest(int& dist) const;
+template
+int MPSt<IQTensor>::farthest(int& dist) const;
+
+template <class Tensor>
+int MPSt<Tensor>::
+farthestUse() const
+    {
+    int dist = -1;
+    farthest(dist);
+    return dist;
+    }
+template
+int MPSt<ITensor>::farthestUse() const;
+template
+int MPSt<IQTensor>::farthestUse() const;
+
+template <class Tensor>
+void MPSt<Tensor>::
+evictFarthest()
+    {
+    int dist = -1;
+    const int j = farthest(dist);
+    if(j == 0) return;
+    io_->write(AFName(j),A_.at(j));
+    A_.at(j) = Tensor();
+    }
+template
+void MPSt<ITensor>::evictFarthest();
+template
+void MPSt<IQTensor>::evictFarthest();
+
 
 template <class Tensor>
 void MPSt<Tensor>::
@@ -859,7 +1117,9 @@ position(int i, const OptSet& opts)
             if(l_orth_lim_ < 0) l_orth_lim_ = 0;
             setBond(l_orth_lim_+1);
             //cout << format("In position, SVDing bond %d\n") % (l_orth_lim_+1) << endl;
-            orthMPS(Anc(l_orth_lim_+1),Anc(l_orth_lim_+2),spectrum_.at(l_orth_lim_+1),
+            //orthMPS leaves the state, and so
+            //the spectra, unchanged
+            orthMPS(A_.at(l_orth_lim_+1),A_.at(l_orth_lim_+2),spectrum_.at(l_orth_lim_+1),
                     Fromleft,opts);
             ++l_orth_lim_;
             if(r_orth_lim_ < l_orth_lim_+2) r_orth_lim_ = l_orth_lim_+2;
@@ -869,7 +1129,7 @@ position(int i, const OptSet& opts)
             if(r_orth_lim_ > N_+1) r_orth_lim_ = N_+1;
             setBond(r_orth_lim_-2);
             //cout << format("In position, SVDing bond %d\n") % (r_orth_lim_-2) << endl;
-            orthMPS(Anc(r_orth_lim_-2),Anc(r_orth_lim_-1),spectrum_.at(r_orth_lim_-2),
+            orthMPS(A_.at(r_orth_lim_-2),A_.at(r_orth_lim_-1),spectrum_.at(r_orth_lim_-2),
                     Fromright,opts);
             --r_orth_lim_;
             if(l_orth_lim_ > r_orth_lim_-2) l_orth_lim_ = r_orth_lim_-2;
@@ -1042,6 +1302,9 @@ initWrite(const OptSet& opts)
         {
         std::string global_write_dir = Global::opts().getString("WriteDir","./");
         writedir_ = mkTempDir("psi",global_write_dir);
+        io_ = boost::make_shared<TensorIO<Tensor> >(opts.getInt("PrefetchWindow",0),
+                                                      opts.getBool("Fsync",false),
+                                                      codecFromName(opts.getString("Compress","None")));
 
         //Write all null tensors to disk immediately because
         //later logic assumes null means written to disk
@@ -1057,7 +1320,7 @@ initWrite(const OptSet& opts)
             for(int j = 1; j <= N_; ++j)
                 {
                 if(A_.at(j).isNull()) continue;
-                writeToFile(AFName(j),A_.at(j));
+                io_->write(AFName(j),A_.at(j));
                 if(j < atb_ || j > atb_+1)
                     A_[j] = Tensor();
                 }
@@ -1081,9 +1344,17 @@ copyWriteDir()
         std::string global_write_dir = Global::opts().getString("WriteDir","./");
         writedir_ = mkTempDir("psi",global_write_dir);
 
-        string cmdstr = "cp -r " + old_writedir + "/* " + writedir_;
-        //cout << "Calling system(" << cmdstr << ")" << endl;
-        system(cmdstr.c_str());
+        //io_ is still shared with the MPS we were
+        //copied from; finish its writes before copying
+        //the files, then start our own
+        const int window = io_->window();
+        const bool fsync = io_->fsync();
+        const Codec codec = io_->codec();
+        io_->flush();
+
+        snapshot_stats_ = snapshotDir(old_writedir,writedir_);
+
+        io_ = boost::make_shared<TensorIO<Tensor> >(window,fsync,codec);
         }
     }
 template
@@ -1098,8 +1369,10 @@ cleanupWrite()
     {
     if(do_write_)
         {
-        const string cmdstr = "rm -fr " + writedir_;
-        system(cmdstr.c_str());
+        if(budget_ != 0) budget_->remove(this);
+        budget_ = 0;
+        io_.reset();
+        removeDir(writedir_);
         do_write_ = false;
         }   
     }
@@ -1751,3 +2024,440 @@ fitWF(const MPSt<Tensor>& psi_basis, MPSt<Tensor>& psi_to_fit)
 template void fitWF(const MPSt<ITensor>& psi_basis, MPSt<ITensor>& psi_to_fit);
 template void fitWF(const MPSt<IQTensor>& psi_basis, MPSt<IQTensor>& psi_to_fit);
 
+
+//
+// Starting guess for fitSum, built in a single left-to-right
+// pass without ever forming the sum. At each site the reduced
+// density matrix of the sum is computed from the overlaps 
+// of the terms with the guess to the left (LE) and of the
+// terms with each other to the right (R), and its leading 
+// eigenvectors (at most maxm of them) become the next site 
+// of the guess. No link of the guess exceeds maxm.
+//
+template <class Tensor>
+void
+densityMatrixGuess(const std::vector<MPSt<Tensor> >& terms, 
+                   const std::vector<Real>& coefs,
+                   MPSt<Tensor>& res, 
+                   Real cutoff, int maxm)
+    {
+    typedef typename Tensor::IndexT 
+    IndexT;
+    typedef typename Tensor::CombinerT 
+    CombinerT;
+    typedef typename Tensor::SparseT 
+    SparseT;
+
+    const int Nt = terms.size();
+    const int N = terms.front().N();
+
+    //R[n][m][j] is the overlap of terms[n] 
+    //with terms[m] over sites j..N
+    vector<vector<vector<Tensor> > > R(Nt,vector<vector<Tensor> >(Nt,vector<Tensor>(N+2)));
+    for(int n = 0; n < Nt; ++n)
+    for(int m = 0; m < Nt; ++m)
+    for(int j = N; j > 1; --j)
+        {
+        const Tensor& A = terms[n].A(j);
+        R[n][m][j] = (R[n][m][j+1].isNull() ? A : R[n][m][j+1]*A);
+        R[n][m][j] *= conj(primed(terms[m].A(j),Link));
+        }
+
+    res = MPSt<Tensor>(terms.front().model(),maxm,cutoff);
+
+    Spectrum spec;
+    spec.cutoff(cutoff);
+    spec.maxm(maxm);
+
+    //LE[n] is the overlap of terms[n] with 
+    //the guess over the sites already fixed
+    vector<Tensor> LE(Nt);
+    for(int j = 1; j < N; ++j)
+        {
+        vector<Tensor> T(Nt);
+        for(int n = 0; n < Nt; ++n)
+            {
+            T[n] = (LE[n].isNull() ? terms[n].A(j) : LE[n]*terms[n].A(j));
+            }
+
+        vector<Tensor> Tc(Nt);
+        for(int n = 0; n < Nt; ++n)
+            {
+            Tc[n] = T[n];
+            Tc[n].noprime();
+            }
+
+        //Combine the guess link and site index
+        CombinerT comb;
+        Foreach(const IndexT& I, Tc.front().indices())
+            { 
+            if(!hasindex(terms.front().A(j+1),I))
+                comb.addleft(I);
+            }
+        comb.doCondense(true);
+        comb.init(nameint("a",j));
+
+        for(int n = 0; n < Nt; ++n)
+            {
+            Tensor t;
+            comb.product(Tc[n],t);
+            Tc[n] = coefs[n]*t;
+            }
+
+        Tensor rho;
+        for(int n = 0; n < Nt; ++n)
+            {
+            Tensor X;
+            for(int m = 0; m < Nt; ++m)
+                {
+                Tensor Y = R[n][m][j+1] * conj(primed(Tc[m]));
+                if(m == 0) X = Y;
+                else       X += Y;
+                }
+            Tensor rn = Tc[n] * X;
+            if(n == 0) rho = rn;
+            else       rho += rn;
+            }
+
+        Tensor U;
+        SparseT D;
+        diag_hermitian(rho,U,D,spec);
+
+        comb.conj();
+        comb.product(conj(U),res.Anc(j));
+
+        for(int n = 0; n < Nt; ++n)
+            {
+            LE[n] = T[n] * conj(primed(res.A(j),Link));
+            }
+        }
+
+    Tensor last;
+    for(int n = 0; n < Nt; ++n)
+        {
+        Tensor t = LE[n]*terms[n].A(N);
+        t *= coefs[n];
+        if(n == 0) last = t;
+        else       last += t;
+        }
+    last.noprime();
+    res.Anc(N) = last;
+    }
+
+template <class Tensor>
+void 
+fitSum(const std::vector<MPSt<Tensor> >& terms, 
+       const std::vector<Real>& coefs,
+       MPSt<Tensor>& res, 
+       const OptSet& opts)
+    {
+    const int Nt = terms.size();
+    if(Nt == 0) Error("fitSum: no terms");
+    if(int(coefs.size()) != Nt) 
+        Error("fitSum: number of coefs must equal number of terms");
+
+    const int N = terms.front().N();
+    for(int n = 0; n < Nt; ++n)
+        {
+        if(terms[n].N() != N) 
+            Error("fitSum: terms must have same number of sites");
+        if(&terms[n] == &res)
+            Error("fitSum: res must not be one of the terms");
+        }
+
+    const Real cutoff = opts.getReal("Cutoff",terms.front().cutoff());
+    const int maxm = opts.getInt("Maxm",terms.front().maxm());
+    const int nsweep = opts.getInt("Nsweep",4);
+    const Real errgoal = opts.getReal("ErrGoal",1E-10);
+    const bool verbose = opts.getBool("Verbose",false);
+
+    if(!opts.getBool("UseGuess",false)) 
+        {
+        densityMatrixGuess(terms,coefs,res,cutoff,maxm);
+        }
+    if(res.N() != N) Error("fitSum: mismatched N of guess");
+
+    const Real orig_cutoff = res.cutoff(),
+               orig_noise = res.noise();
+    const int orig_maxm = res.maxm();
+    res.cutoff(cutoff);
+    res.maxm(maxm);
+    res.noise(0);
+
+    res.position(1);
+
+    //LE[n][j] is the overlap of terms[n] with
+    //res over sites 1..j, RE[n][j] over sites j..N
+    vector<vector<Tensor> > LE(Nt,vector<Tensor>(N+1)),
+                            RE(Nt,vector<Tensor>(N+2));
+    for(int n = 0; n < Nt; ++n)
+    for(int j = N; j > 2; --j)
+        {
+        const Tensor& A = terms[n].A(j);
+        RE[n][j] = (RE[n][j+1].isNull() ? A : RE[n][j+1]*A);
+        RE[n][j] *= conj(primed(res.A(j),Link));
+        }
+
+    Real last_nrm2 = -1;
+    for(int sw = 1; sw <= nsweep; ++sw)
+        {
+        Real nrm2 = 0;
+        for(int b = 1, ha = 1; ha <= 2; sweepnext(b,ha,N))
+            {
+            Tensor phi;
+            for(int n = 0; n < Nt; ++n)
+                {
+                const MPSt<Tensor>& t = terms[n];
+                Tensor tphi = (LE[n][b-1].isNull() ? t.A(b) : LE[n][b-1]*t.A(b));
+                tphi *= t.A(b+1);
+                if(!RE[n][b+2].isNull()) tphi *= RE[n][b+2];
+                tphi *= coefs[n];
+                if(n == 0) phi = tphi;
+                else       phi += tphi;
+                }
+            phi.noprime();
+
+            nrm2 = sqr(phi.norm());
+
+            const Direction dir = (ha == 1 ? Fromleft : Fromright);
+            res.svdBond(b,phi,dir,opts);
+
+            for(int n = 0; n < Nt; ++n)
+                {
+                const MPSt<Tensor>& t = terms[n];
+                if(dir == Fromleft)
+                    {
+                    LE[n][b] = (LE[n][b-1].isNull() ? t.A(b) : LE[n][b-1]*t.A(b));
+                    LE[n][b] *= conj(primed(res.A(b),Link));
+                    }
+                else
+                    {
+                    RE[n][b+1] = (RE[n][b+2].isNull() ? t.A(b+1) : RE[n][b+2]*t.A(b+1));
+                    RE[n][b+1] *= conj(primed(res.A(b+1),Link));
+                    }
+                }
+            }
+
+        if(verbose)
+            {
+            int mm = 1;
+            for(int j = 1; j < N; ++j) mm = max(mm,res.LinkInd(j).m());
+            cout << format("    fitSum: sweep %d, <res|res> = %.12f, max m = %d")
+                    % sw % nrm2 % mm << endl;
+            }
+        if(last_nrm2 > 0 && fabs(nrm2-last_nrm2) < errgoal*nrm2) break;
+        last_nrm2 = nrm2;
+        }
+
+    res.cutoff(orig_cutoff);
+    res.maxm(orig_maxm);
+    res.noise(orig_noise);
+    }
+template void fitSum(const std::vector<MPSt<ITensor> >& terms, const std::vector<Real>& coefs,
+                     MPSt<ITensor>& res, const OptSet& opts);
+template void fitSum(const std::vector<MPSt<IQTensor> >& terms, const std::vector<Real>& coefs,
+                     MPSt<IQTensor>& res, const OptSet& opts);
+
+template <class Tensor>
+void 
+compress(MPSt<Tensor>& psi, int maxm, Real cutoff,
+         const OptSet& opts)
+    {
+    std::vector<MPSt<Tensor> > terms(1,psi);
+
+    const Real orig_cutoff = psi.cutoff();
+    const int orig_maxm = psi.maxm();
+    psi.cutoff(cutoff);
+    psi.maxm(maxm);
+    psi.orthogonalize();
+
+    OptSet fopts(opts);
+    fopts.add(Opt("UseGuess"),Maxm(maxm),Cutoff(cutoff));
+    fitSum(terms,psi,fopts);
+
+    psi.cutoff(orig_cutoff);
+    psi.maxm(orig_maxm);
+    }
+template void compress(MPSt<ITensor>& psi, int maxm, Real cutoff, const OptSet& opts);
+template void compress(MPSt<IQTensor>& psi, int maxm, Real cutoff, const OptSet& opts);
+
+template <class Tensor>
+Matrix
+correlationMatrix(const MPSt<Tensor>& psi, const std::string& op1, 
+                  const std::string& op2, const OptSet& opts)
+    {
+    const bool fermionic = opts.getBool("Fermionic",false);
+    const bool connected = opts.getBool("Connected",false);
+
+    const Model& model = psi.model();
+    const int N = psi.N();
+
+    //Site operators, including products with the
+    //Jordan-Wigner string F where needed
+    std::vector<Tensor> O1(N+1),
+                        O2(N+1),
+                        O1F(N+1),
+                        O2F(N+1),
+                        str(N+1),
+                        O12(N+1);
+    for(int j = 1; j <= N; ++j)
+        {
+        O1.at(j) = model.op(op1,j);
+        O2.at(j) = model.op(op2,j);
+        str.at(j) = model.op(fermionic ? "F" : "Id",j);
+        O1F.at(j) = (fermionic ? multSiteOps(O1.at(j),str.at(j)) : O1.at(j));
+        O2F.at(j) = (fermionic ? multSiteOps(O2.at(j),str.at(j)) : O2.at(j));
+        O12.at(j) = multSiteOps(O1.at(j),O2.at(j));
+        }
+
+    //<op1_j op2_i> = sgn <op2_i op1_j> for i < j
+    const Real sgn = (fermionic ? -1 : 1);
+
+    Matrix C(N,N);
+    C = 0;
+    Vector ev1(N),
+           ev2(N);
+
+    MPSt<Tensor> phi(psi);
+    for(int i = 1; i <= N; ++i)
+        {
+        //Orthogonality center at i: everything to 
+        //the right of the operators contracts to the identity
+        phi.position(i);
+        const Tensor& Ai = phi.A(i);
+        const Tensor Aisc = conj(primed(Ai,Site));
+
+        C(i,i) = (Ai * O12.at(i) * Aisc).toComplex().real();
+        if(connected)
+            {
+            ev1(i) = (Ai * O1.at(i) * Aisc).toComplex().real();
+            ev2(i) = (Ai * O2.at(i) * Aisc).toComplex().real();
+            }
+
+        if(i == N) break;
+
+        const Tensor Aic = primed(Aisc,phi.LinkInd(i));
+
+        //Left environments for op1 and for op2 at site i
+        Tensor L1 = Ai * O1F.at(i) * Aic,
+               L2 = Ai * O2F.at(i) * Aic;
+
+        for(int j = i+1; j <= N; ++j)
+            {
+            const Tensor& Aj = phi.A(j);
+            const Tensor Ajc = conj(primed(primed(Aj,Site),phi.LinkInd(j-1)));
+            Tensor L1A = L1 * Aj,
+                   L2A = L2 * Aj;
+            C(i,j) = (L1A * O2.at(j) * Ajc).toComplex().real();
+            C(j,i) = sgn*(L2A * O1.at(j) * Ajc).toComplex().real();
+
+            if(j == N) break;
+            const Tensor Ajpc = conj(primed(Aj));
+            L1 = L1A * str.at(j) * Ajpc;
+            L2 = L2A * str.at(j) * Ajpc;
+            }
+        }
+
+    if(connected)
+        {
+        for(int i = 1; i <= N; ++i)
+        for(int j = 1; j <= N; ++j)
+            {
+            C(i,j) -= ev1(i)*ev2(j);
+            }
+        }
+
+    return C;
+    }
+template Matrix correlationMatrix(const MPSt<ITensor>& psi, const std::string& op1, 
+                                  const std::string& op2, const OptSet& opts);
+template Matrix correlationMatrix(const MPSt<IQTensor>& psi, const std::string& op1, 
+                                  const std::string& op2, const OptSet& opts);
+
+//Normalized copy of the density matrix eigenvalues eigs
+static Vector
+normalizedEigs(const Vector& eigs)
+    {
+    Vector p(eigs);
+    const Real tot = p.sumels();
+    if(tot > 0) p *= 1./tot;
+    return p;
+    }
+
+template <class Tensor>
+EntanglementProfile
+entanglementProfile(const MPSt<Tensor>& psi, const OptSet& opts)
+    {
+    typedef typename Tensor::IndexT
+    IndexT;
+    typedef typename Tensor::SparseT
+    SparseT;
+
+    const int N = psi.N();
+    EntanglementProfile prof(N);
+
+    //With UseCached, take the stored eigenvalues of valid
+    //bonds and only sweep out to the last invalid bond on 
+    //each side of the center (moving the center through a 
+    //valid bond still takes an svd)
+    const bool cached = opts.getBool("UseCached",false);
+    if(cached)
+        {
+        int nvalid = 0;
+        for(int b = 1; b < N; ++b)
+            {
+            if(!psi.spectrumValid(b)) continue;
+            prof.eigs(b,normalizedEigs(psi.spectrum(b).eigsKept()));
+            ++nvalid;
+            }
+        if(nvalid == N-1) return prof;
+        }
+
+    MPSt<Tensor> phi(psi);
+    if(!phi.isOrtho()) phi.position(1);
+    const int c = phi.orthoCenter();
+
+    int rend = N-1,
+        lend = 1;
+    if(cached)
+        {
+        while(rend >= c && psi.spectrumValid(rend)) --rend;
+        while(lend < c && psi.spectrumValid(lend)) ++lend;
+        }
+
+    //Bonds c,...,rend: move the center to the right.
+    //(Copies of MPS's share their tensor storage, 
+    //so right and left start out cheap.)
+    MPSt<Tensor> right(phi);
+    for(int b = c; b <= rend; ++b)
+        {
+        const IndexT bnd = commonIndex(right.A(b),right.A(b+1),Link);
+        Tensor U,
+               V(bnd);
+        SparseT D;
+        Spectrum spec;
+        svd(right.A(b),U,D,V,spec);
+        right.Anc(b) = U;
+        right.Anc(b+1) *= (D*V);
+        prof.eigs(b,normalizedEigs(spec.eigsKept()));
+        }
+
+    //Bonds c-1,...,lend: move the center to the left
+    MPSt<Tensor>& left = phi;
+    for(int b = c-1; b >= lend; --b)
+        {
+        const IndexT bnd = commonIndex(left.A(b),left.A(b+1),Link);
+        Tensor U,
+               V(bnd);
+        SparseT D;
+        Spectrum spec;
+        svd(left.A(b+1),U,D,V,spec);
+        left.Anc(b+1) = U;
+        left.Anc(b) *= (D*V);
+        prof.eigs(b,normalizedEigs(spec.eigsKept()));
+        }
+
+    return prof;
+    }
+template EntanglementProfile entanglementProfile(const MPSt<ITensor>& psi, const OptSet& opts);
+template EntanglementProfile entanglementProfile(const MPSt<IQTensor>& psi, const OptSet& opts);
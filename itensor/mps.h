@@ -6,6 +6,9 @@
 #define __ITENSOR_MPS_H
 #include "svdalgs.h"
 #include "model.h"
+#include "tensorio.h"
+#include "membudget.h"
+#include "entanglement.h"
 #include "boost/function.hpp"
 
 #define Cout std::cout
@@ -40,7 +43,7 @@ convertToIQ(const Model& model, const std::vector<ITensor>& A,
 //
 
 template <class Tensor>
-class MPSt
+class MPSt : public CacheUser
     {
     public:
 
@@ -135,6 +138,14 @@ class MPSt
     Spectrum& 
     spectrum(int b) { return spectrum_.at(b); }
 
+    //True if spectrum(b) holds the density matrix eigenvalues
+    //of bond b of the current tensors: set by svdBond and svdSite
+    //when done without a noise term. Since changing any tensor
+    //changes every spectrum, svdBond, svdSite and Anc clear it
+    //for all other bonds (rescaling and position do not)
+    bool
+    spectrumValid(int b) const { return spec_valid_.at(b); }
+
 
     bool 
     isNull() const { return (model_==0); }
@@ -215,6 +226,12 @@ class MPSt
 
     bool
     doWrite() const { return do_write_; }
+    //Options used when turning writing on:
+    //  PrefetchWindow - tensors written or read ahead on
+    //                   a background thread (default 0, see tensorio.h)
+    //  Fsync - flush each file to disk (default false)
+    //  Compress - codec of the files (default "None", see compress.h)
+    //  WriteAll - write every tensor to disk right away (default false)
     void
     doWrite(bool val, const OptSet& opts = Global::opts()) 
         { 
@@ -226,7 +243,14 @@ class MPSt
             }
         else
             {
-            read(writedir_);
+            //Tensors still in memory may be newer
+            //than their files, so only read the others
+            if(io_) io_->flush();
+            for(int j = 1; j <= N_; ++j)
+                {
+                if(A_.at(j).isNull())
+                    readCompressed(AFName(j),A_.at(j));
+                }
             cleanupWrite();
             }
         }
@@ -234,6 +258,35 @@ class MPSt
     const std::string&
     writeDir() const { return writedir_; }
 
+    //Statistics of the disk I/O done
+    //since doWrite(true) was called
+    TensorIOStats
+    ioStats() const { return io_ ? io_->stats() : TensorIOStats(); }
+
+    //Statistics of the snapshot of the write directory
+    //made when this MPS was copied from one using doWrite(true)
+    const SnapshotStats&
+    snapshotStats() const { return snapshot_stats_; }
+
+    //Attach to a MemoryBudget (turning on doWrite if needed):
+    //site tensors then stay in memory as long as the budget
+    //allows instead of being written to disk as soon as 
+    //the current bond moves away from them.
+    //Call with budget == 0 to detach.
+    //Copies of this MPS are not attached.
+    void
+    memoryBudget(MemoryBudget* budget, const OptSet& opts = Global::opts());
+
+    //CacheUser interface, used by MemoryBudget
+    Real
+    memUse() const;
+    int
+    farthestUse() const;
+    void
+    evictFarthest();
+    void
+    budgetDestroyed() { budget_ = 0; }
+
     bool 
     isOrtho() const { return is_ortho_; }
     //Only use the following method if
@@ -247,6 +300,21 @@ class MPSt
     void 
     write(std::ostream& s) const;
 
+    //Same as above except that, with doWrite(true), tensors 
+    //on disk are not read back in: the write directory is
+    //linked into the existing directory snapdir (see snapshotDir)
+    //and read takes them from there.
+    void 
+    read(std::istream& s, const std::string& snapdir);
+    void 
+    write(std::ostream& s, const std::string& snapdir) const;
+
+    //Binary file I/O, see binaryio.h
+    void 
+    read(BinaryReader& r);
+    void 
+    write(BinaryWriter& w) const;
+
     //Read from a directory containing individual tensors,
     //as created when doWrite(true) is called.
     void 
@@ -256,10 +324,23 @@ class MPSt
     //MPSt Operators
     //
 
+    //Rescaling leaves the (normalized) spectra valid
     MPSt& 
-    operator*=(Real a) { Anc(l_orth_lim_+1) *= a; return *this; }
+    operator*=(Real a) 
+        { 
+        std::vector<bool> valid(spec_valid_);
+        Anc(l_orth_lim_+1) *= a; 
+        spec_valid_.swap(valid);
+        return *this; 
+        }
     MPSt& 
-    operator/=(Real a) { Anc(l_orth_lim_+1) /= a; return *this; }
+    operator/=(Real a) 
+        { 
+        std::vector<bool> valid(spec_valid_);
+        Anc(l_orth_lim_+1) /= a; 
+        spec_valid_.swap(valid);
+        return *this; 
+        }
 
     MPSt 
     operator*(Real r) const { MPSt res(*this); res *= r; return res; }
@@ -314,6 +395,30 @@ class MPSt
     svdBond(int b, const Tensor& AA, Direction dir, 
                 const LocalOpT& PH, const OptSet& opts = Global::opts());
 
+    //Same as above with the options already
+    //looked up (see DecompOpts in svdalgs.h)
+    template <class LocalOpT>
+    void 
+    svdBond(int b, const Tensor& AA, Direction dir, 
+            const LocalOpT& PH, const DecompOpts& dopts);
+
+    //Single-site analogue of svdBond: replaces site j
+    //by phi and moves the orthogonality center to site
+    //j+1 (dir==Fromleft) or j-1 (dir==Fromright).
+    //If noise() > 0 the basis of the link being crossed 
+    //is first enlarged by the part of PH*phi selected by
+    //PH.deltaRho, weighted by noise() ("subspace expansion"),
+    //which lets the bond dimension grow.
+    template <class LocalOpT>
+    void 
+    svdSite(int j, const Tensor& phi, Direction dir, 
+            const LocalOpT& PH, const OptSet& opts = Global::opts());
+
+    template <class LocalOpT>
+    void 
+    svdSite(int j, const Tensor& phi, Direction dir, 
+            const LocalOpT& PH, const DecompOpts& dopts);
+
     void
     doSVD(int b, const Tensor& AA, Direction dir, const OptSet& opts = Global::opts())
         { 
@@ -408,6 +513,7 @@ class MPSt
         {
         iqpsi = MPSt<IQTensor>(*model_,maxm(),cutoff());
         iqpsi.spectrum_ = spectrum_;
+        iqpsi.spec_valid_ = spec_valid_;
         convertToIQ(*model_,A_,iqpsi.A_,totalq,cut);
         }
 
@@ -447,6 +553,9 @@ class MPSt
 
     std::vector<Spectrum> spectrum_;
 
+    //See spectrumValid
+    std::vector<bool> spec_valid_;
+
     mutable
     int atb_;
 
@@ -454,6 +563,18 @@ class MPSt
 
     bool do_write_;
 
+    //Reads and writes site tensors when doWrite(true),
+    //prefetching the ones needed by the next few bonds
+    boost::shared_ptr<TensorIO<Tensor> > io_;
+
+    SnapshotStats snapshot_stats_;
+
+    MemoryBudget* budget_;
+
+    //Direction of the last move of atb_
+    mutable
+    Direction sweepdir_;
+
     //
     //////////////////////////
 
@@ -469,6 +590,9 @@ class MPSt
     void
     setBond(int b) const;
 
+    int
+    farthest(int& dist) const;
+
     void
     setSite(int j) const
         {
@@ -568,6 +692,14 @@ class InitState
         return *this;
         }
 
+    InitState& 
+    set(int i, const IQIndexVal& state)
+        { 
+        checkRange(i);
+        state_.at(i) = state;
+        return *this;
+        }
+
     InitState& 
     setAll(const String& state)
         { 
@@ -666,9 +798,18 @@ void MPSt<Tensor>::
 svdBond(int b, const Tensor& AA, Direction dir, 
         const LocalOpT& PH, const OptSet& opts)
     {
+    svdBond(b,AA,dir,PH,DecompOpts(opts));
+    }
+
+template <class Tensor>
+template <class LocalOpT>
+void MPSt<Tensor>::
+svdBond(int b, const Tensor& AA, Direction dir, 
+        const LocalOpT& PH, const DecompOpts& dopts)
+    {
     setBond(b);
     const bool use_orig_setting = spectrum_.at(b).useOrigM();
-    if(opts.getBool("UseOrigM",false)) 
+    if(dopts.useOrigM())
         {
         spectrum_.at(b).useOrigM(true);
         }
@@ -686,16 +827,16 @@ svdBond(int b, const Tensor& AA, Direction dir,
         Error("b+2 < r_orth_lim_");
         }
 
-    if(opts.getBool("UseSVD",false) || (noise() == 0 && cutoff() < 1E-12))
+    if(dopts.useSVD() || (noise() == 0 && cutoff() < 1E-12))
         {
         //Need high accuracy, use svd which calls the
         //accurate SVD method in the MatrixRef library
         SparseT D;
         //Cout << "Calling svdBond SVD" << Endl;
-        svd(AA,A_[b],D,A_[b+1],spectrum_.at(b),opts);
+        svd(AA,A_[b],D,A_[b+1],spectrum_.at(b),dopts);
 
         //Normalize the ortho center if requested
-        if(opts.getBool("DoNormalize",false))
+        if(dopts.doNormalize())
             {
             D *= 1./D.norm();
             }
@@ -712,10 +853,10 @@ svdBond(int b, const Tensor& AA, Direction dir,
         //or need to use noise term
         //use density matrix approach
         //Cout << "Calling svdBond denmatDecomp" << Endl;
-        denmatDecomp(AA,A_[b],A_[b+1],dir,spectrum_.at(b),PH,opts);
+        denmatDecomp(AA,A_[b],A_[b+1],dir,spectrum_.at(b),PH,dopts);
 
         //Normalize the ortho center if requested
-        if(opts.getBool("DoNormalize",false))
+        if(dopts.doNormalize())
             {
             Tensor& oc = (dir == Fromleft ? A_[b+1] : A_[b]);
             Real norm = oc.norm();
@@ -741,6 +882,117 @@ svdBond(int b, const Tensor& AA, Direction dir,
         }
 
     spectrum_.at(b).useOrigM(use_orig_setting);
+    //The new tensors change the spectra of all other bonds
+    spec_valid_.assign(N_,false);
+    spec_valid_.at(b) = (spectrum_.at(b).noise() == 0 || PH.isNull());
+    }
+
+template <class Tensor>
+template <class LocalOpT>
+void MPSt<Tensor>::
+svdSite(int j, const Tensor& phi, Direction dir, 
+        const LocalOpT& PH, const OptSet& opts)
+    {
+    svdSite(j,phi,dir,PH,DecompOpts(opts));
+    }
+
+template <class Tensor>
+template <class LocalOpT>
+void MPSt<Tensor>::
+svdSite(int j, const Tensor& phi, Direction dir, 
+        const LocalOpT& PH, const DecompOpts& dopts)
+    {
+    //Bond crossed when moving the orthogonality center
+    const int b = (dir == Fromleft ? j : j-1);
+    if(b < 1 || b >= N_)
+        {
+        Cout << Format("j=%d, N=%d")%j%N_ << Endl;
+        Error("svdSite: cannot move past the end of the MPS");
+        }
+
+    setBond(b);
+    const bool use_orig_setting = spectrum_.at(b).useOrigM();
+    if(dopts.useOrigM())
+        {
+        spectrum_.at(b).useOrigM(true);
+        }
+
+    if(dir == Fromleft && j-1 > l_orth_lim_)
+        {
+        Cout << Format("j=%d, l_orth_lim_=%d")
+                %j%l_orth_lim_ << Endl;
+        Error("j-1 > l_orth_lim_");
+        }
+    if(dir == Fromright && j+1 < r_orth_lim_)
+        {
+        Cout << Format("j=%d, r_orth_lim_=%d")
+                %j%r_orth_lim_ << Endl;
+        Error("j+1 < r_orth_lim_");
+        }
+
+    Tensor& site = A_[j];
+    Tensor& next = (dir == Fromleft ? A_[j+1] : A_[j-1]);
+
+    //C is the matrix taking the old link index 
+    //to the new one; it starts out as a copy
+    //of the neighboring site only so that the 
+    //decompositions below know to keep that link on it
+    Tensor C = next;
+
+    if(dopts.useSVD() || (noise() == 0 && cutoff() < 1E-12))
+        {
+        SparseT D;
+        if(dir == Fromleft)
+            {
+            //svd divides up indices based on its
+            //U argument unless that is null
+            site = Tensor();
+            svd(phi,site,D,C,spectrum_.at(b),dopts);
+            C *= D;
+            }
+        else
+            {
+            svd(phi,C,D,site,spectrum_.at(b),dopts);
+            C *= D;
+            }
+        }
+    else
+        {
+        if(dir == Fromleft)
+            denmatDecomp(phi,site,C,dir,spectrum_.at(b),PH,dopts);
+        else
+            denmatDecomp(phi,C,site,dir,spectrum_.at(b),PH,dopts);
+        }
+
+    next *= C;
+
+    //Normalize the ortho center if requested
+    if(dopts.doNormalize())
+        {
+        next *= 1./next.norm();
+        }
+
+    if(dir == Fromleft)
+        {
+        l_orth_lim_ = j;
+        if(r_orth_lim_ < j+2) 
+            {
+            r_orth_lim_ = j+2;
+            }
+        }
+    else //dir == Fromright
+        {
+        if(l_orth_lim_ > j-2) 
+            {
+            l_orth_lim_ = j-2;
+            }
+        r_orth_lim_ = j;
+        }
+
+    spectrum_.at(b).useOrigM(use_orig_setting);
+    //The new tensors change the spectra of all other bonds
+    spec_valid_.assign(N_,false);
+    spec_valid_.at(b) = (spectrum_.at(b).noise() == 0 || PH.isNull());
     }
 
 //
@@ -887,6 +1139,100 @@ sum(const std::vector<MPSType>& terms, MPSType& res,
         }
     }
 
+//
+// Variational sum of a set of MPS's:
+// fits res to coefs[0]*terms[0] + coefs[1]*terms[1] + ...
+// directly at the requested bond dimension by two-site 
+// sweeps, caching the environments of <res|terms[n]>.
+// Unlike sum above, no intermediate MPS with bond 
+// dimension m_1+m_2+... is ever formed and no link of
+// res exceeds Maxm; cost per step is O(Nt m^3 d^2) for 
+// Nt terms, and only the Nt environments <res|terms[n]> 
+// are stored (plus, while building the default guess,
+// the Nt^2 overlaps <terms[n]|terms[k]>).
+//
+// The terms need not be orthogonalized, but must
+// share the same site indices (and, for IQMPS, total QN).
+// (terms and coefs are zero-indexed)
+//
+// Options recognized:
+//   Maxm, Cutoff - truncation of res (default those of terms[0])
+//   Nsweep  - maximum number of sweeps (default 4)
+//   ErrGoal - stop once the relative change in <res|res>
+//             over a sweep is below this (default 1E-10)
+//   UseGuess - if true, start from res as passed in,
+//              otherwise from a guess built site by site
+//              out of the reduced density matrices of
+//              the sum, truncated to Maxm (default false)
+//   Verbose - print <res|res> after each sweep
+//
+template <class Tensor>
+void 
+fitSum(const std::vector<MPSt<Tensor> >& terms, 
+       const std::vector<Real>& coefs,
+       MPSt<Tensor>& res, 
+       const OptSet& opts = Global::opts());
+
+//Version with all coefficients equal to 1
+template <class Tensor>
+void 
+fitSum(const std::vector<MPSt<Tensor> >& terms, 
+       MPSt<Tensor>& res, 
+       const OptSet& opts = Global::opts())
+    {
+    std::vector<Real> coefs(terms.size(),1.);
+    fitSum(terms,coefs,res,opts);
+    }
+
+//
+// Compresses psi to at most maxm states per bond
+// (or fewer as set by cutoff): truncates it by 
+// SVD, then improves the result variationally
+// with fitSum. Accepts the same options as fitSum.
+//
+template <class Tensor>
+void 
+compress(MPSt<Tensor>& psi, int maxm, Real cutoff,
+         const OptSet& opts = Global::opts());
+
+//
+// Computes the matrix of two-point correlators 
+// C(i,j) = <psi|op1_i op2_j|psi> for all sites i,j
+// in a single sweep of left environments (O(N^2) contractions).
+// The diagonal holds <op1_i op2_i> (op2 acting first).
+// For complex psi, returns the real part.
+//
+// Options recognized:
+//   Fermionic - if true, op1 and op2 are fermionic operators without
+//               Jordan-Wigner string (such as "Adag" and "A"), and the
+//               string operator "F" of the model is inserted between
+//               them, so that C(i,j) = <c^op1_i c^op2_j> (default false)
+//   Connected - if true, subtract <op1_i><op2_j> (default false)
+//
+template <class Tensor>
+Matrix
+correlationMatrix(const MPSt<Tensor>& psi, const std::string& op1,
+                  const std::string& op2, 
+                  const OptSet& opts = Global::opts());
+
+//
+// Entanglement spectra of all bonds of psi, 
+// obtained in a single orthogonalization sweep
+// (see entanglement.h). If psi is already orthogonalized, 
+// the sweep starts from its orthogonality center.
+//
+// Options recognized:
+//   UseCached - if true, use the stored eigenvalues of bonds
+//               with psi.spectrumValid(b) (e.g. the last bond of
+//               a DMRG sweep without noise): bonds past the last
+//               invalid bond on either side of the orthogonality
+//               center are not swept at all (default false)
+//
+template <class Tensor>
+EntanglementProfile
+entanglementProfile(const MPSt<Tensor>& psi, 
+                    const OptSet& opts = Global::opts());
+
 template <class Tensor>
 std::ostream& 
 operator<<(std::ostream& s, const MPSt<Tensor>& M)
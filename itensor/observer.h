@@ -6,6 +6,7 @@
 #define __ITENSOR_OBSERVER_H
 
 #include "spectrum.h"
+#include "sweepstats.h"
 
 // virtual base class
 
@@ -23,6 +24,21 @@ class Observer
     checkDone(int sw, Real energy, 
               const OptSet& opts = Global::opts()) = 0;
 
+    //Called after measure with the timing and
+    //resource use of the step (does nothing by default)
+    void virtual
+    measureStats(const BondStats& stats,
+                 const OptSet& opts = Global::opts()) { }
+
+    //Save and restore any state kept between 
+    //calls to measure and checkDone, so that a
+    //calculation can be resumed from a checkpoint
+    //(do nothing by default)
+    void virtual
+    write(std::ostream& s) const { }
+    void virtual
+    read(std::istream& s) { }
+
     virtual ~Observer() { }
 
     };
@@ -24,6 +24,10 @@ class Opt
 
     Opt(const Name& name, const std::string& sval);
 
+    //Without this a string literal would
+    //be converted to bool instead
+    Opt(const Name& name, const char* sval);
+
     Opt(const Name& name, int ival);
 
     Opt(const Name& name, Real rval);
@@ -162,6 +166,8 @@ class OptSet
     void
     add(const Name& name, const std::string& sval) { add(Opt(name,sval)); }
     void
+    add(const Name& name, const char* sval) { add(Opt(name,sval)); }
+    void
     add(const Name& name, Real rval) { add(Opt(name,rval)); }
 
     void
@@ -232,6 +238,11 @@ class OptSet
 
     OptSet(bool isGlobal);
 
+    //Opt named name, looking in GlobalOpts if not
+    //defined here; null pointer if not defined at all
+    const Opt*
+    find(const Name& name) const;
+
     };
 
 OptSet inline
@@ -291,6 +302,16 @@ Opt(const Name& name, const std::string& sval)
     rval_(NAN)
     { }
 
+inline Opt::
+Opt(const Name& name, const char* sval)
+    :
+    name_(name),
+    bval_(true),
+    sval_(sval),
+    ival_(-10000),
+    rval_(NAN)
+    { }
+
 inline Opt::
 Opt(const Name& name, int ival)
     :
@@ -375,16 +396,23 @@ OptSet(const OptSet& other)
         opts_ = other.opts_;
     }
 
-bool inline OptSet::
-defined(const Opt::Name& name) const
+inline 
+const Opt* OptSet::
+find(const Opt::Name& name) const
     {
-    if(opts_.count(name) > 0)
-        return true;
+    const_iterator it = opts_.find(name);
+    if(it != opts_.end()) return &(it->second);
 
     if(is_global_) 
-        return false;
+        return 0;
     //else see if GlobalOpts contains it
-    return GlobalOpts().defined(name);
+    return GlobalOpts().find(name);
+    }
+
+bool inline OptSet::
+defined(const Opt::Name& name) const
+    {
+    return find(name) != 0;
     }
 
 void inline OptSet::
@@ -428,10 +456,10 @@ getBool(const Opt::Name& name) const
 bool inline OptSet::
 getBool(const Opt::Name& name, bool default_value) const
     {
-    if(defined(name))
-        return get(name).boolVal();
-    else
-        return default_value;
+    //Look name up once rather than with
+    //defined(name) and then get(name)
+    const Opt* opt = find(name);
+    return (opt != 0 ? opt->boolVal() : default_value);
     }
 
 inline 
@@ -444,10 +472,8 @@ getString(const Opt::Name& name) const
 inline const std::string& OptSet::
 getString(const Opt::Name& name, const std::string& default_value) const
     {
-    if(defined(name))
-        return get(name).stringVal();
-    else
-        return default_value;
+    const Opt* opt = find(name);
+    return (opt != 0 ? opt->stringVal() : default_value);
     }
 
 int inline OptSet::
@@ -459,10 +485,8 @@ getInt(const Opt::Name& name) const
 int inline OptSet::
 getInt(const Opt::Name& name, int default_value) const
     {
-    if(defined(name))
-        return get(name).intVal();
-    else
-        return default_value;
+    const Opt* opt = find(name);
+    return (opt != 0 ? opt->intVal() : default_value);
     }
 
 Real inline OptSet::
@@ -474,10 +498,8 @@ getReal(const Opt::Name& name) const
 Real inline OptSet::
 getReal(const Opt::Name& name, Real default_value) const
     {
-    if(defined(name))
-        return get(name).realVal();
-    else
-        return default_value;
+    const Opt* opt = find(name);
+    return (opt != 0 ? opt->realVal() : default_value);
     }
 
 inline 
@@ -512,6 +534,18 @@ Auto(bool val = true)
     return Opt("Auto",val);
     }
 
+Opt inline
+Checkpoint(const std::string& fname)
+    {
+    return Opt("Checkpoint",fname);
+    }
+
+Opt inline
+CheckpointEvery(int nstep)
+    {
+    return Opt("CheckpointEvery",nstep);
+    }
+
 Opt inline
 ConserveNf(bool val = true)
     {
@@ -560,6 +594,24 @@ NumCenter(int nc = 2)
     return Opt("NumCenter",nc);
     }
 
+Opt inline
+NumThreads(int n = 1)
+    {
+    return Opt("NumThreads",n);
+    }
+
+//
+// Number of threads requested by opts for a threaded
+// routine (default 1). Setting "NumThreads" in Global::opts()
+// applies it everywhere and also sizes the thread pool
+// (see threadpool.h).
+//
+int inline
+getNumThreads(const OptSet& opts)
+    {
+    return opts.getInt("NumThreads",1);
+    }
+
 Opt inline
 Offset(int n = 0)
     {
@@ -591,6 +643,18 @@ Repeat(int val)
     return Opt("Repeat",val);
     }
 
+Opt inline
+Restart(bool val = true)
+    {
+    return Opt("Restart",val);
+    }
+
+Opt inline
+StatsFile(const std::string& fname)
+    {
+    return Opt("StatsFile",fname);
+    }
+
 Opt inline
 UseOrigM(bool val = true)
     {
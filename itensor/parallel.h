@@ -0,0 +1,238 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_PARALLEL_H
+#define __ITENSOR_PARALLEL_H
+
+#include "threadpool.h"
+
+//
+// Computes res = term_0 + term_1 + ... + term_{nterm-1}
+// where term_n is computed by calling f(n,term_n).
+//
+// TermFunc must provide
+//
+//     void operator()(int n, Tensor& term) const;
+//
+// and must be safe to call concurrently for different n.
+//
+// If nthread > 1 the terms are dealt out to nthread
+// tasks (round robin) run on the library thread pool
+// (see threadpool.h), each task sums its terms into its
+// own accumulator and the accumulators are added together
+// at the end, so the result only depends on nthread.
+//
+// Without ITENSOR_USE_THREADS defined, if nthread <= 1,
+// or if called inside a parallel region nested more
+// deeply than the pool allows, the terms are summed
+// serially.
+//
+template <class Tensor, class TermFunc>
+void
+parallelSum(const TermFunc& f, int nterm, Tensor& res, int nthread = 1,
+            const std::string& name = "parallelSum");
+
+//
+// Calls f(n) for n = 0,1,...,ntask-1 using up to
+// nthread threads of the library thread pool,
+// which take the next n as they become free.
+//
+// Func must provide
+//
+//     void operator()(int n) const;
+//
+// and must be safe to call concurrently for different n.
+//
+// Task times are recorded under name if
+// the pool timing is on.
+//
+template <class Func>
+void
+parallelFor(const Func& f, int ntask, int nthread = 1,
+            const std::string& name = "parallelFor");
+
+
+//
+// Implementation
+//
+
+template <class Tensor, class TermFunc>
+class SumTermsWorker
+    {
+    public:
+
+    SumTermsWorker(const TermFunc& f, int first, int nterm, int stride,
+                   Tensor& acc, std::string& errmess)
+        :
+        f_(&f),
+        first_(first),
+        nterm_(nterm),
+        stride_(stride),
+        acc_(&acc),
+        errmess_(&errmess)
+        { }
+
+    void
+    operator()() const
+        {
+        try {
+            Tensor term;
+            for(int n = first_; n < nterm_; n += stride_)
+                {
+                if(n == first_)
+                    {
+                    (*f_)(n,*acc_);
+                    continue;
+                    }
+                (*f_)(n,term);
+                *acc_ += term;
+                }
+            }
+        catch(const ITError& e)
+            {
+            //Save the message for the calling thread,
+            //which must wait for the other tasks
+            *errmess_ = e.what();
+            }
+        }
+
+    private:
+
+    const TermFunc* f_;
+    int first_,
+        nterm_,
+        stride_;
+    Tensor* acc_;
+    std::string* errmess_;
+    };
+
+template <class Tensor, class TermFunc>
+void
+parallelSum(const TermFunc& f, int nterm, Tensor& res, int nthread,
+            const std::string& name)
+    {
+    if(nterm < 1)
+        {
+        Error("parallelSum: nterm must be at least 1");
+        }
+
+#ifndef ITENSOR_USE_THREADS
+    nthread = 1;
+#endif
+
+    if(nthread > nterm) nthread = nterm;
+    if(nthread > 1 && !ThreadPool::instance().parallelAllowed()) nthread = 1;
+
+    if(nthread <= 1)
+        {
+        std::string errmess;
+        SumTermsWorker<Tensor,TermFunc>(f,0,nterm,1,res,errmess)();
+        if(!errmess.empty()) throw ITError(errmess);
+        return;
+        }
+
+    std::vector<Tensor> acc(nthread);
+    std::vector<std::string> errmess(nthread);
+
+        {
+        ParallelRegion region;
+        TaskGroup tasks(name);
+        //Calling thread does the work of task 0
+        for(int t = 1; t < nthread; ++t)
+            {
+            tasks.run(SumTermsWorker<Tensor,TermFunc>(f,t,nterm,nthread,acc[t],errmess[t]));
+            }
+        SumTermsWorker<Tensor,TermFunc>(f,0,nterm,nthread,acc[0],errmess[0])();
+        tasks.wait();
+        }
+
+    for(int t = 0; t < nthread; ++t)
+        {
+        if(!errmess[t].empty()) throw ITError(errmess[t]);
+        }
+
+    //Reduce in a fixed order so results don't
+    //depend on how the tasks were scheduled
+    res = acc[0];
+    for(int t = 1; t < nthread; ++t)
+        {
+        res += acc[t];
+        }
+    }
+
+template <class Func>
+class ForTasksWorker
+    {
+    public:
+
+    ForTasksWorker(const Func& f, TaskCounter& next, std::string& errmess)
+        :
+        f_(&f),
+        next_(&next),
+        errmess_(&errmess)
+        { }
+
+    void
+    operator()() const
+        {
+        try {
+            int n = 0;
+            while(next_->next(n))
+                {
+                (*f_)(n);
+                }
+            }
+        catch(const ITError& e)
+            {
+            //Save the message for the calling thread,
+            //which must wait for the other tasks
+            *errmess_ = e.what();
+            }
+        }
+
+    private:
+
+    const Func* f_;
+    TaskCounter* next_;
+    std::string* errmess_;
+    };
+
+template <class Func>
+void
+parallelFor(const Func& f, int ntask, int nthread, const std::string& name)
+    {
+#ifndef ITENSOR_USE_THREADS
+    nthread = 1;
+#endif
+
+    if(nthread > ntask) nthread = ntask;
+    if(nthread > 1 && !ThreadPool::instance().parallelAllowed()) nthread = 1;
+
+    if(nthread <= 1)
+        {
+        for(int n = 0; n < ntask; ++n) f(n);
+        return;
+        }
+
+    TaskCounter next(ntask);
+    std::vector<std::string> errmess(nthread);
+
+        {
+        ParallelRegion region;
+        TaskGroup tasks(name);
+        for(int t = 1; t < nthread; ++t)
+            {
+            tasks.run(ForTasksWorker<Func>(f,next,errmess[t]));
+            }
+        ForTasksWorker<Func>(f,next,errmess[0])();
+        tasks.wait();
+        }
+
+    for(int t = 0; t < nthread; ++t)
+        {
+        if(!errmess[t].empty()) throw ITError(errmess[t]);
+        }
+    }
+
+#endif
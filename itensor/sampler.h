@@ -0,0 +1,364 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_SAMPLER_H
+#define __ITENSOR_SAMPLER_H
+
+#include "mps.h"
+#include "boost/random/mersenne_twister.hpp"
+#include "boost/random/uniform_01.hpp"
+#include "boost/random/seed_seq.hpp"
+
+#include "threadpool.h"
+
+typedef boost::random::mt19937
+SampleRNG;
+
+//
+// Draws product state configurations s_1,...,s_N
+// with probability |<s_1...s_N|psi>|^2/<psi|psi>
+// (perfect sampling).
+//
+// psi is right-orthogonalized once on construction and its
+// tensors are all loaded into memory (even if psi uses
+// doWrite(true)), so that samples can be drawn by several
+// threads at once. Each sample then takes one small
+// contraction per site, from left to right.
+//
+// A configuration conf holds conf[j] = 1,...,d_j, the state
+// of site j (conf[0] is unused) as numbered by the site IQIndex.
+//
+
+template <class Tensor>
+class MPSSampler
+    {
+    public:
+
+    typedef typename Tensor::IndexT
+    IndexT;
+    typedef typename Tensor::IndexValT
+    IndexValT;
+
+    typedef std::vector<int>
+    Config;
+
+    MPSSampler(const MPSt<Tensor>& psi);
+
+    int
+    N() const { return psi_.N(); }
+
+    //Draw a single sample using the random number
+    //generator gen. Returns its probability.
+    Real
+    sample(Config& conf, SampleRNG& gen) const;
+
+    //Draw nsample samples into confs.
+    //Samples are drawn in batches: samples in a batch sharing
+    //states on sites 1,...,j share the work done for those sites.
+    //Batch n uses the random number stream (Seed,n),
+    //so results do not depend on the number of threads.
+    //
+    //Options recognized:
+    //   Seed - seed of the random number streams (default 1)
+    //   BatchSize - number of samples per batch (default 1000)
+    //   NumThreads - number of threads working on separate batches,
+    //                used only if compiled with ITENSOR_USE_THREADS (default 1)
+    void
+    sample(int nsample, std::vector<Config>& confs,
+           const OptSet& opts = Global::opts()) const;
+
+    //Product state corresponding to conf
+    InitState
+    initState(const Config& conf) const;
+
+    //Random number generator for stream (seed,n)
+    static SampleRNG
+    makeRNG(int seed, int n);
+
+    private:
+
+    /////////////////
+    //
+    // Data Members
+    //
+
+    MPSt<Tensor> psi_;
+
+    //Site tensors of psi_, all held in memory
+    //(reading them through psi_.A(j) moves its bond)
+    std::vector<Tensor> A_;
+
+    //proj_[j][s] picks out state s of site j
+    std::vector<std::vector<Tensor> > proj_;
+
+    //
+    /////////////////
+
+    //Draws the states of sites j,...,N of the samples
+    //ids, all sharing the left environment E
+    void
+    sampleBatch(int j, const Tensor& E, const std::vector<int>& ids,
+                const std::vector<std::vector<Real> >& rand,
+                std::vector<Config>& confs) const;
+
+    //Weights of each state of site j given left environment E,
+    //and the projected environments
+    Real
+    siteWeights(int j, const Tensor& E, std::vector<Real>& w,
+                std::vector<Tensor>& nE) const;
+
+    void
+    runBatches(int first, int stride, int nbatch, int nsample,
+               int batchsize, int seed, std::vector<Config>& confs,
+               std::string& errmess) const;
+
+    template <class T>
+    friend class SampleBatchWorker;
+
+    };
+
+template <class Tensor>
+MPSSampler<Tensor>::
+MPSSampler(const MPSt<Tensor>& psi)
+    :
+    psi_(psi),
+    A_(psi.N()+1),
+    proj_(psi.N()+1)
+    {
+    psi_.doWrite(false);
+    psi_.position(1);
+    for(int j = 1; j <= N(); ++j)
+        {
+        A_.at(j) = psi_.A(j);
+        const IndexT s = psi_.si(j);
+        proj_.at(j).resize(s.m()+1);
+        for(int n = 1; n <= s.m(); ++n)
+            {
+            proj_.at(j).at(n) = conj(Tensor(IndexValT(s,n)));
+            }
+        }
+    }
+
+template <class Tensor>
+SampleRNG MPSSampler<Tensor>::
+makeRNG(int seed, int n)
+    {
+    const unsigned int v[] = { (unsigned int) seed, (unsigned int) n };
+    boost::random::seed_seq seq(v,v+2);
+    return SampleRNG(seq);
+    }
+
+template <class Tensor>
+Real MPSSampler<Tensor>::
+siteWeights(int j, const Tensor& E, std::vector<Real>& w,
+            std::vector<Tensor>& nE) const
+    {
+    const Tensor A = (E.isNull() ? A_.at(j) : E*A_.at(j));
+    const int d = proj_.at(j).size()-1;
+    w.assign(d+1,0);
+    nE.assign(d+1,Tensor());
+    Real tot = 0;
+    for(int n = 1; n <= d; ++n)
+        {
+        nE.at(n) = A * proj_.at(j).at(n);
+        w.at(n) = sqr(nE.at(n).norm());
+        tot += w.at(n);
+        }
+    if(tot <= 0) Error("MPSSampler: zero norm");
+    return tot;
+    }
+
+//State n such that w_1+...+w_{n-1} <= r < w_1+...+w_n,
+//never one of zero weight
+inline int
+pickState(const std::vector<Real>& w, Real r)
+    {
+    Real cum = 0;
+    int last = 1;
+    for(size_t n = 1; n < w.size(); ++n)
+        {
+        if(w[n] <= 0) continue;
+        last = n;
+        cum += w[n];
+        if(r < cum) break;
+        }
+    return last;
+    }
+
+template <class Tensor>
+Real MPSSampler<Tensor>::
+sample(Config& conf, SampleRNG& gen) const
+    {
+    boost::random::uniform_01<SampleRNG&> uni(gen);
+    conf.assign(N()+1,0);
+    Real prob = 1;
+    Tensor E;
+    std::vector<Real> w;
+    std::vector<Tensor> nE;
+    for(int j = 1; j <= N(); ++j)
+        {
+        const Real tot = siteWeights(j,E,w,nE);
+        const int n = pickState(w,uni()*tot);
+        conf.at(j) = n;
+        prob *= w.at(n)/tot;
+        E = nE.at(n);
+        E *= 1./sqrt(w.at(n));
+        }
+    return prob;
+    }
+
+template <class Tensor>
+void MPSSampler<Tensor>::
+sampleBatch(int j, const Tensor& E, const std::vector<int>& ids,
+            const std::vector<std::vector<Real> >& rand,
+            std::vector<Config>& confs) const
+    {
+    std::vector<Real> w;
+    std::vector<Tensor> nE;
+    const Real tot = siteWeights(j,E,w,nE);
+    const int d = w.size()-1;
+
+    std::vector<std::vector<int> > group(d+1);
+    Foreach(int id, ids)
+        {
+        const int n = pickState(w,rand.at(id).at(j)*tot);
+        confs.at(id).at(j) = n;
+        group.at(n).push_back(id);
+        }
+
+    if(j == N()) return;
+
+    for(int n = 1; n <= d; ++n)
+        {
+        if(group.at(n).empty()) continue;
+        nE.at(n) *= 1./sqrt(w.at(n));
+        sampleBatch(j+1,nE.at(n),group.at(n),rand,confs);
+        }
+    }
+
+template <class Tensor>
+void MPSSampler<Tensor>::
+runBatches(int first, int stride, int nbatch, int nsample,
+           int batchsize, int seed, std::vector<Config>& confs,
+           std::string& errmess) const
+    {
+    try {
+        for(int b = first; b < nbatch; b += stride)
+            {
+            const int start = b*batchsize,
+                      stop = std::min(nsample,start+batchsize);
+            SampleRNG gen = makeRNG(seed,b);
+            boost::random::uniform_01<SampleRNG&> uni(gen);
+
+            //Index samples within the batch from 0
+            std::vector<std::vector<Real> > rand(stop-start,std::vector<Real>(N()+1));
+            std::vector<Config> bconfs(stop-start,Config(N()+1,0));
+            std::vector<int> ids(stop-start);
+            for(int n = 0; n < stop-start; ++n)
+                {
+                ids.at(n) = n;
+                for(int j = 1; j <= N(); ++j) rand.at(n).at(j) = uni();
+                }
+            sampleBatch(1,Tensor(),ids,rand,bconfs);
+            for(int n = 0; n < stop-start; ++n) confs.at(start+n).swap(bconfs.at(n));
+            }
+        }
+    catch(const ITError& e)
+        {
+        //Exceptions must not escape a thread,
+        //save the message for the calling thread
+        errmess = e.what();
+        }
+    }
+
+template <class Tensor>
+class SampleBatchWorker
+    {
+    public:
+
+    SampleBatchWorker(const MPSSampler<Tensor>& s, int first, int stride,
+                      int nbatch, int nsample, int batchsize, int seed,
+                      std::vector<std::vector<int> >& confs, std::string& errmess)
+        : s_(&s), first_(first), stride_(stride), nbatch_(nbatch),
+          nsample_(nsample), batchsize_(batchsize), seed_(seed),
+          confs_(&confs), errmess_(&errmess)
+        { }
+
+    void
+    operator()() const
+        {
+        s_->runBatches(first_,stride_,nbatch_,nsample_,batchsize_,seed_,*confs_,*errmess_);
+        }
+
+    private:
+
+    const MPSSampler<Tensor>* s_;
+    int first_,
+        stride_,
+        nbatch_,
+        nsample_,
+        batchsize_,
+        seed_;
+    std::vector<std::vector<int> >* confs_;
+    std::string* errmess_;
+    };
+
+template <class Tensor>
+void MPSSampler<Tensor>::
+sample(int nsample, std::vector<Config>& confs, const OptSet& opts) const
+    {
+    const int seed = opts.getInt("Seed",1);
+    const int batchsize = opts.getInt("BatchSize",1000);
+    int nthread = getNumThreads(opts);
+    if(batchsize < 1) Error("MPSSampler: BatchSize must be at least 1");
+
+    confs.assign(nsample,Config());
+    const int nbatch = (nsample+batchsize-1)/batchsize;
+
+#ifndef ITENSOR_USE_THREADS
+    nthread = 1;
+#endif
+    if(nthread > nbatch) nthread = nbatch;
+    if(nthread > 1 && !ThreadPool::instance().parallelAllowed()) nthread = 1;
+
+    if(nthread <= 1)
+        {
+        std::string errmess;
+        runBatches(0,1,nbatch,nsample,batchsize,seed,confs,errmess);
+        if(!errmess.empty()) throw ITError(errmess);
+        return;
+        }
+
+    std::vector<std::string> errmess(nthread);
+        {
+        ParallelRegion region;
+        TaskGroup tasks("MPSSampler");
+        for(int t = 1; t < nthread; ++t)
+            {
+            tasks.run(SampleBatchWorker<Tensor>(*this,t,nthread,nbatch,nsample,batchsize,seed,confs,errmess[t]));
+            }
+        runBatches(0,nthread,nbatch,nsample,batchsize,seed,confs,errmess[0]);
+        tasks.wait();
+        }
+
+    for(int t = 0; t < nthread; ++t)
+        {
+        if(!errmess[t].empty()) throw ITError(errmess[t]);
+        }
+    }
+
+template <class Tensor>
+InitState MPSSampler<Tensor>::
+initState(const Config& conf) const
+    {
+    const Model& model = psi_.model();
+    InitState init(model);
+    for(int j = 1; j <= N(); ++j)
+        {
+        init.set(j,model.si(j)(conf.at(j)));
+        }
+    return init;
+    }
+
+#endif
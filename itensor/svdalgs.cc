@@ -3,6 +3,8 @@
 //    (See accompanying LICENSE file.)
 //
 #include "svdalgs.h"
+#include "parallel.h"
+#include "tensortrace.h"
 
 using std::swap;
 using std::istream;
@@ -118,6 +120,16 @@ svdRank2(ITensor A, const Index& ui, const Index& vi,
          ITensor& U, ITSparse& D, ITensor& V, Spectrum& spec,
          const OptSet& opts)
     {
+    svdRank2(A,ui,vi,U,D,V,spec,DecompOpts(opts));
+    }
+
+void 
+svdRank2(ITensor A, const Index& ui, const Index& vi,
+         ITensor& U, ITSparse& D, ITensor& V, Spectrum& spec,
+         const DecompOpts& dopts)
+    {
+    TraceOp trace(A,ui,vi,spec);
+
     const bool cplx = A.isComplex();
 
     if(A.r() != 2)
@@ -166,7 +178,7 @@ svdRank2(ITensor A, const Index& ui, const Index& vi,
     spec.truncerr(terr);
 
 
-    if(opts.getBool("ShowEigs",false))
+    if(dopts.showEigs())
         {
         cout << endl;
         cout << format("minm = %d, maxm = %d, cutoff = %.3E")
@@ -243,11 +255,105 @@ svdRank2(ITensor A, const Index& ui, const Index& vi,
 
     } // void svdRank2
 
+//
+// SVD of block n of an IQTensor for svdRank2,
+// safe to call concurrently for different n
+//
+class BlockSVD
+    {
+    public:
+
+    BlockSVD(const vector<const ITensor*>& blocks, const IQIndex& uI,
+             const LogNumber& refNorm, bool cplx,
+             vector<Matrix>& Umatrix, vector<Matrix>& Vmatrix,
+             vector<Matrix>& iUmatrix, vector<Matrix>& iVmatrix,
+             vector<Vector>& dvector)
+        : blocks_(blocks), uI_(uI), refNorm_(refNorm), cplx_(cplx),
+          Umatrix_(Umatrix), Vmatrix_(Vmatrix),
+          iUmatrix_(iUmatrix), iVmatrix_(iVmatrix),
+          dvector_(dvector)
+        { }
+
+    void
+    operator()(int n) const
+        {
+        const ITensor& t = *blocks_.at(n);
+        Matrix &UU = Umatrix_.at(n);
+        Matrix &VV = Vmatrix_.at(n);
+        Vector &d =  dvector_.at(n);
+
+        const Index *ui=0,*vi=0;
+        bool gotui = false;
+        Foreach(const Index& I, t.indices())
+            {
+            if(!gotui) 
+                {
+                ui = &I;
+                gotui = true;
+                }
+            else       
+                {
+                vi = &I;
+                break;
+                }
+            }
+
+        if(!hasindex(uI_,*ui))
+            swap(ui,vi);
+
+        if(!cplx_)
+            {
+            Matrix M(ui->m(),vi->m());
+            t.toMatrix11NoScale(*ui,*vi,M);
+
+            SVD(M,UU,d,VV);
+            }
+        else
+            {
+            ITensor ret = realPart(t),
+                    imt = imagPart(t);
+            ret.scaleTo(refNorm_);
+            imt.scaleTo(refNorm_);
+            Matrix Mre(ui->m(),vi->m()),
+                   Mim(ui->m(),vi->m());
+            ret.toMatrix11NoScale(*ui,*vi,Mre);
+            imt.toMatrix11NoScale(*ui,*vi,Mim);
+
+            SVD(Mre,Mim,
+                UU,iUmatrix_.at(n),
+                d,
+                VV,iVmatrix_.at(n));
+            }
+        }
+
+    private:
+
+    const vector<const ITensor*>& blocks_;
+    const IQIndex& uI_;
+    LogNumber refNorm_;
+    bool cplx_;
+    vector<Matrix>& Umatrix_;
+    vector<Matrix>& Vmatrix_;
+    vector<Matrix>& iUmatrix_;
+    vector<Matrix>& iVmatrix_;
+    vector<Vector>& dvector_;
+    };
+
 void
 svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
          IQTensor& U, IQTSparse& D, IQTensor& V, Spectrum& spec,
          const OptSet& opts)
     {
+    svdRank2(A,uI,vI,U,D,V,spec,DecompOpts(opts));
+    }
+
+void
+svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
+         IQTensor& U, IQTSparse& D, IQTensor& V, Spectrum& spec,
+         const DecompOpts& dopts)
+    {
+    TraceOp trace(A,uI,vI,spec);
+
     const bool cplx = A.isComplex();
 
     if(A.r() != 2)
@@ -294,66 +400,23 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
 
     //1. SVD each ITensor within A.
     //   Store results in mmatrix and mvector.
-    int itenind = 0;
+    vector<const ITensor*> blocks;
+    blocks.reserve(Nblock);
     Foreach(const ITensor& t, A.blocks())
         {
-        Matrix &UU = Umatrix.at(itenind);
-        Matrix &VV = Vmatrix.at(itenind);
-        Vector &d =  dvector.at(itenind);
-
-        const Index *ui=0,*vi=0;
-        bool gotui = false;
-        Foreach(const Index& I, t.indices())
-            {
-            if(!gotui) 
-                {
-                ui = &I;
-                gotui = true;
-                }
-            else       
-                {
-                vi = &I;
-                break;
-                }
-            }
-
-        if(!hasindex(uI,*ui))
-            swap(ui,vi);
-
-        if(!cplx)
-            {
-            Matrix M(ui->m(),vi->m());
-            t.toMatrix11NoScale(*ui,*vi,M);
-
-            SVD(M,UU,d,VV);
-            }
-        else
-            {
-            ITensor ret = realPart(t),
-                    imt = imagPart(t);
-            ret.scaleTo(spec.refNorm());
-            imt.scaleTo(spec.refNorm());
-            Matrix Mre(ui->m(),vi->m()),
-                   Mim(ui->m(),vi->m());
-            ret.toMatrix11NoScale(*ui,*vi,Mre);
-            imt.toMatrix11NoScale(*ui,*vi,Mim);
+        blocks.push_back(&t);
+        }
 
-            //SVDComplex(Mre,Mim,
-            //           UU,iUmatrix.at(itenind),
-            //           d,
-            //           VV,iVmatrix.at(itenind));
-            SVD(Mre,Mim,
-                UU,iUmatrix.at(itenind),
-                d,
-                VV,iVmatrix.at(itenind));
-            }
+    parallelFor(BlockSVD(blocks,uI,spec.refNorm(),cplx,Umatrix,Vmatrix,
+                         iUmatrix,iVmatrix,dvector),
+                Nblock,dopts.nthread(),"svdRank2");
 
-        //Store the squared singular values
-        //(denmat eigenvalues) in alleig
+    //Store the squared singular values
+    //(denmat eigenvalues) in alleig
+    Foreach(const Vector& d, dvector)
+        {
         for(int j = 1; j <= d.Length(); ++j) 
             alleig.push_back(sqr(d(j)));
-
-        ++itenind;
         }
 
     //2. Truncate eigenvalues
@@ -372,7 +435,7 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
         svdtruncerr = truncate(alleig,m,docut,spec);
         }
 
-    if(opts.getBool("ShowEigs",false))
+    if(dopts.showEigs())
         {
         cout << endl;
         cout << "svdRank2 (IQTensor):" << endl;
@@ -443,7 +506,7 @@ svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
     vector<ITSparse> Dblock;
     Dblock.reserve(Nblock);
 
-    itenind = 0;
+    int itenind = 0;
     int total_m = 0;
     Foreach(const ITensor& t, A.blocks())
         {
@@ -580,6 +643,15 @@ Real
 diag_hermitian(ITensor rho, ITensor& U, ITSparse& D, Spectrum& spec,
                const OptSet& opts)
     {
+    return diag_hermitian(rho,U,D,spec,DecompOpts(opts));
+    }
+
+Real
+diag_hermitian(ITensor rho, ITensor& U, ITSparse& D, Spectrum& spec,
+               const DecompOpts& dopts)
+    {
+    TraceOp trace(rho,spec);
+
     bool cplx = rho.isComplex();
 
 #ifdef DEBUG
@@ -647,7 +719,7 @@ diag_hermitian(ITensor rho, ITensor& U, ITSparse& D, Spectrum& spec,
 
     //Truncate
     Real svdtruncerr = 0.0;
-    if(opts.getBool("ShowEigs",false))
+    if(dopts.showEigs())
         cout << "Before truncating, m = " << DD.Length() << endl;
     if(spec.truncate())
         {
@@ -671,7 +743,7 @@ diag_hermitian(ITensor rho, ITensor& U, ITSparse& D, Spectrum& spec,
         }
 #endif
 
-    if(opts.getBool("ShowEigs",false))
+    if(dopts.showEigs())
         {
         cout << endl;
         cout << format("minm = %d, maxm = %d, cutoff = %.3E")
@@ -712,6 +784,15 @@ Real
 diag_hermitian(IQTensor rho, IQTensor& U, IQTSparse& D, Spectrum& spec,
                const OptSet& opts)
     {
+    return diag_hermitian(rho,U,D,spec,DecompOpts(opts));
+    }
+
+Real
+diag_hermitian(IQTensor rho, IQTensor& U, IQTSparse& D, Spectrum& spec,
+               const DecompOpts& dopts)
+    {
+    TraceOp trace(rho,spec);
+
     bool cplx = rho.isComplex();
 
     if(rho.r() != 2)
@@ -858,7 +939,7 @@ diag_hermitian(IQTensor rho, IQTensor& U, IQTSparse& D, Spectrum& spec,
         }
     spec.truncerr(svdtruncerr);
 
-    if(opts.getBool("ShowEigs",false))
+    if(dopts.showEigs())
         {
         cout << endl;
         cout << format("useOrigM = %s")
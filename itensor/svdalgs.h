@@ -13,6 +13,94 @@
 #define Endl std::endl
 #define Format boost::format
 
+//
+// Options of the decompositions below (and of the MPS
+// svdBond and svdSite methods), looked up in an OptSet once.
+// Code decomposing a tensor at every step of a sweep
+// resolves its OptSet into a DecompOpts up front and
+// passes that down, instead of the OptSet which would
+// be searched by name on every call.
+//
+// Options recognized:
+//   ShowEigs - print the kept singular values or eigenvalues (default false)
+//   TraceReIm - (denmatDecomp) use only the real part of the
+//               density matrix (default false)
+//   NumThreads - threads decomposing the blocks of an IQTensor (default 1)
+//   UseSVD - (svdBond, svdSite) use svd even if denmatDecomp
+//            would be accurate enough (default false)
+//   UseOrigM - (svdBond, svdSite) keep the current bond dimension (default false)
+//   DoNormalize - (svdBond, svdSite) normalize the new
+//                 orthogonality center (default false)
+//
+class DecompOpts
+    {
+    public:
+
+    DecompOpts();
+
+    explicit
+    DecompOpts(const OptSet& opts);
+
+    bool
+    showEigs() const { return show_eigs_; }
+
+    bool
+    traceReIm() const { return trace_reim_; }
+
+    int
+    nthread() const { return nthread_; }
+
+    bool
+    useSVD() const { return use_svd_; }
+
+    bool
+    useOrigM() const { return use_orig_m_; }
+
+    bool
+    doNormalize() const { return do_normalize_; }
+
+    private:
+
+    bool show_eigs_,
+         trace_reim_;
+    int nthread_;
+    bool use_svd_,
+         use_orig_m_,
+         do_normalize_;
+
+    };
+
+inline DecompOpts::
+DecompOpts()
+    :
+    show_eigs_(false),
+    trace_reim_(false),
+    nthread_(1),
+    use_svd_(false),
+    use_orig_m_(false),
+    do_normalize_(false)
+    { }
+
+inline DecompOpts::
+DecompOpts(const OptSet& opts)
+    :
+    show_eigs_(opts.getBool("ShowEigs",false)),
+    trace_reim_(opts.getBool("TraceReIm",false)),
+    nthread_(getNumThreads(opts)),
+    use_svd_(opts.getBool("UseSVD",false)),
+    use_orig_m_(opts.getBool("UseOrigM",false)),
+    do_normalize_(opts.getBool("DoNormalize",false))
+    { }
+
+//OptSet asking isZero for the fast checks only,
+//made once instead of on every call
+inline const OptSet&
+fastCheck()
+    {
+    static const OptSet fast_(Opt("Fast"));
+    return fast_;
+    }
+
 
 //
 // Singular value decomposition (SVD)
@@ -38,6 +126,12 @@ svd(Tensor AA, Tensor& U, SparseT& D, Tensor& V,
     Spectrum& spec,
     const OptSet& opts = Global::opts());
 
+template<class Tensor, class SparseT>
+void 
+svd(Tensor AA, Tensor& U, SparseT& D, Tensor& V, 
+    Spectrum& spec,
+    const DecompOpts& dopts);
+
 //
 // Density Matrix Decomposition
 // 
@@ -86,6 +180,12 @@ denmatDecomp(const Tensor& AA, Tensor& A, Tensor& B, Direction dir,
              Spectrum& spec, const LocalOpT& PH,
              const OptSet& opts = Global::opts());
 
+template<class Tensor, class LocalOpT>
+void 
+denmatDecomp(const Tensor& AA, Tensor& A, Tensor& B, Direction dir, 
+             Spectrum& spec, const LocalOpT& PH,
+             const DecompOpts& dopts);
+
 
 
 //
@@ -181,23 +281,44 @@ svdRank2(ITensor A, const Index& ui, const Index& vi,
          ITensor& U, ITSparse& D, ITensor& V, Spectrum& spec,
          const OptSet& opts = Global::opts());
 
+void 
+svdRank2(ITensor A, const Index& ui, const Index& vi,
+         ITensor& U, ITSparse& D, ITensor& V, Spectrum& spec,
+         const DecompOpts& dopts);
+
+//The blocks of A are decomposed using up to
+//opts "NumThreads" threads (default 1, see parallel.h)
 void 
 svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
          IQTensor& U, IQTSparse& D, IQTensor& V, Spectrum& spec,
          const OptSet& opts = Global::opts());
 
+void 
+svdRank2(IQTensor A, const IQIndex& uI, const IQIndex& vI,
+         IQTensor& U, IQTSparse& D, IQTensor& V, Spectrum& spec,
+         const DecompOpts& dopts);
+
 template<class Tensor, class SparseT>
 void 
 svd(Tensor AA, Tensor& U, SparseT& D, Tensor& V, 
     Spectrum& spec, 
     const OptSet& opts)
     {
+    svd(AA,U,D,V,spec,DecompOpts(opts));
+    }
+
+template<class Tensor, class SparseT>
+void 
+svd(Tensor AA, Tensor& U, SparseT& D, Tensor& V, 
+    Spectrum& spec, 
+    const DecompOpts& dopts)
+    {
     typedef typename Tensor::IndexT 
     IndexT;
     typedef typename Tensor::CombinerT 
     CombinerT;
     
-    if(isZero(AA,Opt("Fast"))) 
+    if(isZero(AA,fastCheck())) 
         throw ResultIsZero("svd: AA is zero");
 
     if(spec.noise() > 0)
@@ -261,7 +382,7 @@ svd(Tensor AA, Tensor& U, SparseT& D, Tensor& V,
             }
         }
 
-    svdRank2(AA,Ucomb.right(),Vcomb.right(),U,D,V,spec,opts);
+    svdRank2(AA,Ucomb.right(),Vcomb.right(),U,D,V,spec,dopts);
 
     spec.cutoff(saved_cutoff);
     spec.minm(saved_minm);
@@ -302,12 +423,29 @@ Real
 diag_hermitian(IQTensor rho, IQTensor& U, IQTSparse& D, Spectrum& spec,
                const OptSet& opts = Global::opts());
 
+Real 
+diag_hermitian(ITensor rho, ITensor& U, ITSparse& D, Spectrum& spec,
+               const DecompOpts& dopts);
+
+Real 
+diag_hermitian(IQTensor rho, IQTensor& U, IQTSparse& D, Spectrum& spec,
+               const DecompOpts& dopts);
+
 template<class Tensor, class LocalOpT>
 void 
 denmatDecomp(const Tensor& AA, Tensor& A, Tensor& B, Direction dir, 
              Spectrum& spec, const LocalOpT& PH,
              const OptSet& opts)
     {
+    denmatDecomp(AA,A,B,dir,spec,PH,DecompOpts(opts));
+    }
+
+template<class Tensor, class LocalOpT>
+void 
+denmatDecomp(const Tensor& AA, Tensor& A, Tensor& B, Direction dir, 
+             Spectrum& spec, const LocalOpT& PH,
+             const DecompOpts& dopts)
+    {
     typedef typename Tensor::IndexT 
     IndexT;
     typedef typename Tensor::CombinerT 
@@ -315,7 +453,7 @@ denmatDecomp(const Tensor& AA, Tensor& A, Tensor& B, Direction dir,
     typedef typename Tensor::SparseT 
     SparseT;
 
-    if(isZero(AA,Opt("Fast"))) 
+    if(isZero(AA,fastCheck())) 
         {
         throw ResultIsZero("denmatDecomp: AA is zero");
         }
@@ -380,14 +518,14 @@ denmatDecomp(const Tensor& AA, Tensor& A, Tensor& B, Direction dir,
         spec.maxm(mid.m());
         }
 
-    if(opts.getBool("TraceReIm",false))
+    if(dopts.traceReIm())
         {
         rho = realPart(rho);
         }
 
     Tensor U;
     SparseT D;
-    Real truncerr = diag_hermitian(rho,U,D,spec,opts);
+    Real truncerr = diag_hermitian(rho,U,D,spec,dopts);
     spec.truncerr(truncerr);
 
     spec.cutoff(saved_cutoff);
@@ -412,7 +550,7 @@ diagHermitian(const Tensor& M, Tensor& U, SparseT& D, Spectrum& spec,
     typedef typename Tensor::CombinerT 
     CombinerT;
 
-    if(isZero(M,Opt("Fast"))) 
+    if(isZero(M,fastCheck())) 
         throw ResultIsZero("denmatDecomp: M is zero");
 
     CombinerT comb;
@@ -468,7 +606,7 @@ orthoDecomp(Tensor T, Tensor& A, Tensor& B, Direction dir,
     typedef typename Tensor::SparseT
     SparseT;
 
-    if(isZero(T,Opt("Fast"))) 
+    if(isZero(T,fastCheck())) 
         throw ResultIsZero("orthoDecomp: T is zero");
 
     const Real orig_noise = spec.noise();
@@ -0,0 +1,233 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_SWEEPSTATS_H
+#define __ITENSOR_SWEEPSTATS_H
+
+#include "global.h"
+#include "storelink.h"
+#include <fstream>
+
+//
+// Bytes of storage allocated by StoreLink so far
+//
+Real inline
+allocBytes() { return sizeof(Real)*Real(StoreLink::TotalAllocated()); }
+
+//
+// Timing and resource use of a single
+// DMRG step (one bond of one half-sweep).
+//
+// Times are in seconds; "cpu" times are the
+// process' user CPU time (summed over threads).
+//
+
+class BondStats
+    {
+    public:
+
+    BondStats() { reset(); }
+
+    void
+    reset()
+        {
+        sweep = 0;
+        halfsweep = 0;
+        bond = 0;
+        m = 0;
+        truncerr = 0;
+        energy = 0;
+        niter = 0;
+        env_wall = 0;
+        env_cpu = 0;
+        eig_wall = 0;
+        eig_cpu = 0;
+        decomp_wall = 0;
+        decomp_cpu = 0;
+        io_wait = 0;
+        env_alloc = 0;
+        eig_alloc = 0;
+        decomp_alloc = 0;
+        nalloc = 0;
+        flops = 0;
+        peak_mem = 0;
+        }
+
+    int sweep,
+        halfsweep,
+        bond;
+    //Number of states kept on the bond
+    int m;
+    Real truncerr,
+         energy;
+    //Davidson iterations
+    int niter;
+    //Updating the projected operator (environments)
+    Real env_wall,
+         env_cpu;
+    //Eigensolver
+    Real eig_wall,
+         eig_cpu;
+    //SVD or density matrix decomposition
+    Real decomp_wall,
+         decomp_cpu;
+    //Time blocked on disk I/O, when writing to disk
+    Real io_wait;
+    //Storage of tensors, matrices and vectors (see StoreLink)
+    //allocated by each part of the step (bytes).
+    //The time allocating is not measured separately:
+    //timing every allocation would cost about as much
+    //as the allocation itself.
+    Real env_alloc,
+         eig_alloc,
+         decomp_alloc;
+    //Number of storage allocations during the step
+    long nalloc;
+    //Estimated floating point operations of the eigensolver
+    Real flops;
+    //Peak resident memory of the process so far (bytes)
+    Real peak_mem;
+
+    Real
+    wallTime() const { return env_wall+eig_wall+decomp_wall; }
+
+    };
+
+//
+// Collects the BondStats of a DMRG calculation
+// and writes them out as CSV or JSON.
+//
+
+class SweepStats
+    {
+    public:
+
+    SweepStats() { }
+
+    void
+    add(const BondStats& st) { stats_.push_back(st); }
+
+    const std::vector<BondStats>&
+    bonds() const { return stats_; }
+
+    void
+    clear() { stats_.clear(); }
+
+    //Sum of the times, flops and iterations
+    //over all bonds of sweep sw
+    //(the last bond's values are kept for the other fields)
+    BondStats
+    sweepTotal(int sw) const;
+
+    static void
+    writeCSVHeader(std::ostream& s);
+
+    //Write the bonds of sweep sw (all sweeps if sw == 0)
+    void
+    writeCSV(std::ostream& s, int sw = 0) const;
+
+    //Write all bonds as a JSON array of objects
+    void
+    writeJSON(std::ostream& s) const;
+
+    private:
+
+    std::vector<BondStats> stats_;
+
+    };
+
+inline std::ostream&
+operator<<(std::ostream& s, const BondStats& st)
+    {
+    s << boost::format("eigensolver %.3fs (%d iter, %.2f GFlop/s), decomp %.3fs, environments %.3fs, I/O wait %.3fs, allocated %.1f MB (%d allocations), peak mem %.1f MB")
+         % st.eig_wall
+         % st.niter
+         % (st.eig_wall > 0 ? st.flops/st.eig_wall/1E9 : 0.)
+         % st.decomp_wall
+         % st.env_wall
+         % st.io_wait
+         % ((st.env_alloc+st.eig_alloc+st.decomp_alloc)/1E6)
+         % st.nalloc
+         % (st.peak_mem/1E6);
+    return s;
+    }
+
+inline BondStats SweepStats::
+sweepTotal(int sw) const
+    {
+    BondStats tot;
+    Foreach(const BondStats& st, stats_)
+        {
+        if(st.sweep != sw) continue;
+        const BondStats t = tot;
+        tot = st;
+        tot.niter += t.niter;
+        tot.env_wall += t.env_wall;
+        tot.env_cpu += t.env_cpu;
+        tot.eig_wall += t.eig_wall;
+        tot.eig_cpu += t.eig_cpu;
+        tot.decomp_wall += t.decomp_wall;
+        tot.decomp_cpu += t.decomp_cpu;
+        tot.io_wait += t.io_wait;
+        tot.env_alloc += t.env_alloc;
+        tot.eig_alloc += t.eig_alloc;
+        tot.decomp_alloc += t.decomp_alloc;
+        tot.nalloc += t.nalloc;
+        tot.flops += t.flops;
+        tot.m = std::max(tot.m,t.m);
+        tot.truncerr = std::max(tot.truncerr,t.truncerr);
+        }
+    return tot;
+    }
+
+inline void SweepStats::
+writeCSVHeader(std::ostream& s)
+    {
+    s << "sweep,halfsweep,bond,m,truncerr,energy,niter,"
+      << "env_wall,env_cpu,eig_wall,eig_cpu,decomp_wall,decomp_cpu,"
+      << "io_wait,env_alloc,eig_alloc,decomp_alloc,nalloc,flops,peak_mem\n";
+    }
+
+inline void SweepStats::
+writeCSV(std::ostream& s, int sw) const
+    {
+    Foreach(const BondStats& st, stats_)
+        {
+        if(sw != 0 && st.sweep != sw) continue;
+        s << boost::format("%d,%d,%d,%d,%.6E,%.15E,%d,%.6E,%.6E,%.6E,%.6E,%.6E,%.6E,%.6E,%.6E,%.6E,%.6E,%d,%.6E,%.6E\n")
+             % st.sweep % st.halfsweep % st.bond % st.m % st.truncerr % st.energy % st.niter
+             % st.env_wall % st.env_cpu % st.eig_wall % st.eig_cpu
+             % st.decomp_wall % st.decomp_cpu
+             % st.io_wait % st.env_alloc % st.eig_alloc % st.decomp_alloc % st.nalloc
+             % st.flops % st.peak_mem;
+        }
+    }
+
+inline void SweepStats::
+writeJSON(std::ostream& s) const
+    {
+    s << "[";
+    for(size_t n = 0; n < stats_.size(); ++n)
+        {
+        const BondStats& st = stats_[n];
+        s << (n == 0 ? "\n" : ",\n");
+        s << boost::format("{\"sweep\": %d, \"halfsweep\": %d, \"bond\": %d, \"m\": %d, "
+                           "\"truncerr\": %.6E, \"energy\": %.15E, \"niter\": %d, "
+                           "\"env_wall\": %.6E, \"env_cpu\": %.6E, "
+                           "\"eig_wall\": %.6E, \"eig_cpu\": %.6E, "
+                           "\"decomp_wall\": %.6E, \"decomp_cpu\": %.6E, "
+                           "\"io_wait\": %.6E, "
+                           "\"env_alloc\": %.6E, \"eig_alloc\": %.6E, "
+                           "\"decomp_alloc\": %.6E, \"nalloc\": %d, "
+                           "\"flops\": %.6E, \"peak_mem\": %.6E}")
+             % st.sweep % st.halfsweep % st.bond % st.m % st.truncerr % st.energy % st.niter
+             % st.env_wall % st.env_cpu % st.eig_wall % st.eig_cpu
+             % st.decomp_wall % st.decomp_cpu
+             % st.io_wait % st.env_alloc % st.eig_alloc % st.decomp_alloc % st.nalloc
+             % st.flops % st.peak_mem;
+        }
+    s << "\n]\n";
+    }
+
+#endif
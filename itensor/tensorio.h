@@ -0,0 +1,537 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_TENSORIO_H
+#define __ITENSOR_TENSORIO_H
+
+#include "global.h"
+#include "compress.h"
+#include "cputime.h"
+#include <map>
+#include <deque>
+
+#ifdef ITENSOR_USE_THREADS
+#include "boost/thread.hpp"
+#endif
+
+//
+// TensorIO reads and writes tensors to disk
+// on a background I/O thread.
+//
+// write(fname,T) returns immediately; the file is
+// written later, in the order writes were requested.
+// Until then a read of the same file is served from memory.
+//
+// prefetch(fname) asks for fname to be read in the
+// background so that a later read(fname,T) finds
+// it already in memory.
+//
+// At most window() pending writes and window()
+// prefetched tensors are held in memory.
+// A write made when window() writes are pending blocks
+// until an earlier one finishes; prefetch requests
+// made when window() tensors are already prefetched
+// (and not yet read) are ignored.
+//
+// Files are replaced rather than overwritten (see
+// writeToNewFile), so that snapshots of a directory
+// made by snapshotDir are not changed.
+//
+// If fsync is true each file is also flushed to the
+// storage device (fsync) after being written, by the
+// I/O thread when writes are asynchronous. A failed
+// fsync is an error, as is a failed write.
+//
+// Files are compressed with the given codec (see compress.h),
+// on the I/O thread when writes are asynchronous.
+//
+// An error on the I/O thread (ITError or std::exception)
+// is kept with the tensor it occurred for and thrown as 
+// an ITError on the calling thread by the next write, 
+// read or flush.
+//
+// Without ITENSOR_USE_THREADS defined, or if the
+// window is zero, all reads and writes are
+// done synchronously (and prefetch does nothing).
+// The window is zero by default, and MPSt and LocalMPO
+// use the "PrefetchWindow" option (default 0): the
+// background thread has not been found to make DMRG
+// faster, so it is only used when asked for.
+//
+
+class TensorIOStats
+    {
+    public:
+
+    TensorIOStats() { reset(); }
+
+    void
+    reset()
+        {
+        nwrite = 0;
+        nprefetch = 0;
+        nhit = 0;
+        nmiss = 0;
+        wait_time = 0;
+        io_time = 0;
+        codec.reset();
+        }
+
+    //Number of tensors written
+    long nwrite;
+    //Number of prefetch requests accepted
+    long nprefetch;
+    //Number of reads served from memory
+    long nhit;
+    //Number of reads that went to disk synchronously
+    long nmiss;
+    //Wall time (seconds) the calling thread spent
+    //blocked on disk I/O or waiting for the I/O thread
+    Real wait_time;
+    //Wall time (seconds) the I/O thread spent on disk I/O
+    //(including compression)
+    Real io_time;
+    //Data compressed and decompressed, if using a codec
+    CodecStats codec;
+
+    };
+
+inline std::ostream&
+operator<<(std::ostream& s, const TensorIOStats& st)
+    {
+    s << boost::format("writes=%d prefetches=%d hits=%d misses=%d wait=%.3fs io=%.3fs")
+         % st.nwrite % st.nprefetch % st.nhit % st.nmiss % st.wait_time % st.io_time;
+    if(st.codec.raw_bytes > 0) s << " " << st.codec;
+    return s;
+    }
+
+template <class Tensor>
+class TensorIO
+    {
+    public:
+
+    explicit
+    TensorIO(int window = 0, bool fsync = false, Codec codec = NoCodec);
+
+    ~TensorIO();
+
+    int
+    window() const { return window_; }
+
+    bool
+    fsync() const { return fsync_; }
+
+    Codec
+    codec() const { return codec_; }
+
+    void
+    write(const std::string& fname, const Tensor& T);
+
+    void
+    prefetch(const std::string& fname);
+
+    void
+    read(const std::string& fname, Tensor& T);
+
+    //Wait until all pending writes are on disk
+    void
+    flush();
+
+    //Flush and drop any prefetched tensors
+    void
+    clear();
+
+    TensorIOStats
+    stats() const;
+
+    private:
+
+    enum State { Writing, Reading, Ready, Failed };
+
+    struct Entry
+        {
+        Tensor T;
+        State state;
+        long seq;
+        //Message of the error if state == Failed
+        std::string error;
+        };
+
+    struct Job
+        {
+        std::string fname;
+        long seq;
+        };
+
+    typedef typename std::map<std::string,Entry>::iterator
+    entry_it;
+
+    /////////////////
+    //
+    // Data Members
+    //
+
+    int window_;
+    bool fsync_;
+    Codec codec_;
+
+    std::map<std::string,Entry> entries_;
+    std::deque<Job> jobs_;
+    long nextseq_;
+    bool busy_,
+         stop_;
+
+    TensorIOStats stats_;
+
+#ifdef ITENSOR_USE_THREADS
+    mutable boost::mutex mutex_;
+    boost::condition_variable work_,
+                              done_;
+    boost::thread thread_;
+#endif
+
+    //
+    /////////////////
+
+    //Not copyable
+    TensorIO(const TensorIO&);
+    void operator=(const TensorIO&);
+
+    bool
+    async() const;
+
+    int
+    numWrites() const;
+
+    void
+    checkFailed();
+
+    void
+    run();
+
+    };
+
+template <class Tensor>
+TensorIO<Tensor>::
+TensorIO(int window, bool fsync, Codec codec)
+    :
+    window_(window),
+    fsync_(fsync),
+    codec_(codec),
+    nextseq_(0),
+    busy_(false),
+    stop_(false)
+    {
+    if(async())
+        {
+#ifdef ITENSOR_USE_THREADS
+        boost::thread t(&TensorIO::run,this);
+        thread_.swap(t);
+#endif
+        }
+    }
+
+template <class Tensor>
+TensorIO<Tensor>::
+~TensorIO()
+    {
+    if(!async()) return;
+#ifdef ITENSOR_USE_THREADS
+        {
+        boost::mutex::scoped_lock lock(mutex_);
+        stop_ = true;
+        }
+    work_.notify_all();
+    thread_.join();
+#endif
+    }
+
+template <class Tensor>
+bool TensorIO<Tensor>::
+async() const
+    {
+#ifdef ITENSOR_USE_THREADS
+    return window_ > 0;
+#else
+    return false;
+#endif
+    }
+
+template <class Tensor>
+void TensorIO<Tensor>::
+write(const std::string& fname, const Tensor& T)
+    {
+    if(!async())
+        {
+        const Real t0 = mywalltime();
+        writeCompressed(fname,T,codec_,&stats_.codec);
+        if(fsync_ && !syncFile(fname))
+            Error("TensorIO: couldn't sync file \"" + fname + "\"");
+        stats_.wait_time += mywalltime()-t0;
+        ++stats_.nwrite;
+        return;
+        }
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(mutex_);
+    checkFailed();
+    //A newer version of fname supersedes
+    //any pending write or prefetch of it
+    entries_.erase(fname);
+    if(numWrites() >= window_)
+        {
+        const Real t0 = mywalltime();
+        while(numWrites() >= window_)
+            done_.wait(lock);
+        stats_.wait_time += mywalltime()-t0;
+        }
+    Entry& e = entries_[fname];
+    e.T = T;
+    e.state = Writing;
+    e.seq = nextseq_++;
+    Job j;
+    j.fname = fname;
+    j.seq = e.seq;
+    jobs_.push_back(j);
+    ++stats_.nwrite;
+    work_.notify_one();
+#endif
+    }
+
+template <class Tensor>
+void TensorIO<Tensor>::
+prefetch(const std::string& fname)
+    {
+    if(!async()) return;
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(mutex_);
+    if(entries_.count(fname) != 0) return;
+    if(int(entries_.size())-numWrites() >= window_) return;
+    Entry& e = entries_[fname];
+    e.state = Reading;
+    e.seq = nextseq_++;
+    Job j;
+    j.fname = fname;
+    j.seq = e.seq;
+    jobs_.push_back(j);
+    ++stats_.nprefetch;
+    work_.notify_one();
+#endif
+    }
+
+template <class Tensor>
+void TensorIO<Tensor>::
+read(const std::string& fname, Tensor& T)
+    {
+#ifdef ITENSOR_USE_THREADS
+    if(async())
+        {
+        boost::mutex::scoped_lock lock(mutex_);
+        checkFailed();
+        entry_it it = entries_.find(fname);
+        if(it != entries_.end())
+            {
+            if(it->second.state == Reading)
+                {
+                const Real t0 = mywalltime();
+                const long seq = it->second.seq;
+                while(it != entries_.end()
+                      && it->second.seq == seq
+                      && it->second.state == Reading)
+                    {
+                    done_.wait(lock);
+                    it = entries_.find(fname);
+                    }
+                stats_.wait_time += mywalltime()-t0;
+                checkFailed();
+                }
+            if(it != entries_.end())
+                {
+                T = it->second.T;
+                //Prefetched tensors are handed over,
+                //pending writes stay until written
+                if(it->second.state == Ready) entries_.erase(it);
+                ++stats_.nhit;
+                return;
+                }
+            }
+        }
+#endif
+    const Real t0 = mywalltime();
+    CodecStats cs;
+    readCompressed(fname,T,&cs);
+    const Real dt = mywalltime()-t0;
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(mutex_);
+#endif
+    stats_.codec += cs;
+    stats_.wait_time += dt;
+    ++stats_.nmiss;
+    }
+
+template <class Tensor>
+void TensorIO<Tensor>::
+flush()
+    {
+    if(!async()) return;
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(mutex_);
+    const Real t0 = mywalltime();
+    while(!jobs_.empty() || busy_)
+        done_.wait(lock);
+    stats_.wait_time += mywalltime()-t0;
+    checkFailed();
+#endif
+    }
+
+template <class Tensor>
+void TensorIO<Tensor>::
+clear()
+    {
+    flush();
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(mutex_);
+    entries_.clear();
+#endif
+    }
+
+template <class Tensor>
+TensorIOStats TensorIO<Tensor>::
+stats() const
+    {
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(mutex_);
+#endif
+    return stats_;
+    }
+
+//
+// Number of writes not yet completed.
+// Must be called with mutex_ held.
+//
+template <class Tensor>
+int TensorIO<Tensor>::
+numWrites() const
+    {
+    int nw = 0;
+    typedef typename std::map<std::string,Entry>::const_iterator
+    const_it;
+    for(const_it it = entries_.begin(); it != entries_.end(); ++it)
+        {
+        if(it->second.state == Writing) ++nw;
+        }
+    return nw;
+    }
+
+//
+// Throws the error of the first failed read
+// or write, if any, dropping its entry.
+// Must be called with mutex_ held.
+//
+template <class Tensor>
+void TensorIO<Tensor>::
+checkFailed()
+    {
+    for(entry_it it = entries_.begin(); it != entries_.end(); ++it)
+        {
+        if(it->second.state != Failed) continue;
+        const std::string msg = "TensorIO: error on I/O thread for \"" 
+                                + it->first + "\": " + it->second.error;
+        entries_.erase(it);
+        throw ITError(msg);
+        }
+    }
+
+//
+// Body of the I/O thread
+//
+template <class Tensor>
+void TensorIO<Tensor>::
+run()
+    {
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(mutex_);
+    while(true)
+        {
+        while(jobs_.empty() && !stop_)
+            work_.wait(lock);
+        if(jobs_.empty()) return; //stop_ is set and all jobs done
+
+        Job j = jobs_.front();
+        jobs_.pop_front();
+
+        entry_it it = entries_.find(j.fname);
+        if(it == entries_.end() || it->second.seq != j.seq)
+            {
+            //Superseded by a later request
+            done_.notify_all();
+            continue;
+            }
+        const bool is_write = (it->second.state == Writing);
+        Tensor T;
+        if(is_write) T = it->second.T;
+
+        busy_ = true;
+        lock.unlock();
+
+        const Real t0 = mywalltime();
+        bool found = true,
+             failed = false;
+        std::string error;
+        CodecStats cs;
+        //Exceptions must not escape the thread
+        //(that would call std::terminate)
+        try {
+            if(is_write)
+                {
+                writeCompressed(j.fname,T,codec_,&cs);
+                if(fsync_ && !syncFile(j.fname))
+                    throw ITError("couldn't sync file");
+                }
+            else
+                {
+                found = fileExists(j.fname);
+                if(found) readCompressed(j.fname,T,&cs);
+                }
+            }
+        catch(const ITError& e)
+            {
+            failed = true;
+            error = e.what();
+            }
+        catch(const std::exception& e)
+            {
+            failed = true;
+            error = e.what();
+            }
+        const Real dt = mywalltime()-t0;
+
+        lock.lock();
+        busy_ = false;
+        stats_.io_time += dt;
+        stats_.codec += cs;
+        it = entries_.find(j.fname);
+        if(it != entries_.end() && it->second.seq == j.seq)
+            {
+            if(failed)
+                {
+                it->second.T = Tensor();
+                it->second.state = Failed;
+                it->second.error = error;
+                }
+            else if(is_write || !found)
+                {
+                entries_.erase(it);
+                }
+            else
+                {
+                it->second.T = T;
+                it->second.state = Ready;
+                }
+            }
+        done_.notify_all();
+        }
+#endif
+    }
+
+#endif
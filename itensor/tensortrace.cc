@@ -0,0 +1,696 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "tensortrace.h"
+#include "svdalgs.h"
+#include "compress.h"
+#ifdef ITENSOR_USE_THREADS
+#include "boost/thread.hpp"
+#endif
+
+using namespace std;
+using boost::format;
+
+//
+// Trace file layout: the header "ITensorTrace", the
+// format version and whether tensor elements are
+// included, followed by chunks of records. Each chunk
+// is its size (int) and the records compressed with
+// compressBytes (see compress.h). A record is
+//
+//   int type, bool iq, operands, [row and column
+//   indices (SVD)], [Spectrum (SVD, Eigen)], Real wall time
+//
+// An operand is written with ITensor/IQTensor::write if
+// elements are included. Otherwise an ITensor is its
+// indices and whether it is complex, an IQTensor its
+// indices followed by those of each block.
+//
+// Every Index and IQIndex is written in full only once,
+// in a definition record (type IndexDef or IQIndexDef)
+// preceding the first record using it. Records refer to
+// it by the number of its definition, its prime level
+// and (IQIndex) its arrow direction.
+//
+
+static const string trace_header = "ITensorTrace";
+static const int trace_version = 1;
+
+//Types of index definition records
+static const int IndexDef = -1,
+                 IQIndexDef = -2;
+
+bool TensorTrace::active_ = false;
+bool TensorTrace::with_data_ = false;
+
+static ofstream trace_file_;
+static long nrecorded_ = 0;
+
+//Records not yet written, compressed and
+//written once they reach trace_chunk_ bytes
+static string trace_buf_;
+static const size_t trace_chunk_ = 4*1024*1024;
+
+//Numbers of the indices defined so far,
+//by noprimeReal
+static map<Real,int> index_nums_,
+                     iqindex_nums_;
+
+#ifdef ITENSOR_USE_THREADS
+static boost::mutex trace_mutex_;
+static boost::thread_specific_ptr<int> trace_depth_;
+
+//Number of traced operations the calling thread is inside
+static int&
+traceDepth()
+    {
+    if(trace_depth_.get() == 0) trace_depth_.reset(new int(0));
+    return *trace_depth_;
+    }
+#else
+static int&
+traceDepth()
+    {
+    static int depth_ = 0;
+    return depth_;
+    }
+#endif
+
+template <typename T>
+static void
+writeVal(ostream& s, const T& val) { s.write((const char*) &val,sizeof(val)); }
+
+//Records are built in strings, faster
+//than going through an ostringstream
+template <typename T>
+static void
+writeVal(string& s, const T& val) { s.append((const char*) &val,sizeof(val)); }
+
+//Appends an object having a write(ostream&) method
+template <typename T>
+static void
+writeObj(string& s, const T& obj)
+    {
+    ostringstream os;
+    obj.write(os);
+    s += os.str();
+    }
+
+template <typename T>
+static void
+readVal(istream& s, T& val) { s.read((char*) &val,sizeof(val)); }
+
+//Same for all prime levels of an Index, computed without
+//copying it (most indices are looked up many times)
+static Real
+noprimeReal(const Index& I)
+    {
+    return I.uniqueReal()/(1.+I.primeLevel()/10.);
+    }
+
+//
+// Number of the definition of I, first adding the
+// definition to the trace if I has not been seen yet
+// (so it precedes any record using I)
+//
+template <class IndexT>
+static int
+indexNum(map<Real,int>& nums, int deftype, const IndexT& I)
+    {
+    const Real key = noprimeReal(I);
+    map<Real,int>::const_iterator it = nums.find(key);
+    if(it != nums.end()) return it->second;
+    const int n = nums.size();
+    nums[key] = n;
+    writeVal(trace_buf_,deftype);
+    writeObj(trace_buf_,deprimed(I));
+    return n;
+    }
+
+static void
+writeIndex(string& s, const Index& I)
+    {
+    writeVal(s,indexNum(index_nums_,IndexDef,I));
+    writeVal(s,I.primeLevel());
+    }
+
+static void
+writeIndex(string& s, const IQIndex& I)
+    {
+    writeVal(s,indexNum(iqindex_nums_,IQIndexDef,I));
+    writeVal(s,I.primeLevel());
+    writeVal(s,I.dir());
+    }
+
+template <class IndexT>
+static void
+writeIndices(string& s, const IndexSet<IndexT>& is)
+    {
+    writeVal(s,is.r());
+    Foreach(const IndexT& I, is) writeIndex(s,I);
+    }
+
+static void
+writeOperand(string& s, const ITensor& T)
+    {
+    if(TensorTrace::withData())
+        {
+        writeObj(s,T);
+        return;
+        }
+    writeVal(s,T.isNull());
+    if(T.isNull()) return;
+    writeIndices(s,T.indices());
+    writeVal(s,T.isComplex());
+    }
+
+static void
+writeOperand(string& s, const IQTensor& T)
+    {
+    if(TensorTrace::withData())
+        {
+        writeObj(s,T);
+        return;
+        }
+    writeVal(s,T.isNull());
+    if(T.isNull()) return;
+    writeIndices(s,T.indices());
+    writeVal(s,T.iten_size());
+    Foreach(const ITensor& t, T.blocks())
+        {
+        writeIndices(s,t.indices());
+        writeVal(s,t.isComplex());
+        }
+    }
+
+//Tensor with indices is and random elements
+static ITensor
+randomTensor(const IndexSet<Index>& is, bool cplx)
+    {
+    ITensor T(is);
+    T.randomize();
+    if(cplx)
+        {
+        ITensor TI(is);
+        TI.randomize();
+        T = T*Complex_1 + TI*Complex_i;
+        }
+    return T;
+    }
+
+static Index
+readIndex(istream& s, const vector<Index>& defs)
+    {
+    int n = 0,
+        plev = 0;
+    readVal(s,n);
+    readVal(s,plev);
+    Index I = defs.at(n);
+    I.primeLevel(plev);
+    return I;
+    }
+
+static IQIndex
+readIndex(istream& s, const vector<IQIndex>& defs)
+    {
+    int n = 0,
+        plev = 0;
+    Arrow dir = Out;
+    readVal(s,n);
+    readVal(s,plev);
+    readVal(s,dir);
+    IQIndex I = defs.at(n);
+    I.primeLevel(plev);
+    if(I.dir() != dir) I.conj();
+    return I;
+    }
+
+template <class IndexT>
+static IndexSet<IndexT>
+readIndices(istream& s, const vector<IndexT>& defs)
+    {
+    int r = 0;
+    readVal(s,r);
+    if(r == 0) return IndexSet<IndexT>();
+    vector<IndexT> inds(r);
+    Foreach(IndexT& I, inds) I = readIndex(s,defs);
+    return IndexSet<IndexT>(inds);
+    }
+
+static void
+readOperand(istream& s, bool with_data, const vector<Index>& defs, ITensor& T)
+    {
+    if(with_data)
+        {
+        T.read(s);
+        return;
+        }
+    bool null = false;
+    readVal(s,null);
+    if(null)
+        {
+        T = ITensor();
+        return;
+        }
+    const IndexSet<Index> is = readIndices(s,defs);
+    bool cplx = false;
+    readVal(s,cplx);
+    T = randomTensor(is,cplx);
+    }
+
+static void
+readOperand(istream& s, bool with_data,
+            const vector<Index>& defs, const vector<IQIndex>& iqdefs,
+            IQTensor& T)
+    {
+    if(with_data)
+        {
+        T.read(s);
+        return;
+        }
+    bool null = false;
+    readVal(s,null);
+    if(null)
+        {
+        T = IQTensor();
+        return;
+        }
+    const IndexSet<IQIndex> is = readIndices(s,iqdefs);
+    vector<IQIndex> iqinds(is.begin(),is.end());
+    T = IQTensor(iqinds);
+
+    int nblock = 0;
+    readVal(s,nblock);
+    for(int n = 0; n < nblock; ++n)
+        {
+        const IndexSet<Index> bis = readIndices(s,defs);
+        bool cplx = false;
+        readVal(s,cplx);
+        T += randomTensor(bis,cplx);
+        }
+    }
+
+//Replaces the random density matrix rho, with indices
+//i and i', by rho*rho^dagger so diag_hermitian gets a
+//Hermitian, non-negative matrix like the recorded one
+template <class Tensor>
+static void
+makeDensityMatrix(Tensor& rho)
+    {
+    Tensor rhod = conj(rho);
+    rhod.mapprime(0,2);
+    rho *= rhod;
+    rho.mapprime(2,1);
+    }
+
+//Compresses and writes the buffered records
+static void
+writeChunk()
+    {
+    if(trace_buf_.empty()) return;
+    string data;
+    compressBytes(ShuffleLZ,trace_buf_,data);
+    const int size = data.size();
+    writeVal(trace_file_,size);
+    trace_file_.write(data.data(),size);
+    trace_buf_.clear();
+    }
+
+void TensorTrace::
+start(const string& fname, const OptSet& opts)
+    {
+    stop();
+
+    trace_file_.open(fname.c_str(),ios::out|ios::binary);
+    if(!trace_file_.good())
+        {
+        Error("TensorTrace: could not open trace file " + fname);
+        }
+    with_data_ = opts.getBool("TraceData",false);
+
+    trace_file_.write(trace_header.c_str(),trace_header.size());
+    writeVal(trace_file_,trace_version);
+    writeVal(trace_file_,with_data_);
+
+    trace_buf_.clear();
+    index_nums_.clear();
+    iqindex_nums_.clear();
+    nrecorded_ = 0;
+    active_ = true;
+    }
+
+void TensorTrace::
+stop()
+    {
+    if(!active_) return;
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(trace_mutex_);
+#endif
+    active_ = false;
+    writeChunk();
+    trace_file_.close();
+    }
+
+long TensorTrace::
+numRecorded()
+    {
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(trace_mutex_);
+#endif
+    return nrecorded_;
+    }
+
+const char* TensorTrace::
+opName(OpType type)
+    {
+    switch(type)
+        {
+        case Contract: return "contract";
+        case Add: return "add";
+        case SVD: return "svd";
+        case Eigen: return "eigen";
+        }
+    return "unknown";
+    }
+
+//
+// Starts a trace if environment variable
+// ITENSOR_TRACE is set, ends it at exit
+//
+class TraceFromEnv
+    {
+    public:
+
+    TraceFromEnv()
+        {
+        const char* fname = getenv("ITENSOR_TRACE");
+        if(fname == 0 || fname[0] == '\0') return;
+        const char* data = getenv("ITENSOR_TRACE_DATA");
+        TensorTrace::start(fname,Opt("TraceData",data != 0 && atoi(data) > 0));
+        }
+
+    ~TraceFromEnv() { TensorTrace::stop(); }
+    };
+
+static TraceFromEnv trace_from_env_;
+
+void TraceOp::
+begin(TensorTrace::OpType type,
+      const ITensor* A, const ITensor* B,
+      const IQTensor* QA, const IQTensor* QB,
+      const Index* ui, const Index* vi,
+      const IQIndex* uI, const IQIndex* vI,
+      const Spectrum* spec)
+    {
+    int& depth = traceDepth();
+    entered_ = true;
+    record_ = (depth == 0);
+    ++depth;
+    if(!record_) return;
+
+    //The index numbers are shared by all threads
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(trace_mutex_);
+#endif
+    if(!TensorTrace::active())
+        {
+        record_ = false;
+        return;
+        }
+
+    string& s = rec_;
+    s.clear();
+    writeVal(s,int(type));
+    const bool iq = (QA != 0);
+    writeVal(s,iq);
+    if(iq)
+        {
+        writeOperand(s,*QA);
+        if(QB != 0) writeOperand(s,*QB);
+        }
+    else
+        {
+        writeOperand(s,*A);
+        if(B != 0) writeOperand(s,*B);
+        }
+    if(ui != 0)
+        {
+        writeIndex(s,*ui);
+        writeIndex(s,*vi);
+        }
+    if(uI != 0)
+        {
+        writeIndex(s,*uI);
+        writeIndex(s,*vI);
+        }
+    if(spec != 0)
+        {
+        //Only the truncation settings are needed
+        Spectrum settings(*spec);
+        settings.eigsKept(Vector());
+        writeObj(s,settings);
+        }
+
+    t0_ = mywalltime();
+    }
+
+void TraceOp::
+end()
+    {
+    const Real wall = mywalltime()-t0_;
+    --traceDepth();
+    if(!record_) return;
+
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(trace_mutex_);
+#endif
+    //Trace may have been stopped meanwhile
+    if(!TensorTrace::active()) return;
+    trace_buf_ += rec_;
+    trace_buf_.append((const char*) &wall,sizeof(wall));
+    ++nrecorded_;
+    if(trace_buf_.size() >= trace_chunk_) writeChunk();
+    }
+
+TraceReader::
+TraceReader(const string& fname)
+    :
+    file_(fname.c_str(),ios::in|ios::binary),
+    with_data_(false)
+    {
+    if(!file_.good())
+        {
+        Error("TraceReader: could not open trace file " + fname);
+        }
+    string header(trace_header.size(),' ');
+    file_.read(&header[0],header.size());
+    int version = 0;
+    readVal(file_,version);
+    if(!file_ || header != trace_header || version != trace_version)
+        {
+        Error("TraceReader: " + fname + " is not a trace file of this version");
+        }
+    readVal(file_,with_data_);
+    }
+
+bool TraceReader::
+nextChunk()
+    {
+    int size = 0;
+    readVal(file_,size);
+    if(!file_ || size <= 0) return false;
+    string data(size,' ');
+    file_.read(&data[0],size);
+    if(!file_) return false;
+    string raw;
+    decompressBytes(data,raw);
+    s_.clear();
+    s_.str(raw);
+    return true;
+    }
+
+bool TraceReader::
+next(TraceRecord& rec)
+    {
+    int type = 0;
+    while(true)
+        {
+        readVal(s_,type);
+        if(!s_)
+            {
+            if(!nextChunk()) return false;
+            continue;
+            }
+        if(type == IndexDef)
+            {
+            index_.push_back(Index());
+            index_.back().read(s_);
+            }
+        else if(type == IQIndexDef)
+            {
+            iqindex_.push_back(IQIndex());
+            iqindex_.back().read(s_);
+            }
+        else break;
+        }
+
+    rec = TraceRecord();
+    rec.type = TensorTrace::OpType(type);
+    readVal(s_,rec.iq);
+
+    const bool binary = (rec.type == TensorTrace::Contract
+                         || rec.type == TensorTrace::Add);
+    if(rec.iq)
+        {
+        readOperand(s_,with_data_,index_,iqindex_,rec.QA);
+        if(binary) readOperand(s_,with_data_,index_,iqindex_,rec.QB);
+        if(rec.type == TensorTrace::SVD)
+            {
+            rec.uI = readIndex(s_,iqindex_);
+            rec.vI = readIndex(s_,iqindex_);
+            }
+        }
+    else
+        {
+        readOperand(s_,with_data_,index_,rec.A);
+        if(binary) readOperand(s_,with_data_,index_,rec.B);
+        if(rec.type == TensorTrace::SVD)
+            {
+            rec.ui = readIndex(s_,index_);
+            rec.vi = readIndex(s_,index_);
+            }
+        }
+    if(!binary) rec.spec.read(s_);
+    readVal(s_,rec.wall);
+
+    if(rec.type == TensorTrace::Eigen && !with_data_)
+        {
+        if(rec.iq) makeDensityMatrix(rec.QA);
+        else       makeDensityMatrix(rec.A);
+        }
+
+    return !s_.fail();
+    }
+
+Real TraceRecord::
+replay(const OptSet& opts) const
+    {
+    Real t0 = 0;
+    if(iq)
+        {
+        IQTensor R(QA),U,V;
+        IQTSparse D;
+        Spectrum sp(spec);
+        t0 = mywalltime();
+        switch(type)
+            {
+            case TensorTrace::Contract: R *= QB; break;
+            case TensorTrace::Add: R += QB; break;
+            case TensorTrace::SVD: svdRank2(R,uI,vI,U,D,V,sp,opts); break;
+            case TensorTrace::Eigen: diag_hermitian(R,U,D,sp,opts); break;
+            }
+        }
+    else
+        {
+        ITensor R(A),U,V;
+        ITSparse D;
+        Spectrum sp(spec);
+        t0 = mywalltime();
+        switch(type)
+            {
+            case TensorTrace::Contract: R *= B; break;
+            case TensorTrace::Add: R += B; break;
+            case TensorTrace::SVD: svdRank2(R,ui,vi,U,D,V,sp,opts); break;
+            case TensorTrace::Eigen: diag_hermitian(R,U,D,sp,opts); break;
+            }
+        }
+    return mywalltime()-t0;
+    }
+
+//Dimensions of the indices of T, e.g. "(20,2,20)"
+template <class IndexT>
+static string
+dims(const IndexSet<IndexT>& is)
+    {
+    ostringstream s;
+    s << "(";
+    for(int j = 1; j <= is.r(); ++j)
+        s << (j > 1 ? "," : "") << is.index(j).m();
+    s << ")";
+    return s.str();
+    }
+
+//Positions of the indices of A in B (0 if not in B)
+template <class IndexT>
+static vector<int>
+positions(const IndexSet<IndexT>& A, const IndexSet<IndexT>& B)
+    {
+    vector<int> pos(A.r(),0);
+    for(int i = 1; i <= A.r(); ++i)
+    for(int j = 1; j <= B.r(); ++j)
+        {
+        if(A.index(i) == B.index(j)) pos.at(i-1) = j;
+        }
+    return pos;
+    }
+
+template <class IndexT>
+static string
+describeOperands(TensorTrace::OpType type,
+                 const IndexSet<IndexT>& A, const IndexSet<IndexT>& B)
+    {
+    ostringstream s;
+    s << " A" << dims(A) << " B" << dims(B);
+    const vector<int> pos = positions(A,B);
+    if(type == TensorTrace::Contract)
+        {
+        s << " contracted";
+        bool any = false;
+        for(size_t i = 0; i < pos.size(); ++i)
+            {
+            if(pos[i] == 0) continue;
+            s << " A" << i+1 << "-B" << pos[i];
+            any = true;
+            }
+        if(!any) s << " none";
+        }
+    else
+        {
+        //Order of B's indices relative to A's
+        s << " permutation";
+        Foreach(int p, pos) s << " " << p;
+        }
+    return s.str();
+    }
+
+string TraceRecord::
+describe() const
+    {
+    ostringstream s;
+    s << format("%-8s %-8s") % TensorTrace::opName(type) % (iq ? "IQTensor" : "ITensor");
+    const bool binary = (type == TensorTrace::Contract || type == TensorTrace::Add);
+    if(iq)
+        {
+        if(binary)
+            {
+            s << describeOperands(type,QA.indices(),QB.indices());
+            s << format(" blocks %d,%d") % QA.iten_size() % QB.iten_size();
+            }
+        else
+            {
+            s << " A" << dims(QA.indices()) << format(" blocks %d") % QA.iten_size();
+            }
+        }
+    else
+        {
+        if(binary) s << describeOperands(type,A.indices(),B.indices());
+        else       s << " A" << dims(A.indices());
+        }
+    if(!binary)
+        {
+        s << format(" maxm %d cutoff %.1E") % spec.maxm() % spec.cutoff();
+        }
+    s << format(" %.3Es") % wall;
+    return s.str();
+    }
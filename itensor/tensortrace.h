@@ -0,0 +1,218 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_TENSORTRACE_H
+#define __ITENSOR_TENSORTRACE_H
+
+#include "iqtensor.h"
+#include "spectrum.h"
+#include <fstream>
+#include <sstream>
+
+//
+// Opt-in record of the tensor operations done by a
+// program, to be replayed later (see TraceReader and
+// benchmark/tracereplay) for benchmarking changes to the
+// library on realistic inputs.
+//
+// While a trace is being recorded, every ITensor and
+// IQTensor contraction (operator*=) and addition
+// (operator+=), svdRank2 and diag_hermitian call is
+// written to the trace file along with its wall time.
+// Only the outermost operation is recorded: the block
+// products done by an IQTensor contraction, for example,
+// are part of the contraction record.
+//
+// Each record holds the indices of the operands in order
+// (so the permutations the operation needs can be
+// recovered), the QN blocks of IQTensors and, for the
+// decompositions, the Spectrum (truncation settings).
+// The tensor elements are only recorded if requested.
+// Records are written compressed, in chunks of a few MB.
+//
+// Recording is started by
+//
+//   TensorTrace::start(filename,opts)
+//
+// or by setting environment variable ITENSOR_TRACE to
+// the file name before starting the program, and runs
+// until TensorTrace::stop() or the end of the program.
+//
+// Options recognized:
+//   TraceData - also record the elements of the
+//               tensors (default false; environment
+//               variable ITENSOR_TRACE_DATA=1)
+//
+// Operations may be recorded from several threads, but
+// start and stop should not be called while other
+// threads are operating on tensors.
+//
+class TensorTrace
+    {
+    public:
+
+    enum OpType { Contract = 1, Add = 2, SVD = 3, Eigen = 4 };
+
+    static void
+    start(const std::string& fname, const OptSet& opts = Global::opts());
+
+    static void
+    stop();
+
+    //True if operations are being recorded
+    static bool
+    active() { return active_; }
+
+    static bool
+    withData() { return with_data_; }
+
+    //Number of operations recorded since start
+    static long
+    numRecorded();
+
+    static const char*
+    opName(OpType type);
+
+    private:
+
+    static bool active_,
+                with_data_;
+
+    //Not constructible
+    TensorTrace();
+    };
+
+//
+// Records one operation if a trace is active: the
+// operands are saved when it is constructed and the
+// record, with the time elapsed, is written when it
+// is destroyed. Used by the library code doing the
+// operations.
+//
+class TraceOp
+    {
+    public:
+
+    TraceOp(TensorTrace::OpType type, const ITensor& A, const ITensor& B)
+        : entered_(false), record_(false)
+        { if(TensorTrace::active()) begin(type,&A,&B,0,0,0,0,0,0,0); }
+
+    TraceOp(TensorTrace::OpType type, const IQTensor& A, const IQTensor& B)
+        : entered_(false), record_(false)
+        { if(TensorTrace::active()) begin(type,0,0,&A,&B,0,0,0,0,0); }
+
+    //svdRank2
+    TraceOp(const ITensor& A, const Index& ui, const Index& vi, const Spectrum& spec)
+        : entered_(false), record_(false)
+        { if(TensorTrace::active()) begin(TensorTrace::SVD,&A,0,0,0,&ui,&vi,0,0,&spec); }
+
+    TraceOp(const IQTensor& A, const IQIndex& uI, const IQIndex& vI, const Spectrum& spec)
+        : entered_(false), record_(false)
+        { if(TensorTrace::active()) begin(TensorTrace::SVD,0,0,&A,0,0,0,&uI,&vI,&spec); }
+
+    //diag_hermitian
+    TraceOp(const ITensor& rho, const Spectrum& spec)
+        : entered_(false), record_(false)
+        { if(TensorTrace::active()) begin(TensorTrace::Eigen,&rho,0,0,0,0,0,0,0,&spec); }
+
+    TraceOp(const IQTensor& rho, const Spectrum& spec)
+        : entered_(false), record_(false)
+        { if(TensorTrace::active()) begin(TensorTrace::Eigen,0,0,&rho,0,0,0,0,0,&spec); }
+
+    ~TraceOp() { if(entered_) end(); }
+
+    private:
+
+    bool entered_,
+         record_;
+    Real t0_;
+    std::string rec_;
+
+    void
+    begin(TensorTrace::OpType type,
+          const ITensor* A, const ITensor* B,
+          const IQTensor* QA, const IQTensor* QB,
+          const Index* ui, const Index* vi,
+          const IQIndex* uI, const IQIndex* vI,
+          const Spectrum* spec);
+
+    void
+    end();
+
+    //Not copyable
+    TraceOp(const TraceOp&);
+    void operator=(const TraceOp&);
+    };
+
+//
+// One operation read back from a trace file.
+//
+// Operands recorded without their elements
+// are filled with random elements.
+//
+class TraceRecord
+    {
+    public:
+
+    TraceRecord() : type(TensorTrace::Contract), iq(false), wall(0) { }
+
+    TensorTrace::OpType type;
+    //True if the operands are IQTensors
+    bool iq;
+    //Wall time of the operation when recorded (seconds)
+    Real wall;
+
+    //Operands: A, and B for Contract and Add
+    ITensor A, B;
+    IQTensor QA, QB;
+
+    //Row and column indices of an SVD
+    Index ui, vi;
+    IQIndex uI, vI;
+
+    //Truncation settings of an SVD or Eigen
+    Spectrum spec;
+
+    //Reruns the operation, returning its wall time.
+    //opts are passed to svdRank2 and diag_hermitian
+    //(e.g. "NumThreads").
+    Real
+    replay(const OptSet& opts = Global::opts()) const;
+
+    //Operation, operand dimensions and QN blocks,
+    //and the positions of the contracted indices
+    std::string
+    describe() const;
+    };
+
+class TraceReader
+    {
+    public:
+
+    TraceReader(const std::string& fname);
+
+    //True if the elements of the tensors were recorded
+    bool
+    withData() const { return with_data_; }
+
+    //Reads the next record into rec,
+    //returns false at the end of the file
+    bool
+    next(TraceRecord& rec);
+
+    private:
+
+    std::ifstream file_;
+    //Records of the current chunk
+    std::istringstream s_;
+    bool with_data_;
+    //Index and IQIndex definitions read so far
+    std::vector<Index> index_;
+    std::vector<IQIndex> iqindex_;
+
+    bool
+    nextChunk();
+    };
+
+#endif
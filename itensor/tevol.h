@@ -7,6 +7,9 @@
 
 #include "mpo.h"
 #include "bondgate.h"
+#include "vidalmps.h"
+#include "trotter.h"
+#include "parallel.h"
 #include <list>
 
 #define Cout std::cout
@@ -96,6 +99,47 @@ gateTEvol(const Iterable& gatelist,
           MPSt<Tensor>& psi, 
           const OptSet& opts = Global::opts());
 
+//
+// Same as gateTEvol, but for an MPS in Vidal form (TEBD).
+//
+// Consecutive gates of gatelist acting on distinct sites 
+// (such as one even or odd Trotter layer) are applied 
+// concurrently. Gates must act on neighboring sites i,i+1. 
+// Truncation is set by the spectrum of each bond of psi.
+//
+// Options recognized:
+//     NumThreads - number of threads applying the gates of a layer,
+//                  used only if compiled with ITENSOR_USE_THREADS (default 1)
+//     Verbose - print useful information to stdout
+//
+template <class Iterable, class Tensor>
+Real
+gateTEvol(const Iterable& gatelist, 
+          Real ttotal, Real tstep, 
+          VidalMPSt<Tensor>& psi, 
+          const OptSet& opts = Global::opts());
+
+//
+// Evolves psi by an amount ttotal in steps of sched.tstep() 
+// using the gates of a TrotterSchedule (see trotter.h).
+//
+// Options recognized:
+//     NumThreads - (VidalMPSt only) number of threads applying 
+//                  the gates of a layer (default 1)
+//     Verbose - print useful information to stdout
+//
+template <class Tensor>
+Real
+gateTEvol(const TrotterSchedule<Tensor>& sched, Real ttotal, 
+          MPSt<Tensor>& psi, 
+          const OptSet& opts = Global::opts());
+
+template <class Tensor>
+Real
+gateTEvol(const TrotterSchedule<Tensor>& sched, Real ttotal, 
+          VidalMPSt<Tensor>& psi, 
+          const OptSet& opts = Global::opts());
+
 
 
 //
@@ -104,6 +148,28 @@ gateTEvol(const Iterable& gatelist,
 //
 //
 
+int inline
+numTimeSteps(Real ttotal, Real tstep)
+    {
+    const int nt = int(ttotal/tstep+(1e-9*(ttotal/tstep)));
+    if(fabs(nt*tstep-ttotal) > 1E-9)
+        {
+        Error("Timestep not commensurate with total time");
+        }
+    return nt;
+    }
+
+template <class Iterable, class Tensor>
+void
+applyGates(const Iterable& gatelist, MPSt<Tensor>& psi)
+    {
+    Foreach(const BondGate<Tensor>& G, gatelist)
+        {
+        psi.position(G.i());
+        psi.applygate(G);
+        }
+    }
+
 template <class Iterable, class Tensor>
 Real
 gateTEvol(const Iterable& gatelist, Real ttotal, Real tstep, 
@@ -112,11 +178,7 @@ gateTEvol(const Iterable& gatelist, Real ttotal, Real tstep,
     {
     bool verbose = opts.getBool("Verbose",false);
 
-    const int nt = int(ttotal/tstep+(1e-9*(ttotal/tstep)));
-    if(fabs(nt*tstep-ttotal) > 1E-9)
-        {
-        Error("Timestep not commensurate with total time");
-        }
+    const int nt = numTimeSteps(ttotal,tstep);
 
     Real tsofar = 0;
     Real tot_norm = psi.normalize();
@@ -130,11 +192,7 @@ gateTEvol(const Iterable& gatelist, Real ttotal, Real tstep,
         }
     for(int tt = 1; tt <= nt; ++tt)
         {
-        Foreach(const BondGate<Tensor>& G, gatelist)
-            {
-            psi.position(G.i());
-            psi.applygate(G);
-            }
+        applyGates(gatelist,psi);
 
         if(verbose)
             {
@@ -159,6 +217,222 @@ gateTEvol(const Iterable& gatelist, Real ttotal, Real tstep,
 
     } // gateTEvol
 
+template <class Tensor>
+class VidalGateApplier
+    {
+    public:
+
+    VidalGateApplier(const std::vector<const BondGate<Tensor>*>& layer,
+                     VidalMPSt<Tensor>& psi, std::vector<Real>& norms,
+                     const OptSet& opts)
+        : 
+        layer_(&layer), 
+        psi_(&psi), 
+        norms_(&norms), 
+        opts_(&opts)
+        { }
+
+    void
+    operator()(int n) const
+        {
+        norms_->at(n) = psi_->applygate(*layer_->at(n),*opts_);
+        }
+
+    private:
+
+    const std::vector<const BondGate<Tensor>*>* layer_;
+    VidalMPSt<Tensor>* psi_;
+    std::vector<Real>* norms_;
+    const OptSet* opts_;
+    };
+
+//Groups consecutive gates acting on distinct sites into layers,
+//returns the number of gates
+template <class Iterable, class Tensor>
+int
+gateLayers(const Iterable& gatelist, int N,
+           std::vector<std::vector<const BondGate<Tensor>*> >& layers)
+    {
+    layers.assign(1,std::vector<const BondGate<Tensor>*>());
+    std::vector<bool> used(N+2,false);
+    int ngate = 0;
+    Foreach(const BondGate<Tensor>& G, gatelist)
+        {
+        ++ngate;
+        if(G.j() != G.i()+1)
+            {
+            Error("gateTEvol: Vidal MPS gates must act on sites i,i+1");
+            }
+        if(used.at(G.i()) || used.at(G.j()))
+            {
+            layers.push_back(std::vector<const BondGate<Tensor>*>());
+            used.assign(used.size(),false);
+            }
+        layers.back().push_back(&G);
+        used.at(G.i()) = true;
+        used.at(G.j()) = true;
+        }
+    return ngate;
+    }
+
+//Applies the gates of each layer concurrently,
+//returns the product of the norms
+template <class Tensor>
+Real
+applyGates(const std::vector<std::vector<const BondGate<Tensor>*> >& layers,
+           VidalMPSt<Tensor>& psi, int nthread, const OptSet& opts)
+    {
+    Real nrm = 1;
+    std::vector<Real> norms;
+    Foreach(const std::vector<const BondGate<Tensor>*>& layer, layers)
+        {
+        norms.assign(layer.size(),1);
+        parallelFor(VidalGateApplier<Tensor>(layer,psi,norms,opts),
+                    layer.size(),nthread);
+        //Multiply in a fixed order so results don't
+        //depend on how the threads were scheduled
+        Foreach(Real n, norms) nrm *= n;
+        }
+    return nrm;
+    }
+
+template <class Iterable, class Tensor>
+Real
+gateTEvol(const Iterable& gatelist, Real ttotal, Real tstep, 
+          VidalMPSt<Tensor>& psi, 
+          const OptSet& opts)
+    {
+    bool verbose = opts.getBool("Verbose",false);
+    const int nthread = getNumThreads(opts);
+
+    const int nt = numTimeSteps(ttotal,tstep);
+
+    std::vector<std::vector<const BondGate<Tensor>*> > layers;
+    const int ngate = gateLayers(gatelist,psi.N(),layers);
+
+    Real tsofar = 0;
+    Real tot_norm = 1;
+    if(verbose) 
+        {
+        Cout << Format("Taking %d steps of timestep %.5f, total time %.5f")
+                % nt
+                % tstep
+                % ttotal
+                << Endl;
+        Cout << Format("%d gates in %d layers") 
+                % ngate % layers.size() << Endl;
+        }
+    for(int tt = 1; tt <= nt; ++tt)
+        {
+        tot_norm *= applyGates(layers,psi,nthread,opts);
+
+        if(verbose)
+            {
+            Real percentdone = (100.*tt)/nt;
+            if(percentdone < 99.5 || (tt==nt))
+                {
+                Cout << Format("\b\b\b%2.f%%") % percentdone;
+                Cout.flush();
+                }
+            }
+
+        tsofar += tstep;
+        }
+    if(verbose) 
+        {
+        Cout << Format("\nTotal time evolved = %.5f\n") % tsofar << Endl;
+        }
+
+    return tot_norm;
+
+    } // gateTEvol (VidalMPSt)
+
+template <class Tensor>
+Real
+gateTEvol(const TrotterSchedule<Tensor>& sched, Real ttotal, 
+          MPSt<Tensor>& psi, 
+          const OptSet& opts)
+    {
+    bool verbose = opts.getBool("Verbose",false);
+
+    const int nt = numTimeSteps(ttotal,sched.tstep());
+
+    Real tot_norm = psi.normalize();
+    //No steps: not even the head gates are applied
+    if(nt == 0) return tot_norm;
+
+    if(verbose) 
+        {
+        Cout << Format("Taking %d steps of timestep %.5f, total time %.5f (order %d, %d gates)")
+                % nt
+                % sched.tstep()
+                % ttotal
+                % sched.order()
+                % sched.numGates(nt)
+                << Endl;
+        }
+
+    applyGates(sched.head(),psi);
+    for(int tt = 1; tt <= nt; ++tt)
+        {
+        applyGates((tt < nt ? sched.body() : sched.last()),psi);
+        tot_norm *= psi.normalize();
+        }
+
+    if(verbose) 
+        {
+        Cout << Format("Total time evolved = %.5f\n") % (nt*sched.tstep()) << Endl;
+        }
+
+    return tot_norm;
+
+    } // gateTEvol (TrotterSchedule)
+
+template <class Tensor>
+Real
+gateTEvol(const TrotterSchedule<Tensor>& sched, Real ttotal, 
+          VidalMPSt<Tensor>& psi, 
+          const OptSet& opts)
+    {
+    bool verbose = opts.getBool("Verbose",false);
+    const int nthread = getNumThreads(opts);
+
+    const int nt = numTimeSteps(ttotal,sched.tstep());
+    if(nt == 0) return 1;
+
+    std::vector<std::vector<const BondGate<Tensor>*> > head, 
+                                                       body, 
+                                                       last;
+    gateLayers(sched.head(),psi.N(),head);
+    gateLayers(sched.body(),psi.N(),body);
+    gateLayers(sched.last(),psi.N(),last);
+
+    if(verbose) 
+        {
+        Cout << Format("Taking %d steps of timestep %.5f, total time %.5f (order %d, %d gates)")
+                % nt
+                % sched.tstep()
+                % ttotal
+                % sched.order()
+                % sched.numGates(nt)
+                << Endl;
+        }
+
+    Real tot_norm = applyGates(head,psi,nthread,opts);
+    for(int tt = 1; tt <= nt; ++tt)
+        {
+        tot_norm *= applyGates((tt < nt ? body : last),psi,nthread,opts);
+        }
+
+    if(verbose) 
+        {
+        Cout << Format("Total time evolved = %.5f\n") % (nt*sched.tstep()) << Endl;
+        }
+
+    return tot_norm;
+
+    } // gateTEvol (TrotterSchedule, VidalMPSt)
+
 #undef Cout
 #undef Endl
 #undef Format
@@ -0,0 +1,390 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "threadpool.h"
+#include "cputime.h"
+#ifdef ITENSOR_USE_THREADS
+#include "boost/bind.hpp"
+#endif
+
+using std::string;
+
+//
+// What a thread is doing: the queue it owns
+// (-1 for threads which are not pool workers)
+// and the depth of the parallel region it is in
+//
+struct ThreadState
+    {
+    ThreadState() : id(-1), depth(0) { }
+    int id;
+    int depth;
+    };
+
+#ifdef ITENSOR_USE_THREADS
+static boost::thread_specific_ptr<ThreadState> thread_state_;
+
+static ThreadState&
+threadState()
+    {
+    if(thread_state_.get() == 0) thread_state_.reset(new ThreadState());
+    return *thread_state_;
+    }
+#else
+static ThreadState&
+threadState()
+    {
+    static ThreadState state_;
+    return state_;
+    }
+#endif
+
+//Positive integer value of environment variable name, or 0
+static int
+envInt(const char* name)
+    {
+    const char* val = getenv(name);
+    if(val == 0) return 0;
+    const int n = atoi(val);
+    return (n > 0 ? n : 0);
+    }
+
+std::ostream&
+operator<<(std::ostream& s, const PoolStats& st)
+    {
+    typedef std::map<string,TaskTimes>::const_iterator
+    cit;
+    for(cit it = st.tasks.begin(); it != st.tasks.end(); ++it)
+        {
+        const TaskTimes& t = it->second;
+        s << boost::format("%s: %d tasks, total %.3fs, mean %.3fs, max %.3fs\n")
+             % it->first % t.ntask % t.total % t.mean() % t.max;
+        }
+    s << "Tasks stolen: " << st.nsteal << "\n";
+    return s;
+    }
+
+int ThreadPool::
+defaultThreads()
+    {
+    const int nopt = Global::opts().getInt("NumThreads",0);
+    if(nopt > 0) return nopt;
+    const int nenv = envInt("ITENSOR_NUM_THREADS");
+    if(nenv > 0) return nenv;
+
+    int ncore = 1;
+#ifdef ITENSOR_USE_THREADS
+    ncore = std::max<int>(1,boost::thread::hardware_concurrency());
+#endif
+    //Leave room for the threads of a threaded BLAS
+    int nblas = envInt("OPENBLAS_NUM_THREADS");
+    if(nblas == 0) nblas = envInt("MKL_NUM_THREADS");
+    if(nblas == 0) nblas = envInt("OMP_NUM_THREADS");
+    if(nblas == 0) nblas = 1;
+    return std::max(1,ncore/nblas);
+    }
+
+ThreadPool& ThreadPool::
+instance()
+    {
+    static ThreadPool pool_;
+    return pool_;
+    }
+
+ThreadPool::
+ThreadPool()
+    :
+    nthread_(1),
+    max_nesting_(1),
+    timing_(Global::opts().getBool("PoolTiming",false))
+    {
+    const int nenv = envInt("ITENSOR_MAX_NESTING");
+    max_nesting_ = Global::opts().getInt("PoolMaxNesting",nenv > 0 ? nenv : 1);
+    start(defaultThreads());
+    }
+
+ThreadPool::
+~ThreadPool()
+    {
+    stop();
+    }
+
+void ThreadPool::
+resize(int n)
+    {
+    stop();
+    start(n > 0 ? n : defaultThreads());
+    }
+
+void ThreadPool::
+start(int n)
+    {
+#ifndef ITENSOR_USE_THREADS
+    n = 1;
+#endif
+    nthread_ = std::max(1,n);
+    for(int q = 0; q < nthread_; ++q) queues_.push_back(new Queue());
+#ifdef ITENSOR_USE_THREADS
+    pending_ = 0;
+    stop_ = false;
+    for(int id = 0; id < nthread_-1; ++id)
+        {
+        workers_.push_back(new boost::thread(boost::bind(&ThreadPool::work,this,id)));
+        }
+#endif
+    }
+
+void ThreadPool::
+stop()
+    {
+#ifdef ITENSOR_USE_THREADS
+        {
+        boost::mutex::scoped_lock lock(sleep_);
+        stop_ = true;
+        }
+    wake_.notify_all();
+    for(size_t w = 0; w < workers_.size(); ++w)
+        {
+        workers_[w]->join();
+        delete workers_[w];
+        }
+    workers_.clear();
+#endif
+    for(size_t q = 0; q < queues_.size(); ++q) delete queues_[q];
+    queues_.clear();
+    }
+
+PoolStats ThreadPool::
+stats() const
+    {
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(stats_mutex_);
+#endif
+    return stats_;
+    }
+
+void ThreadPool::
+resetStats()
+    {
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(stats_mutex_);
+#endif
+    stats_ = PoolStats();
+    }
+
+int ThreadPool::
+depth()
+    {
+    return threadState().depth;
+    }
+
+void ThreadPool::
+submit(const Task& f, TaskGroup& g)
+    {
+    Item it;
+    it.f = f;
+    it.group = &g;
+    it.depth = depth();
+#ifdef ITENSOR_USE_THREADS
+    const int id = threadState().id;
+    Queue& q = *(id >= 0 ? queues_.at(id) : queues_.back());
+        {
+        boost::mutex::scoped_lock lock(q.mutex);
+        q.items.push_back(it);
+        }
+        {
+        boost::mutex::scoped_lock lock(sleep_);
+        ++pending_;
+        }
+    wake_.notify_one();
+#else
+    runItem(it);
+#endif
+    }
+
+bool ThreadPool::
+runOne()
+    {
+#ifdef ITENSOR_USE_THREADS
+    const int nq = queues_.size();
+    const int id = threadState().id;
+    const int own = (id >= 0 ? id : nq-1);
+    Item it;
+    bool got = false,
+         stolen = false;
+
+    //Newest task of our own queue first
+        {
+        Queue& q = *queues_[own];
+        boost::mutex::scoped_lock lock(q.mutex);
+        if(!q.items.empty())
+            {
+            it = q.items.back();
+            q.items.pop_back();
+            got = true;
+            }
+        }
+    //Otherwise the oldest task of another queue
+    for(int k = 1; k < nq && !got; ++k)
+        {
+        Queue& q = *queues_[(own+k)%nq];
+        boost::mutex::scoped_lock lock(q.mutex);
+        if(!q.items.empty())
+            {
+            it = q.items.front();
+            q.items.pop_front();
+            got = stolen = true;
+            }
+        }
+    if(!got) return false;
+
+        {
+        boost::mutex::scoped_lock lock(sleep_);
+        --pending_;
+        }
+    if(stolen)
+        {
+        boost::mutex::scoped_lock lock(stats_mutex_);
+        ++stats_.nsteal;
+        }
+    runItem(it);
+    return true;
+#else
+    return false;
+#endif
+    }
+
+void ThreadPool::
+runItem(const Item& it)
+    {
+    ThreadState& s = threadState();
+    const int saved_depth = s.depth;
+    s.depth = it.depth;
+
+    const bool timed = timing_;
+    const Real t0 = (timed ? mywalltime() : 0);
+    string errmess;
+    try {
+        it.f();
+        }
+    catch(const ITError& e)
+        {
+        //Exceptions must not escape a thread,
+        //save the message for the waiting thread
+        errmess = e.what();
+        }
+    catch(const std::exception& e)
+        {
+        errmess = e.what();
+        }
+    if(timed)
+        {
+        const Real t = mywalltime()-t0;
+#ifdef ITENSOR_USE_THREADS
+        boost::mutex::scoped_lock lock(stats_mutex_);
+#endif
+        stats_.tasks[it.group->name()].add(t);
+        }
+
+    s.depth = saved_depth;
+    it.group->finished(errmess);
+    }
+
+void ThreadPool::
+work(int id)
+    {
+#ifdef ITENSOR_USE_THREADS
+    threadState().id = id;
+    while(true)
+        {
+        if(runOne()) continue;
+        boost::mutex::scoped_lock lock(sleep_);
+        while(pending_ == 0 && !stop_) wake_.wait(lock);
+        if(stop_) return;
+        }
+#endif
+    }
+
+TaskGroup::
+TaskGroup(const string& name)
+    :
+    name_(name),
+    outstanding_(0)
+    { }
+
+TaskGroup::
+~TaskGroup()
+    {
+    try {
+        wait();
+        }
+    catch(const ITError&)
+        { }
+    }
+
+void TaskGroup::
+run(const ThreadPool::Task& f)
+    {
+        {
+#ifdef ITENSOR_USE_THREADS
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        ++outstanding_;
+        }
+    ThreadPool::instance().submit(f,*this);
+    }
+
+void TaskGroup::
+finished(const string& errmess)
+    {
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex::scoped_lock lock(mutex_);
+#endif
+    if(errmess_.empty()) errmess_ = errmess;
+    --outstanding_;
+#ifdef ITENSOR_USE_THREADS
+    //Notify while holding the lock: once it is released
+    //the waiting thread may destroy the group
+    if(outstanding_ == 0) done_.notify_all();
+#endif
+    }
+
+void TaskGroup::
+wait()
+    {
+#ifdef ITENSOR_USE_THREADS
+    ThreadPool& pool = ThreadPool::instance();
+    while(true)
+        {
+            {
+            boost::mutex::scoped_lock lock(mutex_);
+            if(outstanding_ == 0) break;
+            }
+        //Help with queued tasks; once there are none left
+        //the tasks of this group have all been started
+        if(pool.runOne()) continue;
+        boost::mutex::scoped_lock lock(mutex_);
+        while(outstanding_ > 0) done_.wait(lock);
+        break;
+        }
+#endif
+    if(!errmess_.empty())
+        {
+        string mess;
+        mess.swap(errmess_);
+        throw ITError(mess);
+        }
+    }
+
+ParallelRegion::
+ParallelRegion()
+    {
+    ++threadState().depth;
+    }
+
+ParallelRegion::
+~ParallelRegion()
+    {
+    --threadState().depth;
+    }
@@ -0,0 +1,331 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_THREADPOOL_H
+#define __ITENSOR_THREADPOOL_H
+
+#include "global.h"
+#include <map>
+#include <deque>
+#include "boost/function.hpp"
+
+#ifdef ITENSOR_USE_THREADS
+#include "boost/thread.hpp"
+#endif
+
+//
+// Library-wide pool of worker threads.
+//
+// Work is submitted as tasks belonging to a TaskGroup.
+// Each worker keeps its own queue: tasks submitted by a
+// worker go on the back of its queue and it runs its newest
+// task first, while idle workers steal the oldest tasks of
+// the other queues. A thread waiting for a TaskGroup runs
+// queued tasks itself until the group is done, so tasks can
+// submit and wait for tasks of their own without
+// deadlocking the pool.
+//
+// Number of threads nthread() (the workers plus the
+// thread submitting the tasks), in order of precedence:
+//
+//   Global option "NumThreads"
+//   environment variable ITENSOR_NUM_THREADS
+//   number of cores divided by the number of threads
+//   BLAS is told to use (OPENBLAS_NUM_THREADS, MKL_NUM_THREADS
+//   or OMP_NUM_THREADS, 1 if none are set)
+//
+// read when the pool is first used (or by resize).
+//
+// Nested parallelism: parallelFor and parallelSum (see
+// parallel.h) open a parallel region, and tasks run at the
+// nesting depth of the region submitting them. Regions
+// opened at depth maxNesting() or deeper run serially on
+// the calling thread. The default, 1 (Global option
+// "PoolMaxNesting" or environment variable ITENSOR_MAX_NESTING),
+// only runs the outermost region in parallel, e.g. METTS
+// chains in parallel but the terms of a LocalMPOSet within
+// each chain serially.
+//
+// If timing is on (Global option "PoolTiming", or timing(true))
+// the wall time of each task is recorded under the name
+// of its TaskGroup, see stats().
+//
+// Without ITENSOR_USE_THREADS defined the pool has
+// no workers and tasks run as soon as they are submitted.
+//
+
+//
+// Times of the tasks of one name
+//
+class TaskTimes
+    {
+    public:
+
+    TaskTimes() : ntask(0), total(0), max(0) { }
+
+    void
+    add(Real t)
+        {
+        ++ntask;
+        total += t;
+        if(t > max) max = t;
+        }
+
+    Real
+    mean() const { return ntask > 0 ? total/ntask : 0.; }
+
+    //Number of tasks run
+    long ntask;
+    //Total and largest wall time (seconds) of a task
+    Real total,
+         max;
+
+    };
+
+class PoolStats
+    {
+    public:
+
+    PoolStats() : nsteal(0) { }
+
+    //Times of tasks by TaskGroup name
+    std::map<std::string,TaskTimes> tasks;
+
+    //Number of tasks taken from the queue
+    //of another thread
+    long nsteal;
+
+    };
+
+std::ostream&
+operator<<(std::ostream& s, const PoolStats& st);
+
+class TaskGroup;
+
+class ThreadPool
+    {
+    public:
+
+    typedef boost::function<void()>
+    Task;
+
+    //The library-wide pool
+    static ThreadPool&
+    instance();
+
+    ~ThreadPool();
+
+    //Number of threads running tasks,
+    //counting the thread submitting them
+    int
+    nthread() const { return nthread_; }
+
+    //Replaces the workers so that nthread() == n,
+    //n <= 0 restores the default. Must not be
+    //called while tasks are running.
+    void
+    resize(int n);
+
+    int
+    maxNesting() const { return max_nesting_; }
+    void
+    maxNesting(int val) { max_nesting_ = val; }
+
+    bool
+    timing() const { return timing_; }
+    void
+    timing(bool val) { timing_ = val; }
+
+    PoolStats
+    stats() const;
+
+    void
+    resetStats();
+
+    //Number of parallel regions enclosing
+    //the work of the calling thread
+    static int
+    depth();
+
+    //True if a parallel region opened by
+    //the calling thread may use several threads
+    bool
+    parallelAllowed() const { return nthread_ > 1 && depth() < max_nesting_; }
+
+    //Default number of threads, see above
+    static int
+    defaultThreads();
+
+    private:
+
+    struct Item
+        {
+        Task f;
+        TaskGroup* group;
+        int depth;
+        };
+
+    struct Queue
+        {
+        std::deque<Item> items;
+#ifdef ITENSOR_USE_THREADS
+        boost::mutex mutex;
+#endif
+        };
+
+    /////////////////
+    //
+    // Data Members
+    //
+
+    int nthread_,
+        max_nesting_;
+    bool timing_;
+
+    //One queue per worker, plus a last one
+    //for tasks submitted by other threads
+    std::vector<Queue*> queues_;
+
+    PoolStats stats_;
+
+#ifdef ITENSOR_USE_THREADS
+    //Number of queued tasks, guarded by sleep_
+    long pending_;
+    bool stop_;
+    boost::mutex sleep_;
+    boost::condition_variable wake_;
+    mutable boost::mutex stats_mutex_;
+    std::vector<boost::thread*> workers_;
+#endif
+
+    //
+    /////////////////
+
+    ThreadPool();
+
+    //Not copyable
+    ThreadPool(const ThreadPool&);
+    void operator=(const ThreadPool&);
+
+    void
+    start(int n);
+
+    void
+    stop();
+
+    void
+    submit(const Task& f, TaskGroup& g);
+
+    //Runs one queued task if there is one
+    bool
+    runOne();
+
+    void
+    runItem(const Item& it);
+
+    void
+    work(int id);
+
+    friend class TaskGroup;
+    friend class ParallelRegion;
+    };
+
+//
+// Set of tasks which can be waited for together.
+//
+// run(f) queues f() on the library thread pool; wait()
+// returns once all of them have finished, having run
+// queued tasks itself meanwhile. An ITError thrown by a
+// task is rethrown by wait(). The group should only be
+// used by the thread that created it.
+//
+class TaskGroup
+    {
+    public:
+
+    TaskGroup(const std::string& name = "TaskGroup");
+
+    //Waits for the tasks, ignoring errors
+    ~TaskGroup();
+
+    const std::string&
+    name() const { return name_; }
+
+    void
+    run(const ThreadPool::Task& f);
+
+    void
+    wait();
+
+    private:
+
+    std::string name_;
+    int outstanding_;
+    std::string errmess_;
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex mutex_;
+    boost::condition_variable done_;
+#endif
+
+    //Not copyable
+    TaskGroup(const TaskGroup&);
+    void operator=(const TaskGroup&);
+
+    void
+    finished(const std::string& errmess);
+
+    friend class ThreadPool;
+    };
+
+//
+// Marks the calling thread as working in a parallel
+// region for the lifetime of this object
+// (see nested parallelism above).
+//
+class ParallelRegion
+    {
+    public:
+
+    ParallelRegion();
+
+    ~ParallelRegion();
+
+    private:
+
+    ParallelRegion(const ParallelRegion&);
+    void operator=(const ParallelRegion&);
+    };
+
+//
+// Hands out 0,1,...,n-1 to threads sharing it
+//
+class TaskCounter
+    {
+    public:
+
+    TaskCounter(int n) : next_(0), n_(n) { }
+
+    //Sets i to the next number and returns
+    //true, or false once all are handed out
+    bool
+    next(int& i)
+        {
+#ifdef ITENSOR_USE_THREADS
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        if(next_ >= n_) return false;
+        i = next_++;
+        return true;
+        }
+
+    private:
+
+    int next_,
+        n_;
+#ifdef ITENSOR_USE_THREADS
+    boost::mutex mutex_;
+#endif
+    };
+
+#endif
@@ -0,0 +1,256 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_TROTTER_H
+#define __ITENSOR_TROTTER_H
+
+#include "bondgate.h"
+
+//
+// Merges gates acting on the same sites into a single gate
+// wherever no gate in between shares a site with them
+// (so the order of the product is unchanged).
+//
+template <class Tensor>
+void
+fuseGates(std::vector<BondGate<Tensor> >& gates);
+
+//
+// class TrotterSchedule
+//
+// Gates for time steps exp(-tstep H) of a nearest-neighbor
+// Hamiltonian H = sum_b bondH[b], with bondH[b] acting on
+// sites b and b+1 (b = 1,...,N-1; null tensors are skipped).
+//
+// Writing H = A + B with A the sum over odd bonds and B the sum
+// over even bonds, a step is
+//
+//   Order 1: exp(-tau A) exp(-tau B)
+//   Order 2: exp(-tau A/2) exp(-tau B) exp(-tau A/2)
+//   Order 4: S2(p tau) S2(p tau) S2((1-4p) tau) S2(p tau) S2(p tau)
+//            with S2 the second order step and p = 1/(4-4^(1/3))
+//
+// Consecutive exponentials of the same layer are merged, including
+// the half steps at the end of one time step and the start of
+// the next: a run of n steps applies head(), then body() n-1 times,
+// then last(). Gates left acting on the same bond (for example when
+// one layer is empty) are multiplied together.
+//
+// Between steps the state is then offset by the first half
+// step, which is standard practice for measurements.
+//
+// Options recognized:
+//     Order - order of the Suzuki-Trotter decomposition,
+//             1, 2 or 4 (default 2)
+//
+template <class Tensor>
+class TrotterSchedule
+    {
+    public:
+
+    typedef BondGate<Tensor>
+    GateT;
+
+    typedef typename BondGate<Tensor>::Type
+    Type;
+
+    TrotterSchedule(const Model& model, const std::vector<Tensor>& bondH,
+                    Type type, Real tstep,
+                    const OptSet& opts = Global::opts());
+
+    Real
+    tstep() const { return tstep_; }
+
+    int
+    order() const { return order_; }
+
+    //Gates applied once, before the first step
+    const std::vector<GateT>&
+    head() const { return head_; }
+
+    //Gates of every step but the last one
+    const std::vector<GateT>&
+    body() const { return body_; }
+
+    //Gates of the last step
+    const std::vector<GateT>&
+    last() const { return last_; }
+
+    //Number of gates applied in nstep steps
+    //(none if nstep is zero)
+    int
+    numGates(int nstep) const
+        {
+        if(nstep <= 0) return 0;
+        return head_.size() + (nstep-1)*body_.size() + last_.size();
+        }
+
+    private:
+
+    //Exponentials exp(-coef*tstep*X) with X = A (layer 1) or B (layer 2)
+    struct Factor
+        {
+        int layer;
+        Real coef;
+        Factor(int l, Real c) : layer(l), coef(c) { }
+        };
+
+    void
+    addFactor(std::vector<Factor>& seq, int layer, Real coef) const;
+
+    void
+    addS2(std::vector<Factor>& seq, Real coef) const;
+
+    void
+    makeGates(const std::vector<Factor>& seq,
+              std::vector<GateT>& gates) const;
+
+    /////////////////
+    //
+    // Data Members
+    //
+
+    const Model& model_;
+    std::vector<Tensor> bondH_;
+    Type type_;
+    Real tstep_;
+    int order_;
+    std::vector<GateT> head_,
+                       body_,
+                       last_;
+
+    //
+    /////////////////
+
+    };
+
+template <class Tensor>
+void
+fuseGates(std::vector<BondGate<Tensor> >& gates)
+    {
+    std::vector<BondGate<Tensor> > res;
+    Foreach(const BondGate<Tensor>& G, gates)
+        {
+        bool fused = false;
+        for(int k = int(res.size())-1; k >= 0; --k)
+            {
+            BondGate<Tensor>& R = res.at(k);
+            if(R.i() == G.i() && R.j() == G.j())
+                {
+                R = G * R;
+                fused = true;
+                break;
+                }
+            if(R.i() == G.i() || R.i() == G.j()
+            || R.j() == G.i() || R.j() == G.j()) break;
+            }
+        if(!fused) res.push_back(G);
+        }
+    gates.swap(res);
+    }
+
+template <class Tensor>
+TrotterSchedule<Tensor>::
+TrotterSchedule(const Model& model, const std::vector<Tensor>& bondH,
+                Type type, Real tstep, const OptSet& opts)
+    :
+    model_(model),
+    bondH_(bondH),
+    type_(type),
+    tstep_(tstep),
+    order_(opts.getInt("Order",2))
+    {
+    bondH_.resize(model.N());
+
+    std::vector<Factor> seq;
+    if(order_ == 1)
+        {
+        addFactor(seq,1,1);
+        addFactor(seq,2,1);
+        }
+    else
+    if(order_ == 2)
+        {
+        addS2(seq,1);
+        }
+    else
+    if(order_ == 4)
+        {
+        const Real p = 1./(4-pow(4.,1./3));
+        addS2(seq,p);
+        addS2(seq,p);
+        addS2(seq,1-4*p);
+        addS2(seq,p);
+        addS2(seq,p);
+        }
+    else
+        {
+        Error("TrotterSchedule: Order must be 1, 2 or 4");
+        }
+
+    if(seq.empty()) Error("TrotterSchedule: no bond terms");
+
+    //Fold the last factor of each step into
+    //the first factor of the next one
+    std::vector<Factor> head,
+                        body(seq),
+                        last(seq);
+    if(seq.size() > 1 && seq.front().layer == seq.back().layer)
+        {
+        head.push_back(seq.front());
+        body.erase(body.begin());
+        body.back().coef += seq.front().coef;
+        last.erase(last.begin());
+        }
+    makeGates(head,head_);
+    makeGates(body,body_);
+    makeGates(last,last_);
+    }
+
+template <class Tensor>
+void TrotterSchedule<Tensor>::
+addFactor(std::vector<Factor>& seq, int layer, Real coef) const
+    {
+    //Skip layers without any bond terms
+    bool empty = true;
+    for(int b = layer; b < model_.N(); b += 2)
+        {
+        if(!bondH_.at(b).isNull()) empty = false;
+        }
+    if(empty) return;
+
+    if(!seq.empty() && seq.back().layer == layer)
+        {
+        seq.back().coef += coef;
+        return;
+        }
+    seq.push_back(Factor(layer,coef));
+    }
+
+template <class Tensor>
+void TrotterSchedule<Tensor>::
+addS2(std::vector<Factor>& seq, Real coef) const
+    {
+    addFactor(seq,1,coef/2);
+    addFactor(seq,2,coef);
+    addFactor(seq,1,coef/2);
+    }
+
+template <class Tensor>
+void TrotterSchedule<Tensor>::
+makeGates(const std::vector<Factor>& seq, std::vector<GateT>& gates) const
+    {
+    gates.clear();
+    Foreach(const Factor& f, seq)
+        {
+        for(int b = f.layer; b < model_.N(); b += 2)
+            {
+            if(bondH_.at(b).isNull()) continue;
+            gates.push_back(GateT(model_,b,b+1,type_,f.coef*tstep_,bondH_.at(b)));
+            }
+        }
+    fuseGates(gates);
+    }
+
+#endif
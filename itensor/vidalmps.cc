@@ -0,0 +1,164 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#include "vidalmps.h"
+
+using std::vector;
+
+template <class Tensor>
+VidalMPSt<Tensor>::
+VidalMPSt()
+    :
+    N_(0),
+    model_(0)
+    { }
+template VidalMPSt<ITensor>::
+VidalMPSt();
+template VidalMPSt<IQTensor>::
+VidalMPSt();
+
+template <class Tensor>
+VidalMPSt<Tensor>::
+VidalMPSt(const MPSt<Tensor>& psi, const OptSet& opts)
+    :
+    N_(psi.N()),
+    model_(&psi.model()),
+    B_(psi.N()+1),
+    lambda_(psi.N()),
+    spectrum_(psi.N(),Spectrum(opts))
+    {
+    if(N_ < 2) Error("VidalMPS: need at least 2 sites");
+
+    MPSt<Tensor> phi(psi);
+    phi.position(N_);
+    phi.normalize();
+
+    //Sweep right to left, splitting off the singular
+    //values of each bond. The sites to the left of the
+    //center are left-orthogonal, so these are the
+    //Schmidt values.
+    Tensor C = phi.A(N_);
+    for(int b = N_-1; b >= 1; --b)
+        {
+        const Tensor AA = phi.A(b) * C;
+        Tensor U = phi.A(b),
+               V;
+        SparseT D;
+        svd(AA,U,D,V,spectrum_.at(b),opts);
+        D *= 1./D.norm();
+        B_.at(b+1) = V;
+        lambda_.at(b) = D;
+        C = U * D;
+        }
+    B_.at(1) = C;
+    }
+template VidalMPSt<ITensor>::
+VidalMPSt(const MPSt<ITensor>& psi, const OptSet& opts);
+template VidalMPSt<IQTensor>::
+VidalMPSt(const MPSt<IQTensor>& psi, const OptSet& opts);
+
+template <class Tensor>
+Tensor VidalMPSt<Tensor>::
+Gamma(int j, Real cut) const
+    {
+    if(j == N_) return B_.at(N_);
+    //Lambda_j connects to B_j through its right index,
+    //conj(Lambda_j) has the opposite arrows
+    SparseT inv = conj(lambda_.at(j));
+    inv.pseudoInvert(cut);
+    return B_.at(j) * inv;
+    }
+template
+ITensor VidalMPSt<ITensor>::Gamma(int j, Real cut) const;
+template
+IQTensor VidalMPSt<IQTensor>::Gamma(int j, Real cut) const;
+
+template <class Tensor>
+void VidalMPSt<Tensor>::
+maxm(int val)
+    {
+    Foreach(Spectrum& spec, spectrum_)
+        {
+        spec.maxm(val);
+        }
+    }
+template
+void VidalMPSt<ITensor>::maxm(int val);
+template
+void VidalMPSt<IQTensor>::maxm(int val);
+
+template <class Tensor>
+void VidalMPSt<Tensor>::
+cutoff(Real val)
+    {
+    Foreach(Spectrum& spec, spectrum_)
+        {
+        spec.cutoff(val);
+        }
+    }
+template
+void VidalMPSt<ITensor>::cutoff(Real val);
+template
+void VidalMPSt<IQTensor>::cutoff(Real val);
+
+template <class Tensor>
+Real VidalMPSt<Tensor>::
+applygate(const BondGate<Tensor>& G, const OptSet& opts)
+    {
+    const int b = G.i();
+    if(G.j() != b+1 || b < 1 || b >= N_)
+        {
+        Error("VidalMPS: gates must act on neighboring sites i,i+1");
+        }
+
+    Tensor th = B_.at(b) * B_.at(b+1) * G.gate();
+    th.noprime();
+
+    //Including Lambda_{b-1} makes the left basis orthonormal,
+    //so the SVD yields the new Schmidt values of bond b
+    const Tensor lth = (b == 1 ? th : lambda_.at(b-1) * th);
+
+    Tensor U,
+           V = B_.at(b+1);
+    SparseT D;
+    svd(lth,U,D,V,spectrum_.at(b),opts);
+
+    const Real nrm = D.norm();
+    D *= 1./nrm;
+
+    //B_b = th V^dagger avoids dividing by Lambda_{b-1}
+    B_.at(b) = th * conj(V);
+    B_.at(b) *= 1./nrm;
+    B_.at(b+1) = V;
+    lambda_.at(b) = D;
+
+    return nrm;
+    }
+template
+Real VidalMPSt<ITensor>::applygate(const BondGate<ITensor>& G, const OptSet& opts);
+template
+Real VidalMPSt<IQTensor>::applygate(const BondGate<IQTensor>& G, const OptSet& opts);
+
+template <class Tensor>
+MPSt<Tensor> VidalMPSt<Tensor>::
+toMPS() const
+    {
+    MPSt<Tensor> psi(model());
+    for(int j = 1; j <= N_; ++j)
+        {
+        psi.Anc(j) = B_.at(j);
+        }
+    for(int b = 1; b < N_; ++b)
+        {
+        psi.spectrum(b) = spectrum_.at(b);
+        }
+    psi.leftLim(0);
+    psi.rightLim(2);
+    psi.isOrtho(true);
+    return psi;
+    }
+template
+MPSt<ITensor> VidalMPSt<ITensor>::toMPS() const;
+template
+MPSt<IQTensor> VidalMPSt<IQTensor>::toMPS() const;
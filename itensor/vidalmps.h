@@ -0,0 +1,128 @@
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+#ifndef __ITENSOR_VIDALMPS_H
+#define __ITENSOR_VIDALMPS_H
+
+#include "mps.h"
+#include "bondgate.h"
+
+//
+// class VidalMPSt
+//
+// MPS in Vidal (Gamma-Lambda) form
+//
+//   psi = Gamma_1 Lambda_1 Gamma_2 Lambda_2 ... Lambda_{N-1} Gamma_N
+//
+// with Lambda_b the (normalized) Schmidt values of bond b.
+//
+// Internally the right-orthogonal tensors B_j = Gamma_j Lambda_j
+// are stored together with the Lambda_b, so that applying a gate
+// never divides by small singular values (Hastings' variant).
+//
+// Gates acting on different bonds only touch the tensors
+// of their own bond, so non-overlapping gates can be
+// applied concurrently.
+//
+//   VidalMPS for ITensors
+// IQVidalMPS for IQTensors
+//
+
+template <class Tensor>
+class VidalMPSt
+    {
+    public:
+
+    typedef typename Tensor::SparseT
+    SparseT;
+
+    VidalMPSt();
+
+    //Converts psi (normalizing it). Options such as Cutoff
+    //and Maxm set the truncation used for this and
+    //all later gate applications.
+    VidalMPSt(const MPSt<Tensor>& psi,
+              const OptSet& opts = Global::opts());
+
+    int
+    N() const { return N_; }
+
+    const Model&
+    model() const { return *model_; }
+
+    //Right-orthogonal site tensor B_j = Gamma_j Lambda_j
+    const Tensor&
+    B(int j) const { return B_.at(j); }
+
+    //Singular values of bond b (between sites b and b+1)
+    const SparseT&
+    Lambda(int b) const { return lambda_.at(b); }
+
+    //Gamma_j = B_j Lambda_j^{-1}, dropping singular
+    //values below cut
+    Tensor
+    Gamma(int j, Real cut = 1E-14) const;
+
+    //Truncation parameters and, after a gate has
+    //been applied, the spectrum of bond b
+    const Spectrum&
+    spectrum(int b) const { return spectrum_.at(b); }
+
+    int
+    maxm() const { return spectrum_.front().maxm(); }
+    void
+    maxm(int val);
+
+    Real
+    cutoff() const { return spectrum_.front().cutoff(); }
+    void
+    cutoff(Real val);
+
+    //Applies the gate G acting on sites G.i() and G.i()+1,
+    //truncating bond G.i(). Returns the norm of the state
+    //after the gate, which is then normalized.
+    //
+    //Safe to call concurrently for gates which
+    //do not share a site.
+    //
+    //Right-orthogonality of the B tensors is exact for unitary
+    //gates; imaginary-time gates with a small time step only
+    //spoil it slightly.
+    Real
+    applygate(const BondGate<Tensor>& G,
+              const OptSet& opts = Global::opts());
+
+    //Equivalent MPS, right-orthogonalized
+    //with orthogonality center at site 1
+    MPSt<Tensor>
+    toMPS() const;
+
+    private:
+
+    /////////////////
+    //
+    // Data Members
+    //
+
+    int N_;
+
+    const Model* model_;
+
+    //B_[0] and lambda_[0] unused
+    std::vector<Tensor> B_;
+    std::vector<SparseT> lambda_;
+    std::vector<Spectrum> spectrum_;
+
+    //
+    /////////////////
+
+    };
+
+typedef VidalMPSt<ITensor>
+VidalMPS;
+
+typedef VidalMPSt<IQTensor>
+IQVidalMPS;
+
+#endif
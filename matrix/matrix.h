@@ -150,6 +150,8 @@ public:
     void CopyPointer(const Vector &);	// Reference-count copy of pointer
     inline void CopyDestroy(Vector &);
     inline void MakeTemp();
+    inline void AdoptStorage(Real *, int);	// Use external storage,
+						// see StoreLink::adopt
 
     inline int Storage() const;
     inline int memory() const;		// return memory used in bytes 
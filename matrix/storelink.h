@@ -12,13 +12,21 @@ typedef double Real;
 // StoreLink utilizes reference counting. The ref classes never 
 // allocate storage. The actual storage classes utilize makestorage, 
 // etc. for allocation.
+//
+// Matrices may be made, copied and destroyed by several threads at 
+// once, so with ITENSOR_USE_THREADS defined the reference counts and 
+// the storage counters are updated atomically. The shared empty 
+// storage (nullrep) is not reference counted at all: it is never 
+// deleted, and counting it would make every thread constructing an 
+// empty Matrix or Vector write to the same counter.
 
 class StoreReport;
 
 // Actual StoreLink structure
 struct storerep
     {
-    int storage;			// Size of storage
+    int storage;			// Size of storage (negative if
+					// adopted, see StoreLink::adopt)
     int numref;				// Number of references 
     storerep() : storage(0), numref(1) {}
     };
@@ -39,6 +47,12 @@ public:
     inline void makestorage(int);	// Resize storage to int.
     inline void increasestorage(int);	// Increase size to int, no reduce.
     	
+// Refer to s Reals at store, owned elsewhere and never deleted.
+// The HeaderSize() bytes just before store must be writable;
+// they hold the reference count.
+    inline void adopt(Real * store, int s);
+    inline static int HeaderSize();	// Bytes used in front of storage.
+    	
     int defragment(int newsize);	// Tries to move storage to lower 
     					// place in heap. Returns 1 if
 					// successful, 0 otherwise.
@@ -51,6 +65,14 @@ public:
     inline ~StoreLink();
     inline static int NumObjects();
     inline static int TotalStorage();
+// Number of storage allocations and number of Reals
+// allocated since the program started (never decreased).
+    inline static long NumAllocated();
+    inline static long TotalAllocated();
+// Adds d to n and returns the new value, atomically if
+// ITENSOR_USE_THREADS is defined.
+    inline static int AtomicAdd(int & n, int d);
+    inline static long AtomicAdd(long & n, long d);
     friend class StoreReport;
 private:
     storerep *p;			// Only data member
@@ -67,6 +89,18 @@ private:
         static int numberofobjects_ = 0;		// Number of new's - no. of deletes
         return numberofobjects_;
         }
+    static long& 
+    numallocated()
+        {
+        static long numallocated_ = 0;		// Number of new's
+        return numallocated_;
+        }
+    static long& 
+    totalallocated()
+        {
+        static long totalallocated_ = 0;	// Reals allocated by all new's
+        return totalallocated_;
+        }
     static storerep& 
     nullrep()
         {
@@ -83,6 +117,7 @@ private:
     enum { offset = (sizeof(storerep)-1) / sizeof(Real) + 1 };
     inline void donew(int s);
     inline void dodelete();
+    inline void addref();
 // " =" is private, not allowed.  Put in to replace default shallow copy.
     inline StoreLink & operator = (const StoreLink &); 
     };
@@ -116,44 +151,52 @@ inline void StoreLink::donew(int s)
     if (s > 0)
 	{
 	p = (storerep *) new Real[s + offset];
-	p->numref = 1; p->storage = s; StoreLink::storageinuse() += s;
-    StoreLink::numberofobjects()++;
+	p->numref = 1; p->storage = s; AtomicAdd(StoreLink::storageinuse(),s);
+    AtomicAdd(StoreLink::numberofobjects(),1);
+    AtomicAdd(StoreLink::numallocated(),1L);
+    AtomicAdd(StoreLink::totalallocated(),long(s));
 	// cout << "Making storage address " << (long)(p) << endl;
 	}
     else  
-	{ p = StoreLink::pnullrep(); p->numref++; }
+	{ p = StoreLink::pnullrep(); }
     }
 
 inline void StoreLink::dodelete()
     { 
-    if(--p->numref == 0) 
+    if(p == StoreLink::pnullrep()) return;
+    if(AtomicAdd(p->numref,-1) == 0 && p->storage >= 0) 
 	{
 	// cout << "Deleting storage address " << (long)(p) << endl;
-    StoreLink::storageinuse() -= p->storage; StoreLink::numberofobjects()--;
+    AtomicAdd(StoreLink::storageinuse(),-p->storage); 
+    AtomicAdd(StoreLink::numberofobjects(),-1);
 	delete [] ((Real *) p);
 //	if(StoreLink::storageinuse() <= 0)
 //	    cout << "Storage in use is now " << StoreLink::storageinuse() << endl;
 	}
     }
 
+inline void StoreLink::addref()
+    { if(p != StoreLink::pnullrep()) AtomicAdd(p->numref,1); }
+
 inline StoreLink::StoreLink() : p(StoreLink::pnullrep())
-    { p->numref++; }
+    { }
 
 inline Real * StoreLink::Store() const
     { return ((Real *)p)+offset; }
 
 inline int StoreLink::NumRef() const { return p->numref; }
 
-inline int StoreLink::Storage() const { return p->storage; }
+inline int StoreLink::Storage() const 
+    { return p->storage < 0 ? -p->storage : p->storage; }
 
 inline StoreLink::~StoreLink() { dodelete(); }
 
 inline StoreLink::StoreLink(const StoreLink & S) : p(S.p)
-    { p->numref++; }
+    { addref(); }
 
 inline StoreLink & StoreLink::operator<<(const StoreLink & S)		
     { 			
-    if(this != &S) { dodelete(); p = S.p; p->numref++; }
+    if(this != &S) { dodelete(); p = S.p; addref(); }
     return *this; 
     }
 
@@ -162,14 +205,24 @@ inline StoreLink::StoreLink(int s)
 
 inline void StoreLink::makestorage(int s)	// Negative s treated as 0
     {
-    if(p->storage != s) { dodelete(); donew(s); }
+    if(Storage() != s) { dodelete(); donew(s); }
     }
 
 inline void StoreLink::increasestorage(int s)
     {
-    if(p->storage < s) { dodelete(); donew(s); }
+    if(Storage() < s) { dodelete(); donew(s); }
     }
 
+inline void StoreLink::adopt(Real * store, int s)
+    {
+    dodelete();
+    p = (storerep *) (store - offset);
+    p->numref = 1; p->storage = -s;
+    }
+
+inline int StoreLink::HeaderSize()
+    { return offset*sizeof(Real); }
+
 inline int StoreLink::memory() const
     { return sizeof(Real)*(Storage()+offset); }
 
@@ -177,6 +230,28 @@ inline int StoreLink::TotalStorage() { return StoreLink::storageinuse(); }
 
 inline int StoreLink::NumObjects() { return StoreLink::numberofobjects(); }
 
+inline long StoreLink::NumAllocated() { return StoreLink::numallocated(); }
+
+inline long StoreLink::TotalAllocated() { return StoreLink::totalallocated(); }
+
+inline int StoreLink::AtomicAdd(int & n, int d)
+    {
+#ifdef ITENSOR_USE_THREADS
+    return __sync_add_and_fetch(&n,d);
+#else
+    return (n += d);
+#endif
+    }
+
+inline long StoreLink::AtomicAdd(long & n, long d)
+    {
+#ifdef ITENSOR_USE_THREADS
+    return __sync_add_and_fetch(&n,d);
+#else
+    return (n += d);
+#endif
+    }
+
 inline StoreLink & StoreLink::operator = (const StoreLink & other)
     { return *this << other; } 		// private member function!
 
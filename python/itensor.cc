@@ -1,221 +1,777 @@
-#define THIS_IS_MAIN
-#include "algorithm.h"
-#include "hams.h"
+//
+// Distributed under the ITensor Library License, Version 1.0.
+//    (See accompanying LICENSE file.)
+//
+//Boost.Python first, since input.h defines the macro SP
 #include <boost/python.hpp>
+#include "core.h"
+#include "model/spinhalf.h"
+#include "model/spinone.h"
+#include "hams/Heisenberg.h"
+#include <cstring>
 using namespace boost::python;
+using std::string;
+using std::vector;
+
+//
+// Python bindings
+//
+// Tensor data is shared with Python through the buffer
+// protocol: numpy.asarray(T) or memoryview(T) is a view of
+// the elements of the ITensor T, without copying, having
+// one axis per index in the order of T.indices(). The
+// first index varies fastest (the view is in Fortran order).
+// For an IQTensor, T.blocks() gives one such view per block.
+//
+// A writable view gives the tensor its own copy of the data
+// if it was shared with other tensors; a read-only view
+// (e.g. memoryview) never copies unless the tensor has a
+// scale factor to absorb. Views are valid until the tensor
+// is next changed by an ITensor operation.
+//
+// ITensor(indices,array) and IQTensor(iqindices,blocks) build
+// tensors from arrays with a single copy of the elements
+// (a memcpy if the array is in Fortran order). The array
+// memory itself can't be adopted since tensor storage keeps
+// its reference count just in front of the data.
+//
+
+//
+// Errors are reported as RuntimeError
+//
+
+void
+translateITError(const ITError& e)
+    {
+    PyErr_SetString(PyExc_RuntimeError,e.what());
+    }
+
+//Releases the GIL while long calculations run
+class ReleaseGIL
+    {
+    public:
+    ReleaseGIL() : state_(PyEval_SaveThread()) { }
+    ~ReleaseGIL() { PyEval_RestoreThread(state_); }
+    private:
+    PyThreadState* state_;
+    };
+
+//
+// Options are passed as a dict such as
+// {"Quiet" : True, "Cutoff" : 1E-10}
+//
+OptSet
+toOptSet(const dict& d)
+    {
+    OptSet opts;
+    const list keys = d.keys();
+    for(int k = 0; k < len(keys); ++k)
+        {
+        const string name = extract<string>(keys[k]);
+        PyObject* v = object(d[keys[k]]).ptr();
+        if(PyBool_Check(v))
+            {
+            opts.add(Opt(name,bool(v == Py_True)));
+            }
+        else
+        if(PyLong_Check(v))
+            {
+            //Usable as an int or a Real option
+            const int i = PyLong_AsLong(v);
+            opts.add(Opt(name,false,"",i,Real(i)));
+            }
+        else
+        if(PyFloat_Check(v))
+            {
+            opts.add(Opt(name,Real(PyFloat_AsDouble(v))));
+            }
+        else
+        if(PyUnicode_Check(v))
+            {
+            opts.add(Opt(name,string(extract<string>(v))));
+            }
+        else
+            {
+            throw ITError("Option " + name + " must be a bool, int, float or str");
+            }
+        }
+    return opts;
+    }
+
+//
+// Buffer protocol
+//
+
+//Shape and strides (in bytes) of an exported buffer,
+//freed when the buffer is released
+struct BufferLayout
+    {
+    vector<Py_ssize_t> shape,
+                       strides;
+    //Copy of an exported ITensor, sharing (and so keeping
+    //alive) its storage for as long as the buffer exists.
+    //Changing the ITensor in place afterwards makes it
+    //copy its elements first (see ITensor::solo), leaving
+    //the buffer on the old ones.
+    ITensor pin;
+    };
+
+static bool
+isContiguous(const vector<long>& shape, const vector<long>& strides, bool fortran)
+    {
+    const int ndim = shape.size();
+    long expect = 1;
+    for(int n = 0; n < ndim; ++n)
+        {
+        const int k = (fortran ? n : ndim-1-n);
+        if(shape[k] > 1 && strides[k] != expect) return false;
+        expect *= shape[k];
+        }
+    return true;
+    }
+
+//
+// Fills in view for the Reals at data having the
+// given shape and strides (counted in Reals)
+//
+static int
+exportBuffer(PyObject* obj, Py_buffer* view, int flags,
+             Real* data, bool readonly,
+             const vector<long>& shape, const vector<long>& strides,
+             const ITensor& pin = ITensor())
+    {
+    view->obj = NULL;
+    const bool ccontig = isContiguous(shape,strides,false),
+               fcontig = isContiguous(shape,strides,true);
+    const char* err = 0;
+    if((flags & PyBUF_WRITABLE) && readonly)
+        err = "buffer is read-only";
+    else
+    if((flags & PyBUF_STRIDES) != PyBUF_STRIDES && !ccontig)
+        err = "buffer is in Fortran order, strides are needed";
+    else
+    if((flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS && !ccontig)
+        err = "buffer is not C contiguous";
+    else
+    if((flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS && !fcontig)
+        err = "buffer is not Fortran contiguous";
+    else
+    if((flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS && !ccontig && !fcontig)
+        err = "buffer is not contiguous";
+    if(err)
+        {
+        PyErr_SetString(PyExc_BufferError,err);
+        return -1;
+        }
+
+    BufferLayout* lay = new BufferLayout;
+    lay->pin = pin;
+    Py_ssize_t len = 1;
+    for(size_t k = 0; k < shape.size(); ++k)
+        {
+        lay->shape.push_back(shape[k]);
+        lay->strides.push_back(strides[k]*sizeof(Real));
+        len *= shape[k];
+        }
+
+    view->buf = data;
+    view->obj = obj;
+    Py_INCREF(obj);
+    view->len = len*sizeof(Real);
+    view->itemsize = sizeof(Real);
+    view->readonly = readonly;
+    view->format = ((flags & PyBUF_FORMAT) ? (char*) "d" : NULL);
+    view->ndim = shape.size();
+    const bool nd = ((flags & PyBUF_ND) == PyBUF_ND) && !shape.empty();
+    view->shape = (nd ? &lay->shape.front() : NULL);
+    view->strides = (nd && (flags & PyBUF_STRIDES) == PyBUF_STRIDES
+                     ? &lay->strides.front() : NULL);
+    view->suboffsets = NULL;
+    view->internal = lay;
+    return 0;
+    }
+
+static void
+releaseBuffer(PyObject* obj, Py_buffer* view)
+    {
+    delete (BufferLayout*) view->internal;
+    }
+
+//Exports the elements of T, which are in the order of
+//T.indices() with the first index varying fastest.
+//The buffer keeps these elements alive, but T stops
+//sharing them once it is changed in place (so for
+//instance a writable view of T is only a view of T
+//until the next T *= S or T.set).
+static int
+exportTensor(PyObject* obj, Py_buffer* view, int flags, ITensor& T)
+    {
+    if(T.isNull()) throw ITError("ITensor is null");
+    if(T.isComplex()) throw ITError("Views of complex ITensors not supported");
+    Real* data = 0;
+    const bool readonly = !(flags & PyBUF_WRITABLE);
+    if(readonly)
+        {
+        T.scaleTo(1);
+        data = const_cast<Real*>(T.datStart());
+        }
+    else
+        {
+        data = T.ncdatStart();
+        }
+    vector<long> shape, strides;
+    long str = 1;
+    Foreach(const Index& I, T.indices())
+        {
+        shape.push_back(I.m());
+        strides.push_back(str);
+        str *= I.m();
+        }
+    return exportBuffer(obj,view,flags,data,readonly,shape,strides,T);
+    }
+
+//Wraps getbuffer functions, turning ITErrors into BufferErrors
+template <int (*F)(PyObject*, Py_buffer*, int)>
+int
+getBuffer(PyObject* obj, Py_buffer* view, int flags)
+    {
+    try
+        {
+        return F(obj,view,flags);
+        }
+    catch(const ITError& e)
+        {
+        view->obj = NULL;
+        PyErr_SetString(PyExc_BufferError,e.what());
+        }
+    catch(const error_already_set&)
+        {
+        view->obj = NULL;
+        }
+    return -1;
+    }
+
+static int
+ITensor_buffer(PyObject* obj, Py_buffer* view, int flags)
+    {
+    ITensor& T = extract<ITensor&>(obj);
+    return exportTensor(obj,view,flags,T);
+    }
+
+static int
+Matrix_buffer(PyObject* obj, Py_buffer* view, int flags)
+    {
+    Matrix& M = extract<Matrix&>(obj);
+    vector<long> shape(2), strides(2);
+    shape[0] = M.Nrows();
+    shape[1] = M.Ncols();
+    strides[0] = M.RowStride();
+    strides[1] = 1;
+    return exportBuffer(obj,view,flags,M.Store(),false,shape,strides);
+    }
+
+static int
+Vector_buffer(PyObject* obj, Py_buffer* view, int flags)
+    {
+    Vector& V = extract<Vector&>(obj);
+    vector<long> shape(1,V.Length()),
+                 strides(1,V.Stride());
+    return exportBuffer(obj,view,flags,V.Store(),false,shape,strides);
+    }
+
+//
+// Adds the buffer protocol to the Python class cls,
+// with F filling in the buffer
+//
+template <int (*F)(PyObject*, Py_buffer*, int)>
+void
+addBufferProcs(const object& cls)
+    {
+    static PyBufferProcs procs = { &getBuffer<F>, &releaseBuffer };
+    ((PyTypeObject*) cls.ptr())->tp_as_buffer = &procs;
+    }
+
+//
+// Copies the elements of the buffer-supporting arr
+// (of shape inds[0].m() x inds[1].m() x ...) into T
+//
+static void
+copyFromArray(ITensor& T, const vector<Index>& inds, object arr)
+    {
+    Py_buffer b;
+    if(PyObject_GetBuffer(arr.ptr(),&b,PyBUF_FULL_RO) != 0)
+        throw_error_already_set();
+    const string fmt = (b.format ? b.format : "B");
+    const int ndim = b.ndim;
+    string err;
+    if(fmt != "d" && fmt != "@d" && fmt != "=d" && fmt != "<d")
+        err = "array must have dtype float64, not format " + fmt;
+    else
+    if(ndim != int(inds.size()))
+        err = "number of array dimensions doesn't match number of indices";
+    for(int k = 0; err.empty() && k < ndim; ++k)
+        {
+        if(b.shape[k] != inds[k].m())
+            err = "array shape doesn't match index " + inds[k].name();
+        }
+    if(!err.empty())
+        {
+        PyBuffer_Release(&b);
+        throw ITError(err);
+        }
+
+    //Stride within T of each array axis
+    const IndexSet<Index>& is = T.indices();
+    vector<long> tstride(ndim,0);
+    for(int k = 0; k < ndim; ++k)
+        {
+        long str = 1;
+        for(int j = 1; j <= is.r(); ++j)
+            {
+            if(is.index(j) == inds[k]) tstride[k] = str;
+            str *= is.index(j).m();
+            }
+        }
+
+    Real* p = T.ncdatStart();
+    const long size = b.len/b.itemsize;
+    vector<long> fstride(ndim);
+    long str = 1;
+    for(int k = 0; k < ndim; ++k)
+        {
+        fstride[k] = str;
+        str *= inds[k].m();
+        }
+    if(tstride == fstride && PyBuffer_IsContiguous(&b,'F'))
+        {
+        std::memcpy(p,b.buf,b.len);
+        }
+    else
+        {
+        //Loop over the array elements in Fortran
+        //order, with byte offset src in b
+        vector<long> n(ndim,0);
+        const char* src0 = (const char*) b.buf;
+        for(long e = 0; e < size; ++e)
+            {
+            long src = 0, dst = 0;
+            for(int k = 0; k < ndim; ++k)
+                {
+                src += n[k]*b.strides[k];
+                dst += n[k]*tstride[k];
+                }
+            p[dst] = *((const Real*) (src0+src));
+            for(int k = 0; k < ndim; ++k)
+                {
+                if(++n[k] < b.shape[k]) break;
+                n[k] = 0;
+                }
+            }
+        }
+    PyBuffer_Release(&b);
+    }
+
+template <class T>
+vector<T>
+toVector(const list& l)
+    {
+    vector<T> res;
+    for(int k = 0; k < len(l); ++k)
+        res.push_back(extract<T>(l[k]));
+    return res;
+    }
+
+//
+// Index and IQIndex
+//
 
-//Wrappers:
 IndexVal Index_call(const Index& self, int i) { return self(i); }
 
-void Matrix_set(Matrix& self, int i, int j, Real val) { self(i,j) = val; }
-
-void ITensor_set1(ITensor& self, 
-                  const IndexVal& iv1, 
-                  Real val) 
+Index IQIndex_index(const IQIndex& self, int i) { return self.index(i); }
+
+//
+// ITensor
+//
+
+boost::shared_ptr<ITensor>
+ITensor_fromArray(const list& inds, object arr)
+    {
+    const vector<Index> iv = toVector<Index>(inds);
+    if(iv.empty() || int(iv.size()) > NMAX)
+        throw ITError("ITensor must have between 1 and 8 indices");
+    boost::shared_ptr<ITensor> T = boost::make_shared<ITensor>(IndexSet<Index>(iv));
+    copyFromArray(*T,iv,arr);
+    return T;
+    }
+
+list
+ITensor_indices(const ITensor& self)
+    {
+    list res;
+    Foreach(const Index& I, self.indices()) res.append(I);
+    return res;
+    }
+
+tuple
+ITensor_shape(const ITensor& self)
+    {
+    list res;
+    Foreach(const Index& I, self.indices()) res.append(I.m());
+    return tuple(res);
+    }
+
+void ITensor_set1(ITensor& self,
+                  const IndexVal& iv1,
+                  Real val)
                   { self(iv1) = val; }
 
-void ITensor_set2(ITensor& self, 
-                  const IndexVal& iv1, 
-                  const IndexVal& iv2, 
-                  Real val) 
+void ITensor_set2(ITensor& self,
+                  const IndexVal& iv1,
+                  const IndexVal& iv2,
+                  Real val)
                   { self(iv1,iv2) = val; }
 
-void ITensor_set3(ITensor& self, 
-                  const IndexVal& iv1, 
-                  const IndexVal& iv2, 
-                  const IndexVal& iv3, 
-                  Real val) 
+void ITensor_set3(ITensor& self,
+                  const IndexVal& iv1,
+                  const IndexVal& iv2,
+                  const IndexVal& iv3,
+                  Real val)
                   { self(iv1,iv2,iv3) = val; }
 
-void ITensor_set4(ITensor& self, 
-                  const IndexVal& iv1, 
-                  const IndexVal& iv2, 
-                  const IndexVal& iv3, 
-                  const IndexVal& iv4, 
-                  Real val) 
+void ITensor_set4(ITensor& self,
+                  const IndexVal& iv1,
+                  const IndexVal& iv2,
+                  const IndexVal& iv3,
+                  const IndexVal& iv4,
+                  Real val)
                   { self(iv1,iv2,iv3,iv4) = val; }
 
-void ITensor_set5(ITensor& self, 
-                  const IndexVal& iv1, 
-                  const IndexVal& iv2, 
-                  const IndexVal& iv3, 
-                  const IndexVal& iv4, 
-                  const IndexVal& iv5, 
-                  Real val) 
-                  { self(iv1,iv2,iv3,iv4,iv5) = val; }
-
-void ITensor_set6(ITensor& self, 
-                  const IndexVal& iv1, 
-                  const IndexVal& iv2, 
-                  const IndexVal& iv3, 
-                  const IndexVal& iv4, 
-                  const IndexVal& iv5, 
-                  const IndexVal& iv6, 
-                  Real val) 
-                  { self(iv1,iv2,iv3,iv4,iv5,iv6) = val; }
-
-void ITensor_set7(ITensor& self, 
-                  const IndexVal& iv1, 
-                  const IndexVal& iv2, 
-                  const IndexVal& iv3, 
-                  const IndexVal& iv4, 
-                  const IndexVal& iv5, 
-                  const IndexVal& iv6, 
-                  const IndexVal& iv7, 
-                  Real val) 
-                  { self(iv1,iv2,iv3,iv4,iv5,iv6,iv7) = val; }
-
-void ITensor_set8(ITensor& self, 
-                  const IndexVal& iv1, 
-                  const IndexVal& iv2, 
-                  const IndexVal& iv3, 
-                  const IndexVal& iv4, 
-                  const IndexVal& iv5, 
-                  const IndexVal& iv6, 
-                  const IndexVal& iv7, 
-                  const IndexVal& iv8, 
-                  Real val) 
-                  { self(iv1,iv2,iv3,iv4,iv5,iv6,iv7,iv8) = val; }
-
-void InitState_set(InitState& self, int j, const IQIndexVal& iv) { self(j) = iv; }
-
-class SpinOneModel
-{
-    SpinOne::Model model_;
-public:
-    const SpinOne::Model& model() const { return model_; }
-
-    SpinOneModel(int N) : model_(N) { }
-
-    int NN() const { return model_.NN(); }
-
-    IQIndexVal Up(int j) const { return model_.Up(j); }
-    IQIndexVal Z0(int j) const { return model_.Z0(j); }
-    IQIndexVal Dn(int j) const { return model_.Dn(j); }
-
-    ITensor id(int j) const { return model_.id(j); }
-};
-
-class MPSWrapper
-{
-    const BaseModel& model;
-public:
-    MPS mps;
-
-    MPSWrapper(const SpinOneModel& s1m) : model(s1m.model()),mps(model) { }
-    MPSWrapper(const SpinOneModel& s1m, const InitState& initState) : model(s1m.model()),mps(model,initState) { }
-
-    int NN() const { return model.NN(); }
-    ITensor A(int j) const { return mps.AA(j); }
-
-    void position(int i) { mps.position(i); }
-
-    ITensor projectOp(int j, Direction dir, const ITensor& P, const ITensor& Op)
-    { ITensor res; mps.projectOp(j,dir,P,Op,res); return res; }
-
-    Real bondDavidson(int b, const ITensor& mpoh, const ITensor& LH, const ITensor& RH, int niter, int debuglevel, Direction dir)
-    { mps.bondDavidson(b,mpoh,LH,RH,niter,debuglevel,dir); }
-
-    friend inline ostream& operator<<(ostream& s, const MPSWrapper& M) { s << M.mps; return s; }
-};
-
-class MPOWrapper
-{
-    const BaseModel& model;
-public:
-    MPO mpo;
-
-    MPOWrapper(const MPO& mpo_) : model(mpo_.model()),mpo(mpo_) { }
-    MPOWrapper(const SpinOneModel& s1m) : model(s1m.model()),mpo(model) { }
+Real ITensor_get1(const ITensor& self, const IndexVal& iv1)
+    { return self(iv1); }
+Real ITensor_get2(const ITensor& self, const IndexVal& iv1, const IndexVal& iv2)
+    { return self(iv1,iv2); }
+Real ITensor_get3(const ITensor& self, const IndexVal& iv1, const IndexVal& iv2,
+                  const IndexVal& iv3)
+    { return self(iv1,iv2,iv3); }
+Real ITensor_get4(const ITensor& self, const IndexVal& iv1, const IndexVal& iv2,
+                  const IndexVal& iv3, const IndexVal& iv4)
+    { return self(iv1,iv2,iv3,iv4); }
+
+//
+// IQTensor
+//
+
+//
+// A block of an IQTensor as seen from Python:
+// supports the buffer protocol, giving a view of
+// the block's elements within the IQTensor
+//
+class IQTensorBlock
+    {
+    public:
+
+    IQTensorBlock(const object& T, int n) : T_(T), n_(n) { }
+
+    ITensor&
+    block() const
+        {
+        IQTensor& T = extract<IQTensor&>(T_);
+        if(n_ >= T.iten_size()) throw ITError("IQTensor block no longer exists");
+        IQTDat<ITensor>::iterator it = T.ncblocks().begin();
+        std::advance(it,n_);
+        return *it;
+        }
+
+    list
+    indices() const { return ITensor_indices(block()); }
+
+    tuple
+    shape() const { return ITensor_shape(block()); }
+
+    ITensor
+    toITensor() const { return block(); }
+
+    private:
+
+    //The Python IQTensor, kept alive by the block
+    object T_;
+    int n_;
+    };
+
+static int
+IQTensorBlock_buffer(PyObject* obj, Py_buffer* view, int flags)
+    {
+    const IQTensorBlock& B = extract<const IQTensorBlock&>(obj);
+    return exportTensor(obj,view,flags,B.block());
+    }
+
+boost::shared_ptr<IQTensor>
+IQTensor_fromBlocks(const list& iqinds, const list& blocks)
+    {
+    vector<IQIndex> iv = toVector<IQIndex>(iqinds);
+    if(iv.empty() || int(iv.size()) > NMAX)
+        throw ITError("IQTensor must have between 1 and 8 indices");
+    boost::shared_ptr<IQTensor> T = boost::make_shared<IQTensor>(iv);
+    for(int k = 0; k < len(blocks); ++k)
+        {
+        const ITensor& t = extract<const ITensor&>(blocks[k]);
+        *T += t;
+        }
+    return T;
+    }
+
+list
+IQTensor_indices(const IQTensor& self)
+    {
+    list res;
+    Foreach(const IQIndex& I, self.indices()) res.append(I);
+    return res;
+    }
+
+list
+IQTensor_blocks(object self)
+    {
+    const IQTensor& T = extract<const IQTensor&>(self);
+    list res;
+    for(int n = 0; n < T.iten_size(); ++n)
+        res.append(IQTensorBlock(self,n));
+    return res;
+    }
+
+//
+// Models and MPS
+//
+
+void InitState_set(InitState& self, int j, const string& state) { self.set(j,state); }
+
+template <class Tensor>
+Tensor MPS_A(const MPSt<Tensor>& self, int j) { return self.A(j); }
+
+template <class Tensor>
+Tensor MPO_A(const MPOt<Tensor>& self, int j) { return self.A(j); }
+
+template <class Tensor>
+void MPS_position(MPSt<Tensor>& self, int j) { self.position(j); }
+
+template <class Tensor>
+Vector MPS_eigs(const MPSt<Tensor>& self, int b) { return self.spectrum(b).eigsKept(); }
+
+template <class Tensor>
+Real MPS_truncerr(const MPSt<Tensor>& self, int b) { return self.spectrum(b).truncerr(); }
+
+IQMPO
+Heisenberg_wrapper(const Model& model, const dict& opts)
+    {
+    return Heisenberg(model,toOptSet(opts));
+    }
+
+MPO IQMPO_toMPO(const IQMPO& self) { return self.toMPO(); }
+
+//
+// DMRG and measurements
+//
+
+template <class Tensor>
+Real
+dmrg_wrapper(MPSt<Tensor>& psi, const MPOt<Tensor>& H,
+             const Sweeps& sweeps, const dict& opts)
+    {
+    const OptSet o = toOptSet(opts);
+    ReleaseGIL nogil;
+    return dmrg(psi,H,sweeps,o);
+    }
+
+template <class Tensor>
+Real
+psiphi_wrapper(const MPSt<Tensor>& psi, const MPSt<Tensor>& phi)
+    {
+    return psiphi(psi,phi);
+    }
+
+template <class Tensor>
+Real
+psiHphi_wrapper(const MPSt<Tensor>& psi, const MPOt<Tensor>& H, const MPSt<Tensor>& phi)
+    {
+    return psiHphi(psi,H,phi);
+    }
+
+template <class Tensor>
+Matrix
+correlationMatrix_wrapper(const MPSt<Tensor>& psi, const string& op1,
+                          const string& op2, const dict& opts)
+    {
+    const OptSet o = toOptSet(opts);
+    ReleaseGIL nogil;
+    return correlationMatrix(psi,op1,op2,o);
+    }
+
+template <class Tensor>
+EntanglementProfile
+entanglementProfile_wrapper(const MPSt<Tensor>& psi, const dict& opts)
+    {
+    const OptSet o = toOptSet(opts);
+    ReleaseGIL nogil;
+    return entanglementProfile(psi,o);
+    }
+
+//
+// Classes and functions for MPS and IQMPS
+// (Tensor = ITensor or IQTensor)
+//
+template <class Tensor>
+void
+exportMPS(const char* mpsname, const char* mponame)
+    {
+    typedef MPSt<Tensor> MPST;
+    typedef MPOt<Tensor> MPOT;
+
+    class_<MPST>(mpsname, init<const Model&>()[with_custodian_and_ward<1,2>()])
+    .def(init<const InitState&>()[with_custodian_and_ward<1,2>()])
+    .def("N",&MPST::N)
+    .def("A",&MPS_A<Tensor>)
+    .def("position",&MPS_position<Tensor>)
+    .def("norm",&MPST::norm)
+    .def("eigs",&MPS_eigs<Tensor>)
+    .def("truncerr",&MPS_truncerr<Tensor>)
+    .def("__len__",&MPST::N)
+    .def(self_ns::str(self))
+    ;
 
-    int NN() const { return model.NN(); }
-    ITensor A(int j) const { return mpo.AA(j); }
+    class_<MPOT>(mponame, init<const Model&>()[with_custodian_and_ward<1,2>()])
+    .def("N",&MPOT::N)
+    .def("A",&MPO_A<Tensor>)
+    .def("__len__",&MPOT::N)
+    ;
 
-    friend inline ostream& operator<<(ostream& s, const MPOWrapper& M) { s << M.mpo; return s; }
-};
+    def("dmrg",&dmrg_wrapper<Tensor>,
+        (arg("psi"),arg("H"),arg("sweeps"),arg("opts")=dict()));
+    def("psiphi",&psiphi_wrapper<Tensor>);
+    def("psiHphi",&psiHphi_wrapper<Tensor>);
+    def("correlationMatrix",&correlationMatrix_wrapper<Tensor>,
+        (arg("psi"),arg("op1"),arg("op2"),arg("opts")=dict()));
+    def("entanglementProfile",&entanglementProfile_wrapper<Tensor>,
+        (arg("psi"),arg("opts")=dict()));
+    }
 
-MPOWrapper SpinOneHeisenberg(const SpinOneModel& s1m) { MPO H = SpinOne::Heisenberg(s1m.model())(); MPOWrapper res(H); return res; }
 
-Real dmrg_wrapper(int nsweep, MPSWrapper& psi, const MPOWrapper& H)
+BOOST_PYTHON_MODULE(itensor)
 {
-    Sweeps sweeps(ramp_m,nsweep,1,100,1E-5);
-    return dmrg(psi.mps,H.mpo,sweeps);
-}
+    register_exception_translator<ITError>(&translateITError);
 
+    object matrix = class_<Matrix>("Matrix", init<int,int>())
+    .def("Nrows",&Matrix::Nrows)
+    .def("Ncols",&Matrix::Ncols)
+    .def(self_ns::str(self))
+    ;
+    addBufferProcs<Matrix_buffer>(matrix);
 
-BOOST_PYTHON_MODULE(itensor)
-{
-    class_<Matrix>("MatrixBase", init<int,int>())
-    .def("set",&Matrix_set)
+    object vec = class_<Vector>("Vector", init<int>())
+    .def("__len__",&Vector::Length)
     .def(self_ns::str(self))
     ;
+    addBufferProcs<Vector_buffer>(vec);
 
     class_<Index>("Index", init<string,int>())
     .add_property("m", &Index::m)
     .add_property("name", &Index::name)
-    .add_property("is_null", &Index::is_null)
+    .add_property("isNull", &Index::isNull)
     .def("__call__",&Index_call)
+    .def(self == self)
+    .def(self != self)
     .def(self_ns::str(self))
     ;
 
     class_<IndexVal>("IndexVal", init<Index,int>())
-    .def_readonly("ind",&IndexVal::ind)
     .def_readonly("i",&IndexVal::i)
     .def(self_ns::str(self))
     ;
 
-    class_<ITensor>("ITensor")
+    class_<IQIndex, bases<Index> >("IQIndex", no_init)
+    .def("nindex",&IQIndex::nindex)
+    .def("index",&IQIndex_index)
+    .def(self_ns::str(self))
+    ;
+
+    class_<IQIndexVal>("IQIndexVal", init<IQIndex,int>())
+    .def(self_ns::str(self))
+    ;
+
+    object itensor = class_<ITensor>("ITensor")
+    .def("__init__",make_constructor(&ITensor_fromArray))
     .def(init<Index>())
     .def(init<Index,Index>())
-    .def(init<Index,Index,Matrix>())
     .def(init<Index,Index,Index>())
     .def(init<Index,Index,Index,Index>())
     .def("set",&ITensor_set1).def("set",&ITensor_set2)
     .def("set",&ITensor_set3).def("set",&ITensor_set4)
-    .def("set",&ITensor_set5).def("set",&ITensor_set6)
-    .def("set",&ITensor_set7).def("set",&ITensor_set8)
-    .def("__len__",&ITensor::vec_size)
+    .def("get",&ITensor_get1).def("get",&ITensor_get2)
+    .def("get",&ITensor_get3).def("get",&ITensor_get4)
+    .def("indices",&ITensor_indices)
+    .add_property("shape",&ITensor_shape)
+    .add_property("r",&ITensor::r)
     .def("norm",&ITensor::norm)
     .def(self_ns::str(self))
     .def(self * self)
     .def(self *= self)
+    .def(self * Real())
     ;
+    addBufferProcs<ITensor_buffer>(itensor);
 
-    enum_<Direction>("Direction")
-    .value("Fromleft",Fromleft)
-    .value("Fromright",Fromright)
+    object block = class_<IQTensorBlock>("IQTensorBlock", no_init)
+    .def("indices",&IQTensorBlock::indices)
+    .add_property("shape",&IQTensorBlock::shape)
+    .def("toITensor",&IQTensorBlock::toITensor)
     ;
-
-    class_<IQIndexVal>("IQIndexVal", init<IQIndex,int>())
+    addBufferProcs<IQTensorBlock_buffer>(block);
+
+    class_<IQTensor>("IQTensor")
+    .def("__init__",make_constructor(&IQTensor_fromBlocks))
+    .def("indices",&IQTensor_indices)
+    .def("blocks",&IQTensor_blocks)
+    .def("toITensor",&IQTensor::toITensor)
+    .add_property("r",&IQTensor::r)
+    .def("norm",&IQTensor::norm)
     .def(self_ns::str(self))
+    .def(self * self)
+    .def(self *= self)
+    .def(self * Real())
+    ;
+
+    class_<Model, boost::noncopyable>("Model", no_init)
+    .def("N",&Model::N)
     ;
 
-    class_<SpinOneModel>("SpinOneModel",init<int>())
-    .def("Up",&SpinOneModel::Up)
-    .def("Z0",&SpinOneModel::Z0)
-    .def("Dn",&SpinOneModel::Dn)
+    class_<SpinHalf, bases<Model> >("SpinHalf",init<int>())
     ;
 
-    class_<InitState>("InitState",init<int>())
+    class_<SpinOne, bases<Model> >("SpinOne",init<int>())
+    ;
+
+    class_<InitState>("InitState",init<const Model&>()[with_custodian_and_ward<1,2>()])
     .def("set",&InitState_set)
     ;
 
-    class_<MPSWrapper>("MPS",init<SpinOneModel>())
-    .def(init<SpinOneModel,InitState>())
-    .def("A",&MPSWrapper::A)
-    .def("position",&MPSWrapper::position)
-    .def("projectOp",&MPSWrapper::projectOp)
-    .def("bondDavidson",&MPSWrapper::bondDavidson)
-    .def("__len__",&MPSWrapper::NN)
-    .def(self_ns::str(self))
+    class_<Sweeps>("Sweeps",init<int>())
+    .def("nsweep",(int (Sweeps::*)() const) &Sweeps::nsweep)
+    .def("setmaxm",&Sweeps::setmaxm)
+    .def("setminm",&Sweeps::setminm)
+    .def("setcutoff",&Sweeps::setcutoff)
+    .def("setnoise",(void (Sweeps::*)(int,Real)) &Sweeps::setnoise)
+    .def("setniter",(void (Sweeps::*)(int,int)) &Sweeps::setniter)
     ;
 
-    class_<MPOWrapper>("MPO",init<SpinOneModel>())
-    .def("A",&MPOWrapper::A)
-    .def("__len__",&MPOWrapper::NN)
-    .def(self_ns::str(self))
+    class_<EntanglementProfile>("EntanglementProfile",no_init)
+    .def("N",&EntanglementProfile::N)
+    .def("eigs",(const Vector& (EntanglementProfile::*)(int) const) &EntanglementProfile::eigs,return_value_policy<copy_const_reference>())
+    .def("vonNeumann",&EntanglementProfile::vonNeumann)
+    .def("renyi",&EntanglementProfile::renyi)
     ;
 
-    def("SpinOneHeisenberg",&SpinOneHeisenberg);
-    def("dmrg",&dmrg_wrapper);
+    exportMPS<ITensor>("MPS","MPO");
+    exportMPS<IQTensor>("IQMPS","IQMPO");
+
+    def("Heisenberg",&Heisenberg_wrapper,
+        (arg("model"),arg("opts")=dict()),
+        with_custodian_and_ward_postcall<0,1>());
+    def("toMPO",&IQMPO_toMPO,with_custodian_and_ward_postcall<0,1>());
 }
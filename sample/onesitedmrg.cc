@@ -0,0 +1,94 @@
+#include "core.h"
+#include "model/spinone.h"
+#include "model/hubbard.h"
+#include "hams/Heisenberg.h"
+#include "hams/ExtendedHubbard.h"
+using boost::format;
+using namespace std;
+
+//
+// Compares two-site DMRG with single-site DMRG
+// (NumCenter(1)), which uses subspace expansion
+// to grow the bond dimension, on an S=1 Heisenberg
+// chain and on a half-filled Hubbard chain.
+//
+
+struct Result
+    {
+    Real energy,
+         time;
+    int maxm;
+    };
+
+template <class Model>
+Result
+runDMRG(const Model& model, const IQMPO& H, const InitState& init,
+        const Sweeps& sweeps, const OptSet& opts)
+    {
+    IQMPS psi(init);
+    const Real t0 = mywalltime();
+    Result r;
+    r.energy = dmrg(psi,H,sweeps,opts);
+    r.time = mywalltime()-t0;
+    r.maxm = 1;
+    for(int b = 1; b < psi.N(); ++b)
+        r.maxm = max(r.maxm,psi.LinkInd(b).m());
+    return r;
+    }
+
+template <class Model>
+void
+compare(const string& name, const Model& model, const IQMPO& H,
+        const InitState& init, int maxm)
+    {
+    const int nsweep = 8;
+
+    Sweeps sweeps(nsweep);
+    sweeps.maxm() = 20,50,100,maxm;
+    sweeps.cutoff() = 1E-10;
+    sweeps.niter() = 2;
+    sweeps.noise() = 1E-7,1E-8,0.0;
+    Result two = runDMRG(model,H,init,sweeps,Quiet());
+
+    //Noise sets the subspace expansion weight, so
+    //it is kept on for longer and made larger
+    Sweeps sweeps1(nsweep);
+    sweeps1.maxm() = 20,50,100,maxm;
+    sweeps1.cutoff() = 1E-10;
+    sweeps1.niter() = 2;
+    sweeps1.noise() = 1E-2,1E-3,1E-4,1E-5,1E-6,1E-7,1E-8,0.0;
+    Result one = runDMRG(model,H,init,sweeps1,Quiet()&NumCenter(1));
+
+    cout << format("\n%s, %d sweeps, max m=%d\n") % name % nsweep % maxm;
+    cout << format("    Two-site:    E = %.12f, m = %d, time = %.2f s\n")
+            % two.energy % two.maxm % two.time;
+    cout << format("    Single-site: E = %.12f, m = %d, time = %.2f s\n")
+            % one.energy % one.maxm % one.time;
+    }
+
+int
+main(int argc, char* argv[])
+    {
+    int N = 40;
+    int maxm = 200;
+    if(argc > 1) N = atoi(argv[1]);
+    if(argc > 2) maxm = atoi(argv[2]);
+
+    //S=1 Heisenberg chain, Neel initial state
+    SpinOne spins(N);
+    IQMPO Hs = Heisenberg(spins);
+    InitState sinit(spins);
+    for(int i = 1; i <= N; ++i)
+        sinit.set(i,(i%2 == 1 ? "Up" : "Dn"));
+    compare("S=1 Heisenberg",spins,Hs,sinit,maxm);
+
+    //Half-filled Hubbard chain with U=4
+    Hubbard hub(N);
+    IQMPO Hh = ExtendedHubbard(hub,Opt("U",4.)&Opt("t1",1.));
+    InitState hinit(hub);
+    for(int i = 1; i <= N; ++i)
+        hinit.set(i,(i%2 == 1 ? "Up" : "Dn"));
+    compare("Hubbard U=4",hub,Hh,hinit,maxm);
+
+    return 0;
+    }
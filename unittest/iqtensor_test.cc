@@ -398,6 +398,17 @@ TEST(AddBlock)
     
     }
 
+TEST(NonConstBlocks)
+    {
+    IQTensor T(B);
+    Foreach(ITensor& t, T.ncblocks()) 
+        {
+        Real* p = t.ncdatStart();
+        for(int n = 0; n < t.indices().dim(); ++n) p[n] *= 2;
+        }
+    CHECK_CLOSE(T.norm(),2*B.norm(),1E-10);
+    }
+
 TEST(ComplexConvert)
     {
     IQTensor R(S1(1),L1(3)),
@@ -1,5 +1,8 @@
 #include "test.h"
 #include "itensor.h"
+#include "binaryio.h"
+#include "compress.h"
+#include "tensorio.h"
 #include <boost/test/unit_test.hpp>
 
 using namespace std;
@@ -1369,4 +1372,120 @@ TEST(ComplexScalar)
     CHECK((imagPart(T6)-(f1*A+f2*B)).norm() < 1E-12);
     }
 
+TEST(NonConstData)
+    {
+    ITensor A(b3,b4);
+    A.randomize();
+    A *= 2;
+    ITensor B(A);
+
+    //Elements are in the order of A.indices(),
+    //first index varying fastest
+    const Index &i1 = A.indices().index(1),
+                &i2 = A.indices().index(2);
+    Real* p = A.ncdatStart();
+    CHECK_CLOSE(p[1+i1.m()*2],A(i1(2),i2(3)),1E-10);
+
+    //Changes don't affect copies sharing the data
+    p[0] = 7;
+    CHECK_CLOSE(A(i1(1),i2(1)),7,1E-10);
+    CHECK(fabs(B(i1(1),i2(1))-7) > 1E-10);
+    }
+
+TEST(BinaryReadWrite)
+    {
+    ITensor T(s1,s2,l1);
+    T.randomize();
+    T *= 3.5;
+    const ITensor C = Complex_1*A + Complex_i*B;
+
+    writeBinary(".read_write/ITensor.bin",T);
+    ITensor R;
+    readBinary(".read_write/ITensor.bin",R,Opt("Verify"));
+    CHECK(hasindex(R,s1) && hasindex(R,l1));
+    CHECK((R-T).norm() < 1E-12);
+
+    //Modifying R must not change the file
+    R *= 2;
+    R += T;
+    ITensor R2;
+    readBinary(".read_write/ITensor.bin",R2);
+    CHECK((R2-T).norm() < 1E-12);
+    CHECK((R-3*T).norm() < 1E-12);
+
+    writeBinary(".read_write/ITensor.bin",C);
+    ITensor RC;
+    readBinary(".read_write/ITensor.bin",RC);
+    CHECK(RC.isComplex());
+    CHECK((RC-C).norm() < 1E-12);
+
+    //Files in the old format are also read
+    writeToFile(".read_write/ITensor.old",T);
+    ITensor RO;
+    readBinary(".read_write/ITensor.old",RO);
+    CHECK((RO-T).norm() < 1E-12);
+    }
+
+TEST(CompressedFiles)
+    {
+    //Byte level round trips, including data that
+    //doesn't compress and lengths not a multiple of 8
+    std::string in,
+                out,
+                back;
+    compressBytes(ShuffleLZ,in,out);
+    decompressBytes(out,back);
+    CHECK(back == in);
+    for(int n = 1; n < 3000; n = 3*n+1)
+        {
+        in.resize(n);
+        for(int j = 0; j < n; ++j) in[j] = char(rand() % 256);
+        compressBytes(ShuffleLZ,in,out);
+        decompressBytes(out,back);
+        CHECK(back == in);
+        for(int j = 0; j < n; ++j) in[j] = char((j/7) % 5);
+        compressBytes(ShuffleLZ,in,out);
+        CHECK(n < 1000 || out.size() < in.size()/4);
+        decompressBytes(out,back);
+        CHECK(back == in);
+        }
+
+    //Tensor with many equal elements
+    Index c1("c1",20),
+          c2("c2",30);
+    ITensor T(c1,c2);
+    T(c1(3),c2(7)) = 1.5;
+    CodecStats st;
+    writeCompressed(".read_write/ITensor.lz",T,ShuffleLZ,&st);
+    CHECK(st.ratio() > 2);
+    ITensor R;
+    readCompressed(".read_write/ITensor.lz",R,&st);
+    CHECK((R-T).norm() < 1E-12);
+
+    //Uncompressed files are read too
+    writeCompressed(".read_write/ITensor.lz",T,NoCodec);
+    ITensor R2;
+    readCompressed(".read_write/ITensor.lz",R2);
+    CHECK((R2-T).norm() < 1E-12);
+    }
+
+TEST(TensorIOErrors)
+    {
+    Index c1("c1",2);
+    ITensor T(c1);
+    T(c1(1)) = 1.5;
+
+    //A write failing on the I/O thread is raised by 
+    //the next flush (once); later writes and reads work
+    TensorIO<ITensor> io(2);
+    io.write(".read_write/nodir/T.dat",T);
+    CHECK_THROW(io.flush(),ITError);
+    io.flush();
+    io.write(".read_write/T.dat",T);
+    io.flush();
+    ITensor R;
+    io.read(".read_write/T.dat",R);
+    CHECK((R-T).norm() < 1E-12);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
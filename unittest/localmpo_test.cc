@@ -1,7 +1,12 @@
 #include "test.h"
 #include "localmpo.h"
+#include "localmposet.h"
+#include "localmpo_mps.h"
+#include "dmrg.h"
 #include "model/spinhalf.h"
+#include "hams/Heisenberg.h"
 #include <boost/test/unit_test.hpp>
+#include <dirent.h>
 
 struct LocalMPODefaults
     {
@@ -37,5 +42,334 @@ BOOST_AUTO_TEST_CASE(LocalMPOAsMPS)
     lmps.position(3,psiFerro);
     }
 
+BOOST_AUTO_TEST_CASE(ThreadedSums)
+    {
+    //Use several pool threads whatever the number of cores
+    ThreadPool::instance().resize(3);
+
+    IQMPO H = Heisenberg(shmodel);
+    IQMPS psi(shNeel);
+    const int b = 4;
+    psi.position(b);
+
+    std::vector<IQMPO> Hset(3,H);
+    LocalMPOSet<IQTensor> serial(Hset),
+                          threaded(Hset,NumThreads(2));
+    LocalMPO<IQTensor> single(H);
+    serial.position(b,psi);
+    threaded.position(b,psi);
+    single.position(b,psi);
+
+    IQTensor phi = psi.bondTensor(b);
+    IQTensor sphi, tphi, phi1;
+    serial.product(phi,sphi);
+    threaded.product(phi,tphi);
+    single.product(phi,phi1);
+    phi1 *= 3;
+    CHECK((sphi-tphi).norm() < 1E-12);
+    CHECK((tphi-phi1).norm() < 1E-12*phi1.norm());
+
+    IQTensor sD = serial.diag(),
+             tD = threaded.diag();
+    CHECK((sD-tD).norm() < 1E-12);
+
+    std::vector<IQMPS> psis(2,psi);
+    LocalMPO_MPS<IQTensor> sproj(H,psis,Weight(10)),
+                           tproj(H,psis,Weight(10)&NumThreads(3));
+    sproj.position(b,psi);
+    tproj.position(b,psi);
+    sproj.product(phi,sphi);
+    tproj.product(phi,tphi);
+    CHECK((sphi-tphi).norm() < 1E-12);
+
+    ThreadPool::instance().resize(0);
+    }
+
+BOOST_AUTO_TEST_CASE(SingleSite)
+    {
+    IQMPO H = Heisenberg(shmodel);
+    IQMPS psi(shNeel);
+    const int j = 4;
+    psi.position(j);
+
+    LocalMPO<IQTensor> PH(H,NumCenter(1));
+    PH.position(j,psi);
+    CHECK_CLOSE(PH.expect(psi.A(j)),psiHphi(psi,H,psi),1E-10);
+    CHECK_EQUAL(PH.size(),2);
+
+    Sweeps sweeps(6);
+    sweeps.maxm() = 10,20,40;
+    sweeps.cutoff() = 1E-12;
+    sweeps.noise() = 1E-2,1E-3,1E-4,1E-6,0.0;
+
+    IQMPS psi2(shNeel);
+    Real E2 = dmrg(psi2,H,sweeps,Quiet());
+
+    IQMPS psi1(shNeel);
+    Real E1 = dmrg(psi1,H,sweeps,Quiet()&NumCenter(1));
+    CHECK(psi1.LinkInd(N/2).m() > 1);
+    CHECK_CLOSE(E1,E2,1E-8);
+    CHECK_CLOSE(psiHphi(psi1,H,psi1),E1,1E-8);
+    }
+
+class StatsObserver : public DMRGObserver
+    {
+    public:
+
+    StatsObserver(const OptSet& opts) : DMRGObserver(opts) { }
+
+    void virtual
+    measureStats(const BondStats& st, const OptSet& opts) { stats.add(st); }
+
+    SweepStats stats;
+    };
+
+BOOST_AUTO_TEST_CASE(DMRGStats)
+    {
+    IQMPO H = Heisenberg(shmodel);
+    IQMPS psi(shNeel);
+
+    Sweeps sweeps(2);
+    sweeps.maxm() = 10,20;
+    sweeps.cutoff() = 1E-10;
+
+    StatsObserver obs(Quiet());
+    Real E = dmrg(psi,H,sweeps,obs,Quiet());
+
+    const std::vector<BondStats>& bs = obs.stats.bonds();
+    CHECK_EQUAL(int(bs.size()),2*2*(N-1));
+    Foreach(const BondStats& st, bs)
+        {
+        CHECK(st.niter >= 1);
+        CHECK(st.flops > 0);
+        CHECK(st.eig_wall >= 0);
+        CHECK(st.eig_alloc > 0);
+        CHECK(st.nalloc > 0);
+        CHECK(st.m >= 1 && st.m <= 20);
+        }
+    CHECK_CLOSE(bs.back().energy,E,1E-10);
+    CHECK_EQUAL(bs.back().sweep,2);
+    CHECK_EQUAL(bs.back().bond,1);
+
+    std::stringstream csv;
+    SweepStats::writeCSVHeader(csv);
+    obs.stats.writeCSV(csv,2);
+    int nlines = 0;
+    std::string line;
+    while(std::getline(csv,line)) ++nlines;
+    CHECK_EQUAL(nlines,1+2*(N-1));
+    }
+
+BOOST_AUTO_TEST_CASE(EdgeTensorReadWrite)
+    {
+    IQMPO H = Heisenberg(shmodel);
+    IQMPS psi(shNeel);
+    const int b = 4;
+    psi.position(b);
+
+    LocalMPO<IQTensor> PH(H);
+    PH.position(b,psi);
+    std::stringstream s;
+    PH.write(s);
+
+    LocalMPO<IQTensor> PH2(H);
+    PH2.read(s);
+    CHECK_EQUAL(PH2.position(),b);
+
+    //Changing psi away from bond b shows whether
+    //the edge tensors get recomputed
+    IQMPS psi2(psi);
+    psi2.Anc(1) *= 2;
+    PH2.position(b,psi2);
+
+    IQTensor phi = psi.bondTensor(b), 
+             phip, phip2;
+    PH.product(phi,phip);
+    PH2.product(phi,phip2);
+    CHECK((phip-phip2).norm() < 1E-12*phip.norm());
+    }
+
+//Number of entries of the current directory starting with pfix
+int
+countEntries(const std::string& pfix)
+    {
+    DIR* d = opendir(".");
+    int n = 0;
+    struct dirent* e = 0;
+    while((e = readdir(d)) != 0)
+        {
+        if(std::string(e->d_name).compare(0,pfix.size(),pfix) == 0) ++n;
+        }
+    closedir(d);
+    return n;
+    }
+
+class KillObserver : public DMRGObserver
+    {
+    public:
+
+    struct Killed { };
+
+    //Throws Killed after nkill steps
+    KillObserver(int nkill, const OptSet& opts) 
+        : DMRGObserver(opts), nkill_(nkill), nstep_(0) { }
+
+    void virtual
+    measureStats(const BondStats& st, const OptSet& opts) 
+        { 
+        stats.add(st); 
+        if(++nstep_ == nkill_) throw Killed();
+        }
+
+    SweepStats stats;
+
+    private:
+    int nkill_, nstep_;
+    };
+
+BOOST_AUTO_TEST_CASE(DMRGCheckpoint)
+    {
+    IQMPO H = Heisenberg(shmodel);
+
+    Sweeps sweeps(3);
+    sweeps.maxm() = 10,20,40;
+    sweeps.cutoff() = 1E-10;
+
+    IQMPS psi(shNeel);
+    Real E = dmrg(psi,H,sweeps,Quiet());
+
+    const std::string ckpt = "dmrg_checkpoint";
+    removeCheckpoint(ckpt);
+
+    //Kill the job during sweep 2, there are
+    //2*(N-1) = 18 steps per sweep
+    IQMPS psi1(shNeel);
+    KillObserver kobs(25,Quiet());
+    CHECK_THROW(dmrg(psi1,H,sweeps,kobs,Quiet()&Checkpoint(ckpt)&CheckpointEvery(4)),
+                KillObserver::Killed);
+    CHECK(fileExists(ckpt));
+    CHECK(!fileExists(ckpt+".tmp"));
+    //All tensors were in memory
+    CHECK_EQUAL(countEntries(ckpt+"_snap"),0);
+
+    //The last checkpoint was after step 24
+    IQMPS psi2(shNeel);
+    KillObserver robs(-1,Quiet());
+    Real E2 = dmrg(psi2,H,sweeps,robs,Quiet()&Checkpoint(ckpt)&Restart());
+    const std::vector<BondStats>& bs = robs.stats.bonds();
+    CHECK_EQUAL(int(bs.size()),3*18-24);
+    CHECK_EQUAL(bs.front().sweep,2);
+    CHECK_EQUAL(bs.front().halfsweep,1);
+    CHECK_EQUAL(bs.front().bond,7);
+    CHECK_CLOSE(E2,E,1E-8);
+    CHECK_CLOSE(psiHphi(psi2,H,psi2),E2,1E-8);
+
+    //Restarting a finished job does nothing
+    IQMPS psi3(shNeel);
+    KillObserver dobs(-1,Quiet());
+    Real E3 = dmrg(psi3,H,sweeps,dobs,Quiet()&Checkpoint(ckpt)&Restart());
+    CHECK(dobs.stats.bonds().empty());
+    CHECK_CLOSE(E3,E2,1E-10);
+
+    removeCheckpoint(ckpt);
+    CHECK(!fileExists(ckpt));
+    }
+
+BOOST_AUTO_TEST_CASE(DMRGCheckpointOnDisk)
+    {
+    IQMPO H = Heisenberg(shmodel);
+
+    Sweeps sweeps(3);
+    sweeps.maxm() = 10,20,40;
+    sweeps.cutoff() = 1E-10;
+
+    IQMPS psi(shNeel);
+    Real E = dmrg(psi,H,sweeps,Quiet());
+
+    //Write directories of the killed run are not removed,
+    //keep them all in one place
+    const std::string wdir = mkTempDir("dmrg_write");
+    Global::opts().add(WriteDir(wdir));
+
+    //A tiny budget keeps nearly all tensors on disk
+    const std::string ckpt = "dmrg_checkpoint_disk";
+    const OptSet opts = Quiet() & Checkpoint(ckpt) & Opt("MemoryBudget",0.001);
+    removeCheckpoint(ckpt);
+
+    IQMPS psi1(shNeel);
+    KillObserver kobs(25,Quiet());
+    CHECK_THROW(dmrg(psi1,H,sweeps,kobs,opts&CheckpointEvery(4)),
+                KillObserver::Killed);
+    CHECK(fileExists(ckpt));
+    //Only the snapshot of the last checkpoint is kept
+    CHECK_EQUAL(countEntries(ckpt+"_snap"),1);
+
+    IQMPS psi2(shNeel);
+    KillObserver robs(-1,Quiet());
+    Real E2 = dmrg(psi2,H,sweeps,robs,opts&Restart());
+    CHECK_EQUAL(int(robs.stats.bonds().size()),3*18-24);
+    CHECK_CLOSE(E2,E,1E-8);
+    CHECK_EQUAL(countEntries(ckpt+"_snap"),1);
+
+    removeCheckpoint(ckpt);
+    CHECK(!fileExists(ckpt));
+    CHECK_EQUAL(countEntries(ckpt+"_snap"),0);
+
+    Global::opts().add(WriteDir("./"));
+    removeDir(wdir);
+    }
+
+BOOST_AUTO_TEST_CASE(CopyDetachesBudget)
+    {
+    IQMPO H = Heisenberg(shmodel);
+    IQMPS psi(shNeel);
+    const int b = 4;
+    psi.position(b);
+
+    const std::string wdir = mkTempDir("localmpo_write");
+    Global::opts().add(WriteDir(wdir));
+
+    MemoryBudget mb1(1E9),
+                 mb2(1E9);
+        {
+        LocalMPO<IQTensor> PH(H);
+        PH.memoryBudget(&mb1);
+        PH.position(b,psi);
+        CHECK(mb1.memUse() > 0);
+
+        //Neither a copy nor a LocalMPO assigned to
+        //is attached to a budget afterwards
+        LocalMPO<IQTensor> PHc(PH),
+                           PHa(H);
+        PHa.memoryBudget(&mb2);
+        PHa = PH;
+        CHECK_EQUAL(mb2.memUse(),0);
+        }
+    CHECK_EQUAL(mb1.memUse(),0);
+
+    Global::opts().add(WriteDir("./"));
+    removeDir(wdir);
+    }
+
+BOOST_AUTO_TEST_CASE(DMRGBudgetKilled)
+    {
+    IQMPO H = Heisenberg(shmodel);
+
+    Sweeps sweeps(2);
+    sweeps.maxm() = 10,20;
+    sweeps.cutoff() = 1E-10;
+
+    //psi outlives the MemoryBudget used inside dmrg,
+    //which must detach it when dmrg exits by an exception
+    IQMPS psi(shNeel);
+    KillObserver kobs(5,Quiet());
+    CHECK_THROW(dmrg(psi,H,sweeps,kobs,Quiet()&Opt("MemoryBudget",0.001)),
+                KillObserver::Killed);
+    CHECK(psi.doWrite());
+    psi.position(1);
+    psi.position(N-1);
+    psi.doWrite(false);
+    CHECK(psi.A(N/2).norm() > 0);
+    }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,6 +1,9 @@
 #include "test.h"
 #include "model/spinone.h"
+#include "model/spinhalf.h"
 #include "hams/heisenberg.h"
+#include "hams/J1J2Chain.h"
+#include "metts.h"
 #include <boost/test/unit_test.hpp>
 
 using namespace std;
@@ -17,6 +20,21 @@ struct MPODefaults
 
     };
 
+//Tr(X^dag Y), treating the MPOs as vectors
+Real
+mpoOverlap(const IQMPO& X, const IQMPO& Y)
+    {
+    IQTensor E;
+    for(int j = 1; j <= X.N(); ++j)
+        {
+        IQTensor cx = conj(X.A(j));
+        cx.mapprime(0,4,Link);
+        E = (E.isNull() ? Y.A(j) : E*Y.A(j));
+        E *= cx;
+        }
+    return E.toReal();
+    }
+
 BOOST_FIXTURE_TEST_SUITE(MPOTest,MPODefaults)
 
 BOOST_AUTO_TEST_CASE(Constructors)
@@ -31,4 +49,204 @@ BOOST_AUTO_TEST_CASE(Position)
     CHECK_EQUAL(H.orthoCenter(),1);
     }
 
+BOOST_AUTO_TEST_CASE(FitApplyMPO)
+    {
+    IQMPO H = Heisenberg(s1model);
+
+    InitState init(s1model);
+    for(int j = 1; j <= N; ++j)
+        init.set(j,(j%2==1 ? "Up" : "Dn"));
+    IQMPS neel(init);
+
+    //Entangled starting state H|neel>
+    IQMPS psi;
+    exactApplyMPO(neel,H,psi);
+
+    IQMPS exact;
+    exactApplyMPO(psi,H,exact);
+
+    IQMPS fit;
+    fitApplyMPO(psi,H,fit,Maxm(200)&Cutoff(1E-16));
+
+    const Real ee = psiphi(exact,exact);
+    const Real diff = psiphi(fit,fit) - 2*psiphi(fit,exact) + ee;
+    CHECK(fabs(diff) < 1E-8*ee);
+
+    //Truncating res still gives a close fit
+    IQMPS fitm;
+    fitApplyMPO(psi,H,fitm,Maxm(10)&Cutoff(1E-16));
+    CHECK(fitm.LinkInd(N/2).m() <= 10);
+    const Real tdiff = psiphi(fitm,fitm) - 2*psiphi(fitm,exact) + ee;
+    CHECK(tdiff < 1E-2*ee);
+    }
+
+BOOST_AUTO_TEST_CASE(FitMultMPO)
+    {
+    IQMPO H = Heisenberg(s1model);
+
+    InitState init(s1model);
+    for(int j = 1; j <= N; ++j)
+        init.set(j,(j%2==1 ? "Up" : "Dn"));
+    IQMPS neel(init);
+
+    IQMPS Hneel;
+    exactApplyMPO(neel,H,Hneel);
+    const Real H2 = psiphi(Hneel,Hneel);
+
+    IQMPO HH(s1model);
+    fitMultMPO(H,H,HH,Maxm(200)&Cutoff(1E-14));
+    CHECK_CLOSE(psiHphi(neel,HH,neel),H2,1E-8);
+
+    //Same result as nmultMPO
+    IQMPO HHs(s1model);
+    nmultMPO(H,H,HHs,1E-14,200);
+    CHECK_CLOSE(psiHphi(Hneel,HH,Hneel),psiHphi(Hneel,HHs,Hneel),1E-8);
+
+    //When the product is truncated the fit
+    //is closer to it than nmultMPO
+    SpinHalf jmodel(20);
+    IQMPO J = J1J2Chain(jmodel,Opt("J2",0.5));
+    IQMPO JJ(jmodel),
+          JJn(jmodel),
+          JJf;
+    nmultMPO(J,J,JJ,1E-16,200);
+    nmultMPO(J,J,JJn,1E-16,6);
+    fitMultMPO(J,J,JJf,Maxm(6)&Cutoff(1E-16));
+    //Both keep whole multiplets, so can exceed m=6,
+    //but the fit is not larger than nmultMPO's product
+    int mn = 0, mf = 0;
+    for(int b = 1; b < jmodel.N(); ++b)
+        {
+        mn = std::max(mn,JJn.LinkInd(b).m());
+        mf = std::max(mf,JJf.LinkInd(b).m());
+        }
+    CHECK(mf <= mn);
+    const Real jj = mpoOverlap(JJ,JJ),
+               errn = mpoOverlap(JJn,JJn)-2*mpoOverlap(JJn,JJ)+jj,
+               errf = mpoOverlap(JJf,JJf)-2*mpoOverlap(JJf,JJ)+jj;
+    CHECK(errf < 0.5*errn);
+
+    //expH using fitMultMPO: one doubling step
+    //agrees with a direct Taylor series
+    SpinHalf shmodel(4);
+    IQMPO Hs = Heisenberg(shmodel);
+    InitState shinit(shmodel);
+    for(int j = 1; j <= 4; ++j)
+        shinit.set(j,(j%2==1 ? "Up" : "Dn"));
+    IQMPS shneel(shinit);
+    IQMPO K(shmodel),
+          Kd(shmodel);
+    expH(Hs,K,0.1,-2.,1E-12,0,Opt("Fit",true)&Opt("Order",20));
+    expH(Hs,Kd,0.1,-2.,1E-12,1,Opt("Fit",true)&Opt("Order",12));
+    const Real kk = psiHphi(shneel,K,shneel);
+    CHECK_CLOSE(psiHphi(shneel,Kd,shneel),kk,1E-3);
+    }
+
+BOOST_AUTO_TEST_CASE(ToExpH)
+    {
+    SpinHalf shmodel(8);
+    IQMPO H = Heisenberg(shmodel);
+    InitState init(shmodel);
+    for(int j = 1; j <= 8; ++j)
+        init.set(j,(j%2==1 ? "Up" : "Dn"));
+    IQMPS neel(init);
+
+    //Taylor series for exp(-tau*H)|neel>
+    const Real tau = 0.05;
+    IQMPS exact(neel),
+          term(neel);
+    for(int k = 1; k <= 12; ++k)
+        {
+        IQMPS t;
+        exactApplyMPO(term,H,t);
+        t *= -tau/k;
+        term = t;
+        exact += term;
+        }
+    const Real ee = psiphi(exact,exact);
+
+    for(int a = 0; a < 2; ++a)
+        {
+        const OptSet opts = Opt("Approx",std::string(a == 0 ? "WI" : "WII"));
+
+        IQMPO K;
+        toExpH(H,tau,K,opts);
+        CHECK(K.LinkInd(4).m() <= H.LinkInd(4).m());
+
+        IQMPS psi;
+        exactApplyMPO(neel,K,psi);
+        const Real err1 = sqrt(fabs(psiphi(psi,psi)-2*psiphi(psi,exact)+ee)/ee);
+        CHECK(err1 < 1E-2);
+
+        //Two complex steps cancel the O(tau^2) error
+        IQMPO K1,
+              K2;
+        toExpH(H,tau*Complex(0.5,0.5),K1,opts);
+        toExpH(H,tau*Complex(0.5,-0.5),K2,opts);
+        IQMPS psi1,
+              psi2;
+        exactApplyMPO(neel,K1,psi1);
+        exactApplyMPO(psi1,K2,psi2);
+        Real nre = 0, nim = 0, ore = 0, oim = 0;
+        psiphi(psi2,psi2,nre,nim);
+        psiphi(psi2,exact,ore,oim);
+        const Real err2 = sqrt(fabs(nre-2*ore+ee)/ee);
+        CHECK(err2 < err1/10);
+        }
+    }
+
+BOOST_AUTO_TEST_CASE(METTSThermalEnergy)
+    {
+    const int Ns = 4;
+    const Real beta = 1;
+    SpinHalf shmodel(Ns);
+    MPO H = Heisenberg(shmodel);
+
+    //Exact thermal energy from the full Hamiltonian
+    ITensor T = H.A(1);
+    for(int j = 2; j <= Ns; ++j) T *= H.A(j);
+    Combiner c,
+             cP;
+    for(int j = 1; j <= Ns; ++j)
+        {
+        c.addleft(shmodel.si(j));
+        cP.addleft(shmodel.siP(j));
+        }
+    c.init("c");
+    cP.init("cP");
+    T = c*T;
+    T = cP*T;
+    Matrix Hm;
+    T.toMatrix11(c.right(),cP.right(),Hm);
+    Vector evals;
+    Matrix U;
+    EigenValues(Hm,evals,U);
+    Real Z = 0, 
+         E = 0;
+    for(int k = 1; k <= evals.Length(); ++k)
+        {
+        const Real w = exp(-beta*(evals(k)-evals(1)));
+        Z += w;
+        E += w*evals(k);
+        }
+    E /= Z;
+
+    InitState init(shmodel);
+    for(int j = 1; j <= Ns; ++j)
+        init.set(j,(j%2==1 ? "Up" : "Dn"));
+
+    const OptSet opts = Opt("Nchain",2) & Opt("Nwarm",2) & Opt("Nstep",40) 
+                      & Opt("Tau",0.1) & Opt("AltBasis",std::string("Sx"));
+    METTS<ITensor> metts(H,beta,opts);
+    metts.run(init,METTSEnergy<ITensor>(H));
+    CHECK(metts.nobs() == 1);
+    CHECK(metts.err(0) > 0);
+    CHECK(fabs(metts.mean(0)-E) < 4*metts.err(0));
+
+    //Chains use their own random number streams
+    METTS<ITensor> metts2(H,beta,opts & NumThreads(2));
+    metts2.run(init,METTSEnergy<ITensor>(H));
+    CHECK_CLOSE(metts2.mean(0),metts.mean(0),1E-10);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
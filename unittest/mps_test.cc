@@ -2,6 +2,10 @@
 #include "mps.h"
 #include "model/spinhalf.h"
 #include "model/spinless.h"
+#include "hambuilder.h"
+#include "mpo.h"
+#include "sampler.h"
+#include "tevol.h"
 #include <boost/test/unit_test.hpp>
 
 struct MPSDefaults
@@ -87,5 +91,576 @@ TEST(PositionTest)
     CHECK_EQUAL(findCenter(psi),4);
     }
 
+TEST(WriteToDisk)
+    {
+    IQMPS psi(shNeel);
+
+    std::vector<IQTensor> A(N+1);
+    for(int j = 1; j <= N; ++j) A.at(j) = psi.A(j);
+
+    psi.doWrite(true,Opt("PrefetchWindow",2));
+
+    //Sweep back and forth so tensors get
+    //written out and prefetched in both directions
+    for(int sw = 1; sw <= 2; ++sw)
+        {
+        for(int b = 1; b < N; ++b)
+            {
+            IQTensor AA = psi.bondTensor(b);
+            CHECK((AA-A.at(b)*A.at(b+1)).norm() < 1E-12);
+            }
+        for(int b = N-1; b >= 1; --b)
+            {
+            IQTensor AA = psi.bondTensor(b);
+            CHECK((AA-A.at(b)*A.at(b+1)).norm() < 1E-12);
+            }
+        }
+
+    //Copying must see all pending writes
+    IQMPS cpsi(psi);
+    CHECK(cpsi.snapshotStats().nfile() > 0);
+    CHECK(cpsi.writeDir() != psi.writeDir());
+    for(int j = 1; j <= N; ++j)
+        {
+        CHECK((cpsi.A(j)-A.at(j)).norm() < 1E-12);
+        }
+
+    //Files of the copy share their contents with
+    //the original's, changing those must not affect it
+    IQMPS dpsi(psi);
+    for(int j = 1; j <= N; ++j)
+        {
+        psi.Anc(j) *= 2;
+        }
+    for(int b = N-1; b >= 1; --b) psi.bondTensor(b);
+    for(int b = 1; b < N; ++b) psi.bondTensor(b);
+    for(int j = 1; j <= N; ++j)
+        {
+        CHECK((dpsi.A(j)-A.at(j)).norm() < 1E-12);
+        }
+
+    const std::string dir = dpsi.writeDir();
+    dpsi.doWrite(false);
+    CHECK(!fileExists(dir+"/model"));
+
+    psi.doWrite(false);
+    for(int j = 1; j <= N; ++j)
+        {
+        CHECK((psi.A(j)-2*A.at(j)).norm() < 1E-12);
+        }
+
+    //Synchronous and fsync'ed writes, compressed
+    for(int window = 0; window <= 2; window += 2)
+        {
+        IQMPS spsi(shNeel);
+        for(int j = 1; j <= N; ++j) A.at(j) = spsi.A(j);
+        spsi.doWrite(true,Opt("PrefetchWindow",window)&Opt("Fsync")&Opt("WriteAll")
+                          &Opt("Compress","LZ"));
+        for(int b = 1; b < N; ++b)
+            {
+            IQTensor AA = spsi.bondTensor(b);
+            CHECK((AA-A.at(b)*A.at(b+1)).norm() < 1E-12);
+            }
+        CHECK(spsi.ioStats().nwrite >= N);
+        CHECK(spsi.ioStats().codec.ratio() > 1);
+        IQMPS cpsi(spsi);
+        spsi.doWrite(false);
+        for(int j = 1; j <= N; ++j)
+            {
+            CHECK((spsi.A(j)-A.at(j)).norm() < 1E-12);
+            CHECK((cpsi.A(j)-A.at(j)).norm() < 1E-12);
+            }
+        }
+    }
+
+TEST(MemoryBudgetTest)
+    {
+    IQMPS psi(shNeel);
+
+    std::vector<IQTensor> A(N+1);
+    for(int j = 1; j <= N; ++j) A.at(j) = psi.A(j);
+
+    //Room for about four site tensors
+    MemoryBudget budget(4*memBytes(A.at(N/2)));
+    psi.memoryBudget(&budget);
+    CHECK(psi.doWrite());
+
+    for(int b = 1; b < N; ++b)
+        {
+        IQTensor AA = psi.bondTensor(b);
+        CHECK((AA-A.at(b)*A.at(b+1)).norm() < 1E-12);
+        CHECK(budget.memUse() <= budget.maxBytes());
+        }
+    for(int b = N-1; b >= 1; --b)
+        {
+        IQTensor AA = psi.bondTensor(b);
+        CHECK((AA-A.at(b)*A.at(b+1)).norm() < 1E-12);
+        CHECK(budget.memUse() <= budget.maxBytes());
+        }
+    CHECK(budget.nevict() > 0);
+
+    psi.memoryBudget(0);
+    psi.doWrite(false);
+    for(int j = 1; j <= N; ++j)
+        {
+        CHECK((psi.A(j)-A.at(j)).norm() < 1E-12);
+        }
+
+    //A budget going out of scope detaches psi
+        {
+        MemoryBudget scoped(memBytes(A.at(N/2)));
+        psi.memoryBudget(&scoped);
+        psi.position(N/2);
+        }
+    psi.position(1);
+    psi.position(N-1);
+    psi.doWrite(false);
+    CHECK_CLOSE(psi.norm(),1,1E-12);
+    }
+
+TEST(FitSum)
+    {
+    Spinless model(10);
+
+    //Single particle on site j, weighted by j
+    const int Nt = 5;
+    std::vector<IQMPS> terms;
+    std::vector<Real> coefs;
+    for(int j = 1; j <= Nt; ++j)
+        {
+        InitState init(model,"Emp");
+        init.set(2*j-1,"Occ");
+        terms.push_back(IQMPS(init));
+        coefs.push_back(j);
+        }
+
+    IQMPS exact = terms.front();
+    for(int j = 2; j <= Nt; ++j)
+        {
+        IQMPS t = terms.at(j-1);
+        t *= coefs.at(j-1);
+        exact += t;
+        }
+
+    IQMPS res;
+    fitSum(terms,coefs,res,Cutoff(1E-14));
+    CHECK_EQUAL(totalQN(res),QN(0,1));
+    const Real ee = psiphi(exact,exact);
+    CHECK_CLOSE(ee,1+4+9+16+25,1E-8);
+    CHECK(fabs(psiphi(res,res)-2*psiphi(res,exact)+ee) < 1E-10*ee);
+
+    //The default guess alone (no sweeps) is exact at m=2
+    //and never has a link larger than maxm, even though 
+    //adding any two terms would give m=2
+    IQMPS guess;
+    fitSum(terms,coefs,guess,Opt("Nsweep",0)&Maxm(2)&Cutoff(1E-14));
+    CHECK(fabs(psiphi(guess,guess)-2*psiphi(guess,exact)+ee) < 1E-10*ee);
+    IQMPS res1;
+    fitSum(terms,coefs,res1,Maxm(1)&Cutoff(1E-14));
+    for(int b = 1; b < model.N(); ++b)
+        {
+        CHECK_EQUAL(res1.LinkInd(b).m(),1);
+        }
+    CHECK_CLOSE(psiphi(res1,res1)-2*psiphi(res1,exact)+ee,ee-25,1E-6);
+
+    //Compressing to m=1 keeps the largest term
+    IQMPS cpsi(exact);
+    compress(cpsi,1,1E-14);
+    CHECK_EQUAL(cpsi.LinkInd(5).m(),1);
+    const Real cdiff = psiphi(cpsi,cpsi)-2*psiphi(cpsi,exact)+ee;
+    CHECK_CLOSE(cdiff,ee-25,1E-6);
+
+    //m=2 is enough to represent the sum exactly
+    IQMPS cpsi2(exact);
+    compress(cpsi2,2,1E-14);
+    CHECK(fabs(psiphi(cpsi2,cpsi2)-2*psiphi(cpsi2,exact)+ee) < 1E-10*ee);
+    }
+
+TEST(CorrelationMatrix)
+    {
+    //Neel state: <Sz_i Sz_j> = +-1/4, no connected part
+    IQMPS neel(shNeel);
+    Matrix C = correlationMatrix(neel,"Sz","Sz");
+    CHECK_CLOSE(C(1,1),0.25,1E-10);
+    CHECK_CLOSE(C(1,2),-0.25,1E-10);
+    CHECK_CLOSE(C(4,2),0.25,1E-10);
+    Matrix Cc = correlationMatrix(neel,"Sz","Sz",Opt("Connected"));
+    CHECK(Norm(Cc.TreatAsVector()) < 1E-10);
+
+    //Entangled state: compare to MPO expectation values
+    IQMPO Hflip;
+    HamBuilder hb(shmodel);
+    hb.getMPO(3,shmodel.op("Sm",3),4,shmodel.op("Sp",4),Hflip);
+    IQMPS flip;
+    exactApplyMPO(neel,Hflip,flip);
+    IQMPS psi(neel);
+    psi += flip;
+    psi *= 1./sqrt(psiphi(psi,psi));
+    Matrix Cpm = correlationMatrix(psi,"Sp","Sm");
+    for(int i = 1; i <= N; ++i)
+    for(int j = 1; j <= N; ++j)
+        {
+        IQMPO P;
+        if(i == j) hb.getMPO(i,multSiteOps(shmodel.op("Sp",i),shmodel.op("Sm",i)),P);
+        else       hb.getMPO(i,shmodel.op("Sp",i),j,shmodel.op("Sm",j),P);
+        CHECK_CLOSE(Cpm(i,j),psiHphi(psi,P,psi),1E-10);
+        }
+
+    //Fermions: (c^dag_1 c^dag_2 + c^dag_2 c^dag_4)|0>/sqrt(2)
+    //has <c^dag_1 c_4> = -1/2 due to the occupied site 2
+    Spinless model(6);
+    InitState i1(model,"Emp"),
+              i2(model,"Emp");
+    i1.set(1,"Occ");
+    i1.set(2,"Occ");
+    i2.set(2,"Occ");
+    i2.set(4,"Occ");
+    IQMPS fpsi = ISqrt2*(IQMPS(i1) + IQMPS(i2));
+    Matrix F = correlationMatrix(fpsi,"Adag","A",Opt("Fermionic"));
+    CHECK_CLOSE(F(1,4),-0.5,1E-10);
+    CHECK_CLOSE(F(4,1),-0.5,1E-10);
+    CHECK_CLOSE(F(2,2),1,1E-10);
+    CHECK(fabs(F(1,2)) < 1E-10);
+    Matrix B = correlationMatrix(fpsi,"Adag","A");
+    CHECK_CLOSE(B(1,4),0.5,1E-10);
+    }
+
+TEST(EntanglementProfileTest)
+    {
+    //W state of spin flips at sites 2, 5, 8
+    InitState base(shmodel,"Dn");
+    IQMPS w;
+    for(int j = 2; j <= 8; j += 3)
+        {
+        InitState init(base);
+        init.set(j,"Up");
+        if(w.isNull()) w = IQMPS(init);
+        else           w += IQMPS(init);
+        }
+    w *= 1./sqrt(3.);
+
+    const Real S = -(2./3)*log(2./3)-(1./3)*log(1./3);
+    const Real S2 = -log(4./9+1./9);
+    EntanglementProfile prof = entanglementProfile(w);
+    CHECK(prof.N() == N);
+    CHECK(fabs(prof.vonNeumann(1)) < 1E-10);
+    CHECK_CLOSE(prof.vonNeumann(2),S,1E-8);
+    CHECK_CLOSE(prof.vonNeumann(7),S,1E-8);
+    CHECK_CLOSE(prof.renyi(4,2),S2,1E-8);
+    CHECK_CLOSE(prof.eigs(5)(1),2./3,1E-8);
+    CHECK(fabs(prof.vonNeumann(9)) < 1E-10);
+
+    //Starting from an orthogonality center in the middle
+    w.position(5);
+    EntanglementProfile profc = entanglementProfile(w);
+    for(int b = 1; b < N; ++b)
+        {
+        CHECK(fabs(prof.vonNeumann(b)-profc.vonNeumann(b)) < 1E-10);
+        }
+
+    //Each svdBond leaves only its own bond valid; the center
+    //ends at site N, and moving it does not change the spectra
+    w.position(1);
+    for(int b = 1; b < N; ++b)
+        {
+        w.svdBond(b,w.bondTensor(b),Fromleft);
+        }
+    w.position(1);
+    CHECK(w.spectrumValid(N-1));
+    for(int b = 1; b < N-1; ++b)
+        {
+        CHECK(!w.spectrumValid(b));
+        }
+    EntanglementProfile profs = entanglementProfile(w,Opt("UseCached"));
+    for(int b = 1; b < N; ++b)
+        {
+        CHECK(fabs(prof.vonNeumann(b)-profs.vonNeumann(b)) < 1E-10);
+        }
+
+    //Rescaling keeps the stored spectra valid, changing
+    //a tensor with Anc (here the weight of the flip at
+    //site 5, without changing any bond dimension) 
+    //invalidates every bond
+    w *= 2;
+    CHECK(w.spectrumValid(N-1));
+    IQTensor A5 = w.A(5) * shmodel.op("Sz",5);
+    A5.noprime(Site);
+    w.Anc(5) += A5;
+    CHECK(!w.spectrumValid(3));
+    CHECK(!w.spectrumValid(N-1));
+    EntanglementProfile profm = entanglementProfile(w,Opt("UseCached")),
+                        profx = entanglementProfile(w);
+    CHECK(fabs(profm.vonNeumann(5)-prof.vonNeumann(5)) > 1E-3);
+    CHECK(fabs(profm.vonNeumann(3)-prof.vonNeumann(3)) > 1E-3);
+    for(int b = 1; b < N; ++b)
+        {
+        CHECK(fabs(profm.vonNeumann(b)-profx.vonNeumann(b)) < 1E-10);
+        }
+
+    std::stringstream ss;
+    prof.write(ss);
+    EntanglementProfile rprof;
+    rprof.read(ss);
+    CHECK(rprof.N() == N);
+    CHECK_CLOSE(rprof.renyi(4,2),S2,1E-8);
+    }
+
+TEST(Sampler)
+    {
+    //Superposition of spin flips at sites 2, 5, 8
+    //with probabilities 1/6, 1/3, 1/2
+    InitState base(shmodel,"Dn");
+    IQMPS psi;
+    for(int k = 1; k <= 3; ++k)
+        {
+        InitState init(base);
+        init.set(3*k-1,"Up");
+        IQMPS t(init);
+        t *= sqrt(k/6.);
+        if(psi.isNull()) psi = t;
+        else             psi += t;
+        }
+
+    MPSSampler<IQTensor> sampler(psi);
+    const int up = shmodel(1,"Up").i;
+
+    SampleRNG gen = MPSSampler<IQTensor>::makeRNG(7,0);
+    MPSSampler<IQTensor>::Config conf;
+    const Real p = sampler.sample(conf,gen);
+    int nup = 0, 
+        flip = 0;
+    for(int j = 1; j <= N; ++j) 
+        if(conf.at(j) == up) { ++nup; flip = j; }
+    CHECK_EQUAL(nup,1);
+    CHECK_CLOSE(p,(flip+1)/18.,1E-8);
+    CHECK_EQUAL(sampler.initState(conf)(flip),shmodel(flip,"Up"));
+
+    const int ns = 3000;
+    std::vector<MPSSampler<IQTensor>::Config> confs;
+    sampler.sample(ns,confs,Opt("BatchSize",500));
+    std::vector<int> count(N+1,0);
+    Foreach(const MPSSampler<IQTensor>::Config& c, confs)
+        {
+        for(int j = 1; j <= N; ++j) 
+            if(c.at(j) == up) ++count.at(j);
+        }
+    CHECK_EQUAL(count.at(2)+count.at(5)+count.at(8),ns);
+    CHECK(fabs(count.at(2)/Real(ns)-1./6) < 0.04);
+    CHECK(fabs(count.at(5)/Real(ns)-1./3) < 0.04);
+    CHECK(fabs(count.at(8)/Real(ns)-1./2) < 0.04);
+
+    //Same samples independent of the number of threads
+    std::vector<MPSSampler<IQTensor>::Config> tconfs;
+    sampler.sample(ns,tconfs,Opt("BatchSize",500)&NumThreads(3));
+    CHECK(tconfs == confs);
+
+    //psi written to disk is loaded by the sampler, 
+    //leaving psi itself unchanged
+    IQMPS wpsi(psi);
+    wpsi.doWrite(true);
+    MPSSampler<IQTensor> wsampler(wpsi);
+    CHECK(wpsi.doWrite());
+    std::vector<MPSSampler<IQTensor>::Config> wconfs;
+    wsampler.sample(ns,wconfs,Opt("BatchSize",500)&NumThreads(3));
+    CHECK(wconfs == confs);
+    wpsi.doWrite(false);
+
+    //ITensor version
+    MPS mpsi;
+    for(int k = 1; k <= 3; ++k)
+        {
+        InitState init(base);
+        init.set(3*k-1,"Up");
+        MPS t(init);
+        t *= sqrt(k/6.);
+        if(mpsi.isNull()) mpsi = t;
+        else              mpsi += t;
+        }
+    MPSSampler<ITensor> msampler(mpsi);
+    std::vector<MPSSampler<ITensor>::Config> mconfs;
+    msampler.sample(ns,mconfs,Opt("BatchSize",500));
+    CHECK(mconfs == confs);
+    }
+
+TEST(VidalMPS)
+    {
+    //Equal superposition of the two Neel states
+    InitState aNeel(shmodel);
+    for(int j = 1; j <= N; ++j)
+        {
+        aNeel.set(j,j%2==1 ? "Dn" : "Up");
+        }
+    IQMPS psi(shNeel);
+    psi += IQMPS(aNeel);
+
+    IQVidalMPS vpsi(psi);
+    CHECK(vpsi.N() == N);
+    for(int b = 1; b < N; ++b)
+        {
+        CHECK_CLOSE(vpsi.Lambda(b).norm(),1,1E-10);
+        CHECK_EQUAL(vpsi.spectrum(b).numEigsKept(),2);
+        CHECK_CLOSE(vpsi.spectrum(b).eigsKept()(1),0.5,1E-10);
+        }
+    IQTensor B3 = vpsi.Gamma(3) * vpsi.Lambda(3);
+    B3 -= vpsi.B(3);
+    CHECK(B3.norm() < 1E-10);
+
+    IQMPS rpsi = vpsi.toMPS();
+    CHECK(rpsi.isOrtho());
+    CHECK_EQUAL(rpsi.orthoCenter(),1);
+    CHECK_CLOSE(psiphi(rpsi,psi)/sqrt(psiphi(psi,psi)),1,1E-10);
+
+    //Second order Trotter step, odd and even layers
+    const Real tstep = 0.1;
+    std::vector<IQGate> gates;
+    for(int b = 1; b < N; ++b)
+        {
+        if(b%2 == 0) continue;
+        IQTensor hh = shmodel.op("Sz",b)*shmodel.op("Sz",b+1) 
+                    + 0.5*shmodel.op("Sp",b)*shmodel.op("Sm",b+1) 
+                    + 0.5*shmodel.op("Sm",b)*shmodel.op("Sp",b+1);
+        gates.push_back(IQGate(shmodel,b,b+1,IQGate::tReal,tstep/2,hh));
+        }
+    const int nodd = gates.size();
+    for(int b = 2; b < N; b += 2)
+        {
+        IQTensor hh = shmodel.op("Sz",b)*shmodel.op("Sz",b+1) 
+                    + 0.5*shmodel.op("Sp",b)*shmodel.op("Sm",b+1) 
+                    + 0.5*shmodel.op("Sm",b)*shmodel.op("Sp",b+1);
+        gates.push_back(IQGate(shmodel,b,b+1,IQGate::tReal,tstep,hh));
+        }
+    for(int n = 0; n < nodd; ++n) gates.push_back(gates.at(n));
+
+    IQMPS mpsi(shNeel);
+    gateTEvol(gates,1,tstep,mpsi,Opt("Cutoff",1E-12));
+
+    IQVidalMPS vneel(IQMPS(shNeel),Opt("Cutoff",1E-12));
+    const Real nrm = gateTEvol(gates,1,tstep,vneel,NumThreads(2));
+    CHECK_CLOSE(nrm,1,1E-8);
+    IQMPS vres = vneel.toMPS();
+    Real re = 0, im = 0;
+    psiphi(vres,mpsi,re,im);
+    CHECK_CLOSE(sqrt(re*re+im*im),1,1E-8);
+    }
+
+TEST(TrotterGates)
+    {
+    const int Ns = 6;
+    SpinHalf model(Ns);
+    std::vector<IQTensor> bondH(Ns);
+    for(int b = 1; b < Ns; ++b)
+        {
+        bondH.at(b) = model.op("Sz",b)*model.op("Sz",b+1) 
+                    + 0.5*model.op("Sp",b)*model.op("Sm",b+1) 
+                    + 0.5*model.op("Sm",b)*model.op("Sp",b+1);
+        }
+    InitState neel(model);
+    for(int j = 1; j <= Ns; ++j)
+        {
+        neel.set(j,j%2==1 ? "Up" : "Dn");
+        }
+    const OptSet opts = Opt("Cutoff",1E-14);
+
+    //Reference from small fourth order steps
+    TrotterSchedule<IQTensor> ref(model,bondH,IQGate::tReal,0.01,Opt("Order",4));
+    IQMPS rpsi(neel);
+    gateTEvol(ref,1,rpsi,opts);
+
+    //Half steps of neighboring time steps are merged:
+    //3 odd bond gates, then 2 even and 3 odd gates per step
+    TrotterSchedule<IQTensor> s2(model,bondH,IQGate::tReal,0.1);
+    CHECK(s2.head().size() == 3);
+    CHECK(s2.body().size() == 5);
+    CHECK(s2.numGates(10) == 53);
+
+    //Evolving for no time applies no gates
+    CHECK(s2.numGates(0) == 0);
+    IQMPS zpsi(neel);
+    CHECK_CLOSE(gateTEvol(s2,0,zpsi,opts),1,1E-12);
+    CHECK_CLOSE(psiphi(zpsi,IQMPS(neel)),1,1E-12);
+    IQVidalMPS zvpsi(IQMPS(neel),opts);
+    CHECK_CLOSE(gateTEvol(s2,0,zvpsi,opts),1,1E-12);
+    CHECK_CLOSE(psiphi(zvpsi.toMPS(),IQMPS(neel)),1,1E-12);
+
+    Real err[5];
+    const int orders[] = { 1, 2, 4 };
+    for(int n = 0; n < 3; ++n)
+        {
+        const int ord = orders[n];
+        TrotterSchedule<IQTensor> sched(model,bondH,IQGate::tReal,0.1,Opt("Order",ord));
+        IQMPS psi(neel);
+        const Real nrm = gateTEvol(sched,1,psi,opts);
+        CHECK_CLOSE(nrm,1,1E-8);
+        Real re = 0, im = 0;
+        psiphi(psi,rpsi,re,im);
+        err[ord] = sqrt(fabs(2-2*sqrt(re*re+im*im)));
+        }
+    CHECK(err[1] > 10*err[2]);
+    CHECK(err[2] > 10*err[4]);
+
+    //Same result for an MPS in Vidal form
+    TrotterSchedule<IQTensor> s4(model,bondH,IQGate::tReal,0.1,Opt("Order",4));
+    IQMPS psi(neel);
+    gateTEvol(s4,1,psi,opts);
+    IQVidalMPS vpsi(IQMPS(neel),opts);
+    gateTEvol(s4,1,vpsi,NumThreads(2));
+    Real re = 0, im = 0;
+    psiphi(vpsi.toMPS(),psi,re,im);
+    CHECK_CLOSE(sqrt(re*re+im*im),1,1E-8);
+
+    //A single bond: each step fuses into one gate
+    SpinHalf model2(2);
+    std::vector<IQTensor> bondH2(2);
+    bondH2.at(1) = model2.op("Sz",1)*model2.op("Sz",2);
+    TrotterSchedule<IQTensor> s1(model2,bondH2,IQGate::tImag,0.1,Opt("Order",4));
+    CHECK(s1.head().empty());
+    CHECK(s1.body().size() == 1);
+    }
+
+TEST(BinaryMPSFile)
+    {
+    IQMPS psi(shNeel);
+    psi.position(1);
+    //Entangle the state a little
+    for(int j = 1; j < N; ++j)
+        {
+        IQTensor AA = psi.A(j)*psi.A(j+1),
+                 hop = shmodel.op("Sp",j)*shmodel.op("Sm",j+1)*AA;
+        hop.noprime();
+        AA += 0.3*hop;
+        psi.svdBond(j,AA,Fromleft);
+        }
+    psi.normalize();
+
+    writeBinary(".read_write/IQMPS.bin",psi);
+    IQMPS bpsi(shmodel);
+    readBinary(".read_write/IQMPS.bin",bpsi,Opt("Verify"));
+    CHECK(bpsi.leftLim() == psi.leftLim());
+    CHECK(bpsi.rightLim() == psi.rightLim());
+    CHECK_CLOSE(psiphi(bpsi,psi),1,1E-12);
+
+    //Loaded tensors can be modified freely
+    bpsi.Anc(3) *= 2;
+    bpsi.position(N);
+    IQMPS cpsi(shmodel);
+    readBinary(".read_write/IQMPS.bin",cpsi);
+    CHECK_CLOSE(psiphi(cpsi,psi),1,1E-12);
+    CHECK_CLOSE(psiphi(bpsi,psi),2,1E-12);
+
+    //Old format
+    writeToFile(".read_write/IQMPS.old",psi);
+    IQMPS opsi(shmodel);
+    readBinary(".read_write/IQMPS.old",opsi);
+    CHECK_CLOSE(psiphi(opsi,psi),1,1E-12);
+
+    //Tensors written to disk by doWrite(true)
+    IQMPS dpsi(psi);
+    dpsi.doWrite(true);
+    dpsi.position(N/2);
+    writeBinary(".read_write/IQMPS.bin",dpsi);
+    IQMPS rpsi(shmodel);
+    readBinary(".read_write/IQMPS.bin",rpsi);
+    CHECK_CLOSE(psiphi(rpsi,psi),1,1E-12);
+    }
 
 BOOST_AUTO_TEST_SUITE_END()
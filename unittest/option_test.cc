@@ -53,6 +53,12 @@ TEST(TestOptSet)
     CHECK(opts1.get("Quiet").name() == "Quiet");
     CHECK(opts1.getBool("Quiet") == false);
 
+    //String literals are string values, not bools
+    OptSet sopts(Opt("Compress","LZ"));
+    CHECK(sopts.getString("Compress") == "LZ");
+    sopts.add("Name","value");
+    CHECK(sopts.getString("Name") == "value");
+
     OptSet opts2(opts1);
     opts2.add(o3,o4);
 
@@ -1,5 +1,6 @@
 #include "test.h"
 #include "svdalgs.h"
+#include "threadpool.h"
 #include <boost/test/unit_test.hpp>
 
 using namespace std;
@@ -429,6 +430,72 @@ TEST(ComplexSVD)
     CHECK(diff.norm() < 1E-10);
     }
 
+TEST(ThreadedBlockSVD)
+    {
+    ThreadPool::instance().resize(3);
+
+    IQTensor L(L1,S1,Mid),R(Mid,S2,L2);
+    IQTSparse V(Mid);
+    Spectrum spec = csvd(Phi0,L,V,R,NumThreads(3));
+    CHECK((L*V*R-Phi0).norm() < 1E-12);
+
+    IQTensor sL(L1,S1,Mid),sR(Mid,S2,L2);
+    IQTSparse sV(Mid);
+    Spectrum sspec = csvd(Phi0,sL,sV,sR);
+    CHECK_EQUAL(spec.eigsKept().Length(),sspec.eigsKept().Length());
+    CHECK(Norm(spec.eigsKept()-sspec.eigsKept()) < 1E-14);
+
+    IQTensor TR(L1(1),primed(L1(31))),
+             TI(L1(1),primed(L1(31)));
+    IQTensor T = Complex_1*TR+Complex_i*TI;
+    T.randomize();
+    T *= 1.0/T.norm();
+    IQTensor U(L1),W;
+    IQTSparse D;
+    svd(T,U,D,W,NumThreads(3));
+    CHECK((T-U*D*W).norm() < 1E-10);
+
+    ThreadPool::instance().resize(0);
+    }
+
+TEST(DecompOptions)
+    {
+    DecompOpts defaults;
+    CHECK(!defaults.showEigs());
+    CHECK(!defaults.useSVD());
+    CHECK_EQUAL(defaults.nthread(),1);
+
+    DecompOpts dopts(Opt("UseSVD") & NumThreads(2) & DoNormalize(true));
+    CHECK(dopts.useSVD());
+    CHECK(dopts.doNormalize());
+    CHECK(!dopts.useOrigM());
+    CHECK(!dopts.traceReIm());
+    CHECK_EQUAL(dopts.nthread(),2);
+
+    //Same decomposition with the options
+    //as an OptSet or already looked up
+    IQTensor L(L1,S1),R;
+    IQTSparse D;
+    Spectrum spec;
+    spec.maxm(20);
+    svd(Phi0,L,D,R,spec,NumThreads(2));
+
+    IQTensor dL(L1,S1),dR;
+    IQTSparse dD;
+    Spectrum dspec;
+    dspec.maxm(20);
+    svd(Phi0,dL,dD,dR,dspec,dopts);
+
+    CHECK_EQUAL(spec.eigsKept().Length(),dspec.eigsKept().Length());
+    CHECK(Norm(spec.eigsKept()-dspec.eigsKept()) < 1E-14);
+    CHECK((L*D*R-dL*dD*dR).norm() < 1E-12);
+
+    IQTensor A(L1,S1),B;
+    Spectrum aspec;
+    denmatDecomp(Phi0,A,B,Fromleft,aspec,LocalOp<IQTensor>::Null(),DecompOpts());
+    CHECK((A*B-Phi0).norm() < 1E-10);
+    }
+
 TEST(ComplexDenmat)
     {
     Index r("r",4),c("c",4);
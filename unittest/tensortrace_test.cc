@@ -0,0 +1,157 @@
+#include "test.h"
+#include "tensortrace.h"
+#include "svdalgs.h"
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using boost::format;
+
+struct TensorTraceDefaults
+    {
+    const Index l1, s1, l2;
+    IQIndex L1, S1, L2;
+
+    TensorTraceDefaults()
+        :
+        l1(Index("l1",4)),
+        s1(Index("s1",2,Site)),
+        l2(Index("l2",3))
+        {
+        L1 = IQIndex("L1",
+                     Index("L1 Up",2),QN(+1),
+                     Index("L1 Z0",3),QN( 0),
+                     Index("L1 Dn",2),QN(-1),
+                     Out);
+        S1 = IQIndex("S1",
+                     Index("S1 Up",1,Site),QN(+1),
+                     Index("S1 Dn",1,Site),QN(-1),
+                     Out);
+        L2 = IQIndex("L2",
+                     Index("L2 UU",2),QN(+2),
+                     Index("L2 Z0",3),QN( 0),
+                     Index("L2 DD",2),QN(-2),
+                     Out);
+        }
+
+    ~TensorTraceDefaults()
+        {
+        TensorTrace::stop();
+        }
+    };
+
+BOOST_FIXTURE_TEST_SUITE(TensorTraceTest,TensorTraceDefaults)
+
+TEST(RecordAndRead)
+    {
+    const string fname = ".read_write/Trace";
+
+    ITensor A(l1,s1), B(s1,l2), C(l1,s1);
+    A.randomize();
+    B.randomize();
+    C.randomize();
+
+    CHECK(!TensorTrace::active());
+    TensorTrace::start(fname);
+    CHECK(TensorTrace::active());
+    CHECK(!TensorTrace::withData());
+
+    ITensor AB = A*B;
+    ITensor AC = A + C;
+    ITensor U,V;
+    ITSparse D;
+    Spectrum spec;
+    svdRank2(AB,l1,l2,U,D,V,spec);
+
+    //The block products of an IQTensor contraction
+    //are not recorded separately
+    IQTensor QA(L1(1),S1(1)), QB(conj(S1)(1),L2(3));
+    QA.randomize();
+    QB.randomize();
+    IQTensor QAB = QA*QB;
+
+    TensorTrace::stop();
+    CHECK(!TensorTrace::active());
+    CHECK_EQUAL(TensorTrace::numRecorded(),4);
+
+    //Operations after stop are not recorded
+    AB = A*B;
+
+    TraceReader reader(fname);
+    CHECK(!reader.withData());
+    TraceRecord rec;
+
+    CHECK(reader.next(rec));
+    CHECK_EQUAL(rec.type,TensorTrace::Contract);
+    CHECK(!rec.iq);
+    CHECK(rec.A.indices().index(1) == l1);
+    CHECK(rec.A.indices().index(2) == s1);
+    CHECK(rec.B.indices().index(2) == l2);
+    CHECK(rec.wall >= 0);
+
+    CHECK(reader.next(rec));
+    CHECK_EQUAL(rec.type,TensorTrace::Add);
+    CHECK(rec.B.indices() == C.indices());
+
+    CHECK(reader.next(rec));
+    CHECK_EQUAL(rec.type,TensorTrace::SVD);
+    CHECK(rec.ui == l1);
+    CHECK(rec.vi == l2);
+    CHECK(rec.replay() >= 0);
+
+    CHECK(reader.next(rec));
+    CHECK_EQUAL(rec.type,TensorTrace::Contract);
+    CHECK(rec.iq);
+    //IQTensor::operator* computes QA*QB as QB *= QA
+    CHECK(hasindex(rec.QA,L2));
+    CHECK(hasindex(rec.QB,L1));
+    CHECK_EQUAL(rec.QA.iten_size(),QB.iten_size());
+    CHECK_EQUAL(rec.QB.iten_size(),QA.iten_size());
+    CHECK(rec.replay() >= 0);
+
+    CHECK(!reader.next(rec));
+    }
+
+TEST(RecordData)
+    {
+    const string fname = ".read_write/TraceData";
+
+    IQTensor QA(L1(1),S1(1),conj(L2)(1)), QB(L2(1),conj(S1)(1));
+    QA.randomize();
+    QB.randomize();
+
+    TensorTrace::start(fname,Opt("TraceData"));
+    CHECK(TensorTrace::withData());
+    IQTensor QAB = QA*QB;
+    IQTensor rho = QA*conj(primed(QA,L1));
+    IQTensor U;
+    IQTSparse D;
+    Spectrum spec;
+    diag_hermitian(rho,U,D,spec);
+    TensorTrace::stop();
+
+    TraceReader reader(fname);
+    CHECK(reader.withData());
+    TraceRecord rec;
+
+    CHECK(reader.next(rec));
+    CHECK_EQUAL(rec.type,TensorTrace::Contract);
+    CHECK_CLOSE((rec.QA-QB).norm(),0,1E-12);
+    CHECK_CLOSE((rec.QB-QA).norm(),0,1E-12);
+
+    //Replaying the contraction gives the same result
+    IQTensor R(rec.QA);
+    R *= rec.QB;
+    CHECK_CLOSE((R-QAB).norm(),0,1E-12);
+
+    CHECK(reader.next(rec));
+    CHECK_EQUAL(rec.type,TensorTrace::Contract);
+
+    CHECK(reader.next(rec));
+    CHECK_EQUAL(rec.type,TensorTrace::Eigen);
+    CHECK_CLOSE((rec.QA-rho).norm(),0,1E-12);
+    CHECK(rec.replay() >= 0);
+
+    CHECK(!reader.next(rec));
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,236 @@
+#include "test.h"
+#include "parallel.h"
+#include "itensor.h"
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using boost::format;
+
+struct ThreadPoolDefaults
+    {
+    ThreadPoolDefaults()
+        {
+        ThreadPool::instance().resize(4);
+        }
+
+    ~ThreadPoolDefaults()
+        {
+        ThreadPool& pool = ThreadPool::instance();
+        pool.resize(0);
+        pool.maxNesting(1);
+        pool.timing(false);
+        pool.resetStats();
+        }
+    };
+
+class CountTask
+    {
+    public:
+
+    CountTask(vector<int>& count) : count_(count) { }
+
+    void
+    operator()(int n) const { ++count_.at(n); }
+
+    private:
+
+    vector<int>& count_;
+    };
+
+class TermTask
+    {
+    public:
+
+    TermTask(const vector<ITensor>& terms) : terms_(terms) { }
+
+    void
+    operator()(int n, ITensor& term) const { term = terms_.at(n); }
+
+    private:
+
+    const vector<ITensor>& terms_;
+    };
+
+class NestedTask
+    {
+    public:
+
+    NestedTask(vector<vector<int> >& count, vector<int>& depth, vector<int>& allowed)
+        : count_(count), depth_(depth), allowed_(allowed) { }
+
+    void
+    operator()(int n) const
+        {
+        depth_.at(n) = ThreadPool::depth();
+        allowed_.at(n) = ThreadPool::instance().parallelAllowed();
+        parallelFor(CountTask(count_.at(n)),count_.at(n).size(),3);
+        }
+
+    private:
+
+    vector<vector<int> >& count_;
+    vector<int>& depth_;
+    vector<int>& allowed_;
+    };
+
+//Makes, copies and destroys matrices and vectors,
+//some of them sharing the storage of m
+class StorageTask
+    {
+    public:
+
+    StorageTask(const Matrix& m) : m_(m) { }
+
+    void
+    operator()(int n) const
+        {
+        for(int k = 0; k < 200; ++k)
+            {
+            Matrix empty;
+            Vector v(3+n%5,1.0);
+            Vector vc(v);
+            MatrixRef shared = m_;
+            Matrix copy(shared);
+            copy *= 2;
+            empty = copy;
+            }
+        }
+
+    private:
+
+    const Matrix& m_;
+    };
+
+class FailingTask
+    {
+    public:
+
+    void
+    operator()(int n) const
+        {
+        if(n == 7) throw ITError("task 7 failed");
+        }
+    };
+
+BOOST_FIXTURE_TEST_SUITE(ThreadPoolTest,ThreadPoolDefaults)
+
+TEST(Resize)
+    {
+    ThreadPool& pool = ThreadPool::instance();
+    CHECK_EQUAL(pool.nthread(),4);
+    CHECK_EQUAL(ThreadPool::depth(),0);
+    CHECK(pool.parallelAllowed());
+
+    pool.resize(2);
+    CHECK_EQUAL(pool.nthread(),2);
+    pool.resize(0);
+    CHECK_EQUAL(pool.nthread(),ThreadPool::defaultThreads());
+    }
+
+TEST(ParallelForCoversAll)
+    {
+    const int ntask = 1000;
+    vector<int> count(ntask,0);
+    parallelFor(CountTask(count),ntask,4);
+    for(int n = 0; n < ntask; ++n) CHECK_EQUAL(count.at(n),1);
+
+    //More threads than tasks or than the pool has
+    vector<int> few(3,0);
+    parallelFor(CountTask(few),3,8);
+    for(int n = 0; n < 3; ++n) CHECK_EQUAL(few.at(n),1);
+    }
+
+TEST(ParallelSumFixedOrder)
+    {
+    Index i("i",5), j("j",4);
+    vector<ITensor> terms(17,ITensor(i,j));
+    Foreach(ITensor& t, terms) t.randomize();
+
+    ITensor serial;
+    parallelSum(TermTask(terms),terms.size(),serial,1);
+
+    ITensor s1, s2;
+    parallelSum(TermTask(terms),terms.size(),s1,3);
+    parallelSum(TermTask(terms),terms.size(),s2,3);
+
+    CHECK((s1-serial).norm() < 1E-12);
+    //Same nthread gives the same result exactly
+    CHECK_EQUAL((s1-s2).norm(),0);
+    }
+
+TEST(NestedParallelism)
+    {
+    ThreadPool& pool = ThreadPool::instance();
+
+    const int nouter = 6;
+    vector<vector<int> > count(nouter,vector<int>(50,0));
+    vector<int> depth(nouter,-1),
+                allowed(nouter,-1);
+
+    //Default: nested regions run serially
+    parallelFor(NestedTask(count,depth,allowed),nouter,3);
+    for(int n = 0; n < nouter; ++n)
+        {
+        CHECK_EQUAL(depth.at(n),1);
+        CHECK_EQUAL(allowed.at(n),0);
+        Foreach(int c, count.at(n)) CHECK_EQUAL(c,1);
+        }
+    CHECK_EQUAL(ThreadPool::depth(),0);
+
+    //Nested regions in parallel, tasks waiting
+    //on tasks must not deadlock the pool
+    pool.maxNesting(2);
+    count.assign(nouter,vector<int>(50,0));
+    parallelFor(NestedTask(count,depth,allowed),nouter,3);
+    for(int n = 0; n < nouter; ++n)
+        {
+        CHECK_EQUAL(allowed.at(n),1);
+        Foreach(int c, count.at(n)) CHECK_EQUAL(c,1);
+        }
+    }
+
+TEST(MatrixStorage)
+    {
+    Matrix m(4,4);
+    m = 1;
+    const int nobj = StoreLink::NumObjects(),
+              storage = StoreLink::TotalStorage();
+
+    parallelFor(StorageTask(m),64,4);
+
+    //Reference counts and storage counters
+    //are back where they started
+    CHECK_EQUAL(m.NumRef(),1);
+    CHECK_EQUAL(StoreLink::NumObjects(),nobj);
+    CHECK_EQUAL(StoreLink::TotalStorage(),storage);
+    CHECK_CLOSE(m(2,2),1,1E-15);
+    CHECK_CLOSE(m(2,3),0,1E-15);
+    }
+
+TEST(Errors)
+    {
+    CHECK_THROW(parallelFor(FailingTask(),20,4),ITError);
+
+    //Pool is still usable
+    vector<int> count(10,0);
+    parallelFor(CountTask(count),10,4);
+    Foreach(int c, count) CHECK_EQUAL(c,1);
+    }
+
+TEST(Timing)
+    {
+    ThreadPool& pool = ThreadPool::instance();
+    pool.resetStats();
+    pool.timing(true);
+
+    vector<int> count(20,0);
+    parallelFor(CountTask(count),20,4,"Counting");
+
+    const PoolStats st = pool.stats();
+    CHECK(st.tasks.count("Counting") == 1);
+    //One task per thread besides the calling thread
+    CHECK_EQUAL(st.tasks.find("Counting")->second.ntask,3);
+    CHECK(st.tasks.find("Counting")->second.total >= 0);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -34,6 +34,25 @@ double mytime()
 
 #endif
 
+double mywalltime()
+    {
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec + 1e-6 * tv.tv_usec;
+    }
+
+double mypeakmem()
+    {
+    struct rusage result;
+    getrusage(RUSAGE_SELF,&result);
+    //ru_maxrss is in kilobytes on Linux, bytes on Mac OS X
+#ifdef __APPLE__
+    return result.ru_maxrss;
+#else
+    return 1024. * result.ru_maxrss;
+#endif
+    }
+
 ostream & operator << (ostream & s, const cpu_time & t)
     {
     double time = t.time;
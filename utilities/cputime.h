@@ -10,6 +10,12 @@
 
 double mytime();
 
+//Wall clock time in seconds (arbitrary origin)
+double mywalltime();
+
+//Peak resident memory of this process in bytes
+double mypeakmem();
+
 class init_time
     {
 public: